@@ -0,0 +1,161 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   bench.tcl
+#
+# PROJECT:
+#   athena-mars
+#
+# DESCRIPTION:
+#   Mars benchmark harness: main program.
+#
+#   Usage: tclsh bench.tcl ?options...? ?file.bench...?
+#
+#   Sources the named *.bench files, or all *.bench files in this
+#   directory, runs the benchmarks they define, and writes a JSON
+#   report of ops/sec and per-operation latencies.  If a baseline
+#   report is given, each result is compared with the baseline, and
+#   the exit status is 1 if any benchmark has regressed.
+#
+#   Options:
+#
+#     -match pattern      Run only benchmarks matching the glob pattern
+#     -samples n          Timed samples per benchmark; default 20
+#     -warmup n           Untimed warmup samples; default 2
+#     -nbhoods n          uramdb(n) mkperfdb scaling options; see
+#     -civgroups n        uramdb(n) for the defaults.
+#     -frcgroups n
+#     -orggroups n
+#     -actors n
+#     -cells n            Cells per synthetic cellmodel(5) model
+#     -events n           Events per eventq(n) sample
+#     -polygons n         Polygons per geometry sample
+#     -systems n          mam(n) systems
+#     -topics n           mam(n) topics
+#     -out file           Write the JSON report to file, not stdout
+#     -baseline file      Compare against this JSON report
+#     -tolerance pct      Allowable ops/sec change; default 10
+#
+#   Progress and the comparison are written to stderr.
+#
+#-----------------------------------------------------------------------
+
+#-----------------------------------------------------------------------
+# Load the packages to be benchmarked
+
+set benchdir [file dirname [file normalize [info script]]]
+
+source [file join $benchdir .. lib simlib pkgModules.tcl]
+namespace import ::kiteutils::*
+namespace import ::marsutil::*
+namespace import ::simlib::*
+
+source [file join $benchdir benchlib.tcl]
+
+#-----------------------------------------------------------------------
+# Main Program
+
+# main argv
+#
+# argv     Command line arguments
+#
+# Parses the arguments, runs the benchmarks, and writes the report.
+
+proc main {argv} {
+    global benchdir
+
+    # FIRST, parse the options.
+    set outfile   ""
+    set basefile  ""
+    set tolerance 10.0
+
+    while {[string match "-*" [lindex $argv 0]]} {
+        set opt [lshift argv]
+
+        switch -exact -- $opt {
+            -out       { set outfile   [lshift argv] }
+            -baseline  { set basefile  [lshift argv] }
+            -tolerance { set tolerance [lshift argv] }
+
+            default {
+                set name [string range $opt 1 end]
+
+                if {[catch {bench::parm $name [lshift argv]} result]} {
+                    puts stderr $result
+                    exit 1
+                }
+            }
+        }
+    }
+
+    # NEXT, read the baseline now, so that a bad file is reported
+    # before the benchmarks are run.
+    if {$basefile ne ""} {
+        set baseline [dict get [bench::fromjson [readfile $basefile]] \
+                          benchmarks]
+    }
+
+    # NEXT, define and run the benchmarks.
+    if {[llength $argv] == 0} {
+        set argv [lsort [glob -directory $benchdir *.bench]]
+    }
+
+    foreach file $argv {
+        uplevel #0 [list source $file]
+    }
+
+    set results [bench::runAll [list puts stderr]]
+
+    # NEXT, compare with the baseline.
+    set regressions 0
+
+    if {$basefile ne ""} {
+        set results [bench::compare $results $baseline $tolerance]
+
+        puts stderr "\nCompared with $basefile (tolerance $tolerance%):"
+
+        foreach r $results {
+            if {[dict get $r status] eq "new"} {
+                puts stderr [format "%-24s %8s  new" [dict get $r name] ""]
+                continue
+            }
+
+            puts stderr [format "%-24s %+7.1f%%  %s" \
+                             [dict get $r name]       \
+                             [dict get $r change_pct] \
+                             [dict get $r status]]
+
+            if {[dict get $r status] eq "regression"} {
+                incr regressions
+            }
+        }
+    }
+
+    # NEXT, write the report.
+    set report [dict create \
+                    date       [clock format [clock seconds] \
+                                    -format "%Y-%m-%dT%H:%M:%S"] \
+                    host       [info hostname] \
+                    platform   $::tcl_platform(os)-$::tcl_platform(machine) \
+                    tcl        [info patchlevel] \
+                    marsbin    [expr {[llength [package provide Marsbin]] > 0}] \
+                    samples    [bench::parm samples] \
+                    parms      [bench::parms] \
+                    benchmarks $results]
+
+    set json [bench::tojson $report]
+
+    if {$outfile ne ""} {
+        set f [open $outfile w]
+        puts $f $json
+        close $f
+    } else {
+        puts $json
+    }
+
+    exit [expr {$regressions > 0}]
+}
+
+#-----------------------------------------------------------------------
+# Invoke the program
+
+main $argv
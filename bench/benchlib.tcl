@@ -0,0 +1,505 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   benchlib.tcl
+#
+# PROJECT:
+#   athena-mars
+#
+# DESCRIPTION:
+#   Mars benchmark harness: benchmark definition, timing, statistics,
+#   and JSON input/output.
+#
+#   A benchmark is defined in a *.bench file by a call to
+#   "bench::bench", which is analogous to tcltest(n)'s "test":
+#
+#     bench::bench uram.advance {uram advance, one tick} -setup {
+#         ...
+#     } -body {
+#         ...
+#     } -cleanup {
+#         ...
+#     } -ops 1
+#
+#   The setup, body, and cleanup scripts are evaluated in the global
+#   namespace, once per sample; only the body is timed.  If the body
+#   performs more than one operation, e.g., it loops over a list of
+#   polygons, -ops gives the number of operations, so that ops/sec and
+#   the per-operation latencies are computed correctly.
+#
+#   Benchmarks are scaled by parameters, e.g., the number of
+#   neighborhoods, which are set on the bench.tcl command line and
+#   retrieved by the *.bench files using "bench::parm".
+#
+#-----------------------------------------------------------------------
+
+namespace eval ::bench:: {
+    # parms: Array of benchmark parameters by name.  The defaults
+    # are set here; bench.tcl overrides them from the command line.
+
+    variable parms
+    array set parms {
+        nbhoods   10
+        civgroups 2
+        frcgroups 4
+        orggroups 4
+        actors    4
+        cells     200
+        events    1000
+        polygons  100
+        systems   20
+        topics    10
+        samples   20
+        warmup    2
+        match     *
+    }
+
+    # defs: List of benchmark definitions, in order of definition.
+    # Each definition is a dictionary with keys name, title, setup,
+    # body, cleanup, and ops.
+
+    variable defs [list]
+
+    # results: List of result dictionaries, in order of execution.
+    variable results [list]
+}
+
+#-----------------------------------------------------------------------
+# Benchmark Definition
+
+# parm name ?value?
+#
+# name     A parameter name, e.g., "nbhoods"
+# value    A new value
+#
+# Sets and/or returns the value of the named parameter.
+
+proc ::bench::parm {name args} {
+    variable parms
+
+    if {![info exists parms($name)]} {
+        error "Unknown benchmark parameter: \"$name\""
+    }
+
+    if {[llength $args] == 1} {
+        set parms($name) [lindex $args 0]
+    } elseif {[llength $args] > 1} {
+        error "wrong # args: should be \"bench::parm name ?value?\""
+    }
+
+    return $parms($name)
+}
+
+# parms
+#
+# Returns a dictionary of the scaling parameters, i.e., all parameters
+# but those that control the harness itself.
+
+proc ::bench::parms {} {
+    variable parms
+
+    set result [dict create]
+
+    foreach name [lsort [array names parms]] {
+        if {$name ni {samples warmup match}} {
+            dict set result $name $parms($name)
+        }
+    }
+
+    return $result
+}
+
+# bench name title ?options...?
+#
+# name     The benchmark name, "<module>.<operation>"
+# title    A one-line description
+#
+# Options:
+#
+#   -setup script     Untimed script run before each sample
+#   -body script      The script to time
+#   -cleanup script   Untimed script run after each sample
+#   -ops n            Number of operations performed by the body;
+#                     defaults to 1.
+#
+# Defines a benchmark.  Benchmarks whose names don't match the "match"
+# parameter are ignored.
+
+proc ::bench::bench {name title args} {
+    variable defs
+
+    set def [dict create \
+                 name    $name \
+                 title   $title \
+                 setup   {} \
+                 body    {} \
+                 cleanup {} \
+                 ops     1]
+
+    foreach {opt val} $args {
+        switch -exact -- $opt {
+            -setup   -
+            -body    -
+            -cleanup -
+            -ops     {
+                dict set def [string range $opt 1 end] $val
+            }
+
+            default {
+                error "Unknown option: \"$opt\""
+            }
+        }
+    }
+
+    if {![string match [parm match] $name]} {
+        return
+    }
+
+    lappend defs $def
+    return
+}
+
+#-----------------------------------------------------------------------
+# Execution
+
+# runAll ?logcmd?
+#
+# logcmd    A command prefix called with a line of progress text
+#
+# Runs all defined benchmarks, returning the list of result
+# dictionaries.
+
+proc ::bench::runAll {{logcmd ""}} {
+    variable defs
+    variable results
+
+    set results [list]
+
+    foreach def $defs {
+        set result [Run $def]
+        lappend results $result
+
+        if {$logcmd ne ""} {
+            {*}$logcmd [format "%-24s %12.1f ops/sec  p50 %10.4f ms  p99 %10.4f ms" \
+                            [dict get $result name]        \
+                            [dict get $result ops_per_sec] \
+                            [dict get $result p50_ms]      \
+                            [dict get $result p99_ms]]
+        }
+    }
+
+    return $results
+}
+
+# Run def
+#
+# def     A benchmark definition
+#
+# Runs the warmup and timed samples for the benchmark, and returns
+# a result dictionary.
+
+proc ::bench::Run {def} {
+    dict with def {}
+
+    set nsamples [parm samples]
+    set times [list]
+
+    for {set i -[parm warmup]} {$i < $nsamples} {incr i} {
+        uplevel #0 $setup
+
+        set t0 [clock microseconds]
+        uplevel #0 $body
+        set t1 [clock microseconds]
+
+        uplevel #0 $cleanup
+
+        if {$i >= 0} {
+            lappend times [expr {$t1 - $t0}]
+        }
+    }
+
+    return [Stats $name $title $ops $times]
+}
+
+# Stats name title ops times
+#
+# name     The benchmark name
+# title    The benchmark title
+# ops      Operations per sample
+# times    List of sample times in microseconds
+#
+# Computes the result dictionary.  Latencies are per operation,
+# in milliseconds.  The ops/sec figure is computed from the median
+# latency rather than the mean, so that an occasional slow sample,
+# e.g., due to a page fault, doesn't register as a regression.
+
+proc ::bench::Stats {name title ops times} {
+    set n [llength $times]
+    set total [tcl::mathop::+ {*}$times]
+
+    set lats [list]
+    foreach t [lsort -integer $times] {
+        lappend lats [expr {$t/1000.0/$ops}]
+    }
+
+    set p50 [Percentile $lats 50]
+
+    if {$p50 > 0} {
+        set opsPerSec [expr {1000.0/$p50}]
+    } else {
+        set opsPerSec 0.0
+    }
+
+    dict create \
+        name        $name                                \
+        title       $title                               \
+        samples     $n                                   \
+        ops         $ops                                 \
+        ops_per_sec [Round $opsPerSec]                   \
+        mean_ms     [Round [expr {$total/1000.0/$ops/$n}]] \
+        min_ms      [Round [lindex $lats 0]]             \
+        p50_ms      [Round $p50]                         \
+        p99_ms      [Round [Percentile $lats 99]]        \
+        max_ms      [Round [lindex $lats end]]
+}
+
+# Percentile sorted pct
+#
+# sorted    A sorted list of numbers
+# pct       A percentile, 0 to 100
+#
+# Returns the pct'th percentile of the list, using the nearest-rank
+# method.
+
+proc ::bench::Percentile {sorted pct} {
+    set rank [expr {int(ceil($pct/100.0*[llength $sorted]))}]
+
+    lindex $sorted [expr {max(0, $rank - 1)}]
+}
+
+# Round x
+#
+# Rounds x to six significant digits, for readability.
+
+proc ::bench::Round {x} {
+    expr {double([format %.6g $x])}
+}
+
+#-----------------------------------------------------------------------
+# Baseline Comparison
+
+# compare results baseline tolerance
+#
+# results     A list of result dictionaries
+# baseline    A list of result dictionaries from a previous run
+# tolerance   Allowable slowdown, in percent
+#
+# Adds baseline_ops_per_sec, change_pct, and status fields to each
+# result for which there is a baseline result with the same name.
+# The status is "regression" if ops/sec has dropped by more than
+# the tolerance, "improvement" if it has risen by more than the
+# tolerance, and "ok" otherwise.  Results with no baseline have
+# status "new".
+
+proc ::bench::compare {results baseline tolerance} {
+    foreach b $baseline {
+        set base([dict get $b name]) [dict get $b ops_per_sec]
+    }
+
+    set out [list]
+
+    foreach r $results {
+        set name [dict get $r name]
+
+        if {![info exists base($name)] || $base($name) <= 0} {
+            dict set r status new
+            lappend out $r
+            continue
+        }
+
+        set change [expr {
+            100.0*([dict get $r ops_per_sec] - $base($name))/$base($name)
+        }]
+
+        if {$change < -$tolerance} {
+            set status regression
+        } elseif {$change > $tolerance} {
+            set status improvement
+        } else {
+            set status ok
+        }
+
+        dict set r baseline_ops_per_sec $base($name)
+        dict set r change_pct           [Round $change]
+        dict set r status               $status
+
+        lappend out $r
+    }
+
+    return $out
+}
+
+#-----------------------------------------------------------------------
+# JSON Input/Output
+
+# tojson report
+#
+# report    A report dictionary: a dictionary of scalar values, plus
+#           "parms", a dictionary, and "benchmarks", a list of result
+#           dictionaries.
+#
+# Returns the report as JSON, using huddle.
+
+proc ::bench::tojson {report} {
+    set hud [huddle create]
+
+    dict for {key value} $report {
+        switch -exact -- $key {
+            parms {
+                huddle append hud $key [huddle compile dict $value]
+            }
+
+            benchmarks {
+                set list [huddle list]
+                foreach r $value {
+                    huddle append list [huddle compile dict $r]
+                }
+                huddle append hud $key $list
+            }
+
+            default {
+                huddle append hud $key [huddle compile string $value]
+            }
+        }
+    }
+
+    return [huddle jsondump $hud]
+}
+
+# fromjson text
+#
+# text     A JSON document
+#
+# Parses the JSON, returning the equivalent Tcl value: objects become
+# dictionaries, arrays become lists, and true, false, and null become
+# 1, 0, and the empty string.  This is sufficient for reading the
+# reports written by tojson.
+
+proc ::bench::fromjson {text} {
+    set pos 0
+    set value [JsonValue $text pos]
+    JsonSkip $text pos
+
+    if {$pos < [string length $text]} {
+        error "JSON syntax error at offset $pos"
+    }
+
+    return $value
+}
+
+# JsonValue text posVar
+#
+# Parses the JSON value at the position, leaving the position after it.
+
+proc ::bench::JsonValue {text posVar} {
+    upvar 1 $posVar pos
+
+    JsonSkip $text pos
+
+    switch -exact -- [string index $text $pos] {
+        "\{" {
+            set result [dict create]
+            incr pos
+            JsonSkip $text pos
+
+            if {[string index $text $pos] eq "\}"} {
+                incr pos
+                return $result
+            }
+
+            while 1 {
+                JsonSkip $text pos
+                set key [JsonValue $text pos]
+                JsonExpect $text pos :
+                dict set result $key [JsonValue $text pos]
+
+                if {[JsonExpect $text pos ",\}"] eq "\}"} {
+                    return $result
+                }
+            }
+        }
+
+        "\[" {
+            set result [list]
+            incr pos
+            JsonSkip $text pos
+
+            if {[string index $text $pos] eq "\]"} {
+                incr pos
+                return $result
+            }
+
+            while 1 {
+                lappend result [JsonValue $text pos]
+
+                if {[JsonExpect $text pos ",\]"] eq "\]"} {
+                    return $result
+                }
+            }
+        }
+
+        "\"" {
+            if {![regexp -start $pos -indices {\A"((?:[^"\\]|\\.)*)"} \
+                      $text match inner]} {
+                error "JSON syntax error at offset $pos"
+            }
+
+            set pos [expr {[lindex $match 1] + 1}]
+            return [subst -nocommands -novariables \
+                        [string range $text {*}$inner]]
+        }
+
+        default {
+            if {![regexp -start $pos -indices \
+                      {\A(?:true|false|null|-?[0-9][0-9.eE+-]*)} \
+                      $text match]} {
+                error "JSON syntax error at offset $pos"
+            }
+
+            set token [string range $text {*}$match]
+            set pos [expr {[lindex $match 1] + 1}]
+
+            return [string map {true 1 false 0 null ""} $token]
+        }
+    }
+}
+
+# JsonSkip text posVar
+#
+# Skips whitespace.
+
+proc ::bench::JsonSkip {text posVar} {
+    upvar 1 $posVar pos
+
+    while {[string is space -strict [string index $text $pos]]} {
+        incr pos
+    }
+}
+
+# JsonExpect text posVar chars
+#
+# Skips whitespace, and then expects one of the chars, which is
+# consumed and returned.
+
+proc ::bench::JsonExpect {text posVar chars} {
+    upvar 1 $posVar pos
+
+    JsonSkip $text pos
+    set ch [string index $text $pos]
+
+    if {$ch eq "" || [string first $ch $chars] == -1} {
+        error "JSON syntax error at offset $pos: expected \"$chars\""
+    }
+
+    incr pos
+    return $ch
+}
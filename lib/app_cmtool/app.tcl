@@ -218,6 +218,41 @@ snit::type app {
 
         puts "*** $string $stars\n"
     }
+
+    # Type Method: profile
+    #
+    # Creates a profiler(n) attached to the cell model as module
+    # "cellmodel", for the "-profile" option, and returns its name.
+    #
+    # Syntax:
+    #   profile _cm_
+    #
+    #   cm - The cellmodel(n) object
+
+    typemethod profile {cm} {
+        set prof [profiler %AUTO%]
+        $prof attach cellmodel $cm
+
+        return $prof
+    }
+
+    # Type Method: profiledump
+    #
+    # Outputs a profiler(n)'s statistics as a section of the program's
+    # output, and destroys the profiler.
+    #
+    # Syntax:
+    #   profiledump _prof_
+    #
+    #   prof - A profiler created by <profile>
+
+    typemethod profiledump {prof} {
+        app section "Profile"
+        puts [$prof dump]
+        puts ""
+
+        $prof destroy
+    }
 }
 
 #-----------------------------------------------------------------------
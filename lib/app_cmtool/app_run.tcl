@@ -30,6 +30,7 @@
 #   -epsilon value              - Epsilon for solution
 #   -maxiters value             - Max number of iterations
 #   -case name ?cell value....? - Specifies a case.
+#   -profile                    - Output per-method timings.
 
 snit::type app_run {
     pragma -hasinstances 0
@@ -63,6 +64,7 @@ snit::type app_run {
         set cases [list]
         set epsilon  [$cm cget -epsilon]
         set maxiters [$cm cget -maxiters]
+        set profile  0
 
         while {[llength $argv] > 0 } {
             set opt [lshift argv]
@@ -78,6 +80,10 @@ snit::type app_run {
                         [app validate "$opt:" ::maxiters [lshift argv]]
                 }
 
+                -profile {
+                    set profile 1
+                }
+
                 -case {
                     set case [lshift argv]
 
@@ -116,6 +122,11 @@ snit::type app_run {
             -epsilon  $epsilon  \
             -maxiters $maxiters
 
+        # NEXT, profile the solutions, if requested.
+        if {$profile} {
+            set prof [app profile $cm]
+        }
+
         # NEXT, solve each of the cases.
         foreach case $cases {
             # FIRST, reset the model to its initial values, and apply
@@ -178,6 +189,12 @@ snit::type app_run {
 
             puts ""
         }
+
+        # NEXT, output the profile, if requested.
+        if {$profile} {
+            puts ""
+            app profiledump $prof
+        }
     }
 }
 
@@ -38,6 +38,7 @@
 #  -dumpfinal       - Output dump of final cell values and formulas.
 #  -diffpages a b   - Dumps a comparison of the final values of two 
 #                     pages a and b.
+#  -profile         - Output per-method timings for the cell model.
 #
 # The remaining options apply only to cyclic pages.  The value of
 # each is the name of a cyclic page; each can be repeated to produce
@@ -114,6 +115,7 @@ snit::type app_solve {
             -tracevalues {}
             -tracedeltas {}
             -initfrom    {}
+            -profile     0
         }
         set opts(-epsilon)  [$cm cget -epsilon]
         set opts(-maxiters) [$cm cget -maxiters]
@@ -147,7 +149,8 @@ snit::type app_solve {
                 }
 
                 -dumpstart -
-                -dumpfinal { 
+                -dumpfinal -
+                -profile { 
                     set opts($opt) 1 
                 }
 
@@ -240,6 +243,10 @@ snit::type app_solve {
 
         set convergence [list]
 
+        if {$opts(-profile)} {
+            set prof [app profile $cm]
+        }
+
         set result [$cm solve]
 
         # NEXT, -dumpfinal
@@ -287,6 +294,12 @@ snit::type app_solve {
                 puts "ok"
             }
         }
+
+        # NEXT, -profile
+        if {$opts(-profile)} {
+            puts ""
+            app profiledump $prof
+        }
     }
 
     # Type method: DiffPages
@@ -37,6 +37,7 @@ snit::type app {
     typecomponent msgline           ;# The application message line.
     typecomponent rdb               ;# The runtime database, for nsat(n)
                                      # inputs.
+    typecomponent prof              ;# The profiler(n), if -profile
                                      
     #-------------------------------------------------------------------
     # Group: Application Initialization
@@ -54,6 +55,9 @@ snit::type app {
         # FIRST, handle the command line.
         set uramdbFile  ""
         set initScript ""
+        set profile    0
+        set batchInputs ""
+        set batchOpts   [list]
 
         while {[string match "-*" [lindex $argv 0]]} {
             set opt [lshift argv]
@@ -66,6 +70,19 @@ snit::type app {
                 -script {
                     set initScript [lshift argv]
                 }
+                -profile {
+                    set profile 1
+                }
+                -batch {
+                    set batchInputs [lshift argv]
+                }
+                -replicates -
+                -workers    -
+                -ticks      -
+                -seed       -
+                -out        {
+                    lappend batchOpts $opt [lshift argv]
+                }
                 default {
                     puts "Unknown option: $opt"
                     app usage
@@ -81,6 +98,17 @@ snit::type app {
             exit 1
         }
         
+        # NEXT, in batch mode there's no GUI; run the batch and exit.
+        if {$batchInputs ne ""} {
+            if {$uramdbFile eq ""} {
+                puts "Error: -batch requires a uramdb(5) file."
+                app usage
+                exit 1
+            }
+
+            app RunBatch $uramdbFile $batchInputs $batchOpts
+        }
+
         # NEXT, allow the developer to pop up the debugger window
         # no matter what window they are in.
         bind all <Control-F12> [list debugger new]
@@ -92,6 +120,10 @@ snit::type app {
         parmdb init                    ;# Initialize the parameter database
         sim init                       ;# Initialize the simulation manager
 
+        if {$profile} {
+            app CreateProfiler         ;# Creates ::prof
+        }
+
         # NEXT, define global conditions
         namespace eval ::cond {
             statecontroller dbloaded -events {
@@ -157,6 +189,50 @@ snit::type app {
         rdb clear
     }
 
+    # Type method: CreateProfiler
+    #
+    # Creates the profiler, ::prof, and attaches it to the RDB; the
+    # <sim> attaches it to each uram(n) instance as it is created.
+    # The accumulated statistics are saved to the RDB's temporary
+    # profile_stats table and logged after each simulation step.
+
+    typemethod CreateProfiler {} {
+        set prof [profiler ::prof]
+        prof attachdb rdb ::rdb
+        sim profiler ::prof
+
+        log normal app "Profiling enabled"
+    }
+
+    # Type method: RunBatch
+    #
+    # Runs a <batch> of replicates without the GUI, and exits.  The
+    # exit status is 1 if the batch could not be run or any replicate
+    # failed.
+    #
+    # Syntax:
+    #   app RunBatch _dbfile inputs opts_
+    #
+    #   dbfile - The uramdb(5) file
+    #   inputs - The inputs script
+    #   opts   - <batch> run options
+
+    typemethod RunBatch {dbfile inputs opts} {
+        wm withdraw .
+
+        app CreateLogger
+        app CreateRdb
+        parmdb init
+
+        if {[catch {batch run $dbfile $inputs {*}$opts} result]} {
+            log error app "batch: $::errorInfo"
+            puts "Error: $result"
+            exit 1
+        }
+
+        exit [expr {$result > 0}]
+    }
+
     #-------------------------------------------------------------------
     # Group: Event Handlers
     
@@ -180,8 +256,18 @@ snit::type app {
         puts {Usage: mars uram [options...] [file.uramdb]}
         puts ""
         puts "    -script script.tcl     Execute the named script file."
+        puts "    -profile               Profile uram(n), ucurve(n), and SQL."
+        puts "    -batch inputs.tcl      Run replicates in batch; see below."
         puts "    -help                  Display this text."
         puts ""
+        puts "Batch options (require -batch and a uramdb file):"
+        puts ""
+        puts "    -replicates n          Number of replicates (10)"
+        puts "    -workers n             Number of worker threads (4)"
+        puts "    -ticks n               Ticks per replicate (52)"
+        puts "    -seed n                Base random seed (1)"
+        puts "    -out file.db           Output database (batch.db)"
+        puts ""
         puts "See mars_uram(1) for more information."
     }
 
@@ -0,0 +1,396 @@
+#-----------------------------------------------------------------------
+# FILE: batch.tcl
+#
+# Batch Replicate Manager
+#
+# PACKAGE:
+#   app_uram(n) -- mars_uram(1) implementation package
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+#-----------------------------------------------------------------------
+
+#-----------------------------------------------------------------------
+# Module: batch
+#
+# The batch module runs many replicates of a uramdb(5) scenario
+# concurrently, for Monte-Carlo studies, and aggregates the results
+# into a single output database.  It is used when mars_uram(1) is
+# invoked with the -batch option.
+#
+# The uramdb(5) file is loaded and validated once, into the RDB, and
+# a snapshot of the RDB is written to a temporary file.  The replicates
+# are then run by a pool of worker threads; each worker restores the
+# snapshot into its own in-memory RDB, and runs the replicates it is
+# given using <batchworker>.  The user's inputs script provides the
+# (usually randomized) attitude inputs for each replicate.
+#
+# The results are saved to the output database as they arrive, and
+# progress is reported to stdout and to the log.
+
+snit::type batch {
+    pragma -hasinstances no
+
+    #-------------------------------------------------------------------
+    # Group: Type Variables
+
+    # Type variable: schema
+    #
+    # The schema of the output database.  The *_stats views summarize
+    # the time series across the successful replicates.
+
+    typevariable schema {
+        CREATE TABLE IF NOT EXISTS batch_info (
+            parm  TEXT PRIMARY KEY,
+            value TEXT
+        );
+
+        CREATE TABLE IF NOT EXISTS batch_runs (
+            rep    INTEGER PRIMARY KEY,   -- Replicate number
+            seed   INTEGER,               -- Random seed
+            status TEXT,                  -- ok or error
+            error  TEXT,                  -- Error message, if any
+            msecs  INTEGER                -- Wall-clock run time
+        );
+
+        CREATE TABLE IF NOT EXISTS batch_mood (
+            rep  INTEGER,
+            t    INTEGER,
+            g    TEXT,
+            mood DOUBLE,
+            PRIMARY KEY (rep, t, g)
+        );
+
+        CREATE TABLE IF NOT EXISTS batch_nbmood (
+            rep    INTEGER,
+            t      INTEGER,
+            n      TEXT,
+            nbmood DOUBLE,
+            PRIMARY KEY (rep, t, n)
+        );
+
+        CREATE TABLE IF NOT EXISTS batch_nbcoop (
+            rep    INTEGER,
+            t      INTEGER,
+            n      TEXT,
+            g      TEXT,
+            nbcoop DOUBLE,
+            PRIMARY KEY (rep, t, n, g)
+        );
+
+        CREATE TABLE IF NOT EXISTS batch_contribs (
+            rep     INTEGER,
+            g       TEXT,
+            driver  INTEGER,
+            contrib DOUBLE,
+            PRIMARY KEY (rep, g, driver)
+        );
+
+        CREATE VIEW IF NOT EXISTS batch_mood_stats AS
+        SELECT t, g,
+               count(mood) AS reps,
+               avg(mood)   AS mean,
+               min(mood)   AS min,
+               max(mood)   AS max
+        FROM batch_mood
+        GROUP BY t, g;
+
+        CREATE VIEW IF NOT EXISTS batch_nbmood_stats AS
+        SELECT t, n,
+               count(nbmood) AS reps,
+               avg(nbmood)   AS mean,
+               min(nbmood)   AS min,
+               max(nbmood)   AS max
+        FROM batch_nbmood
+        GROUP BY t, n;
+
+        CREATE VIEW IF NOT EXISTS batch_nbcoop_stats AS
+        SELECT t, n, g,
+               count(nbcoop) AS reps,
+               avg(nbcoop)   AS mean,
+               min(nbcoop)   AS min,
+               max(nbcoop)   AS max
+        FROM batch_nbcoop
+        GROUP BY t, n, g;
+    }
+
+    # Type variable: info
+    #
+    # An array of information about the current batch.  The keys are
+    # as follows.
+    #
+    #   pool     - The thread pool ID
+    #   odb      - The output database handle
+    #   total    - Number of replicates
+    #   done     - Number of replicates completed
+    #   failed   - Number of replicates that failed
+    #   start    - Start time, in milliseconds
+
+    typevariable info -array {
+        pool   ""
+        odb    ""
+        total  0
+        done   0
+        failed 0
+        start  0
+    }
+
+    #-------------------------------------------------------------------
+    # Group: Public Type Methods
+
+    # Type method: run
+    #
+    # Runs a batch of replicates of the scenario in the dbfile,
+    # and saves the results in the output database.  Returns the
+    # number of replicates that failed.
+    #
+    # Syntax:
+    #   batch run _dbfile inputs ?options...?_
+    #
+    #   dbfile - A uramdb(5) file
+    #   inputs - A Tcl script defining the "inputs" command
+    #
+    # Options:
+    #   -replicates n - Number of replicates; defaults to 10
+    #   -workers n    - Number of worker threads; defaults to 4
+    #   -ticks n      - Ticks per replicate; defaults to 52
+    #   -seed n       - Base random seed; replicate i uses seed+i.
+    #                   Defaults to 1.
+    #   -out file     - Output database file; defaults to batch.db.
+    #                   Any existing batch results are replaced.
+
+    typemethod run {dbfile inputs args} {
+        # FIRST, get the options
+        array set opts {
+            -replicates 10
+            -workers    4
+            -ticks      52
+            -seed       1
+            -out        batch.db
+        }
+
+        foreach {opt val} $args {
+            require {[info exists opts($opt)]} "Unknown option: \"$opt\""
+
+            if {$opt ne "-out"} {
+                require {[string is integer -strict $val] && $val >= 0} \
+                    "Invalid $opt value: \"$val\""
+            }
+
+            set opts($opt) $val
+        }
+
+        require {$opts(-workers) > 0} "Invalid -workers value: \"0\""
+        require {[file exists $inputs]} "No such inputs script: \"$inputs\""
+
+        if {[catch {package require Thread 2.6}]} {
+            error "batch mode requires the Thread package"
+        }
+
+        # NEXT, load the scenario once, and snapshot it for the workers.
+        log normal batch "Loading uramdb $dbfile"
+        uramdb loadfile $dbfile ::rdb
+
+        set snapshot [file normalize $opts(-out).snapshot]
+        file delete -force $snapshot
+        rdb saveas $snapshot
+
+        # NEXT, open the output database.
+        $type OpenOutput $opts(-out) \
+            [list uramdb $dbfile inputs $inputs {*}[array get opts]]
+
+        # NEXT, run the replicates.
+        try {
+            $type RunReplicates $snapshot [file normalize $inputs] \
+                $opts(-replicates) $opts(-workers) $opts(-ticks) \
+                $opts(-seed)
+        } finally {
+            if {$info(pool) ne ""} {
+                tpool::release $info(pool)
+                set info(pool) ""
+            }
+
+            $info(odb) close
+            set info(odb) ""
+            file delete -force $snapshot
+        }
+
+        return $info(failed)
+    }
+
+    #-------------------------------------------------------------------
+    # Group: Private Type Methods
+
+    # Type method: OpenOutput
+    #
+    # Opens the output database, defines the schema, and clears any
+    # previous results.
+    #
+    # Syntax:
+    #   batch OpenOutput _filename parms_
+    #
+    #   filename - The output database file
+    #   parms    - A dictionary of batch parameters, for batch_info
+
+    typemethod OpenOutput {filename parms} {
+        set info(odb) [namespace current]::odb
+        sqlite3 $info(odb) $filename
+
+        $info(odb) eval $schema
+
+        $info(odb) transaction {
+            foreach table {
+                batch_info batch_runs batch_mood batch_nbmood
+                batch_nbcoop batch_contribs
+            } {
+                $info(odb) eval "DELETE FROM $table"
+            }
+
+            dict for {parm value} $parms {
+                $info(odb) eval {
+                    INSERT INTO batch_info(parm, value)
+                    VALUES($parm, $value)
+                }
+            }
+        }
+    }
+
+    # Type method: RunReplicates
+    #
+    # Creates the thread pool, posts one job per replicate, and saves
+    # the results as the jobs complete.
+    #
+    # Syntax:
+    #   batch RunReplicates _snapshot inputs replicates workers ticks seed_
+    #
+    #   snapshot   - The RDB snapshot file
+    #   inputs     - The inputs script
+    #   replicates - Number of replicates
+    #   workers    - Number of worker threads
+    #   ticks      - Ticks per replicate
+    #   seed       - Base random seed
+
+    typemethod RunReplicates {snapshot inputs replicates workers ticks seed} {
+        set info(total)  $replicates
+        set info(done)   0
+        set info(failed) 0
+        set info(start)  [clock milliseconds]
+
+        # FIRST, the workers use the application's parameter settings.
+        set parms [dict create \
+                       ::simlib::uram::parm [::simlib::uram parm checkpoint] \
+                       ::simlib::rmf::parm  [::simlib::rmf parm checkpoint]]
+
+        # NEXT, create the pool.  There's no point in having more
+        # workers than replicates.
+        set workers [expr {max(1, min($workers, $replicates))}]
+
+        set initcmd [list apply {{autopath library args} {
+            set ::auto_path $autopath
+            package require -exact simlib [lindex $args 0]
+            namespace import ::kiteutils::* ::marsutil::* ::simlib::*
+            source [file join $library batch_worker.tcl]
+            batchworker init {*}[lrange $args 1 end]
+        }} $::auto_path $::app_uram::library [package present simlib] \
+            $snapshot $inputs $ticks $parms]
+
+        log normal batch \
+            "Running $replicates replicates of $ticks ticks on $workers workers"
+
+        set info(pool) [tpool::create \
+                            -minworkers $workers \
+                            -maxworkers $workers \
+                            -initcmd    $initcmd]
+
+        # NEXT, post the jobs.
+        set pending [list]
+
+        for {set rep 1} {$rep <= $replicates} {incr rep} {
+            lappend pending [tpool::post $info(pool) \
+                                 [list batchworker run $rep [expr {$seed + $rep}]]]
+        }
+
+        # NEXT, save the results as they come in.
+        while {[llength $pending] > 0} {
+            foreach job [tpool::wait $info(pool) $pending pending] {
+                $type SaveResult [tpool::get $info(pool) $job]
+            }
+        }
+    }
+
+    # Type method: SaveResult
+    #
+    # Saves a replicate's results to the output database, and reports
+    # progress.
+    #
+    # Syntax:
+    #   batch SaveResult _result_
+    #
+    #   result - A <batchworker> result dictionary
+
+    typemethod SaveResult {result} {
+        dict with result {}
+
+        $info(odb) transaction {
+            $info(odb) eval {
+                INSERT INTO batch_runs(rep, seed, status, error, msecs)
+                VALUES($rep, $seed, $status, $error, $msecs)
+            }
+
+            foreach {t g value} $mood {
+                $info(odb) eval {
+                    INSERT INTO batch_mood(rep, t, g, mood)
+                    VALUES($rep, $t, $g, $value)
+                }
+            }
+
+            foreach {t n value} $nbmood {
+                $info(odb) eval {
+                    INSERT INTO batch_nbmood(rep, t, n, nbmood)
+                    VALUES($rep, $t, $n, $value)
+                }
+            }
+
+            foreach {t n g value} $nbcoop {
+                $info(odb) eval {
+                    INSERT INTO batch_nbcoop(rep, t, n, g, nbcoop)
+                    VALUES($rep, $t, $n, $g, $value)
+                }
+            }
+
+            foreach {g driver value} $contribs {
+                $info(odb) eval {
+                    INSERT INTO batch_contribs(rep, g, driver, contrib)
+                    VALUES($rep, $g, $driver, $value)
+                }
+            }
+        }
+
+        incr info(done)
+
+        if {$status ne "ok"} {
+            incr info(failed)
+            log warning batch "Replicate $rep failed: $error"
+        }
+
+        $type Progress
+    }
+
+    # Type method: Progress
+    #
+    # Reports the progress of the batch to stdout and the log.
+
+    typemethod Progress {} {
+        set secs [expr {([clock milliseconds] - $info(start))/1000.0}]
+
+        set text [format "%d/%d replicates done, %d failed, %.1f seconds" \
+                      $info(done) $info(total) $info(failed) $secs]
+
+        puts "batch: $text"
+        log normal batch $text
+    }
+}
@@ -0,0 +1,203 @@
+#-----------------------------------------------------------------------
+# FILE: batch_worker.tcl
+#
+# Batch Replicate Worker
+#
+# PACKAGE:
+#   app_uram(n) -- mars_uram(1) implementation package
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+#-----------------------------------------------------------------------
+
+#-----------------------------------------------------------------------
+# Module: batchworker
+#
+# The batchworker module runs <batch> replicates in a worker thread.
+# It is not part of the app_uram(n) package proper; rather, <batch>
+# sources this file into each thread in its thread pool.
+#
+# Each worker has its own in-memory RDB, initialized once from the
+# snapshot of the loaded uramdb(5) data made by <batch>, and its own
+# uram(n) instance, which is created afresh for each replicate.  The
+# user's inputs script is sourced once into the worker's global
+# namespace.
+
+snit::type batchworker {
+    pragma -hasinstances no
+
+    #-------------------------------------------------------------------
+    # Group: Type Variables
+
+    # Type variable: info
+    #
+    # An array of information about the worker.  The keys are as
+    # follows.
+    #
+    #   ticks    - Number of ticks to run each replicate.
+
+    typevariable info -array {
+        ticks 0
+    }
+
+    #-------------------------------------------------------------------
+    # Group: Initialization
+
+    # Type method: init
+    #
+    # Initializes the worker: creates the RDB from the snapshot,
+    # restores the model parameters, and sources the inputs script.
+    #
+    # Syntax:
+    #   batchworker init _snapshot inputs ticks parms_
+    #
+    #   snapshot - An SQLite3 database file containing the uramdb(5) data
+    #   inputs   - The user's inputs script
+    #   ticks    - The number of ticks to run each replicate
+    #   parms    - A dictionary of parmset(n) checkpoints by parmset name
+
+    typemethod init {snapshot inputs ticks parms} {
+        set info(ticks) $ticks
+
+        # FIRST, create the RDB and copy in the uramdb(5) data.  The
+        # RDB can't have an open transaction during the restore.
+        sqldocument ::rdb -autotrans no
+        rdb register ::marsutil::undostack
+        rdb register ::simlib::uramdb
+        rdb register ::simlib::ucurve
+        rdb register ::simlib::uram
+        rdb open :memory:
+        rdb clear
+        rdb restore main $snapshot
+
+        # NEXT, use the same parameter settings as the application.
+        dict for {ps checkpoint} $parms {
+            $ps restore $checkpoint
+        }
+
+        # NEXT, load the inputs script.
+        uplevel #0 [list source $inputs]
+
+        if {[llength [info commands ::inputs]] == 0} {
+            error "inputs script does not define \"inputs\": $inputs"
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Group: Replicates
+
+    # Type method: run
+    #
+    # Runs one replicate, and returns a dictionary of results:
+    #
+    #   rep      - The replicate number
+    #   seed     - The random seed
+    #   status   - ok or error
+    #   error    - The error message, or ""
+    #   msecs    - Wall-clock run time in milliseconds
+    #   mood     - Flat list of t, g, mood
+    #   nbmood   - Flat list of t, n, nbmood
+    #   nbcoop   - Flat list of t, n, g, nbcoop
+    #   contribs - Flat list of g, driver, contrib, giving the
+    #              contribution of each driver to each civilian group's
+    #              mood over the run.
+    #
+    # Syntax:
+    #   batchworker run _rep seed_
+    #
+    #   rep  - The replicate number
+    #   seed - The random seed for the replicate
+
+    typemethod run {rep seed} {
+        set result [dict create \
+                        rep      $rep  \
+                        seed     $seed \
+                        status   ok    \
+                        error    ""    \
+                        mood     {}    \
+                        nbmood   {}    \
+                        nbcoop   {}    \
+                        contribs {}]
+
+        set t0 [clock milliseconds]
+
+        if {[catch {$type Replicate $rep $seed result} msg]} {
+            dict set result status error
+            dict set result error  $msg
+        }
+
+        catch {::ram destroy}
+
+        dict set result msecs [expr {[clock milliseconds] - $t0}]
+
+        return $result
+    }
+
+    # Type method: Replicate
+    #
+    # Creates the uram(n), and runs it from t=0 to the last tick,
+    # calling the user's inputs command just before each advance.
+    # Accumulates the outputs into the result dictionary.
+    #
+    # Syntax:
+    #   batchworker Replicate _rep seed resultVar_
+    #
+    #   rep       - The replicate number
+    #   seed      - The random seed
+    #   resultVar - Name of the result dictionary
+
+    typemethod Replicate {rep seed resultVar} {
+        upvar 1 $resultVar result
+
+        # FIRST, seed the inputs script's random number generator.
+        set ::replicate $rep
+        set ::seed      $seed
+        expr {srand($seed)}
+
+        # NEXT, create and initialize the uram(n).
+        uram ::ram \
+            -rdb     ::rdb \
+            -loadcmd {::simlib::uramdb loader ::rdb}
+
+        ram init
+
+        # NEXT, run the replicate.
+        for {set t 0} {$t <= $info(ticks)} {incr t} {
+            ::inputs ::ram $t
+            ram advance $t
+
+            rdb eval {
+                SELECT g, mood FROM uram_mood
+            } {
+                dict lappend result mood $t $g $mood
+            }
+
+            rdb eval {
+                SELECT n, nbmood FROM uram_n
+            } {
+                dict lappend result nbmood $t $n $nbmood
+            }
+
+            rdb eval {
+                SELECT n, g, nbcoop FROM uram_nbcoop
+            } {
+                dict lappend result nbcoop $t $n $g $nbcoop
+            }
+        }
+
+        # NEXT, get the contributions by driver to each group's mood.
+        foreach g [rdb eval {SELECT g FROM uram_mood}] {
+            ram contribs mood $g
+
+            rdb eval {
+                SELECT driver, contrib FROM uram_contribs
+            } {
+                dict lappend result contribs $g $driver $contrib
+            }
+        }
+    }
+}
@@ -51,6 +51,7 @@ namespace eval ::app_uram:: {
 
 source [file join $::app_uram::library app.tcl      ]
 source [file join $::app_uram::library appwin.tcl   ]
+source [file join $::app_uram::library batch.tcl    ]
 source [file join $::app_uram::library executive.tcl] 
 source [file join $::app_uram::library parmdb.tcl   ]
 source [file join $::app_uram::library sim.tcl      ]
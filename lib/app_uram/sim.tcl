@@ -66,11 +66,13 @@ snit::type sim {
     #
     #   dbloaded - 1 if a uramdb(5) is loaded, and 0 otherwise
     #   dbfile   - Name of the loaded uramdb(5) file, or "" if none.
+    #   profiler - Name of the profiler(n) object, or "" if none.
     
     typevariable info -array {
         time       0
         dbloaded   0
         dbfile     ""
+        profiler   ""
     }
 
     #-------------------------------------------------------------------
@@ -190,6 +192,7 @@ snit::type sim {
                      -rdb          ::rdb                            \
                      -logger       ::log                            \
                      -logcomponent uram                             \
+                     -profiler     $info(profiler)                  \
                      -loadcmd      {::simlib::uramdb loader ::rdb}]
         profile "uram init" $ram init
     }
@@ -247,11 +250,41 @@ snit::type sim {
             incr info(time)
             incr ticks -1
             profile "uram advance" $ram advance $info(time)
+            $type SaveProfile
             notifier send ::sim <Time>
         }
         return
     }
 
+    # Type method: profiler
+    #
+    # Sets the profiler(n) object to attach to each uram(n) instance
+    # as it is created.  Takes effect on the next load or reset.
+    #
+    # Syntax:
+    #   sim profiler _prof_
+    #
+    #   prof - A profiler(n) object, or ""
+
+    typemethod profiler {prof} {
+        set info(profiler) $prof
+    }
+
+    # Type method: SaveProfile
+    #
+    # If profiling is enabled, saves the accumulated statistics to
+    # the RDB's profile_stats table and logs them for the current tick.
+
+    typemethod SaveProfile {} {
+        if {$info(profiler) eq ""} {
+            return
+        }
+
+        $info(profiler) save ::rdb
+        log normal sim \
+            "profile at t=$info(time):\n[$info(profiler) dump]"
+    }
+
     #-------------------------------------------------------------------
     # Group: Queries
     
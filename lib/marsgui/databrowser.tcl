@@ -22,6 +22,12 @@
 #    The name "_uid" is reserved by this widget; it may not appear 
 #    as an attribute record name.
 #
+#    Alternatively, the widget can display an SQL table or view in
+#    "virtual" mode, given -db, -view and -uid.  In virtual mode only 
+#    the rows visible in the window are fetched, using LIMIT/OFFSET;
+#    sorting and filtering are done by the query; and changes are 
+#    applied by refetching the visible rows.
+#
 #-----------------------------------------------------------------------
 
 #-----------------------------------------------------------------------
@@ -51,6 +57,8 @@ snit::widget ::marsgui::databrowser {
     component lazy      ;# Lazy Updater
     component sorter    ;# Timeout that handles re-sorting on update.
     component changer   ;# Timeout that calls -selectioncmd on delete.
+    component pager     ;# Timeout that refetches the visible rows on
+                         # change, in virtual mode.
     component toolbar   ;# The browser toolbar
     component filter    ;# filter(n) component used to filter entries
     component cbar      ;# The client's toolbar, for application-specific
@@ -100,6 +108,55 @@ snit::widget ::marsgui::databrowser {
 
     option -dictcmd
 
+    # -db db
+    #
+    # An sqldocument(n) or sqlite3 database.  If given, the browser
+    # is in virtual mode, and displays the -view.
+
+    option -db \
+        -readonly yes
+
+    # -worker worker
+    #
+    # In virtual mode, an sqlworker(n) for the -db.  If given, the
+    # visible rows are fetched by the worker in the background.
+
+    option -worker \
+        -default ""
+
+    # -view name
+    #
+    # In virtual mode, the table or view to display.  It must contain
+    # the columns named in the -layout, and the -uid column.
+
+    option -view \
+        -default         {}     \
+        -configuremethod ConfigureView
+
+    method ConfigureView {opt val} {
+        # If nothing changed, do nothing.
+        if {$val eq $options($opt)} {
+            return
+        }
+
+        # Save the option, stop fetching the old view, and start
+        # again at the top.
+        set options($opt) $val
+        $self CancelQuery
+        set info(offset)  0
+
+        $self reload
+    }
+
+    # -uid name
+    #
+    # In virtual mode, the name of the -view column that contains
+    # each row's unique ID.
+
+    option -uid \
+        -default  {} \
+        -readonly yes
+
     # -layout spec
     #
     # A specification of the columns to display.
@@ -193,6 +250,31 @@ snit::widget ::marsgui::databrowser {
         }
     }
     
+    # -monitoron events
+    #
+    # events is a list of sqldocument(n) subjects and monitored table
+    # names.  The browser will apply the monitored row updates and 
+    # deletes to its contents as they are received.  The table's 
+    # monitor key must be the UID.
+
+    option -monitoron                      \
+        -default         {}                \
+        -configuremethod ConfigureMonitorOn
+
+    method ConfigureMonitorOn {opt val} {
+        # FIRST, remove any existing bindings
+        foreach {subject table} $options(-monitoron) {
+            notifier bind $subject <$table> $win ""
+        }
+
+        # NEXT, add the new bindings
+        set options($opt) $val
+
+        foreach {subject table} $val {
+            notifier bind $subject <$table> $win [mymethod MonitorEvent]
+        }
+    }
+
     # -selectioncmd
     #
     # A command that's called when the browser's selection
@@ -234,10 +316,32 @@ snit::widget ::marsgui::databrowser {
     #   layoutFlag      1 if the columns have been laid out, and 0
     #                   otherwise.
     #   columns         Column names, in order.
+    #
+    # In virtual mode:
+    #
+    #   virtual         1 if the browser is in virtual mode, and 0 
+    #                   otherwise.
+    #   offset          Row offset of the first displayed row
+    #   total           Number of rows matching the current filter
+    #   pagerows        Number of rows that fit in the window
+    #   sortcol         Name of the sort column, or ""
+    #   sortorder       increasing | decreasing
+    #   filterfunc      Name of the SQL function used to filter rows.
+    #   query           The ID of the -worker query fetching rows, or "".
+    #   rows            The rows fetched so far by the -worker query.
     
     variable info -array {
         layoutFlag     0
         columns        {}
+        virtual        0
+        offset         0
+        total          0
+        pagerows       14
+        sortcol        {}
+        sortorder      increasing
+        filterfunc     {}
+        query          {}
+        rows           {}
     }
     
     # layout array: layout dicts by column name.  For each column:
@@ -250,6 +354,12 @@ snit::widget ::marsgui::databrowser {
     # uidmap: Map from UIDs to row indices
     
     variable uidmap -array {}
+
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Counter used to name the SQL filter functions.
+    typevariable filterCounter 0
     
     #-------------------------------------------------------------------
     # Constructor
@@ -274,6 +384,13 @@ snit::widget ::marsgui::databrowser {
             -interval   1                                  \
             -repetition no
 
+        # Pager: timeout controlling refetching rows on uid update
+        # in virtual mode.
+        install pager using timeout ${selfns}::pager       \
+            -command    [mymethod FetchPage]               \
+            -interval   1                                  \
+            -repetition no
+
         # Set the hull defaults
         $hull configure       \
             -borderwidth 1    \
@@ -288,6 +405,10 @@ snit::widget ::marsgui::databrowser {
             set labelCommand ""
         }
 
+        # Are we in virtual mode?
+        set options(-db)  [from args -db ""]
+        set info(virtual) [expr {$options(-db) ne ""}]
+
         # Create the tablelist.
         install tlist using tablelist::tablelist $win.tlist    \
             -background       white                            \
@@ -314,6 +435,20 @@ snit::widget ::marsgui::databrowser {
             -orient  vertical             \
             -command [list $tlist yview]
 
+        # In virtual mode the scrollbar scrolls through the view rather
+        # than the tablelist, which only holds the visible rows.
+        if {$info(virtual)} {
+            $tlist configure -yscrollcommand ""
+            $win.yscroll configure -command [mymethod YView]
+
+            foreach event {<MouseWheel> <4> <5>} {
+                bind [$tlist bodytag] $event \
+                    "[mymethod MouseWheel %D %b]; break"
+            }
+
+            bind [$tlist bodypath] <Configure> [mymethod BodyResized]
+        }
+
         ttk::scrollbar $win.xscroll       \
             -orient  horizontal           \
             -command [list $tlist xview]
@@ -380,12 +515,27 @@ snit::widget ::marsgui::databrowser {
         # When the widget receives the focus, pass it on to the tlist.
         bind $win <FocusIn> [mymethod FocusIn]
         
+        # NEXT, name the SQL filter function, if need be.  It's
+        # defined by FetchPage.
+        if {$info(virtual) && $options(-filterbox)} {
+            set info(filterfunc) databrowser_filter[incr filterCounter]
+        }
+
         # NEXT, schedule the first reload
         $self reload
     }
     
     destructor {
         notifier forget $win
+        catch {$self CancelQuery}
+
+        # The sqlite3 command can't delete a function, so make the
+        # filter function pass everything.
+        if {$info(filterfunc) ne ""} {
+            catch {
+                $options(-db) function $info(filterfunc) [myproc NoFilter]
+            }
+        }
     }
     
     #-------------------------------------------------------------------
@@ -407,13 +557,34 @@ snit::widget ::marsgui::databrowser {
     method ReloadOnEvent {args} {
         $self reload
     }
+
+    # MonitorEvent operation uid
+    #
+    # operation   update | delete
+    # uid         The UID of the modified row
+    #
+    # Applies a -monitoron row change.
+
+    method MonitorEvent {operation uid} {
+        $self uid $operation $uid
+    }
     
     # FilterData
     #
     # Filters the data based upon the specified target.
     
     method FilterData {} {
-        # FIRST, initialize row and all data
+        # FIRST, in virtual mode the query does the filtering; start
+        # again at the top.
+        if {$info(virtual)} {
+            set info(offset) 0
+            $self FetchPage
+            $tlist selection clear 0 end
+            $self SelectionChanged
+            return
+        }
+
+        # NEXT, initialize row and all data
         set rowidx 0
         set datasets [$tlist get 0 end]
 
@@ -497,6 +668,12 @@ snit::widget ::marsgui::databrowser {
             return
         }
         
+        # NEXT, in virtual mode fetch just the visible rows.
+        if {$info(virtual)} {
+            $self FetchPage
+            return
+        }
+
         # NEXT, Save the selected UIDs. (There's no
         # point is saving row indices, as the same row index could
         # refer to an entirely different record after the reload.)
@@ -549,6 +726,397 @@ snit::widget ::marsgui::databrowser {
         return $data
     }
     
+    #-------------------------------------------------------------------
+    # Virtual Mode
+
+    # FetchPage
+    #
+    # Fetches the rows visible at the current offset from the -view,
+    # and displays them in place of the current rows.  If there's a
+    # -worker, they are fetched in the background.
+
+    method FetchPage {} {
+        # FIRST, there's nothing to fetch without columns and a view.
+        if {!$info(layoutFlag)} {
+            $self LayoutColumns
+        }
+
+        # NEXT, stop any fetch in progress.
+        $self CancelQuery
+
+        if {[llength $info(columns)] == 0 || $options(-view) eq ""} {
+            $self ClearBrowser
+            set info(total) 0
+            $self UpdateScrollbar
+            return
+        }
+
+        # NEXT, if there's a -worker, let it count and fetch the rows.
+        $self DefineFilter
+        set where [$self WhereClause]
+
+        if {$options(-worker) ne ""} {
+            set info(rows)  [list]
+            set info(query) [$options(-worker) query \
+                                 "SELECT count(*) FROM $options(-view) $where" \
+                                 [mymethod CountFetched $where]]
+            return
+        }
+
+        # NEXT, count the matching rows, and make sure the offset
+        # is in range.
+        $self SetTotal [$options(-db) onecolumn "
+            SELECT count(*) FROM $options(-view) $where
+        "]
+
+        # NEXT, fetch and display the visible rows.
+        $self DisplayPage [$options(-db) eval [$self PageQuery $where]]
+    }
+
+    # SetTotal total
+    #
+    # total    The number of rows matching the current filter
+    #
+    # Saves the total, and makes sure the offset is in range.
+
+    method SetTotal {total} {
+        set info(total) $total
+
+        set maxOffset [expr {max(0, $info(total) - $info(pagerows))}]
+
+        if {$info(offset) > $maxOffset} {
+            set info(offset) $maxOffset
+        }
+    }
+
+    # PageQuery where
+    #
+    # where    The WHERE clause
+    #
+    # Returns the query for the rows visible at the current offset.
+
+    method PageQuery {where} {
+        return "
+            SELECT [$self SelectColumns]
+            FROM $options(-view)
+            $where
+            [$self OrderByClause]
+            LIMIT $info(pagerows) OFFSET $info(offset)
+        "
+    }
+
+    # CountFetched where id event ?arg?
+    #
+    # where    The WHERE clause
+    # id       The query ID
+    # event    page | done | error
+    # arg      The count, or the error message
+    #
+    # -worker callback for the count: saves the total, and asks
+    # for the visible rows.
+
+    method CountFetched {where id event args} {
+        if {$id ne $info(query)} {
+            return
+        }
+
+        switch -exact -- $event {
+            page {
+                $self SetTotal [lindex $args 0 0]
+            }
+
+            done {
+                set info(query) [$options(-worker) query \
+                                     [$self PageQuery $where] \
+                                     [mymethod PageFetched]]
+            }
+
+            error {
+                set info(query) ""
+                bgerror "databrowser $win: [lindex $args 0]"
+            }
+        }
+    }
+
+    # PageFetched id event ?arg?
+    #
+    # id       The query ID
+    # event    page | done | error
+    # arg      The rows, or the error message
+    #
+    # -worker callback for the visible rows: displays them once
+    # they have all arrived.
+
+    method PageFetched {id event args} {
+        if {$id ne $info(query)} {
+            return
+        }
+
+        switch -exact -- $event {
+            page {
+                lappend info(rows) {*}[lindex $args 0]
+            }
+
+            done {
+                set info(query) ""
+                $self DisplayPage $info(rows)
+                set info(rows) [list]
+            }
+
+            error {
+                set info(query) ""
+                bgerror "databrowser $win: [lindex $args 0]"
+            }
+        }
+    }
+
+    # CancelQuery
+    #
+    # Cancels the -worker query fetching rows, if any.
+
+    method CancelQuery {} {
+        if {$info(query) ne ""} {
+            $options(-worker) cancel $info(query)
+            set info(query) ""
+        }
+    }
+
+    # DisplayPage rows
+    #
+    # rows    A flat list of rows of column values
+    #
+    # Displays the rows in place of the current rows, keeping the
+    # selection.
+
+    method DisplayPage {rows} {
+        # FIRST, save the selection, and clear the table.
+        set ids [$self uid curselection]
+        $self ClearBrowser
+
+        # NEXT, insert the rows.
+        set rindex -1
+        set ncols  [llength $info(columns)]
+
+        for {set i 0} {$i < [llength $rows]} {incr i $ncols} {
+            set data [lrange $rows $i [expr {$i + $ncols - 1}]]
+            $tlist insert end $data
+            set uidmap([lindex $data end]) [incr rindex]
+
+            callwith $options(-displaycmd) $rindex $data
+        }
+
+        # NEXT, restore the selection and the scrollbar.
+        $self uid select $ids -silent
+        $self UpdateScrollbar
+    }
+
+    # SelectColumns
+    #
+    # Returns the SELECT column list for the displayed columns; the
+    # _uid column is the -uid column.
+
+    method SelectColumns {} {
+        set cols [list]
+
+        foreach cname $info(columns) {
+            if {$cname eq "_uid"} {
+                lappend cols "\"$options(-uid)\""
+            } else {
+                lappend cols "\"$cname\""
+            }
+        }
+
+        return [join $cols ", "]
+    }
+
+    # WhereClause
+    #
+    # Returns the WHERE clause that implements the filter, or "".
+
+    method WhereClause {} {
+        if {$info(filterfunc) eq "" || ![$filter active]} {
+            return ""
+        }
+
+        return "WHERE $info(filterfunc)([$self SelectColumns])"
+    }
+
+    # OrderByClause
+    #
+    # Returns the ORDER BY clause for the current sort column, or "".
+    # The UID breaks ties, so that paging is stable.
+
+    method OrderByClause {} {
+        if {$info(sortcol) eq ""} {
+            return ""
+        }
+
+        if {$info(sortcol) eq "_uid"} {
+            set col "\"$options(-uid)\""
+        } else {
+            set col "\"$info(sortcol)\""
+        }
+
+        if {[dict get $layout($info(sortcol)) sortmode] 
+            in {dictionary ascii}
+        } {
+            append col " COLLATE NOCASE"
+        }
+
+        if {$info(sortorder) eq "decreasing"} {
+            append col " DESC"
+        }
+
+        return "ORDER BY $col, \"$options(-uid)\""
+    }
+
+    # DefineFilter
+    #
+    # Defines the SQL filter function, if it isn't defined; it's lost
+    # when the -db is reopened.
+
+    method DefineFilter {} {
+        if {$info(filterfunc) eq ""} {
+            return
+        }
+
+        if {[catch {
+            $options(-db) eval "SELECT $info(filterfunc)() WHERE 0"
+        }]} {
+            $options(-db) function $info(filterfunc) [mymethod SqlFilter]
+        }
+    }
+
+    # NoFilter args
+    #
+    # args    The column values for one row.
+    #
+    # SQL function: the filter function, once the browser is destroyed.
+
+    proc NoFilter {args} {
+        return 1
+    }
+
+    # SqlFilter args
+    #
+    # args    The column values for one row.
+    #
+    # SQL function: returns 1 if the row passes the filter, and 0 
+    # otherwise.
+
+    method SqlFilter {args} {
+        $filter check $args
+    }
+
+    # YView args
+    #
+    # args    Scrollbar command arguments: moveto fraction, or
+    #         scroll number units|pages
+    #
+    # Scrolls the view by changing the offset.
+
+    method YView {args} {
+        switch -exact -- [lindex $args 0] {
+            moveto {
+                set offset [expr {
+                    round([lindex $args 1] * $info(total))
+                }]
+            }
+
+            scroll {
+                lassign $args dummy number what
+
+                if {$what eq "pages"} {
+                    set number [expr {$number * max(1, $info(pagerows) - 1)}]
+                }
+
+                set offset [expr {$info(offset) + $number}]
+            }
+
+            default {
+                return
+            }
+        }
+
+        $self ScrollTo $offset
+    }
+
+    # MouseWheel delta button
+    #
+    # delta    The <MouseWheel> %D value
+    # button   The <4>/<5> %b value
+    #
+    # Scrolls the view in response to the mouse wheel.
+
+    method MouseWheel {delta button} {
+        if {$button eq "4"} {
+            set units -3
+        } elseif {$button eq "5"} {
+            set units 3
+        } elseif {$delta > 0} {
+            set units -3
+        } else {
+            set units 3
+        }
+
+        $self ScrollTo [expr {$info(offset) + $units}]
+    }
+
+    # ScrollTo offset
+    #
+    # offset    The desired row offset
+    #
+    # Displays the rows starting at the offset.
+
+    method ScrollTo {offset} {
+        set maxOffset [expr {max(0, $info(total) - $info(pagerows))}]
+        set offset    [expr {min(max(0, $offset), $maxOffset)}]
+
+        if {$offset != $info(offset)} {
+            set info(offset) $offset
+            $self FetchPage
+        }
+    }
+
+    # UpdateScrollbar
+    #
+    # Sets the scrollbar to reflect the visible rows.
+
+    method UpdateScrollbar {} {
+        if {$info(total) == 0} {
+            $win.yscroll set 0.0 1.0
+            return
+        }
+
+        set first [expr {double($info(offset))/$info(total)}]
+        set last  [expr {
+            min(1.0, double($info(offset) + $info(pagerows))/$info(total))
+        }]
+
+        $win.yscroll set $first $last
+    }
+
+    # BodyResized
+    #
+    # The tablelist body has been resized; fetch enough rows to 
+    # fill it.
+
+    method BodyResized {} {
+        set height [winfo height [$tlist bodypath]]
+        set rowHeight [font metrics datafont -linespace]
+
+        if {[$tlist size] > 0} {
+            set rowHeight [lindex [$tlist bbox 0] 3]
+        }
+
+        set pagerows [expr {max(1, $height / max(1, $rowHeight))}]
+
+        if {$pagerows != $info(pagerows)} {
+            set info(pagerows) $pagerows
+            $pager schedule -nocomplain
+        }
+    }
+
     #-------------------------------------------------------------------
     # Layout
     
@@ -605,8 +1173,9 @@ snit::widget ::marsgui::databrowser {
             lappend info(columns) $cname
             
             set layout($cname) [dict create \
-                name    $cname              \
-                cindex  [incr cindex]]
+                name     $cname             \
+                cindex   [incr cindex]      \
+                sortmode $sortmode]
 
             $tlist insertcolumns end 0 $label
             
@@ -625,8 +1194,9 @@ snit::widget ::marsgui::databrowser {
     # sort command.
   
     method SortData {} {
-        # FIRST, if we've sorted previously, sort again.
-        if {[$tlist sortcolumn] > -1} {
+        # FIRST, if we've sorted previously, sort again.  In virtual 
+        # mode, the query sorts.
+        if {!$info(virtual) && [$tlist sortcolumn] > -1} {
             # FIRST, sort on the same column in the same way as before.
             $tlist sortbycolumn [$tlist sortcolumn] -[$tlist sortorder]
 
@@ -677,7 +1247,22 @@ snit::widget ::marsgui::databrowser {
     # Sets the sort direction for the specified column, and resorts.
 
     method SortByColumn {w cindex} {
-        # FIRST, let tablelist sort on the selected column, toggling
+        # FIRST, in virtual mode, sort by the column in the query,
+        # toggling the sort direction if necessary.
+        if {$info(virtual)} {
+            set cname [$self cindex2cname $cindex]
+
+            if {$cname eq $info(sortcol) && 
+                $info(sortorder) eq "increasing"
+            } {
+                $self sortby $cname -decreasing
+            } else {
+                $self sortby $cname -increasing
+            }
+            return
+        }
+
+        # NEXT, let tablelist sort on the selected column, toggling
         # the sort direction if necessary.
         tablelist::sortByColumn $w $cindex
 
@@ -704,7 +1289,18 @@ snit::widget ::marsgui::databrowser {
 
         set cindex [$self cname2cindex $col]
 
-        # FIRST, sort in the desired way
+        # FIRST, in virtual mode sort in the query, and start again
+        # at the top.
+        if {$info(virtual)} {
+            set info(sortcol)   $col
+            set info(sortorder) [string trimleft $direction -]
+            set info(offset)    0
+            $self FetchPage
+            callwith $options(-selectioncmd)
+            return
+        }
+
+        # NEXT, sort in the desired way
         $tlist sortbycolumn $cindex $direction
 
         # NEXT, update the UID map, if any.
@@ -754,6 +1350,7 @@ snit::widget ::marsgui::databrowser {
     # Clear the browser, and call the -selectioncmd.
     
     method clear {{opt ""}} {
+        $self CancelQuery
         $self ClearBrowser
         if {$opt ne ""} {
             callwith $options(-selectioncmd)
@@ -894,7 +1491,14 @@ snit::widget ::marsgui::databrowser {
     # the relevant row.
 
     method {uid update} {uid} {
-        # FIRST, this call is only for updating records that 
+        # FIRST, in virtual mode the row might be new or might have
+        # moved; refetch the visible rows once the updates are done.
+        if {$info(virtual)} {
+            $self VirtualChange
+            return
+        }
+
+        # NEXT, this call is only for updating records that 
         # are already displayed in this browser.  If no such 
         # record is displayed, we can ignore the call.
         if {![info exists uidmap($uid)]} {
@@ -937,7 +1541,14 @@ snit::widget ::marsgui::databrowser {
     # This method deletes the specified row from the tablelist.
 
     method {uid delete} {uid} {
-        # FIRST, look for a match on uid.  If the record isn't currently
+        # FIRST, in virtual mode the rows below it will move up;
+        # refetch the visible rows once the updates are done.
+        if {$info(virtual)} {
+            $self VirtualChange
+            return
+        }
+
+        # NEXT, look for a match on uid.  If the record isn't currently
         # displayed, there's nothing to do.
         if {![info exists uidmap($uid)]} {
             return
@@ -961,6 +1572,21 @@ snit::widget ::marsgui::databrowser {
     }
     
     
+    # VirtualChange
+    #
+    # A row has been inserted, updated, or deleted in virtual mode.
+    # Schedules a refetch of the visible rows, or a lazy reload if
+    # the window isn't mapped.
+
+    method VirtualChange {} {
+        if {![winfo ismapped $win]} {
+            $lazy update
+        } else {
+            $pager schedule -nocomplain
+            $changer schedule -nocomplain
+        }
+    }
+
     # uid select uids ?-silent?
     #
     # uids   - A list of UIDs
@@ -256,6 +256,14 @@ snit::widgetadaptor ::marsgui::filter {
     #-------------------------------------------------------------------
     # Public Methods
 
+    # active
+    #
+    # Returns 1 if there is a filter target, so that some strings
+    # may be excluded, and 0 otherwise.
+    method active {} {
+        expr {$targetRegexp ne ""}
+    }
+
     # check string
     #
     # string    A string to filter
@@ -795,19 +795,37 @@ snit::widget ::marsgui::loglist {
     # file    The name of the file to read
     #
     # Returns the raw contents of the file provided there are no errors
-    # opening or reading the file.
+    # opening or reading the file.  Binary logger(n) files are decoded
+    # to text.
     method ReadLog  {file} {
 
         # Open the file, and configure it explicitly for "lf" mode.
         # This way, carriage returns in the data don't cause trouble.
-        if {[catch {set handle [open $file]} result]} {
+        if {[catch {
+            set binary [expr {
+                [::marsutil::logger fileformat $file] eq "binary"
+            }]
+            set handle [open $file]
+        } result]} {
             $self Message "Error opening [file tail $file]: $result"
             return ""
         }
-        fconfigure $handle -translation lf
+
+        if {$binary} {
+            fconfigure $handle -translation binary
+            seek $handle [::marsutil::logger headersize]
+        } else {
+            fconfigure $handle -translation lf
+        }
         
         # Read the file contents. 
-        if {[catch {set contents [read -nonewline $handle]} result]} {
+        if {$binary} {
+            set readcmd [list read $handle]
+        } else {
+            set readcmd [list read -nonewline $handle]
+        }
+
+        if {[catch {set contents [{*}$readcmd]} result]} {
             $self Message "Error reading [file tail $file]: $result"
             catch {close $handle}
             return ""
@@ -815,6 +833,17 @@ snit::widget ::marsgui::loglist {
         
         # Close the file.
         catch {close $handle}
+
+        # Decode binary contents.
+        if {$binary} {
+            if {[catch {
+                set contents [join [lindex \
+                    [::marsutil::logdecode $contents {}] 2] \n]
+            } result]} {
+                $self Message "Error reading [file tail $file]: $result"
+                return ""
+            }
+        }
         
         return $contents
     }
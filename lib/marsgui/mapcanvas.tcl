@@ -16,7 +16,10 @@
 #
 #    The Map
 #        The map is an image file; the canvas' scroll region is precisely
-#        the extent of the map.
+#        the extent of the map.  At 100% the map image is displayed
+#        as is; at other zoom factors it is displayed as a pyramid of 
+#        roughly 256-pixel tiles, which are generated in the background
+#        as they become visible, and optionally cached on disk.
 #
 #    Neighborhoods
 #        Neighborhoods are represented as polygons.  By default, 
@@ -260,26 +263,39 @@ snit::widgetadaptor ::marsgui::mapcanvas {
 
         set options(-map) $val
 
-        # NEXT, clear the zoom cache
-        foreach factor [array names zooms] {
-            if {$factor ne "100"} {
-                image delete $zooms($factor)
-            }
-        }
-        
-        array unset zooms
+        # NEXT, clear the tile cache; the tiles will be regenerated
+        # as needed.
+        $self TilesClear
+        $self TileCacheCheck
 
-        # NEXT, set the zoom to 100%
-        set zooms(100) $options(-map)
 
-        if {$info(zoom) != 100} {
-            $self ScaleMap $info(zoom)
-        }
+        # TBD: Might want to schedule a refresh....
+    }
 
+    # -tilecache
+    #
+    # A directory in which to save zoomed map tiles as PNG files, so that
+    # they needn't be regenerated; it's conventionally placed next
+    # to the map file.  If "", tiles are not saved.
 
-        # TBD: Might want to schedule a refresh....
+    option -tilecache \
+        -default         ""       \
+        -configuremethod ConfigTileCache
+
+    method ConfigTileCache {opt val} {
+        set options($opt) $val
+        $self TileCacheCheck
     }
 
+    # -tilebudget
+    #
+    # The maximum number of zoomed map tiles to keep in memory.  The
+    # least recently used tiles that aren't displayed are deleted first.
+
+    option -tilebudget \
+        -type    {snit::integer -min 1} \
+        -default 256
+
     # -projection
     #
     # A projection(i) object.  If not specified, a maprect(n) will be
@@ -343,13 +359,24 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         zoom           100
     }
 
-    # zooms array
+    # tiles array: zoomed map tiles.  Tile keys are "factor,col,row",
+    # where factor is the zoom factor.
     #
-    # Array of images by zoom factor.  The zoom factor is one of
-    # the keys in the zoomfactors() array, e.g., 100 is full size.
+    #   image-$key    Photo image for the tile; it is empty until it 
+    #                 has been generated.
+    #   item-$key     Canvas item ID, if the tile is displayed.
+    #   lru           Dictionary of tile keys, least recently used first
+    #   queue         List of keys of tiles awaiting generation
+    #   genId         "after" ID of the pending GenerateTiles, or ""
+    #   updateId      "after" ID of the pending TilesUpdate, or ""
+    #   cacheOK       1 if the -tilecache can be used, and 0 otherwise.
 
-    variable zooms -array {
-        100 {}
+    variable tiles -array {
+        lru      {}
+        queue    {}
+        genId    {}
+        updateId {}
+        cacheOK  0
     }
 
     # icons array
@@ -409,6 +436,12 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         $self refresh
     }
 
+    destructor {
+        after cancel $tiles(genId)
+        after cancel $tiles(updateId)
+        catch {$self TilesClear}
+    }
+
     #-------------------------------------------------------------------
     # Public Methods
 
@@ -459,13 +492,6 @@ snit::widgetadaptor ::marsgui::mapcanvas {
                 "Invalid zoom factor, should be one of: [join [dict keys $zoomfactors] {, }]"
         }
 
-        # NEXT, scale the image, if needed.
-        if {$options(-map) ne "" &&
-            ![info exists zooms($factor)]
-        } {
-            $self ScaleMap $factor
-        }
-        
         # NEXT, set the zoom factor
         set info(zoom) $factor
 
@@ -512,14 +538,21 @@ snit::widgetadaptor ::marsgui::mapcanvas {
             # NEXT, get the projection.
             $self GetProjection
 
-            # NEXT, create the map item using the current zoom.
-            $hull create image 0 0          \
-                -anchor nw                  \
-                -image  $zooms($info(zoom)) \
-                -tags   map
+            # NEXT, the tiles are no longer displayed.
+            array unset tiles item-*
+
+            # NEXT, create the map item using the current zoom; if 
+            # zoomed, the map is displayed as tiles.
+            if {$info(zoom) == 100} {
+                $hull create image 0 0         \
+                    -anchor nw                 \
+                    -image  $options(-map)     \
+                    -tags   map
+            }
         }
         
-        # NEXT, get and set the scroll region
+        # NEXT, get and set the scroll region; this also displays the
+        # visible tiles.
         $self ScrollConfigure
         
         # NEXT, add the layer marker, to separate nbhoods from
@@ -585,14 +618,12 @@ snit::widgetadaptor ::marsgui::mapcanvas {
     # scroll regions
 
     method GetScrollRegions {} {
-        set bbox [$hull bbox map]
-        
         set winw [winfo width $self]
         set winh [winfo height $self]
 
-        if {[llength $bbox] != 0} {
+        if {$options(-map) ne ""} {
             # x1,y1 = 0,0
-            lassign $bbox x1 y1 x2 y2
+            lassign [$self MapSize] x2 y2
         } else {
             set x2 [expr {$info(zoom)/100.0*[$proj cget -width]}]
             set y2 [expr {$info(zoom)/100.0*[$proj cget -height]}]
@@ -673,6 +704,8 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         # NEXT, scroll!
         $hull xview moveto $fx
         $hull yview moveto $fy
+
+        $self TilesSchedule
     }
 
     #-------------------------------------------------------------------
@@ -792,6 +825,31 @@ snit::widgetadaptor ::marsgui::mapcanvas {
     method ScrollConfigure {} {
         $self GetScrollRegions
         $self region $info(region)
+        $self TilesUpdate
+    }
+
+    # xview args
+    # yview args
+    # scan args
+    #
+    # These are passed along to the canvas; the newly visible tiles
+    # are then displayed.
+
+    method xview {args} {
+        set result [$hull xview {*}$args]
+        $self TilesSchedule
+        return $result
+    }
+
+    method yview {args} {
+        set result [$hull yview {*}$args]
+        $self TilesSchedule
+        return $result
+    }
+
+    method scan {args} {
+        $hull scan {*}$args
+        $self TilesSchedule
     }
 
     # MaplocSet wx wy
@@ -1834,46 +1892,337 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         }
     }
 
-    # ScaleMap factor
+    #-------------------------------------------------------------------
+    # Map Tiles
     #
-    # factor    Creates a scaled copy of the the -map at the specified
-    #           zoom factor.
+    # At zoom factors other than 100%, the map is displayed as a 
+    # pyramid of square tiles, one set per zoom factor.  A tile is 
+    # k*up pixels square on the canvas, and is generated from a k*down
+    # square of the -map, where up/down is the zoom factor's 
+    # -zoom/-subsample and k is chosen so that tiles are about 256
+    # pixels square.  Only the tiles that intersect the visible part
+    # of the canvas are displayed; they are generated in the 
+    # background, and kept subject to the -tilebudget.
+
+    # MapSize
     #
-    # Creates and caches a new map image.  Assumes that:
-    # 
-    # * factor is a valid zoomfactor
-    # * There is a -map
-    # * No cached image exists for this factor
+    # Returns the size of the map at the current zoom factor, in 
+    # pixels, as a list {width height}.
 
-    method ScaleMap {factor} {
-        # FIRST, if the canvas has no map, nothing to do
-        if {$options(-map) eq ""} {
+    method MapSize {} {
+        lassign [dict get $zoomfactors $info(zoom)] up down
+
+        list \
+            [expr {int(ceil(double([image width  $options(-map)])*$up/$down))}] \
+            [expr {int(ceil(double([image height $options(-map)])*$up/$down))}]
+    }
+
+    # TileGeometry factor
+    #
+    # factor    A zoom factor
+    #
+    # Returns {csize msize up down}, where csize is the size of a tile
+    # on the canvas and msize is the size of the map region from which
+    # it is generated, in pixels.
+
+    method TileGeometry {factor} {
+        lassign [dict get $zoomfactors $factor] up down
+
+        set k [expr {256/$up}]
+
+        list [expr {$k*$up}] [expr {$k*$down}] $up $down
+    }
+
+    # TilesSchedule
+    #
+    # Schedules a TilesUpdate, e.g., after scrolling.
+
+    method TilesSchedule {} {
+        if {$tiles(updateId) eq ""} {
+            set tiles(updateId) [after idle [mymethod TilesUpdate]]
+        }
+    }
+
+    # TilesUpdate
+    #
+    # Displays the tiles that intersect the visible part of the canvas,
+    # plus a margin of one tile, and removes the rest from the canvas.
+    # Tiles that don't exist yet are queued for generation.
+
+    method TilesUpdate {} {
+        after cancel $tiles(updateId)
+        set tiles(updateId) ""
+
+        # FIRST, if the map isn't zoomed, there are no tiles.
+        if {$options(-map) eq "" || $info(zoom) == 100} {
             return
         }
 
-        # NEXT, update the GUI, and set the watch cursor
-        set oldCursor [$hull cget -cursor]
-        $hull configure -cursor watch
-        update idletasks
+        # NEXT, get the range of visible tiles.
+        set factor $info(zoom)
+        lassign [$self TileGeometry $factor] csize msize
+
+        set ncols [expr {
+            int(ceil(double([image width  $options(-map)])/$msize))
+        }]
+        set nrows [expr {
+            int(ceil(double([image height $options(-map)])/$msize))
+        }]
+
+        set cx1 [$hull canvasx 0]
+        set cy1 [$hull canvasy 0]
+        set cx2 [$hull canvasx [winfo width  $win]]
+        set cy2 [$hull canvasy [winfo height $win]]
+
+        set col1 [expr {max(0, int($cx1/$csize) - 1)}]
+        set row1 [expr {max(0, int($cy1/$csize) - 1)}]
+        set col2 [expr {min($ncols - 1, int($cx2/$csize) + 1)}]
+        set row2 [expr {min($nrows - 1, int($cy2/$csize) + 1)}]
+
+        # NEXT, remove tiles that are no longer visible from the canvas.
+        foreach name [array names tiles item-*] {
+            lassign [split [string range $name 5 end] ,] f col row
+
+            if {$f != $factor || 
+                $col < $col1 || $col > $col2 ||
+                $row < $row1 || $row > $row2
+            } {
+                $hull delete $tiles($name)
+                unset tiles($name)
+            }
+        }
+
+        # NEXT, display the visible tiles.
+        set queued 0
 
-        # NEXT, get the base image, and the upsample/downsample figures
+        for {set row $row1} {$row <= $row2} {incr row} {
+            for {set col $col1} {$col <= $col2} {incr col} {
+                set key $factor,$col,$row
+
+                # FIRST, create the tile image if need be.
+                if {![info exists tiles(image-$key)]} {
+                    set tiles(image-$key) [image create photo]
+                    lappend tiles(queue) $key
+                    set queued 1
+                }
+
+                # NEXT, mark it recently used.
+                dict unset tiles(lru) $key
+                dict set tiles(lru) $key 1
+
+                # NEXT, display it, below everything else.
+                if {![info exists tiles(item-$key)]} {
+                    set tiles(item-$key) [$hull create image \
+                        [expr {$col*$csize}] [expr {$row*$csize}] \
+                        -anchor nw                                 \
+                        -image  $tiles(image-$key)                 \
+                        -tags   map]
+                    $hull lower $tiles(item-$key)
+                }
+            }
+        }
+
+        # NEXT, generate queued tiles in the background, and keep
+        # within the budget.
+        if {$queued && $tiles(genId) eq ""} {
+            set tiles(genId) [after idle [mymethod TilesGenerate]]
+        }
+
+        $self TilesEvict
+    }
+
+    # TilesGenerate
+    #
+    # Generates queued tiles for up to 20 milliseconds, and then 
+    # reschedules itself if there are more, so that the GUI remains
+    # responsive.
+
+    method TilesGenerate {} {
+        set tiles(genId) ""
+        set deadline [expr {[clock milliseconds] + 20}]
+
+        while {[llength $tiles(queue)] > 0 &&
+               [clock milliseconds] < $deadline
+        } {
+            set key [lshift tiles(queue)]
+
+            # Skip tiles evicted while waiting.
+            if {[info exists tiles(image-$key)]} {
+                $self TileGenerate $key
+            }
+        }
+
+        if {[llength $tiles(queue)] > 0} {
+            set tiles(genId) [after 1 [mymethod TilesGenerate]]
+        }
+    }
+
+    # TileGenerate key
+    #
+    # key     A tile key
+    #
+    # Fills in the tile's image from the -tilecache, if possible, 
+    # or from the -map, saving it to the -tilecache.
+
+    method TileGenerate {key} {
+        set img  $tiles(image-$key)
+        set file [$self TileCacheFile $key]
+
+        # FIRST, read it from the cache, if we can.
+        if {$file ne "" && [file exists $file] && 
+            ![catch {$img read $file -format png}]
+        } {
+            return
+        }
+
+        # NEXT, get the region of the map.
+        lassign [split $key ,] factor col row
+        lassign [$self TileGeometry $factor] csize msize up down
+
+        set x1 [expr {$col*$msize}]
+        set y1 [expr {$row*$msize}]
+        set x2 [expr {min($x1 + $msize, [image width  $options(-map)])}]
+        set y2 [expr {min($y1 + $msize, [image height $options(-map)])}]
+
+        # NEXT, upsample and then downsample it.
+        if {$down == 1} {
+            $img copy $options(-map) -from $x1 $y1 $x2 $y2 -zoom $up
+        } elseif {$up == 1} {
+            $img copy $options(-map) -from $x1 $y1 $x2 $y2 -subsample $down
+        } else {
+            set temp [image create photo]
+            $temp copy $options(-map) -from $x1 $y1 $x2 $y2 -zoom $up
+            $img copy $temp -subsample $down
+            image delete $temp
+        }
+
+        # NEXT, save it to the cache.
+        if {$file ne ""} {
+            catch {$img write $file -format png}
+        }
+    }
+
+    # TilesEvict
+    #
+    # Deletes the least recently used tiles that aren't displayed
+    # until the number of tiles is within the -tilebudget.
+
+    method TilesEvict {} {
+        set excess [expr {[dict size $tiles(lru)] - $options(-tilebudget)}]
+
+        foreach key [dict keys $tiles(lru)] {
+            if {$excess <= 0} {
+                break
+            }
+
+            if {[info exists tiles(item-$key)]} {
+                continue
+            }
+
+            image delete $tiles(image-$key)
+            unset tiles(image-$key)
+            dict unset tiles(lru) $key
+            incr excess -1
+        }
+    }
+
+    # TilesClear
+    #
+    # Deletes all tiles, e.g., when the -map changes.
+
+    method TilesClear {} {
+        foreach name [array names tiles item-*] {
+            $hull delete $tiles($name)
+        }
+
+        foreach name [array names tiles image-*] {
+            image delete $tiles($name)
+        }
+
+        array unset tiles item-*
+        array unset tiles image-*
+        set tiles(lru)   [dict create]
+        set tiles(queue) [list]
+    }
+
+    # TileCacheCheck
+    #
+    # Determines whether the -tilecache can be used with the current
+    # -map.  The cache directory contains a file "tiles.info" containing
+    # the map's stamp; if it doesn't match, the cached tiles are deleted.
+
+    method TileCacheCheck {} {
+        set tiles(cacheOK) 0
+        set dir $options(-tilecache)
+
+        if {$dir eq "" || $options(-map) eq ""} {
+            return
+        }
+
+        set infoFile [file join $dir tiles.info]
+
+        if {[catch {
+            set stamp [$self TileCacheStamp]
+            file mkdir $dir
+
+            set old ""
+            if {[file exists $infoFile]} {
+                set old [string trim [::kiteutils::readfile $infoFile]]
+            }
+
+            if {$old ne $stamp} {
+                file delete {*}[glob -nocomplain -directory $dir *.png]
+                set f [open $infoFile w]
+                puts $f $stamp
+                close $f
+            }
+        } result]} {
+            return
+        }
+
+        set tiles(cacheOK) 1
+    }
+
+    # TileCacheStamp
+    #
+    # Returns a stamp identifying the -map's content: its size, plus
+    # the file's name, modification time, and length, if it was read
+    # from a file, or a checksum of its data otherwise.
+
+    method TileCacheStamp {} {
         set img $options(-map)
-        lassign [dict get $zoomfactors $factor] up down
+        set stamp [list [image width $img] [image height $img]]
+
+        set file [$img cget -file]
+
+        if {$file ne ""} {
+            set file [file normalize $file]
+            lappend stamp $file [file mtime $file] [file size $file]
+        } else {
+            set data [$img cget -data]
 
-        # NEXT, upsample, if necessary
-        set temp [image create photo]
-        $temp copy $img -zoom $up
+            if {$data eq ""} {
+                set data [$img data -format png]
+            }
 
-        # NEXT, downsample, if necessary
-        set final [image create photo]
-        $final copy $temp -subsample $down
+            lappend stamp [zlib crc32 $data]
+        }
 
-        # NEXT, delete the temp image and save the new image.
-        image delete $temp
-        set zooms($factor) $final
+        return $stamp
+    }
+
+    # TileCacheFile key
+    #
+    # key     A tile key
+    #
+    # Returns the name of the tile's -tilecache file, or "" if none.
+
+    method TileCacheFile {key} {
+        if {!$tiles(cacheOK)} {
+            return ""
+        }
 
-        # NEXT, restore the cursor
-        $hull configure -cursor $oldCursor
+        return [file join $options(-tilecache) "tile$key.png"]
     }
 
     # CanSnap x1 y1 x2 y2
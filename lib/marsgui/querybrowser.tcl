@@ -45,6 +45,7 @@ snit::widget ::marsgui::querybrowser {
     delegate option -db           to browser
     delegate option -selectmode   to browser
     delegate option -selectioncmd to browser
+    delegate option -worker       to browser
     
     # -reloadon events
     #
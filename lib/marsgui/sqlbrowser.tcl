@@ -167,8 +167,9 @@ snit::widget ::marsgui::sqlbrowser {
             return
         }
         
-        # NEXT, save the change
+        # NEXT, save the change, and stop loading the old view.
         set options($opt) $val
+        $self CancelQuery
 
         # NEXT, update the Views pulldown, if any.
         if {$vmenu ne ""} {
@@ -200,13 +201,21 @@ snit::widget ::marsgui::sqlbrowser {
             return
         }
         
-        # NEXT, save the change
+        # NEXT, save the change, and stop loading the old rows.
         set options($opt) $val
+        $self CancelQuery
 
         # NEXT, schedule a reload.
         $self reload
     }
     
+    # -worker worker
+    #
+    # An sqlworker(n) for the -db.  If given, the content is loaded
+    # by the worker in the background, and displayed a page at a time.
+
+    option -worker \
+        -default ""
     
     # -views viewdict
     #
@@ -327,12 +336,17 @@ snit::widget ::marsgui::sqlbrowser {
     #                   of -views.
     #   columns         Column names in the current view, in order.
     #   reloadRequests  Number of reload requests since the last reload.
+    #   query           The ID of the -worker query loading the content,
+    #                   or "".
+    #   ids             The UIDs to select once the query is done.
     
     variable info -array {
         layoutFlag     0
         views          {}
         columns        {}
         reloadRequests 0
+        query          {}
+        ids            {}
     }
     
     # layout array: layout dicts by column name.  For each column:
@@ -494,6 +508,7 @@ snit::widget ::marsgui::sqlbrowser {
     
     destructor {
         notifier forget $win
+        catch {$self CancelQuery}
     }
     
     #-------------------------------------------------------------------
@@ -617,8 +632,11 @@ snit::widget ::marsgui::sqlbrowser {
             return
         }
         
-        # NEXT, clear the reload request counter.
+        # NEXT, clear the reload request counter, and stop any load
+        # in progress.
         set info(reloadRequests) 0
+        set loading [expr {$info(query) ne ""}]
+        $self CancelQuery
 
         # NEXT, Layout the columns if need be.
         if {!$info(layoutFlag)} {
@@ -635,13 +653,29 @@ snit::widget ::marsgui::sqlbrowser {
         # NEXT, If we've got a -uid, save the selection. (There's no
         # point is saving row indices, as the same row index could
         # refer to an entirely different record after the reload.)
+        # If a load was interrupted, the rows to select are the ones
+        # that were to be selected when it was done.
         if {$options(-uid) ne ""} {
-            set ids [$self uid curselection]
+            if {$loading} {
+                set ids $info(ids)
+            } else {
+                set ids [$self uid curselection]
+            }
         }
         
         # NEXT, clear the table
         $self ClearBrowser
         
+        # NEXT, if there's a -worker, let it load the rows.
+        if {$options(-worker) ne ""} {
+            if {$options(-uid) ne ""} {
+                set info(ids) $ids
+            }
+
+            $self LoadInBackground
+            return
+        }
+        
         # NEXT, request and insert all rows from the current view
         set rindex -1
 
@@ -688,6 +722,132 @@ snit::widget ::marsgui::sqlbrowser {
         }
     }
     
+    # LoadInBackground
+    #
+    # Asks the -worker to query the displayed columns from the -view.
+    # A temporary view is replaced by its definition, so that the
+    # worker can run it.
+
+    method LoadInBackground {} {
+        set cols [list]
+
+        foreach name $info(columns) {
+            lappend cols "\"$name\""
+        }
+
+        set source $options(-view)
+
+        set sql [$db onecolumn {
+            SELECT sql FROM sqlite_temp_master
+            WHERE type = 'view' AND name = $source
+        }]
+
+        if {[regexp -nocase -- \
+                 {^\s*CREATE\s+VIEW\s+("[^"]*"|\S+)\s+AS\s+(.*)$} \
+                 $sql dummy name select]
+        } {
+            set source "($select\n) AS $source"
+        }
+
+        set query "SELECT [join $cols {, }] FROM $source"
+
+        if {[llength $options(-where)] > 0} {
+            append query "\nWHERE $options(-where)"
+        }
+
+        set info(query) [$options(-worker) query $query [mymethod RowsLoaded]]
+    }
+
+    # RowsLoaded id event ?arg?
+    #
+    # id      The query ID
+    # event   page | done | error
+    # arg     The rows, or the error message
+    #
+    # -worker callback: displays each page of rows as it arrives, and
+    # then sorts the rows and restores the selection.
+
+    method RowsLoaded {id event args} {
+        if {$id ne $info(query)} {
+            return
+        }
+
+        switch -exact -- $event {
+            page {
+                $self InsertRows [lindex $args 0]
+            }
+
+            done {
+                set info(query) ""
+                $self SortData
+
+                if {$options(-uid) ne ""} {
+                    $self uid select $info(ids)
+                }
+            }
+
+            error {
+                set info(query) ""
+                bgerror "sqlbrowser $win: [lindex $args 0]"
+            }
+        }
+    }
+
+    # InsertRows rows
+    #
+    # rows    A flat list of rows of column values
+    #
+    # Adds the rows to the browser.  A row whose UID is already
+    # displayed, because "uid update" got to it first, replaces
+    # the displayed row.
+
+    method InsertRows {rows} {
+        set ncols [llength $info(columns)]
+        set ucol  [lsearch -exact $info(columns) $options(-uid)]
+
+        for {set i 0} {$i < [llength $rows]} {incr i $ncols} {
+            set data [lrange $rows $i [expr {$i + $ncols - 1}]]
+
+            # FIRST, insert or update the data, and update the key map.
+            if {$options(-uid) eq "" || $ucol == -1} {
+                set rindex [$tlist index end]
+                $tlist insert end $data
+            } else {
+                set uid [lindex $data $ucol]
+
+                if {[info exists uidmap($uid)]} {
+                    set rindex $uidmap($uid)
+                    $tlist rowconfigure $rindex -text $data
+                } else {
+                    set rindex [$tlist index end]
+                    set uidmap($uid) $rindex
+                    $tlist insert end $data
+                }
+            }
+
+            # NEXT, call the -displaycmd, if any.
+            callwith $options(-displaycmd) $rindex $data
+
+            # NEXT, determine whether it should be filtered.
+            if {$options(-filterbox) && ![$filter check $data]} {
+                $tlist rowconfigure $rindex -hide true
+            } else {
+                $tlist rowconfigure $rindex -hide false
+            }
+        }
+    }
+
+    # CancelQuery
+    #
+    # Cancels the -worker query loading the content, if any.
+
+    method CancelQuery {} {
+        if {$info(query) ne ""} {
+            $options(-worker) cancel $info(query)
+            set info(query) ""
+        }
+    }
+
     #-------------------------------------------------------------------
     # Layout
     
@@ -924,6 +1084,7 @@ snit::widget ::marsgui::sqlbrowser {
     # Clear the browser, and call the -selectioncmd.
     
     method clear {} {
+        $self CancelQuery
         $self ClearBrowser
         callwith $options(-selectioncmd)
     }
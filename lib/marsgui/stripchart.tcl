@@ -320,6 +320,12 @@ snit::widgetadaptor ::marsgui::stripchart {
     #                 is given.
     #   dmax-$name  - Max data value for named series, or "" if -rmax
     #                 is given.
+    #   dec-$name   - Decimation cache for the named series:
+    #                 {xform coords next}, where xform is the pixel 
+    #                 transform, coords are the decimated pixel 
+    #                 coordinates up to the final pixel column, and
+    #                 next is the index of the first data pair in the
+    #                 final pixel column.  See RenderSeries.
 
     variable series -array { 
         names {}
@@ -990,11 +996,7 @@ snit::widgetadaptor ::marsgui::stripchart {
             }
 
             # NEXT, create the list of coordinates
-            set coords [list]
-
-            foreach {x y} $series(data-$name) {
-                lappend coords [$self x2px $x] [$self y2py $y]
-            }
+            set coords [$self DecimateSeries $name]
 
             # NEXT, if there's only one point, double it to make a valid line.
             if {[llength $coords] == 2} {
@@ -1024,6 +1026,50 @@ snit::widgetadaptor ::marsgui::stripchart {
 
     }
 
+    # Method: DecimateSeries
+    #
+    # Returns the pixel coordinates for the named series, decimated so
+    # that there are at most four points per pixel column.  If the
+    # pixel transform hasn't changed since the last render, only the
+    # data appended since then is decimated.
+    #
+    # Syntax:
+    #   DecimateSeries _name_
+    #
+    #   name - The series name
+
+    method DecimateSeries {name} {
+        # FIRST, get the pixel transform; see x2px and y2py.
+        set xform [list \
+                       $layout(pxmin) $layout(xmin) $layout(xppu) \
+                       $layout(pymax) $layout(ymin) $layout(yppu)]
+
+        # NEXT, use the cached coordinates if they are still valid.
+        set prefix [list]
+        set start  0
+
+        if {[info exists series(dec-$name)]} {
+            lassign $series(dec-$name) cxform cprefix cnext
+
+            if {$cxform eq $xform} {
+                set prefix $cprefix
+                set start  $cnext
+            }
+        }
+
+        # NEXT, decimate the remaining data.  The final pixel column
+        # might get more data, so don't cache it.
+        lassign [decimate $series(data-$name) {*}$xform $start] \
+            coords next lastlen
+
+        set coords [concat $prefix $coords]
+
+        set series(dec-$name) [list \
+            $xform [lrange $coords 0 end-$lastlen] $next]
+
+        return $coords
+    }
+
     # Method: HoverText
     #
     # Returns the appropriate text for hovering over a plot
@@ -1457,8 +1503,9 @@ snit::widgetadaptor ::marsgui::stripchart {
         }
 
         if {$opts(-data) ne ""} {
-            # FIRST, save the series
+            # FIRST, save the series, and clear the decimation cache.
             set series(data-$name) $opts(-data)
+            unset -nocomplain series(dec-$name)
 
             # NEXT, clear the min and max stats, as we'll compute
             # them as needed.
@@ -1477,4 +1524,61 @@ snit::widgetadaptor ::marsgui::stripchart {
         # NEXT, schedule the next rendering
         $lu update
     }
+
+    # Method: append
+    #
+    # Appends data to an existing series called _name_, updating the 
+    # cached data bounds incrementally.  A render is scheduled.  Unlike
+    # plot -data, only the new data needs to be processed when the
+    # chart is rendered, provided that the axis bounds don't change.
+    #
+    # Syntax:
+    #   append _name xylist_
+    #
+    #   name   - The series name
+    #   xylist - A flat list of X/Y pairs, following the existing data
+    #            in X order.
+
+    method append {name xylist} {
+        require {$name in $series(names)} \
+            "Unknown data series: \"$name\""
+
+        if {[llength $xylist] == 0} {
+            return
+        }
+
+        require {[llength $xylist] % 2 == 0} \
+            "Invalid xylist: odd number of elements"
+
+        # FIRST, update the X bounds.
+        if {$series(xmin-$name) eq ""} {
+            set series(xmin-$name) [lindex $xylist 0]
+        }
+
+        set series(xmax-$name) [lindex $xylist end-1]
+
+        # NEXT, update the Y bounds, if they've been computed.
+        if {$series(dmin-$name) ne "" || $series(dmax-$name) ne ""} {
+            set ylist [list]
+            foreach {x y} $xylist {
+                lappend ylist $y
+            }
+
+            if {$series(dmin-$name) ne ""} {
+                set series(dmin-$name) \
+                    [tcl::mathfunc::min $series(dmin-$name) {*}$ylist]
+            }
+
+            if {$series(dmax-$name) ne ""} {
+                set series(dmax-$name) \
+                    [tcl::mathfunc::max $series(dmax-$name) {*}$ylist]
+            }
+        }
+
+        # NEXT, save the data.
+        lappend series(data-$name) {*}$xylist
+
+        # NEXT, schedule the next rendering
+        $lu update
+    }
 }
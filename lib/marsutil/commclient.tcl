@@ -22,6 +22,11 @@
 #   logging, a log component name, and aliases for any update commands
 #   it expects to receive.
 #
+#   The client asks the server for batched output, which it unpacks.
+#   If -framing is set, the client also asks for framed output,
+#   i.e., for long messages and replies to be sent as compressed 
+#   frames; see commframe(n).
+#
 #   See also commserver(n).
 #
 #-----------------------------------------------------------------------
@@ -39,6 +44,7 @@ snit::type ::marsutil::commclient {
     component log            ;# The logger(n) object.
     component retryer        ;# Retry timeout
     component pinger         ;# Ping timeout
+    component codec          ;# commframe(n) object
 
     #-------------------------------------------------------------------
     # Options
@@ -109,6 +115,13 @@ snit::type ::marsutil::commclient {
 
     option -bgerrorcmd -default ""
 
+    # -framing
+    #
+    # If 1, the client asks the server for framed output when it
+    # connects.  Defaults to 0.
+
+    option -framing -default 0 -readonly 1
+
 
     #-------------------------------------------------------------------
     # Instance Variables
@@ -128,6 +141,10 @@ snit::type ::marsutil::commclient {
     # 1 if there's a HandleUpdate call scheduled, and 0 otherwise.
     variable updateScheduled 0
 
+    # Maximum number of milliseconds HandleUpdate spends processing
+    # queued updates before returning to the event loop.
+    variable updateSlice 20
+
     #-------------------------------------------------------------------
     # Constructor
 
@@ -156,6 +173,9 @@ snit::type ::marsutil::commclient {
         # Create the interpreter
         install interp using interp create -safe
 
+        # Create the frame codec
+        install codec using commframe ${selfns}::codec
+
         # Create a new comm(n) channel, and configure it.
         #
         # Note: the -listen 1 is required in order for this
@@ -164,11 +184,17 @@ snit::type ::marsutil::commclient {
         
         set comm [::comm::comm new ${selfns}::commchan -listen 1]
 
-        # Prepare to handle the return protocol.
-        $comm hook reply {
+        # Prepare to handle the return protocol.  Long replies to a
+        # framed client are framed.
+        $comm hook reply [format {
             set return(-code) [lindex $ret 0]
-            set ret [lindex $ret 1]
-        }
+
+            if {[lindex $ret 2] eq "frame"} {
+                set ret [%s decode [lindex $ret 1]]
+            } else {
+                set ret [lindex $ret 1]
+            }
+        } $codec]
 
         # Prepare to handle updates.
         $comm hook eval \
@@ -200,7 +226,9 @@ snit::type ::marsutil::commclient {
     #
     # Receives update commands from commserver(n).  For each command,
     #
-    # * Add the command to the updateQueue
+    # * Add the command to the updateQueue; a "commbatch" of commands
+    #   adds each of them, and a "commframe" is decoded to a 
+    #   "commbatch".  A "commcodebook" adds words to the codebook.
     # * If necessary, schedule an after handler to process it.
     #
     # NOTE: Originally, this routine actually processed the command
@@ -219,8 +247,21 @@ snit::type ::marsutil::commclient {
             return
         }
 
-        # Queue the update command.
-        lappend updateQueue [lindex $buffer 0]
+        # Queue the update command, or the batch of commands.
+        set script [lindex $buffer 0]
+
+        if {[string match "commframe *" $script]} {
+            set script [$codec decode [lindex $script 1]]
+        } elseif {[string match "commcodebook *" $script]} {
+            $codec add {*}[lindex $script 1]
+            return
+        }
+
+        if {[string match "commbatch *" $script]} {
+            lappend updateQueue {*}[lindex $script 1]
+        } else {
+            lappend updateQueue $script
+        }
 
         # If there's no scheduled update handler, schedule one.
         if {!$updateScheduled} {
@@ -231,8 +272,8 @@ snit::type ::marsutil::commclient {
 
     # HandleUpdate
     #
-    # Handles one queued update, and re-schedules itself if there 
-    # are additional updates.
+    # Handles queued updates for up to updateSlice milliseconds, and
+    # re-schedules itself if there are additional updates.
 
     method HandleUpdate {} {
         # FIRST, if there are no queued updates we shouldn't be here.
@@ -242,20 +283,32 @@ snit::type ::marsutil::commclient {
             return
         }
 
-        # NEXT, Dequeue the next command.
-        set cmd [lindex $updateQueue 0]
-        set updateQueue [lrange $updateQueue 1 end]
+        # NEXT, Evaluate commands until the slice is used up, and log
+        # any errors.  Note that the update queue might grow during 
+        # this time.
+        set deadline [expr {[clock milliseconds] + $updateSlice}]
+        set i 0
+
+        while {$i < [llength $updateQueue]} {
+            set cmd [lindex $updateQueue $i]
+            incr i
 
-        # NEXT, Evaluate the command, and log any errors.
-        # Note that the update queue might grow during this time.
-        set code [catch {$interp eval $cmd} result]
+            set code [catch {$interp eval $cmd} result]
 
-        if {$code} {
-            # There shouldn't be any update errors.
-            $self Log warning \
-                "Update error: $result\nCommand: $cmd\n$::errorInfo"
+            if {$code} {
+                # There shouldn't be any update errors.
+                $self Log warning \
+                    "Update error: $result\nCommand: $cmd\n$::errorInfo"
+            }
+
+            if {[clock milliseconds] >= $deadline} {
+                break
+            }
         }
 
+        # NEXT, Dequeue the commands that were handled.
+        set updateQueue [lrange $updateQueue $i end]
+
         # NEXT, if there are any more updates to process, then reschedule.
         # Otherwise note that no handler is scheduled.
         if {[llength $updateQueue] > 0} {
@@ -284,7 +337,14 @@ snit::type ::marsutil::commclient {
         # NEXT, send the connection script, catching any error.  If
         # there's no error, we're connected.  If there's an error and
         # it doesn't indicate a lack of connection, we're OK.
-        set connectScript [list connect $options(-clientname)]
+        set connectScript [list connect $options(-clientname) batch]
+
+        if {$options(-framing)} {
+            lappend connectScript frame
+
+            # The server will send its codebook afresh.
+            $codec reset
+        }
 
         if {[catch {$self send $connectScript} result]} {
             if {![string match "lost connection" $result]} {
@@ -311,7 +371,11 @@ snit::type ::marsutil::commclient {
                 }
             }
         } else {
-            $self Log normal "connected"
+            if {$options(-framing) && "frame" ni $result} {
+                $self Log normal "connected; server does not frame output"
+            } else {
+                $self Log normal "connected"
+            }
 
             if {$options(-connectcmd) ne ""} {
                 uplevel \#0 $options(-connectcmd)
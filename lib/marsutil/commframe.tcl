@@ -0,0 +1,219 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   commframe.tcl
+#
+# PACKAGE:
+#   marsutil(n) -- Tcl Utilities
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+# DESCRIPTION:
+#   marsutil(n) Comm Frame Codec
+#
+#   A commframe(n) object encodes long messages sent by a commserver(n)
+#   as compressed binary frames, and decodes them for a commclient(n).
+#   A frame is:
+#
+#     magic     2 bytes   "MF"
+#     version   1 byte    1
+#     flags     1 byte    1 if the payload is zlib-compressed
+#     words     4 bytes   Number of codebook words used as the
+#                         compression dictionary
+#     length    4 bytes   Length of the payload in bytes
+#     payload   length bytes
+#
+#   Integers are big-endian.  The payload is the message in UTF-8,
+#   compressed using the first "words" words of the codebook as a
+#   zlib preset dictionary.  The codebook is a list of strings that
+#   recur in the messages, e.g., game truth column names; the encoder
+#   and decoder must have the same codebook, which can only grow.
+#
+#   comm(n) carries text, so frames are base64-encoded for
+#   transmission, as gtserver(n) does with its compressed batches.
+#
+#   See also commserver(n), commclient(n).
+#
+#-----------------------------------------------------------------------
+
+namespace eval ::marsutil:: {
+    namespace export commframe
+}
+
+snit::type ::marsutil::commframe {
+    #-------------------------------------------------------------------
+    # Options
+
+    # -level
+    #
+    # The zlib compression level, 0 to 9.  The default, 1, is the
+    # fastest; on a LAN, the time saved compressing more tightly is
+    # worth more than the bytes.
+
+    option -level -default 1 -type {snit::integer -min 0 -max 9}
+
+    #-------------------------------------------------------------------
+    # Instance Variables
+
+    # The codebook: a list of words.
+    variable codebook {}
+
+    # Array of the codebook words, for membership tests.
+    variable words -array {}
+
+    # Array of compression dictionaries, by number of words.
+    variable dicts -array {}
+
+    #-------------------------------------------------------------------
+    # Constructor
+
+    constructor {args} {
+        $self configurelist $args
+    }
+
+    #-------------------------------------------------------------------
+    # Private Methods
+
+    # Dictionary n
+    #
+    # n      A number of codebook words
+    #
+    # Returns the compression dictionary made from the first n words.
+
+    method Dictionary {n} {
+        if {![info exists dicts($n)]} {
+            if {$n > [llength $codebook]} {
+                error "invalid comm frame: unknown codebook words"
+            }
+
+            set dicts($n) [encoding convertto utf-8 \
+                               [join [lrange $codebook 0 $n-1] " "]]
+        }
+
+        return $dicts($n)
+    }
+
+    #-------------------------------------------------------------------
+    # Public Methods
+
+    # codebook
+    #
+    # Returns the codebook.
+
+    method codebook {} {
+        return $codebook
+    }
+
+    # size
+    #
+    # Returns the number of words in the codebook.
+
+    method size {} {
+        llength $codebook
+    }
+
+    # add word...
+    #
+    # word     A word to add to the codebook
+    #
+    # Adds the words to the end of the codebook, ignoring those
+    # already in it.  Returns the number of words added.
+
+    method add {args} {
+        set count 0
+
+        foreach word $args {
+            if {![info exists words($word)]} {
+                set words($word) 1
+                lappend codebook $word
+                incr count
+            }
+        }
+
+        return $count
+    }
+
+    # reset
+    #
+    # Empties the codebook.
+
+    method reset {} {
+        set codebook [list]
+        array unset words
+        array unset dicts
+    }
+
+    # encode text ?n?
+    #
+    # text     The message text
+    # n        Number of codebook words to use; defaults to all
+    #
+    # Returns the text as a compressed, base64-encoded frame.
+
+    method encode {text {n ""}} {
+        if {$n eq ""} {
+            set n [llength $codebook]
+        }
+
+        set data [encoding convertto utf-8 $text]
+
+        if {$n == 0} {
+            set payload [zlib compress $data $options(-level)]
+        } else {
+            set z [zlib stream compress \
+                       -level      $options(-level) \
+                       -dictionary [$self Dictionary $n]]
+
+            try {
+                $z put -finalize $data
+                set payload [$z get]
+            } finally {
+                $z close
+            }
+        }
+
+        binary encode base64 \
+            [binary format a2ccIIa* MF 1 1 $n [string length $payload] \
+                 $payload]
+    }
+
+    # decode frame
+    #
+    # frame    A base64-encoded frame
+    #
+    # Returns the text of the frame's message.
+
+    method decode {frame} {
+        if {[catch {binary decode base64 -strict $frame} bytes] ||
+            ![binary scan $bytes a2cucuIuIu magic version flags n length] ||
+            $magic ne "MF"                                ||
+            $version != 1                                 ||
+            $length != [string length $bytes] - 12
+        } {
+            error "invalid comm frame"
+        }
+
+        set payload [string range $bytes 12 end]
+
+        if {$flags & 1} {
+            if {$n == 0} {
+                set payload [zlib decompress $payload]
+            } else {
+                set z [zlib stream decompress \
+                           -dictionary [$self Dictionary $n]]
+
+                try {
+                    $z put -finalize $payload
+                    set payload [$z get]
+                } finally {
+                    $z close
+                }
+            }
+        }
+
+        encoding convertfrom utf-8 $payload
+    }
+}
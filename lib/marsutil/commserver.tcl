@@ -18,6 +18,23 @@
 #   port and send commands to a command executive for processing.
 #   Incoming commands are handled and responded to synchronously.
 #
+#   A client may ask for batched output by connecting with
+#   "connect <name> batch".  Outgoing scripts, sent by broadcast and
+#   send, are then queued for the client, and sent in batches when the
+#   event loop is idle.  Each batch is serialized once, however many
+#   clients it goes to.  A client whose socket has more than -highwater
+#   bytes of pending output is sent its further batches as its socket
+#   becomes writable, so that one slow client doesn't block the server;
+#   a client that falls more than -maxqueue bytes behind is dropped.
+#   Other clients are sent each script immediately.
+#
+#   A batched client may also ask for framed output by connecting with
+#   "connect <name> batch frame".  Batches and replies longer than
+#   -framethreshold bytes are then sent to it as compressed frames;
+#   see commframe(n).  The server's codebook, to which gtserver(n)
+#   adds its column names, is sent to each framed client before the
+#   first frame that uses it.
+#
 #   The creator must specify the port ID, a logger(n) object for
 #   logging, a log component name, and the command used to validate
 #   connections.
@@ -83,10 +100,47 @@ snit::type ::marsutil::commserver {
     
     option -allowremote -default 0 -readonly 1
 
+    # -batch
+    #
+    # If 1 (the default), clients may ask for batched output, as
+    # described above.  If 0, each script is sent immediately.
+
+    option -batch -default 1 -readonly 1
+
+    # -highwater
+    #
+    # The maximum number of bytes of pending output on a client's
+    # socket, and the maximum number of bytes sent to a client when
+    # its socket becomes writable.
+
+    option -highwater -default 262144
+
+    # -maxqueue
+    #
+    # The maximum number of bytes of batches waiting to be sent to a
+    # client.  A client whose queue grows larger is dropped.
+
+    option -maxqueue -default 16777216
+
+    # -framing
+    #
+    # If 1 (the default), clients may ask for framed output.  Framing
+    # requires -batch.
+
+    option -framing -default 1 -readonly 1
+
+    # -framethreshold
+    #
+    # Batches and replies to framed clients are framed if they are
+    # longer than this many bytes.
+
+    option -framethreshold -default 4096
+
     #-------------------------------------------------------------------
     # Components
 
     component log            ;# logger(n) object
+    component codec          ;# commframe(n) object
     component comm           ;# comm(n) channel
 
     #-------------------------------------------------------------------
@@ -105,9 +159,34 @@ snit::type ::marsutil::commserver {
     #    ex-$id            Executive which handles commands for client
     #    time-$name        Connection time of given logical $name
     #    stat-$name        Connection status of given logical $name
+    #
+    # Batching:
+    #
+    #    batched           Number of batched clients
+    #    batch-$id         1 if $id gets batched output, and 0 otherwise.
+    #    bcast             List of broadcast scripts not yet batched.
+    #    bexclude          Names of the clients to which the bcast 
+    #                      scripts are not sent.
+    #    direct            List of IDs of clients with direct-$id scripts.
+    #    direct-$id        List of scripts sent to $id not yet batched.
+    #    queue-$id         List of batches waiting to be sent to $id.
+    #    qbytes-$id        Number of bytes in queue-$id.
+    #    flushing          1 if a Flush is scheduled, and 0 otherwise.
+    #
+    # Framing:
+    #
+    #    framed            Number of framed clients
+    #    frame-$id         1 if $id gets framed output, and 0 otherwise.
+    #    words-$id         Number of codebook words sent to $id.
     variable info -array {
-        ids   {}
-        names {}
+        ids      {}
+        names    {}
+        bcast    {}
+        bexclude {}
+        direct   {}
+        flushing 0
+        batched  0
+        framed   0
     }
 
     #-------------------------------------------------------------------
@@ -132,10 +211,18 @@ snit::type ::marsutil::commserver {
         # this.
         set comm ::comm::comm
 
+        install codec using commframe ${selfns}::codec
+
         $self Log normal "Initialized"
     }
 
     destructor {
+        after cancel [mymethod Flush]
+
+        foreach id $info(ids) {
+            catch {chan event [$self ClientSocket $id] writable {}}
+        }
+
         catch {$comm destroy}
     }
 
@@ -162,8 +249,7 @@ snit::type ::marsutil::commserver {
     method ClientEval {id buffer} {
         # Register the sender
         if {![info exists info(name-$id)]} {
-            $self ClientConnect $id $buffer
-            return
+            return [$self ClientConnect $id $buffer]
         }
         
         # Since the command is sent as a single script rather than
@@ -181,8 +267,9 @@ snit::type ::marsutil::commserver {
         # if need be.
         set currentClient $id
 
-        # Ask the application to evaluate the command.
-        $self Log detail "$info(name-$id): $script"
+        # Ask the application to evaluate the command.  The command
+        # is logged at debug level; clients send many of them.
+        $self Log debug "$info(name-$id): $script"
         set result [callwith $options(-evalcmd) $info(name-$id) $script]
 
         # Next, clear currentClient.
@@ -199,7 +286,9 @@ snit::type ::marsutil::commserver {
     #
     # Validates and accepts a connection from the client.  
     # The buffer should contain a Tcl list of the form 
-    # {connect <name>}.
+    # {connect <name> ?batch? ?frame?}.  Returns the list of the
+    # options the client will get, which is empty for clients that
+    # ask for none.
     #
     # The logical name and the IP address (or localhost) of the 
     # client will be passed to the -validatecmd, which will throw
@@ -213,7 +302,13 @@ snit::type ::marsutil::commserver {
             error "protocol error: expected 'connect <name>', got '$buffer'"
         }
         
-        set name [lindex $buffer 1]
+        set name  [lindex $buffer 1]
+        set batch [expr {
+            "batch" in [lrange $buffer 2 end] && $options(-batch)
+        }]
+        set frame [expr {
+            "frame" in [lrange $buffer 2 end] && $options(-framing) && $batch
+        }]
 
         if {$name eq ""} {
             set name [join $id _]
@@ -255,10 +350,30 @@ snit::type ::marsutil::commserver {
         set info(ip-$id)     $ip
         set info(time-$name) [clock seconds] 
         set info(stat-$name) "connected"
+        set info(queue-$id)  [list]
+        set info(qbytes-$id) 0
+        set info(batch-$id)  $batch
+        set info(frame-$id)  $frame
+        set info(words-$id)  0
+        incr info(batched)   $batch
+        incr info(framed)    $frame
 
         $self Log detail "Connect: '$name' at id <$id>"
 
         callwith $options(-connectcmd) $name $ip
+
+        # Tell the client what output it will get.
+        set result [list]
+
+        if {$batch} {
+            lappend result batch
+        }
+
+        if {$frame} {
+            lappend result frame
+        }
+
+        return $result
     }
     
 
@@ -285,11 +400,302 @@ snit::type ::marsutil::commserver {
         unset info(id-$name)
         unset info(name-$id)
         unset info(ip-$id)
+        incr info(batched) -$info(batch-$id)
+        incr info(framed) -$info(frame-$id)
+        unset info(batch-$id) info(frame-$id) info(words-$id)
+        unset info(queue-$id) info(qbytes-$id)
+        unset -nocomplain info(direct-$id)
+        ldelete info(direct) $id
 
         set info(time-$name) [clock seconds] 
         set info(stat-$name) "disconnected"
     }
 
+    #-------------------------------------------------------------------
+    # Batching
+
+    # ScheduleFlush
+    #
+    # Schedules a Flush when the event loop is next idle, if one isn't
+    # already scheduled.
+
+    method ScheduleFlush {} {
+        if {!$info(flushing)} {
+            set info(flushing) 1
+            after idle [mymethod Flush]
+        }
+    }
+
+    # Flush
+    #
+    # Batches the scripts sent since the last flush, and sends each
+    # client what its socket can take.  Clients left with more than
+    # -maxqueue bytes to send are dropped.
+
+    method Flush {} {
+        set info(flushing) 0
+
+        $self BatchBroadcast
+        $self BatchDirect
+
+        # Sending to one client can disconnect it, so check that each
+        # is still here.
+        foreach id $info(ids) {
+            if {![info exists info(queue-$id)] ||
+                [llength $info(queue-$id)] == 0
+            } {
+                continue
+            }
+
+            $self SendQueue $id
+
+            if {[info exists info(qbytes-$id)] &&
+                $info(qbytes-$id) > $options(-maxqueue)
+            } {
+                $self DropClient $id
+            }
+        }
+    }
+
+    # DropClient id
+    #
+    # id     A client's comm(n) ID
+    #
+    # Disconnects a client that can't keep up with its output.
+
+    method DropClient {id} {
+        $self Log warning \
+            "Dropping '$info(name-$id)' at <$id>: $info(qbytes-$id) bytes queued"
+
+        set sock [$self ClientSocket $id]
+
+        if {$sock ne ""} {
+            catch {chan event $sock writable {}}
+        }
+
+        catch {$comm shutdown $id}
+
+        # The "lost" hook has probably disconnected it already.
+        $self ClientDisconnect $id
+    }
+
+    # Enqueue id msg
+    #
+    # id      A batched client's comm(n) ID
+    # msg     A message to send to the client
+    #
+    # Adds the message to the client's queue.
+
+    method Enqueue {id msg} {
+        lappend info(queue-$id) $msg
+        incr info(qbytes-$id) [string length $msg]
+    }
+
+    # BatchBroadcast
+    #
+    # Adds the pending broadcast scripts to the queue of each client
+    # not excluded as a single batch.  The batch's string representation
+    # is computed here, once, and shared by all of the queues.
+
+    method BatchBroadcast {} {
+        if {[llength $info(bcast)] == 0} {
+            return
+        }
+
+        set batch [list commbatch $info(bcast)]
+        string length $batch
+        set exclude $info(bexclude)
+        set info(bcast)    [list]
+        set info(bexclude) [list]
+
+        if {$info(framed) > 0} {
+            set framed [$self Frame $batch]
+        }
+
+        foreach id $info(ids) {
+            if {$info(name-$id) in $exclude} {
+                continue
+            }
+
+            if {$info(frame-$id)} {
+                $self QueueFramed $id $framed
+            } elseif {$info(batch-$id)} {
+                $self Enqueue $id $batch
+            }
+        }
+    }
+
+    # BatchDirect
+    #
+    # Adds the pending scripts sent to individual clients to their
+    # queues, one batch per client.
+
+    method BatchDirect {} {
+        foreach id $info(direct) {
+            set batch [list commbatch $info(direct-$id)]
+            unset info(direct-$id)
+
+            if {$info(frame-$id)} {
+                $self QueueFramed $id [$self Frame $batch]
+            } else {
+                $self Enqueue $id $batch
+            }
+        }
+
+        set info(direct) [list]
+    }
+
+    # Frame batch
+    #
+    # batch    A commbatch message
+    #
+    # Returns the batch as a commframe message, if it is longer than
+    # -framethreshold, and the batch itself otherwise.  The frame's
+    # string representation is computed here, so that it can be shared.
+
+    method Frame {batch} {
+        if {[string length $batch] <= $options(-framethreshold)} {
+            return $batch
+        }
+
+        set msg [list commframe [$codec encode $batch]]
+        string length $msg
+
+        return $msg
+    }
+
+    # QueueFramed id msg
+    #
+    # id      A framed client's comm(n) ID
+    # msg     A commbatch or commframe message
+    #
+    # Adds the message to the client's queue, preceded by any codebook
+    # words the client doesn't have yet.
+
+    method QueueFramed {id msg} {
+        if {$info(words-$id) < [$codec size]} {
+            $self Enqueue $id \
+                [list commcodebook \
+                     [lrange [$codec codebook] $info(words-$id) end]]
+            set info(words-$id) [$codec size]
+        }
+
+        $self Enqueue $id $msg
+    }
+
+    # ClientReply id result
+    #
+    # id       A client's comm(n) ID
+    # result   The result of the client's command
+    #
+    # Returns the reply to send to the client: a list of "ok" and the
+    # result, or, if the client is framed and the result is long, of
+    # "ok", the result as a frame, and "frame".  Replies bypass the
+    # queue, and so don't use the codebook.
+
+    method ClientReply {id result} {
+        if {[info exists info(frame-$id)] && $info(frame-$id) &&
+            [string length $result] > $options(-framethreshold)
+        } {
+            return [list ok [$codec encode $result 0] frame]
+        }
+
+        return [list ok $result]
+    }
+
+    # SendQueue id
+    #
+    # id     A client's comm(n) ID
+    #
+    # Sends the client's queued batches until the queue is empty, 
+    # -highwater bytes have been sent, or the client's socket has more
+    # than -highwater bytes of pending output.  Any remaining batches
+    # are sent when the socket is writable.
+
+    method SendQueue {id} {
+        set sock [$self ClientSocket $id]
+        set sent 0
+
+        while {[llength $info(queue-$id)] > 0} {
+            if {$sock ne "" && 
+                ($sent >= $options(-highwater) ||
+                 [chan pending output $sock] > $options(-highwater))
+            } {
+                chan event $sock writable [mymethod ClientWritable $id]
+                return
+            }
+
+            set info(queue-$id) [lassign $info(queue-$id) batch]
+            incr sent [string length $batch]
+            incr info(qbytes-$id) -[string length $batch]
+
+            if {![$self SendTo $id $batch]} {
+                return
+            }
+        }
+
+        if {$sock ne ""} {
+            chan event $sock writable {}
+        }
+    }
+
+    # ClientWritable id
+    #
+    # id     A client's comm(n) ID
+    #
+    # Called when the client's socket is writable; sends more of its
+    # queued batches.
+
+    method ClientWritable {id} {
+        if {[info exists info(queue-$id)]} {
+            $self SendQueue $id
+        }
+    }
+
+    # ClientSocket id
+    #
+    # id     A client's comm(n) ID
+    #
+    # Returns the client's socket, or "" if it isn't known.  comm(n)
+    # doesn't make its sockets public, so this depends on its 
+    # internals; without the socket, batches are simply sent in 
+    # order.
+
+    method ClientSocket {id} {
+        set key "$comm,peers,$id"
+
+        if {[info exists ::comm::comm($key)]} {
+            return $::comm::comm($key)
+        }
+
+        return ""
+    }
+
+    # SendTo id script
+    #
+    # id       A client's comm(n) ID
+    # script   A script or batch
+    #
+    # Sends the script to the client asynchronously.  If the client
+    # has gone away, disconnects it and returns 0; otherwise returns 1.
+
+    method SendTo {id script} {
+        if {[catch {$comm send -async $id $script} result]} {
+            $self Log detail "Error sending to <$id>: $result"
+
+            # There's likely a disconnect further back in the queue
+            # so just handle it now.
+            if {[regexp "connection reset by peer" $result] ||
+                [regexp "broken pipe" $result]
+            } {
+                catch {$self ClientDisconnect $id}
+                return 0
+            }
+        }
+
+        return 1
+    }
+
     #-------------------------------------------------------------------
     # Public methods
 
@@ -319,9 +725,9 @@ snit::type ::marsutil::commserver {
                 if {$code} {
                     return [list error $result]
                 } else {
-                    return [list ok $result]
+                    return [%s ClientReply $id $result]
                 }
-            } $self]
+            } $self $self]
 
         # Prepare to receive disconnects
         $comm hook lost [format {
@@ -335,28 +741,42 @@ snit::type ::marsutil::commserver {
         $self Log detail "listening"
     }
 
-    # broadcast script
+    # broadcast script ?exclude?
     #
     # script     A client update script
+    # exclude    A list of client logical names
     #
-    # Sends the script to all attached clients asynchronously;
-    # the response is ignored.
+    # Sends the script to all attached clients but those excluded
+    # asynchronously; the response is ignored.  The script is queued
+    # for batched clients.
 
-    method broadcast {script} {
+    method broadcast {script {exclude ""}} {
         $self Log debug "Broadcast: $script"
+
         foreach id $info(ids) {
-            if {[catch {$comm send -async $id $script} result]} {
-                $self Log detail "Error sending to <$id>: $result"
-                
-                # There's likely a disconnect further back in the queue
-                # so just handle it now.
-                if {[regexp "connection reset by peer" $result] ||
-                    [regexp "broken pipe" $result]
-                } {
-                    catch {$self ClientDisconnect $id}
-                }
+            if {!$info(batch-$id) && $info(name-$id) ni $exclude} {
+                $self SendTo $id $script
             }
         }
+
+        if {$info(batched) == 0} {
+            return
+        }
+
+        # Scripts sent to individual clients before this one must
+        # be batched first, to preserve the order.
+        if {[llength $info(direct)] > 0} {
+            $self BatchDirect
+        }
+
+        # Scripts in a batch go to the same clients.
+        if {[llength $info(bcast)] > 0 && $exclude ne $info(bexclude)} {
+            $self BatchBroadcast
+        }
+
+        set info(bexclude) $exclude
+        lappend info(bcast) $script
+        $self ScheduleFlush
     }
 
     # send name script
@@ -365,13 +785,64 @@ snit::type ::marsutil::commserver {
     # script     A client update script
     #
     # Sends the script to the specified client asynchronously;
-    # the response is ignored.
+    # the response is ignored.  The script is queued for a batched 
+    # client.
 
     method send {name script} {
         $self Log debug "Update client $name: $script"
 
         require {[info exists info(id-$name)]} "Unknown client name: '$name'"
-        $comm send -async $info(id-$name) $script
+
+        if {!$info(batch-$info(id-$name))} {
+            $comm send -async $info(id-$name) $script
+            return
+        }
+
+        # Broadcast scripts sent before this one must be batched 
+        # first, to preserve the order.
+        if {[llength $info(bcast)] > 0} {
+            $self BatchBroadcast
+        }
+
+        set id $info(id-$name)
+
+        if {![info exists info(direct-$id)]} {
+            lappend info(direct) $id
+        }
+
+        lappend info(direct-$id) $script
+        $self ScheduleFlush
+    }
+
+    # codebook add word...
+    #
+    # word     A word that recurs in messages sent to clients
+    #
+    # Adds the words to the codebook used to compress frames; see
+    # commframe(n).  Words already in the codebook are ignored.
+
+    method {codebook add} {args} {
+        $codec add {*}$args
+        return
+    }
+
+    # codebook get
+    #
+    # Returns the codebook.
+
+    method {codebook get} {} {
+        $codec codebook
+    }
+
+    # flush
+    #
+    # Sends all queued scripts to the clients immediately, rather than
+    # waiting for the event loop.  Clients with a backlog still 
+    # receive the remainder as their sockets become writable.
+
+    method flush {} {
+        after cancel [mymethod Flush]
+        $self Flush
     }
 
     # clientid
@@ -21,6 +21,10 @@
 #   an output color in which R, G, and B are each interpolated
 #   separately.
 #
+#   The colors are precomputed into a lookup table of -lutsize 
+#   entries, which is rebuilt on first use after the gradient is
+#   configured; [color] is then just an index into the table.
+#
 #-----------------------------------------------------------------------
 
 namespace eval ::marsutil:: {
@@ -44,6 +48,7 @@ snit::type ::marsutil::gradient {
         set options($opt) $val
 
         scan $val "#%2x%2x%2x" min(r) min(g) min(b)
+        set lut {}
     }
 
     # -midcolor
@@ -56,6 +61,7 @@ snit::type ::marsutil::gradient {
         set options($opt) $val
 
         scan $val "#%2x%2x%2x" mid(r) mid(g) mid(b)
+        set lut {}
     }
 
 
@@ -69,25 +75,41 @@ snit::type ::marsutil::gradient {
         set options($opt) $val
 
         scan $val "#%2x%2x%2x" max(r) max(g) max(b)
+        set lut {}
     }
 
     # -minlevel
     #
     # The minimum input level
 
-    option -minlevel -default 0.0
+    option -minlevel -default 0.0 -configuremethod ConfigLUT
 
     # -midlevel
     #
     # The minimum input level
 
-    option -midlevel -default 0.0
+    option -midlevel -default 0.0 -configuremethod ConfigLUT
 
     # -maxlevel
     #
     # The maximum input level
     
-    option -maxlevel -default 0.0
+    option -maxlevel -default 0.0 -configuremethod ConfigLUT
+
+    # -lutsize
+    #
+    # The number of entries in the color lookup table, half for 
+    # each side of -midlevel.
+
+    option -lutsize \
+        -default         512                              \
+        -type            {snit::integer -min 4 -max 4096} \
+        -configuremethod ConfigLUT
+
+    method ConfigLUT {opt val} {
+        set options($opt) $val
+        set lut {}
+    }
 
     #-------------------------------------------------------------------
     # Instance variables
@@ -115,6 +137,23 @@ snit::type ::marsutil::gradient {
         b    0x00
     }
 
+    # Color lookup table: a list of -lutsize colors, or {} if it 
+    # needs to be rebuilt.  The first half spans -minlevel to 
+    # -midlevel, and the second half -midlevel to -maxlevel.
+    variable lut {}
+
+    # Array of lookup table parameters
+    #
+    # half       Number of entries in each half of the table
+    # loscale    Entries per unit level below -midlevel
+    # hiscale    Entries per unit level above -midlevel
+    
+    variable scale -array {
+        half     0
+        loscale  0.0
+        hiscale  0.0
+    }
+
     #-------------------------------------------------------------------
     # Public Methods
 
@@ -123,14 +162,126 @@ snit::type ::marsutil::gradient {
     # level    An input level
     #
     # Given an input level between -minlevel and -maxlevel, produces
+    # an output color between -mincolor and -maxcolor, as looked up 
+    # in the table.  See Interpolate for the details.
+
+    method color {level} {
+        if {$lut eq ""} {
+            $self BuildLUT
+        }
+
+        if {$level < $options(-midlevel)} {
+            set i [expr {
+                int(($level - $options(-minlevel))*$scale(loscale) + 0.5)
+            }]
+
+            if {$i < 0} {
+                set i 0
+            }
+        } else {
+            set i [expr {
+                int(($level - $options(-midlevel))*$scale(hiscale) + 0.5)
+            }]
+
+            if {$i >= $scale(half)} {
+                set i [expr {$scale(half) - 1}]
+            }
+
+            incr i $scale(half)
+        }
+
+        return [lindex $lut $i]
+    }
+
+    # colors levels
+    #
+    # levels   A list of input levels
+    #
+    # Returns a list of the colors for the input levels.  This is
+    # [color] inlined into a loop, for recoloring many items at once.
+
+    method colors {levels} {
+        if {$lut eq ""} {
+            $self BuildLUT
+        }
+
+        set minlevel $options(-minlevel)
+        set midlevel $options(-midlevel)
+        set last     [expr {$scale(half) - 1}]
+        set result   [list]
+
+        foreach level $levels {
+            if {$level < $midlevel} {
+                set i [expr {int(($level - $minlevel)*$scale(loscale) + 0.5)}]
+
+                if {$i < 0} {
+                    set i 0
+                }
+            } else {
+                set i [expr {int(($level - $midlevel)*$scale(hiscale) + 0.5)}]
+
+                if {$i > $last} {
+                    set i $last
+                }
+
+                incr i $scale(half)
+            }
+
+            lappend result [lindex $lut $i]
+        }
+
+        return $result
+    }
+
+    #-------------------------------------------------------------------
+    # Private Methods
+
+    # BuildLUT
+    #
+    # Builds the color lookup table for the current options.  Each
+    # half of the table samples its range at evenly spaced levels, 
+    # including both ends, so that the -mincolor, -midcolor, and
+    # -maxcolor are exact.  A zero-width range is sampled at its 
+    # single level.
+
+    method BuildLUT {} {
+        set half [expr {$options(-lutsize)/2}]
+        set lo   [expr {double($options(-midlevel) - $options(-minlevel))}]
+        set hi   [expr {double($options(-maxlevel) - $options(-midlevel))}]
+
+        set scale(half)    $half
+        set scale(loscale) [expr {$lo > 0 ? ($half - 1)/$lo : 0.0}]
+        set scale(hiscale) [expr {$hi > 0 ? ($half - 1)/$hi : 0.0}]
+
+        set lut [list]
+
+        for {set i 0} {$i < $half - 1} {incr i} {
+            lappend lut [$self Interpolate \
+                [expr {$options(-minlevel) + $i*$lo/($half - 1)}]]
+        }
+
+        lappend lut [$self Interpolate $options(-midlevel)]
+
+        for {set i 0} {$i < $half - 1} {incr i} {
+            lappend lut [$self Interpolate \
+                [expr {$options(-midlevel) + $i*$hi/($half - 1)}]]
+        }
+
+        lappend lut [$self Interpolate $options(-maxlevel)]
+    }
+
+    # Interpolate level
+    #
+    # level    An input level
+    #
+    # Given an input level between -minlevel and -maxlevel, produces
     # an output color between -mincolor and -maxcolor.  Actually, 
     # inputs from -minlevel to -midlevel scale between -mincolor and
     # -midcolor; inputs from -midlevel to -maxlevel scale between
     # -midcolor and -maxcolor.  Inputs outside of -minlevel,-maxlevel
     # are clamped.
-   
 
-    method color {level} {
+    method Interpolate {level} {
         # FIRST, it all depends on where we are relative to the
         # -midlevel. 
         if {$level == $options(-midlevel)} {
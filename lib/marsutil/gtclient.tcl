@@ -26,6 +26,10 @@
 #      commclient proxy ...options...
 #      gtclient gt ...options...
 #      proxy alias gt gt
+#
+#   A client on the same host as the gtserver(n) may instead read the
+#   game truth objects from the server's shared database; see the 
+#   "share" method.
 #    
 #-----------------------------------------------------------------------
 
@@ -82,6 +86,7 @@ snit::type gtclient {
 
     component log            ;# logger(n) object
     component db             ;# sqlite database
+    component shared         ;# read-only shared database, or ""
 
     #-------------------------------------------------------------------
     # Instance variables
@@ -90,12 +95,17 @@ snit::type gtclient {
     variable watchers            ;# Array of watch commands.
     variable receivingRefresh 0  ;# 0 normally, 1 while receiving refresh
                                   # before calling watchers.
+    # Memory-map size for the shared database, in bytes.
+    variable mmapSize 268435456
+
     # classinfo -- class information array
     # 
     # classes       the list of classes registered with the server
     # $class-table  the name of the database table 
     # $class-idcol  the key column in the table
     # $class-prefix the command callback 
+    # $class-version the class version received in the last batch,
+    #               or "" if none.
     #
     variable classinfo -array {
         classes {}
@@ -112,6 +122,10 @@ snit::type gtclient {
         set db $options(-db)
     }
 
+    destructor {
+        catch {$shared close}
+    }
+
     #-------------------------------------------------------------------
     # Private Methods
 
@@ -241,6 +255,11 @@ snit::type gtclient {
         if {[info exists db]} {
             $db clear
         }
+
+        # NEXT, the class versions are no longer valid.
+        foreach class $classinfo(classes) {
+            set classinfo($class-version) ""
+        }
     }
 
     # complete
@@ -288,6 +307,7 @@ snit::type gtclient {
         set classinfo($class-table)  $table
         set classinfo($class-idcol)  $idcolumn
         set classinfo($class-prefix) ""
+        set classinfo($class-version) ""
 
         # NEXT, add this class in the classes list if not already there
         if {[lsearch -exact $classinfo(classes) $class] == -1} {
@@ -351,6 +371,200 @@ snit::type gtclient {
         }
     }
 
+    # batch class version reset format payload
+    #
+    # class    The class of game truth object
+    # version  The server's version of the class after this batch
+    # reset    1 if the class's table should be emptied first, 0 otherwise
+    # format   "zlib" or "list"
+    # payload  The encoded list {columns rows deleted}
+    #
+    # Applies a batch of rows sent by gtserver(n) during a refresh:
+    # rows are inserted or updated, and the deleted IDs are deleted,
+    # all in a single transaction.
+
+    method batch {class version reset format payload} {
+        # FIRST, check to see if the class has been registered
+        if {[lsearch -exact $classinfo(classes) $class] == -1} {
+            $self Log warning "Unknown game truth object class: $class"
+            return
+        }
+
+        # NEXT, decode the payload
+        if {$format eq "zlib"} {
+            set payload [encoding convertfrom utf-8 \
+                [zlib decompress [binary decode base64 $payload]]]
+        }
+
+        lassign $payload columns rows deleted
+
+        set table $classinfo($class-table)
+        set idcol $classinfo($class-idcol)
+        set prefix $classinfo($class-prefix)
+        set notify [expr {!$receivingRefresh && $prefix ne ""}]
+
+        # NEXT, build the update query once for the whole batch.
+        set sets [list]
+        foreach col $columns {
+            lappend sets "$col = \$row($col)"
+        }
+        set update "
+            UPDATE $table SET [join $sets ,]
+            WHERE $idcol == \$row($idcol)
+        "
+
+        set updated [list]
+
+        $db transaction {
+            if {$reset} {
+                $db eval "DELETE FROM $table"
+            }
+
+            foreach values $rows {
+                foreach col $columns val $values {
+                    set row($col) $val
+                }
+
+                $db eval "
+                    INSERT OR IGNORE INTO ${table}($idcol)
+                    VALUES(\$row($idcol))
+                "
+                $db eval $update
+
+                lappend updated $row($idcol)
+            }
+
+            foreach id $deleted {
+                if {$notify} {
+                    callwith $prefix delete $id
+                }
+
+                $db eval "DELETE FROM $table WHERE $idcol == \$id"
+            }
+        }
+
+        set classinfo($class-version) $version
+
+        # NEXT, notify the application
+        if {$notify} {
+            foreach id $updated {
+                callwith $prefix update $id
+            }
+        }
+    }
+
+    # share filename
+    #
+    # filename   The gtserver(n)'s shared database file, as returned
+    #            by its "share" method.
+    #
+    # Opens the shared database read-only, and memory-maps it.  The
+    # game truth objects are then read from the shared database,
+    # rather than from -db, and "gt published" notifications update
+    # the class versions and call the -onupdate commands.
+
+    method share {filename} {
+        catch {$shared close}
+
+        sqlite3 ${selfns}::shared $filename -readonly 1
+        set shared ${selfns}::shared
+
+        $shared eval "PRAGMA mmap_size = $mmapSize"
+
+        $self published
+    }
+
+    # shareddb
+    #
+    # Returns the name of the read-only shared database command, or
+    # "" if the client isn't sharing.  Game truth object tables are
+    # queried using this command.
+
+    method shareddb {} {
+        return $shared
+    }
+
+    # published ?changes?
+    #
+    # changes    A dictionary of class versions; ignored.
+    #
+    # Handles a "gt published" notification: for each class whose
+    # version in the shared database has changed, calls the
+    # class's -onupdate command for each row changed or deleted since
+    # the client's version.  If the client has no version, or the
+    # server's change tracking has been restarted, it is called for
+    # every row.  The shared database is read in one transaction, so
+    # that the versions and the rows are consistent.
+
+    method published {{changes ""}} {
+        if {$shared eq ""} {
+            $self Log warning "Ignoring gt published; not sharing."
+            return
+        }
+
+        $shared transaction {
+            $shared eval {
+                SELECT class, tbl, idcol, generation, version
+                FROM gtshared_classes
+            } {
+                if {$class ni $classinfo(classes)} {
+                    continue
+                }
+
+                set version [list $generation $version]
+                set old     $classinfo($class-version)
+
+                if {$old eq $version} {
+                    continue
+                }
+
+                set classinfo($class-version) $version
+                set prefix $classinfo($class-prefix)
+
+                if {$receivingRefresh || $prefix eq ""} {
+                    continue
+                }
+
+                lassign $old ogen ocount
+
+                if {$ogen eq $generation} {
+                    $shared eval {
+                        SELECT id, deleted FROM gtshared_rows
+                        WHERE class = $class AND version > $ocount
+                        ORDER BY version
+                    } {
+                        if {$deleted} {
+                            callwith $prefix delete $id
+                        } else {
+                            callwith $prefix update $id
+                        }
+                    }
+                } else {
+                    foreach id [$shared eval "SELECT $idcol FROM $tbl"] {
+                        callwith $prefix update $id
+                    }
+                }
+            }
+        }
+    }
+
+    # versions
+    #
+    # Returns a dictionary of the class versions received from
+    # gtserver(n), for use in requesting a delta refresh.
+
+    method versions {} {
+        set result [dict create]
+
+        foreach class $classinfo(classes) {
+            if {$classinfo($class-version) ne ""} {
+                dict set result $class $classinfo($class-version)
+            }
+        }
+
+        return $result
+    }
+
     # delete class id
     #
     # class    The class of game truth object 
@@ -27,6 +27,13 @@
 #
 #   Game truth clients should use gtclient(n) in tandem with a commclient(n).
 #
+#   Clients on the same host may instead read the game truth objects 
+#   from a shared SQLite database file, given by -sharedfile, into 
+#   which the server publishes the class tables when the application
+#   calls "complete".  Such clients are sent a short "gt published"
+#   notification rather than the individual "gt update" and 
+#   "gt delete" messages.
+#
 #-----------------------------------------------------------------------
 
 namespace eval ::marsutil:: {
@@ -64,12 +71,28 @@ snit::type ::marsutil::gtserver {
     
     option -db -readonly 1
 
+    # -compress
+    #
+    # If true, the payload of "gt batch" messages is compressed.
+
+    option -compress -default yes -type snit::boolean
+
+    # -sharedfile
+    #
+    # The name of the SQLite database file in which to publish the 
+    # game truth objects for local clients, or "" for none.  It should
+    # be on a memory-backed file system, e.g., /dev/shm.  The file is
+    # created afresh, and deleted when the gtserver is destroyed.
+
+    option -sharedfile -default "" -readonly 1
+
     #-------------------------------------------------------------------
     # Components
 
     component log            ;# logger(n) object
     component cs             ;# commserver(n) object
     component db             ;# sqlite database 
+    component shared         ;# shared database, or ""
 
     #-------------------------------------------------------------------
     # Instance Variables
@@ -82,11 +105,19 @@ snit::type ::marsutil::gtserver {
     # classes      the list of classes registered with the server
     # $class-table the name of the database table 
     # $class-idcol the key column in the table
+    # $class-norefresh 1 if the class isn't refreshed, 0 otherwise
+    # $class-generation the generation of the class's change-tracking
+    #              triggers; see Track.
+    # $class-published the class version last published to the shared
+    #              database, if any.
     #
     variable classinfo -array {
         classes {}
     }
 
+    # Names of the clients that read the shared database.
+    variable sharedClients {}
+
     #-------------------------------------------------------------------
     # Constructor and Destructor
     
@@ -104,9 +135,23 @@ snit::type ::marsutil::gtserver {
         require {[info commands $log] ne ""} "-log is not defined."
         require {[info commands $cs]  ne ""} "-commserver is not defined."
 
+        # NEXT, create the shared database, if any.
+        if {$options(-sharedfile) ne ""} {
+            $self OpenShared
+        }
+
         $self Log normal "Initialized"
     }
 
+    destructor {
+        if {$shared ne ""} {
+            catch {$shared close}
+
+            set f $options(-sharedfile)
+            catch {file delete -force $f $f-wal $f-shm}
+        }
+    }
+
     #-------------------------------------------------------------------
     # Private Methods
 
@@ -168,90 +213,415 @@ snit::type ::marsutil::gtserver {
         $cs broadcast [list gt clear]
     }
 
-    # refresh ?id?
+    # refresh ?id? ?versions?
     #
-    # id      A client comm(n) ID
+    # id        A client comm(n) ID
+    # versions  A dict of class versions, as returned by the client's
+    #           "versions" method.
     #
     # Broadcasts all data to all clients, or
     # if id is given refreshes just that client.
     #
-    # Either way, first delete all game truth variables, then 
-    # update all current game truth variables.
+    # Without versions, first deletes all game truth variables, then 
+    # sends all current game truth variables and objects.  If versions
+    # is given, the client's tables are kept, and only the rows that
+    # have changed or been deleted since the given class versions are
+    # sent.  Either way, each class's rows are sent as a single
+    # "gt batch" message.
+
+    method refresh {{id ""} {versions ""}} {
+        require {$id ne "" || $versions eq ""} \
+            "a delta refresh requires a client ID"
+
+        # FIRST, send start refresh
+        $self Send $id [list gt startrefresh]
+
+        # NEXT, send a clear, unless this is a delta refresh.
+        if {$versions eq ""} {
+            $self Send $id [list gt clear]
+        }
+
+        # NEXT, send all names and values
+        $self Send $id [linsert [array get data] 0 gt set]
+
+        # NEXT, send all game truth objects, one batch per class.
+        foreach class $classinfo(classes) {
+            # FIRST, if this class does not get refreshed, don't
+            if {$classinfo($class-norefresh)} {continue}
+
+            $self Send $id [$self Batch $class $versions]
+        }
+
+        # NEXT, send end of refresh
+        $self Send $id [list gt endrefresh]
+    }
+
+    # resync versions
+    #
+    # versions  A dict of class versions, as returned by the client's
+    #           "versions" method.
     #
-    # TBD: commserver should be udpated to handle whether the message
-    # is a broadcast message or single client message. The presence or
-    # absence of the id would indicate which type it is. Once this
-    # is done, then the if - else block can go away.
+    # Does a delta refresh of the client whose command is being
+    # evaluated by the commserver(n).  The application makes this
+    # available to clients as a command, so that a client that
+    # reconnects with its data intact can catch up.
+
+    method resync {versions} {
+        set name [$cs clientname]
+
+        require {$name ne ""} "no client command is being evaluated"
+
+        $self refresh $name $versions
+    }
 
-    method refresh {{id ""}} {
+    # Send id script
+    #
+    # id      A client comm(n) ID, or ""
+    # script  A script to send
+    #
+    # Sends the script to the client, or broadcasts it to all clients
+    # if id is "".
+
+    method Send {id script} {
         if {$id eq ""} {
-            # FIRST, broadcast start refresh
-            $cs broadcast [list gt startrefresh]
+            $cs broadcast $script
+        } else {
+            $cs send $id $script
+        }
+    }
 
-            # NEXT, broadcast a clear
-            $cs broadcast [list gt clear]
+    # Broadcast script
+    #
+    # script  A script to send
+    #
+    # Broadcasts the script to all clients except those that read the
+    # shared database.
 
-            # NEXT, broadcast all names and values
-            $cs broadcast [linsert [array get data] 0 gt set]
+    method Broadcast {script} {
+        $cs broadcast $script $sharedClients
+    }
 
-            # NEXT, broadcast all game truth objects
-            foreach class $classinfo(classes) {
-                # FIRST, if this class does not get refreshed, don't
-                if {$classinfo($class-norefresh)} {continue}
+    # OpenShared
+    #
+    # Creates the shared database.  It uses WAL mode, so that clients
+    # can read it while the server publishes.  The database is a copy
+    # of data the server already has, so it isn't synced to disk.
+    #
+    # gtshared_classes has the table, key column, and last published
+    # version of each class; gtshared_rows has the version at which 
+    # each row was last changed, as in gtserver_rows, so that a client
+    # can determine which rows have changed.
+
+    method OpenShared {} {
+        set f $options(-sharedfile)
+        file delete -force $f $f-wal $f-shm
+
+        sqlite3 ${selfns}::shared $f
+        set shared ${selfns}::shared
+
+        $shared eval {
+            PRAGMA journal_mode = WAL;
+            PRAGMA synchronous = OFF;
+
+            CREATE TABLE gtshared_classes(
+                class      TEXT PRIMARY KEY,
+                tbl        TEXT,
+                idcol      TEXT,
+                generation INTEGER,
+                version    INTEGER
+            );
+
+            CREATE TABLE gtshared_rows(
+                class   TEXT,
+                id,
+                version INTEGER,
+                deleted INTEGER DEFAULT 0,
+                PRIMARY KEY (class, id)
+            );
+        }
+    }
 
-                # NEXT, build the query
-                set query  { 
-                    SELECT * from $classinfo($class-table) 
-                }
+    # Publish class
+    #
+    # class     A game truth object class
+    #
+    # Publishes the class's rows that have changed since it was last
+    # published to the shared database, and returns 1 if there were
+    # any, and 0 otherwise.  If the class's change tracking has been
+    # restarted, the whole table is published.  Must be called in a
+    # transaction on the shared database.
 
-                # NEXT, clear the row array
-                array unset row
+    method Publish {class} {
+        set table $classinfo($class-table)
+        set idcol $classinfo($class-idcol)
 
-                # NEXT, make the request and broadcast
-                $db eval [subst $query] row {
-                    unset -nocomplain row(*)
-                    set dict [array get row]
-                    set id   $row($classinfo($class-idcol))
-                    $cs broadcast [list gt update $class $id $dict]
-                }
+        lassign [$self Version $class] gen count
+
+        if {[info exists classinfo($class-published)]} {
+            lassign $classinfo($class-published) pgen pcount
+        } else {
+            set pgen ""
+        }
+
+        if {$pgen eq $gen && $pcount == $count} {
+            return 0
+        }
+
+        # FIRST, determine the rows to copy.  A new generation means 
+        # a new table, possibly with different columns.
+        if {$pgen ne $gen} {
+            set columns [list]
+
+            $db eval "PRAGMA table_info($table)" row {
+                lappend columns "$row(name) $row(type)"
             }
 
-            # NEXT, broadcast end of refresh
-            $cs broadcast [list gt endrefresh]
+            $shared eval "
+                DROP TABLE IF EXISTS $table;
+                CREATE TABLE $table ([join $columns ,], PRIMARY KEY ($idcol));
+                DELETE FROM gtshared_rows WHERE class = \$class;
+            "
+
+            set query "SELECT * FROM $table"
         } else {
-            # FIRST, send start refresh to requesting client
-            $cs send $id [list gt startrefresh]
+            set query "
+                SELECT T.* FROM $table AS T
+                JOIN gtserver_rows AS R
+                ON R.class = \$class AND R.id = T.$idcol
+                WHERE R.version > \$pcount
+            "
+
+            $db eval {
+                SELECT id, version, deleted FROM gtserver_rows
+                WHERE class = $class AND version > $pcount
+            } {
+                if {$deleted} {
+                    $shared eval "DELETE FROM $table WHERE $idcol = \$id"
+                }
 
-            # NEXT, send clear to client
-            $cs send $id [list gt clear]
+                $shared eval {
+                    INSERT OR REPLACE INTO 
+                    gtshared_rows(class, id, version, deleted)
+                    VALUES($class, $id, $version, $deleted)
+                }
+            }
+        }
 
-            # NEXT, send names and values to client
-            $cs send $id [linsert [array get data] 0 gt set]
+        # NEXT, copy the rows.
+        set insert ""
 
-            # NEXT, send game truth objects to client
-            foreach class $classinfo(classes) {
-                # FIRST, if this class does not get refreshed, don't
-                
-                if {$classinfo($class-norefresh)} {continue}
-                # NEXT, build the query
-                set query  { 
-                    SELECT * from $classinfo($class-table) 
+        $db eval $query row {
+            if {$insert eq ""} {
+                set values [list]
+                foreach col $row(*) {
+                    lappend values "\$row($col)"
                 }
 
-                # NEXT, clear the row array
-                array unset row
+                set insert "
+                    INSERT OR REPLACE INTO ${table}([join $row(*) ,])
+                    VALUES([join $values ,])
+                "
+            }
+
+            $shared eval $insert
+        }
 
-                # NEXT, make the request and send
-                $db eval [subst $query] row {
-                    unset -nocomplain row(*)
-                    set dict [array get row]
-                    set cid   $row($classinfo($class-idcol))
-                    $cs send $id [list gt update $class $cid $dict]
+        # NEXT, save the version.
+        $shared eval {
+            INSERT OR REPLACE INTO 
+            gtshared_classes(class, tbl, idcol, generation, version)
+            VALUES($class, $table, $idcol, $gen, $count)
+        }
+
+        set classinfo($class-published) [list $gen $count]
+
+        return 1
+    }
+
+    # Batch class versions
+    #
+    # class     A game truth object class
+    # versions  A dict of client class versions, or ""
+    #
+    # Returns a "gt batch" message containing the class's rows.  If
+    # the versions dict contains a version for this class that is
+    # still valid, only the rows changed since then are included, along
+    # with the IDs of the rows deleted since then.  Otherwise, all rows
+    # are included, and the client is told to reset its table first.
+
+    method Batch {class versions} {
+        set table $classinfo($class-table)
+        set idcol $classinfo($class-idcol)
+
+        # FIRST, get the current version, and determine the version
+        # the client has.
+        set version [$self Version $class]
+        set since   ""
+        set reset   0
+
+        if {$versions ne ""} {
+            set reset 1
+
+            if {[dict exists $versions $class]} {
+                lassign [dict get $versions $class] cgen ccount
+
+                if {$cgen eq [lindex $version 0] &&
+                    [string is integer -strict $ccount] &&
+                    $ccount <= [lindex $version 1]
+                } {
+                    set since $ccount
+                    set reset 0
                 }
             }
+        }
+
+        # NEXT, retrieve the rows.
+        set columns [list]
+        set rows    [list]
+        set deleted [list]
+
+        if {$since eq ""} {
+            set query "SELECT * FROM $table"
+        } else {
+            set query "
+                SELECT T.* FROM $table AS T
+                JOIN gtserver_rows AS R
+                ON R.class = \$class AND R.id = T.$idcol
+                WHERE R.version > \$since
+            "
+
+            set deleted [$db eval {
+                SELECT id FROM gtserver_rows
+                WHERE class = $class AND deleted AND version > $since
+            }]
+        }
+
+        $db eval $query row {
+            if {[llength $columns] == 0} {
+                set columns $row(*)
+            }
+
+            set values [list]
+            foreach col $columns {
+                lappend values $row($col)
+            }
+            lappend rows $values
+        }
 
-            # NEXT, send end of refresh to client
-            $cs send $id [list gt endrefresh]
+        # NEXT, encode the payload.
+        set payload [list $columns $rows $deleted]
+
+        if {$options(-compress)} {
+            set format zlib
+            set payload [binary encode base64 \
+                [zlib compress [encoding convertto utf-8 $payload]]]
+        } else {
+            set format list
+        }
+
+        $self Log detail \
+            "batch $class since {$since}: [llength $rows] rows, [llength $deleted] deleted"
+
+        return [list gt batch $class $version $reset $format $payload]
+    }
+
+    # Version class
+    #
+    # class     A game truth object class
+    #
+    # Returns the class's current version, {generation count}.  The
+    # generation changes whenever the change-tracking triggers have to
+    # be (re)created, e.g., because the table was dropped and recreated;
+    # the count is incremented by every change to the class's table.
+
+    method Version {class} {
+        $self Track $class
+
+        list $classinfo($class-generation) [$db onecolumn {
+            SELECT version FROM gtserver_classes WHERE class = $class
+        }]
+    }
+
+    # Track class
+    #
+    # class     A game truth object class
+    #
+    # Ensures that the change-tracking tables and the class's triggers
+    # exist.  These are TEMP objects, so they never become part of
+    # the application's saved data.
+
+    method Track {class} {
+        set table $classinfo($class-table)
+        set idcol $classinfo($class-idcol)
+        set trigger "gtserver_${table}"
+
+        # FIRST, if the triggers exist, we're done.
+        if {[$db exists {
+            SELECT name FROM sqlite_temp_master
+            WHERE type = 'trigger' AND name = $trigger || '_insert'
+        }]} {
+            return
+        }
+
+        # NEXT, create the version tables if need be.
+        $db eval {
+            CREATE TEMP TABLE IF NOT EXISTS gtserver_classes(
+                class   TEXT PRIMARY KEY,
+                version INTEGER DEFAULT 0
+            );
+
+            CREATE TEMP TABLE IF NOT EXISTS gtserver_rows(
+                class   TEXT,
+                id,
+                version INTEGER,
+                deleted INTEGER DEFAULT 0,
+                PRIMARY KEY (class, id)
+            );
+        }
+
+        # NEXT, start a new generation for this class.
+        $db eval {
+            DELETE FROM gtserver_rows WHERE class = $class;
+            INSERT OR REPLACE INTO gtserver_classes(class, version)
+            VALUES($class, 0);
+        }
+
+        set classinfo($class-generation) [clock microseconds]
+
+        # NEXT, create the triggers.
+        set c '[string map {' ''} $class]'
+
+        set version "(SELECT version FROM gtserver_classes WHERE class=$c)"
+
+        foreach {event ref deleted} {
+            INSERT new 0
+            UPDATE new 0
+            DELETE old 1
+        } {
+            set name "${trigger}_[string tolower $event]"
+
+            # If an update changes a row's ID, the old ID is gone.
+            set rekey ""
+
+            if {$event eq "UPDATE"} {
+                set rekey "
+                INSERT OR REPLACE INTO gtserver_rows(class,id,version,deleted)
+                SELECT $c, old.$idcol, $version, 1
+                WHERE old.$idcol IS NOT new.$idcol;
+                "
+            }
+
+            $db eval "
+                CREATE TEMP TRIGGER $name
+                AFTER $event ON $table
+                BEGIN
+                UPDATE gtserver_classes SET version = version + 1
+                WHERE class = $c;
+                $rekey
+                INSERT OR REPLACE INTO gtserver_rows(class,id,version,deleted)
+                VALUES($c, $ref.$idcol, $version, $deleted);
+                END;
+            "
         }
     }
 
@@ -261,8 +631,75 @@ snit::type ::marsutil::gtserver {
     # current state is consistent.
 
     method complete {} {
+        $self publish
         $cs broadcast [list gt complete]
     }
+
+    # share name
+    #
+    # name      A client's logical name
+    #
+    # Publishes the game truth objects to the shared database, and
+    # marks the client as one that reads it.  It will be sent 
+    # "gt published" notifications rather than "gt update" and 
+    # "gt delete" messages.  Returns the name of the shared database
+    # file, which the client should pass to gtclient(n)'s "share" 
+    # method.
+
+    method share {name} {
+        require {$shared ne ""} "-sharedfile is not defined."
+
+        if {$name ni $sharedClients} {
+            lappend sharedClients $name
+        }
+
+        $self publish
+
+        return $options(-sharedfile)
+    }
+
+    # publish
+    #
+    # Publishes the game truth objects that have changed to the shared
+    # database, if any, and sends "gt published" to the clients that
+    # read it.  Clients that have disconnected are forgotten.  This is
+    # done automatically by "complete".
+
+    method publish {} {
+        if {$shared eq "" || [info commands $db] eq ""} {
+            return
+        }
+
+        set changed [dict create]
+
+        $shared transaction {
+            # All classes are published, since the shared clients
+            # don't get the updates for -norefresh classes either.
+            foreach class $classinfo(classes) {
+                if {[$self Publish $class]} {
+                    dict set changed $class $classinfo($class-published)
+                }
+            }
+        }
+
+        if {[dict size $changed] == 0} {
+            return
+        }
+
+        $self Log detail "published [dict keys $changed]"
+
+        set clients [$cs clients]
+        set names   [list]
+
+        foreach name $sharedClients {
+            if {$name in $clients} {
+                lappend names $name
+                $cs send $name [list gt published $changed]
+            }
+        }
+
+        set sharedClients $names
+    }
  
     # class class table idcolumn
     #
@@ -306,6 +743,24 @@ snit::type ::marsutil::gtserver {
         if {[lsearch -exact $classinfo(classes) $class] == -1} {
             lappend classinfo(classes) $class
         }
+
+        # NEXT, begin tracking changes so that delta refreshes
+        # are possible.
+        if {!$norefresh && [info commands $db] ne ""} {
+            $self Track $class
+        }
+
+        # NEXT, the class's column names recur in every update, so
+        # add them to the commserver's codebook for framed clients.
+        if {[info commands $db] ne ""} {
+            set words [list gt update delete $class]
+
+            $db eval "PRAGMA table_info($table)" row {
+                lappend words $row(name)
+            }
+
+            $cs codebook add {*}$words
+        }
     }
 
     # update class id ?dict?
@@ -335,7 +790,7 @@ snit::type ::marsutil::gtserver {
         }
 
         # NEXT, send update to clients
-        $cs broadcast [list gt update $class $id $dict]
+        $self Broadcast [list gt update $class $id $dict]
 
     }
 
@@ -349,7 +804,7 @@ snit::type ::marsutil::gtserver {
 
     method delete {class id} {
         # FIRST, send delete to clients
-        $cs broadcast [list gt delete $class $id]
+        $self Broadcast [list gt delete $class $id]
     }
     
 }
@@ -64,6 +64,23 @@
 #    string will be included automatically if the logger is given a 
 #    -simclock.
 #
+#    Asynchronous Output
+#
+#    With -async set, entries are buffered in memory and written to
+#    the log in large batches, either every -flushinterval 
+#    milliseconds or immediately when an entry at or above the
+#    -flushon level is logged.  If the buffer fills, the logger either
+#    writes it out at once (back-pressure) or drops the new entries,
+#    counting them, depending on -bufferpolicy.
+#
+#    Binary Log Files
+#
+#    With -format binary, log files are written as length-prefixed
+#    binary records rather than lines of text; see "BINARY FORMAT", 
+#    below.  Binary logs are smaller and much faster to filter, and can
+#    be converted to and from the text format using "logger convert".
+#    Entries written to stdout are always text.
+#
 #    Merging Log Files
 #
 #    If the Mars simulation is split into multiple executables,
@@ -73,11 +90,39 @@
 #
 #-----------------------------------------------------------------------
 
+#-----------------------------------------------------------------------
+# BINARY FORMAT
+#
+#   A binary log file begins with the 8-byte magic string 
+#   "MARSLOG\x01", followed by a sequence of records.  Each record
+#   is a 32-bit length, followed by that many bytes of record body.
+#   All integers are big-endian; all strings are UTF-8.
+#
+#   Component record: Assigns a 16-bit ID to a component name; it
+#   precedes the first entry logged by that component in the file.
+#
+#     1 byte    "C"
+#     2 bytes   Component ID
+#     N bytes   Component name
+#
+#   Entry record:
+#
+#     1 byte    "E"
+#     8 bytes   Wall-clock time, in milliseconds since the epoch
+#     8 bytes   Simulation time in ticks, or -1 if there's no -simclock
+#     1 byte    Verbosity level number
+#     2 bytes   Component ID
+#     4 bytes   Message length, M
+#     M bytes   Message, unflattened
+#     N bytes   Simulation time string, if there's a -simclock
+#
+#-----------------------------------------------------------------------
+
 #-----------------------------------------------------------------------
 # Exported commands
 
 namespace eval ::marsutil:: {
-    namespace export logger
+    namespace export logger logdecode
 }
 
 #-----------------------------------------------------------------------
@@ -107,6 +152,9 @@ snit::type ::marsutil::logger {
         all
     }
 
+    # Magic string at the beginning of a binary log file.
+    typevariable magic "MARSLOG\x01"
+
     #-------------------------------------------------------------------
     # Type Constructor
 
@@ -156,6 +204,16 @@ snit::type ::marsutil::logger {
 
     option -logdir -default "" -readonly 1
 
+    # -format format
+    #
+    # format      text | binary
+    #
+    # This is a creation time option; it specifies whether log files
+    # are written as text or in the binary format.
+
+    option -format -default text -readonly 1 \
+        -type {snit::enum -values {text binary}}
+
     # -logfile name
     #
     # name     The new log file name, or "".
@@ -242,6 +300,78 @@ snit::type ::marsutil::logger {
 
     option -newlogcmd -default {}
 
+    # -async flag
+    #
+    # flag    A boolean flag
+    #
+    # If true, entries are buffered and written in batches; otherwise,
+    # each entry is written as soon as it is logged.
+
+    option -async -type snit::boolean -default no \
+        -configuremethod CfgAsync
+
+    method CfgAsync {option value} {
+        set options($option) $value
+
+        # Write anything that's pending, and set up the channel 
+        # buffering for the new mode.
+        $self flush
+        $self ConfigureChannel
+    }
+
+    # -flushinterval msecs
+    #
+    # msecs    A positive number of milliseconds
+    #
+    # In -async mode, buffered entries are written no later than this
+    # long after they are logged.
+
+    option -flushinterval -type {snit::integer -min 1} -default 500
+
+    # -flushon level
+    #
+    # level     A verbosity level
+    #
+    # In -async mode, logging an entry at this level or a more severe 
+    # one writes the buffer immediately.
+
+    option -flushon -default warning \
+        -configuremethod CfgFlushon
+
+    method CfgFlushon {option value} {
+        set ndx [lsearch -exact $levels $value]
+
+        if {$ndx == -1} {
+            set choices [join $levels ", "]
+
+            return -code error \
+                "-flushon: got \"$value\", should be one of: $choices"
+        }
+
+        set flushon $ndx
+        set options($option) $value
+    }
+
+    # -buffersize num
+    #
+    # num    A positive integer
+    #
+    # In -async mode, the maximum number of entries that may be
+    # buffered before -bufferpolicy applies.
+
+    option -buffersize -type {snit::integer -min 1} -default 10000
+
+    # -bufferpolicy policy
+    #
+    # policy   block | drop
+    #
+    # What to do when the buffer is full: "block" writes the buffer
+    # immediately, and "drop" discards the new entry and counts it.
+    # Entries at the -flushon level are never dropped.
+
+    option -bufferpolicy -type {snit::enum -values {block drop}} \
+        -default block
+
     #-------------------------------------------------------------------
     # Instance variables
 
@@ -252,13 +382,24 @@ snit::type ::marsutil::logger {
                                 # 1 = level   (log based on -verbosity)
                                 # 2 = all     (log all entries)
     variable entryCount 0      ;# Number of entries logged.
+    variable flushon 3         ;# -flushon level number (warning).
+    variable buffer {}         ;# Entries awaiting output in -async mode.
+    variable flushId ""        ;# after(n) ID of the pending flush, or "".
+    variable droppedCount 0    ;# Number of entries dropped in -async mode.
+    variable compIds -array {} ;# Binary component IDs by name for the
+                                # current log file.
 
     #-------------------------------------------------------------------
     # Constructor/Destructor
 
     constructor {args} {
-        # FIRST, get the -logdir option, if any.
+        # FIRST, get the -logdir and -format options, if any.
         set options(-logdir) [from args -logdir]
+        set options(-format) [from args -format text]
+
+        if {$options(-format) ni {text binary}} {
+            error "-format: got \"$options(-format)\", should be text or binary"
+        }
 
         # NEXT, if a -logdir was specified, make sure it
         # exists, and open the first log file.
@@ -272,7 +413,9 @@ snit::type ::marsutil::logger {
     }
 
     destructor {
-        # Close the log file, if it's open
+        # Write any buffered entries and close the log file, if 
+        # it's open
+        catch {$self flush}
         $self CloseFile
     }
 
@@ -422,20 +565,48 @@ snit::type ::marsutil::logger {
                 append message "\nentry too long..."
             }
 
-            # NEXT, format the entry as a list.
+            # NEXT, format the entry as a list.  Binary records
+            # have the wall-clock time in milliseconds.
+            set binary [expr {
+                $options(-format) eq "binary" && $channel ne "stdout"
+            }]
+
+            if {$binary} {
+                set wallms  [clock milliseconds]
+                set seconds [expr {$wallms / 1000}]
+            } else {
+                set seconds [clock seconds]
+            }
+
             set entry [list \
-                           [Timestamp] \
+                           [Timestamp $seconds] \
                            $level \
                            $component \
                            [Flatten $message]]
 
             # NEXT, if there's a simclock, add the time string.
             if {$options(-simclock) ne ""} {
-                lappend entry [$options(-simclock) asString]
+                set zulu [$options(-simclock) asString]
+                lappend entry $zulu
             }
   
-            # NEXT, output the log entry
-            puts $channel $entry
+            # NEXT, output the log entry, or buffer it.  In binary
+            # mode, encode it first.
+            if {$binary} {
+                set out [$self Encode $entry $levelnum $wallms]
+            } else {
+                set out $entry
+            }
+
+            if {!$options(-async)} {
+                if {$binary} {
+                    puts -nonewline $channel $out
+                } else {
+                    puts $channel $out
+                }
+            } elseif {[$self MakeRoom $levelnum]} {
+                $self BufferEntry $levelnum $out
+            }
 
             # NEXT, call the -entrycmd, if any.
             if {$options(-entrycmd) ne ""} {
@@ -450,6 +621,138 @@ snit::type ::marsutil::logger {
         return
     }
 
+    # Encode entry levelnum wallms
+    #
+    # entry     The formatted entry
+    # levelnum  The numeric verbosity level
+    # wallms    The wall-clock time of the entry, in milliseconds
+    #
+    # Returns the entry's binary record(s), as they will be written to
+    # a binary log.
+
+    method Encode {entry levelnum wallms} {
+        lassign $entry stamp level component message zulu
+
+        # FIRST, define the component, if it's new to this file.
+        set out ""
+
+        if {![info exists compIds($component)]} {
+            set compIds($component) [array size compIds]
+            append out [ComponentRecord $compIds($component) $component]
+        }
+
+        # NEXT, get the sim time, if any.
+        if {$options(-simclock) ne ""} {
+            set simtime [$options(-simclock) now]
+        } else {
+            set simtime -1
+        }
+
+        # NEXT, add the entry.
+        append out [EntryRecord                    \
+                        $wallms                        \
+                        $simtime                       \
+                        $levelnum                      \
+                        $compIds($component)           \
+                        [$type unflatten $message]     \
+                        $zulu]
+
+        return $out
+    }
+
+    # IsBinary
+    #
+    # Returns 1 if entries are being written to a binary log file, and
+    # 0 otherwise.
+
+    method IsBinary {} {
+        expr {$options(-format) eq "binary" && $channel ne "stdout"}
+    }
+
+    # Output entries
+    #
+    # entries    A list of encoded entries
+    #
+    # Writes the entries to the log.
+
+    method Output {entries} {
+        if {[$self IsBinary]} {
+            puts -nonewline $channel [join $entries ""]
+        } else {
+            puts $channel [join $entries \n]
+        }
+    }
+
+    # MakeRoom levelnum
+    #
+    # levelnum  The numeric verbosity level
+    #
+    # Makes room in the -async buffer for an entry at the given level,
+    # applying the -bufferpolicy if it is full.  Returns 1 if the 
+    # entry should be buffered, and 0 if it has been dropped.
+
+    method MakeRoom {levelnum} {
+        if {[llength $buffer] < $options(-buffersize)} {
+            return 1
+        }
+
+        if {$options(-bufferpolicy) eq "drop" && $levelnum > $flushon} {
+            incr droppedCount
+            return 0
+        }
+
+        $self flush
+        return 1
+    }
+
+    # BufferEntry levelnum entry
+    #
+    # levelnum  The numeric verbosity level
+    # entry     The encoded entry
+    #
+    # Adds the entry to the -async buffer, and schedules it to be 
+    # written.
+
+    method BufferEntry {levelnum entry} {
+        lappend buffer $entry
+
+        # NEXT, write it now or later.
+        if {$levelnum <= $flushon} {
+            $self flush
+        } elseif {$flushId eq ""} {
+            set flushId [after $options(-flushinterval) [mymethod flush]]
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Methods: Asynchronous Output
+
+    # flush
+    #
+    # Writes any buffered entries to the log, and flushes the channel.
+
+    method flush {} {
+        after cancel $flushId
+        set flushId ""
+
+        if {[llength $buffer] > 0} {
+            $self Output $buffer
+            set buffer {}
+        }
+
+        flush $channel
+        return
+    }
+
+    # dropped
+    #
+    # Returns the number of entries dropped because the -async
+    # buffer was full.
+
+    method dropped {} {
+        return $droppedCount
+    }
+
     #-------------------------------------------------------------------
     # Methods: Component Verbosity Modes
 
@@ -503,7 +806,9 @@ snit::type ::marsutil::logger {
     # sets -logfile.
 
     method OpenFile {name} {
-        # FIRST, close the existing file, if any.
+        # FIRST, close the existing file, if any, after writing any
+        # entries that belong to it.
+        $self flush
         $self CloseFile
 
         # NEXT, if the new name is "", we're done; CloseFile updated
@@ -521,9 +826,16 @@ snit::type ::marsutil::logger {
         set options(-logfile) $name
         set channel $result
 
-        # NEXT, make the channel be line-buffering, so that it's
-        # written to disk after each line.
-        fconfigure $channel -buffering line
+        # NEXT, a binary log file begins with the magic string, and 
+        # defines its own components.
+        if {$options(-format) eq "binary"} {
+            fconfigure $channel -translation binary
+            puts -nonewline $channel $magic
+            array unset compIds
+        }
+
+        # NEXT, set up the channel buffering.
+        $self ConfigureChannel
 
         # Notify the app.
         if {$options(-newlogcmd) ne ""} {
@@ -534,6 +846,27 @@ snit::type ::marsutil::logger {
         }
     }
 
+    # ConfigureChannel
+    #
+    # Makes the log file line-buffered (unbuffered, for binary logs),
+    # so that it's written to disk after each entry, or fully-buffered 
+    # with a large buffer in -async mode, where the logger flushes it 
+    # explicitly.  stdout is left alone.
+
+    method ConfigureChannel {} {
+        if {$channel eq "stdout"} {
+            return
+        }
+
+        if {$options(-async)} {
+            fconfigure $channel -buffering full -buffersize 65536
+        } elseif {$options(-format) eq "binary"} {
+            fconfigure $channel -buffering none
+        } else {
+            fconfigure $channel -buffering line
+        }
+    }
+
     # CloseFile
     #
     # Closes the current log file, if any.
@@ -549,12 +882,14 @@ snit::type ::marsutil::logger {
     #-------------------------------------------------------------------
     # Utility Procs
 
-    # Timestamp
+    # Timestamp seconds
+    #
+    # seconds    A time in seconds
     #
-    # Returns the current time, formatted as YYYY-MM-DDTHH:MM:SS
+    # Returns the time, formatted as YYYY-MM-DDTHH:MM:SS
 
-    proc Timestamp {} {
-        clock format [clock seconds] -format "%Y-%m-%dT%T"
+    proc Timestamp {seconds} {
+        clock format $seconds -format "%Y-%m-%dT%T"
     }
 
     # Flatten string
@@ -568,6 +903,40 @@ snit::type ::marsutil::logger {
         string map [list \\ \\\\ \n \\n] $message
     }
 
+    # ComponentRecord id name
+    #
+    # id      A component ID
+    # name    The component name
+    #
+    # Returns a binary component record.
+
+    proc ComponentRecord {id name} {
+        set body [binary format a1Sa* C $id [encoding convertto utf-8 $name]]
+
+        return [binary format I [string length $body]]$body
+    }
+
+    # EntryRecord wallms simtime levelnum id message zulu
+    #
+    # wallms     Wall-clock time in milliseconds
+    # simtime    Sim time in ticks, or -1
+    # levelnum   The numeric verbosity level
+    # id         The component ID
+    # message    The unflattened message
+    # zulu       The sim time string, or ""
+    #
+    # Returns a binary entry record.
+
+    proc EntryRecord {wallms simtime levelnum id message zulu} {
+        set message [encoding convertto utf-8 $message]
+
+        set body [binary format a1WWcSIa*a* E $wallms $simtime $levelnum $id \
+                      [string length $message] $message                    \
+                      [encoding convertto utf-8 $zulu]]
+
+        return [binary format I [string length $body]]$body
+    }
+
     #-----------------------------------------------------------------------
     # Public Typemethods
 
@@ -596,6 +965,239 @@ snit::type ::marsutil::logger {
     typemethod unflatten {message} {
         string map [list \\\\ \\ \\n \n] $message
     }
+
+    # fileformat file
+    #
+    # file      A log file name
+    #
+    # Returns "binary" if the file is a binary log file, and "text"
+    # otherwise.
+
+    typemethod fileformat {file} {
+        set f [open $file r]
+        fconfigure $f -translation binary
+        set header [read $f [string length $magic]]
+        close $f
+
+        if {$header eq $magic} {
+            return binary
+        } else {
+            return text
+        }
+    }
+
+    # headersize
+    #
+    # Returns the size in bytes of the binary log file header.
+
+    typemethod headersize {} {
+        string length $magic
+    }
+
+    # convert infile outfile
+    #
+    # infile     A log file name
+    # outfile    A log file name
+    #
+    # Converts a text log file to binary, or a binary log file to
+    # text, writing the result to the outfile.
+
+    typemethod convert {infile outfile} {
+        set in [open $infile r]
+        set out [open $outfile w]
+
+        try {
+            fconfigure $in -translation binary
+            fconfigure $out -translation binary
+
+            if {[read $in [string length $magic]] eq $magic} {
+                # FIRST, binary to text.  Decode it a chunk at a time.
+                fconfigure $out -translation lf -encoding utf-8
+
+                set comps [dict create]
+                set data ""
+
+                while {![eof $in]} {
+                    append data [read $in 1048576]
+
+                    lassign [::marsutil::logdecode $data $comps] \
+                        consumed comps entries
+
+                    foreach entry $entries {
+                        puts $out $entry
+                    }
+
+                    set data [string range $data $consumed end]
+                }
+
+                if {$data ne ""} {
+                    error "incomplete record at end of $infile"
+                }
+            } else {
+                # FIRST, text to binary.
+                seek $in 0
+                fconfigure $in -translation auto -encoding utf-8
+                puts -nonewline $out $magic
+
+                array set ids {}
+                set lineno 0
+
+                while {[gets $in line] >= 0} {
+                    incr lineno
+
+                    if {[string trim $line] eq ""} {
+                        continue
+                    }
+
+                    lassign $line stamp level component message zulu
+
+                    set ndx [lsearch -exact $levels $level]
+
+                    if {$ndx == -1} {
+                        error "invalid log level at $infile line $lineno: \"$level\""
+                    }
+
+                    if {![info exists ids($component)]} {
+                        set ids($component) [array size ids]
+                        puts -nonewline $out \
+                            [ComponentRecord $ids($component) $component]
+                    }
+
+                    puts -nonewline $out [EntryRecord \
+                        [expr {[clock scan $stamp -format %Y-%m-%dT%T] * 1000}] \
+                        -1                                                  \
+                        $ndx                                                \
+                        $ids($component)                                    \
+                        [$type unflatten $message]                          \
+                        $zulu]
+                }
+            }
+        } finally {
+            close $in
+            close $out
+        }
+
+        return
+    }
+}
+
+#-----------------------------------------------------------------------
+# logdecode
+#
+# NOTE: Marsbin defines this as a binary command.  Define it here
+# only if the binary command doesn't exist.
+
+if {[llength [info commands ::marsutil::logdecode]] == 0} {
+    # logdecode data comps ?options...?
+    #
+    # data      Binary log records, sans file header
+    # comps     Dictionary of component names by component ID
+    #
+    # Options:
+    #   -base offset      Offset of data within the file; default 0
+    #   -index            Return index records rather than entries
+    #   -level num        Entries at this level number or lower
+    #   -component name   Entries logged by this component
+    #   -since ms         Entries logged at or after this time, in ms
+    #
+    # Decodes the complete records in data, returning a list 
+    # {consumed comps entries}: the number of bytes decoded, the updated
+    # component dictionary, and the matching entries in text form,
+    # {timestamp level component message ?zulu?}.  With -index, entries
+    # are {offset length timestamp level component} instead.
+
+    proc ::marsutil::logdecode {data comps args} {
+        # FIRST, get the options.
+        array set opts {
+            -base      0
+            -index     0
+            -level     7
+            -component ""
+            -since     ""
+        }
+
+        while {[llength $args] > 0} {
+            set opt [lshift args]
+
+            switch -exact -- $opt {
+                -index  { set opts(-index) 1 }
+                -base   -
+                -level  -
+                -component -
+                -since  { set opts($opt) [lshift args] }
+                default { error "bad option \"$opt\"" }
+            }
+        }
+
+        set levels [logger levels]
+        set len [string length $data]
+        set pos 0
+        set entries [list]
+
+        # NEXT, decode the complete records.
+        while {$pos + 4 <= $len} {
+            binary scan $data @${pos}Iu reclen
+
+            if {$pos + 4 + $reclen > $len} {
+                break
+            }
+
+            set body [string range $data $pos+4 [expr {$pos + 3 + $reclen}]]
+            set rtype [string index $body 0]
+
+            if {$rtype eq "C"} {
+                binary scan $body x1Sua* id name
+                dict set comps $id [encoding convertfrom utf-8 $name]
+            } elseif {$rtype eq "E" && $reclen >= 24} {
+                binary scan $body x1WWcuSuIu wallms simtime levelnum id msglen
+
+                if {$levelnum <= $opts(-level) && 
+                    ($opts(-since) eq "" || $wallms >= $opts(-since))
+                } {
+                    if {[dict exists $comps $id]} {
+                        set component [dict get $comps $id]
+                    } else {
+                        set component ""
+                    }
+
+                    if {$opts(-component) eq "" || 
+                        $component eq $opts(-component)
+                    } {
+                        set stamp [clock format [expr {$wallms / 1000}] \
+                                       -format %Y-%m-%dT%T]
+                        set level [lindex $levels $levelnum]
+
+                        if {$opts(-index)} {
+                            lappend entries [list \
+                                [expr {$opts(-base) + $pos}] \
+                                [expr {4 + $reclen}] \
+                                $stamp $level $component]
+                        } else {
+                            set message [encoding convertfrom utf-8 \
+                                [string range $body 24 [expr {23 + $msglen}]]]
+                            set zulu [encoding convertfrom utf-8 \
+                                [string range $body [expr {24 + $msglen}] end]]
+
+                            set entry [list $stamp $level $component \
+                                [string map [list \\ \\\\ \n \\n] $message]]
+
+                            if {$zulu ne ""} {
+                                lappend entry $zulu
+                            }
+
+                            lappend entries $entry
+                        }
+                    }
+                }
+            } else {
+                error "invalid log record"
+            }
+
+            incr pos [expr {4 + $reclen}]
+        }
+
+        return [list $pos $comps $entries]
+    }
 }
 
 
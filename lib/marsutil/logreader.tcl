@@ -28,6 +28,19 @@
 #   The logreader expects that the file to be read consists of lines of
 #   text (entries).  Beyond that, this module places no constraints on
 #   the nature of the entries or on how they should be parsed.
+#
+#   For large files, the "range" and "search" methods use an index of
+#   entry offsets, timestamps, levels, and components, so that only the
+#   requested entries need be read and parsed.  The index is built
+#   incrementally as the file grows, and is saved in a sidecar file
+#   (<file>.idx) so that it needn't be rebuilt when the file is next
+#   read.  The index understands logger(n)-format entries; other
+#   entries are indexed by offset only.
+#
+#   Binary log files written by logger(n) are decoded to logger(n)'s
+#   text format before being passed to the -parsecmd, so that the 
+#   -parsecmd needn't care which format the file is in.  Binary logs
+#   are quick to index, and are not given sidecars.
 # 
 #-----------------------------------------------------------------------
 
@@ -51,12 +64,34 @@ snit::type ::marsutil::logreader {
     # 
     # The command used to parse the contents of a log file.  
     option  -parsecmd
+
+    # -sidecar flag
+    #
+    # If true, entry indices are saved to and loaded from <file>.idx.
+    option -sidecar -type snit::boolean -default yes
     
     #-------------------------------------------------------------------
     # Variables
     
     variable currentName ""   ;# Name of the current log file, or ""
     variable handle      ""   ;# Handle of the current log file, or ""
+    variable binary      0    ;# 1 if the current log file is binary
+    variable comps       {}   ;# Component dictionary for the current
+                               # binary log file.
+
+    # idx: Entry index array, by normalized file name and field.
+    #
+    # $file,binary    1 if the file is a binary log file, and 0 otherwise.
+    # $file,comps     Component dictionary, for binary log files
+    # $file,size      Number of bytes of the file that have been indexed.
+    # $file,offset    List of byte offsets of the indexed entries
+    # $file,length    List of byte lengths of the entries, sans newline
+    #                 for text files
+    # $file,time      List of entry timestamps, or ""
+    # $file,level     List of entry verbosity levels, or ""
+    # $file,component List of entry components, or ""
+
+    variable idx -array {}
 
     #-------------------------------------------------------------------
     # Constructor & Destructor
@@ -82,6 +117,46 @@ snit::type ::marsutil::logreader {
         return [uplevel \#0 $cmd]
     }
 
+    # OpenLog file
+    #
+    # file      Pathname of a log file
+    #
+    # Opens the file, determines whether it's a binary log or not,
+    # and positions the handle at the first entry.  Text files are
+    # configured explicitly for "lf" mode, so that carriage returns
+    # in the data don't cause trouble.
+
+    method OpenLog {file} {
+        set binary [expr {[::marsutil::logger fileformat $file] eq "binary"}]
+        set handle [open $file]
+
+        if {$binary} {
+            fconfigure $handle -translation binary
+            seek $handle [::marsutil::logger headersize]
+            set comps [dict create]
+        } else {
+            fconfigure $handle -translation lf
+        }
+    }
+
+    # ReadEntries
+    #
+    # Reads the remaining complete entries from the current handle,
+    # returning them as text.  For binary logs, any partial record at
+    # the end of the file is left to be read next time.
+
+    method ReadEntries {} {
+        if {!$binary} {
+            return [read -nonewline $handle]
+        }
+
+        set data [read $handle]
+        lassign [::marsutil::logdecode $data $comps] consumed comps entries
+        seek $handle [expr {$consumed - [string length $data]}] current
+
+        return [join $entries \n]
+    }
+
     #-------------------------------------------------------------------
     # Public Methods
     
@@ -96,13 +171,9 @@ snit::type ::marsutil::logreader {
         # Save the file name.
         set currentName $file
         
-        # Open the file, and configure it explicitly for "lf" mode.
-        # This way, carriage returns in the data don't cause trouble.
-        set handle [open $file]
-        fconfigure $handle -translation lf
-        
-        # Read the file contents. 
-        set contents [read -nonewline $handle]
+        # Open the file, and read its contents.
+        $self OpenLog $file
+        set contents [$self ReadEntries]
         
         # Close the file.
         $self close
@@ -130,18 +201,411 @@ snit::type ::marsutil::logreader {
         
         # NEXT, Open the file if needed.
         if {$handle eq ""} {
-            set handle [open $currentName]
-            fconfigure $handle -translation lf
+            $self OpenLog $currentName
         }
         
         # NEXT, Get any new entries, skipping the newline at the end.
-        set newData [read -nonewline $handle]
-        seek $handle 0 end
+        set newData [$self ReadEntries]
+
+        if {!$binary} {
+            seek $handle 0 end
+        }
 
         # NEXT, Parse and return the log data.
         return [$self Parse $newData]
     }
 
+    # count file
+    #
+    # file     Pathname of a log file.
+    #
+    # Brings the file's index up to date, and returns the number of
+    # entries in the file.
+
+    method count {file} {
+        set f [$self Index $file]
+        return [llength $idx($f,offset)]
+    }
+
+    # range file start count
+    #
+    # file     Pathname of a log file.
+    # start    Index of the first entry to return; 0 is the first
+    #          entry in the file, and "end" the last.
+    # count    Maximum number of entries to return.
+    #
+    # Returns the entries from start through start+count-1, as parsed
+    # by the -parsecmd.  Only those entries are read from the disk.
+
+    method range {file start count} {
+        set f [$self Index $file]
+        set n [llength $idx($f,offset)]
+
+        if {$start eq "end"} {
+            set start [expr {$n - 1}]
+        }
+
+        snit::integer validate $start
+        snit::integer validate $count
+
+        set first [expr {max(0, $start)}]
+        set last  [expr {min($n, $start + $count) - 1}]
+
+        if {$last < $first} {
+            return [$self Parse ""]
+        }
+
+        # The entries are contiguous, so read them all in one go.
+        set begin [lindex $idx($f,offset) $first]
+        set end   [expr {
+            [lindex $idx($f,offset) $last] + [lindex $idx($f,length) $last]
+        }]
+
+        set data [ReadBytes $file $begin [expr {$end - $begin}]]
+
+        return [$self Parse [$self Decode $f [list $data]]]
+    }
+
+    # search file ?options...?
+    #
+    # file     Pathname of a log file.
+    #
+    # Options:
+    #    -level level       Entries at this logger(n) verbosity level 
+    #                       or more severe.
+    #    -component comp    Entries logged by this component.
+    #    -since timestamp   Entries logged at or after this logger(n)
+    #                       timestamp, YYYY-MM-DDTHH:MM:SS.
+    #
+    # Returns the matching entries, as parsed by the -parsecmd.  The
+    # search is done using the file's index; only matching entries are
+    # read from the disk.
+
+    method search {file args} {
+        # FIRST, get the options.
+        set maxlevel  ""
+        set component ""
+        set since     ""
+
+        while {[llength $args] > 0} {
+            set opt [::marsutil::lshift args]
+
+            switch -exact -- $opt {
+                -level {
+                    set level [::marsutil::lshift args]
+                    set maxlevel [lsearch -exact [::marsutil::logger levels] \
+                                      $level]
+
+                    if {$maxlevel == -1} {
+                        error "Invalid -level: \"$level\""
+                    }
+                }
+
+                -component {
+                    set component [::marsutil::lshift args]
+                }
+
+                -since {
+                    set since [::marsutil::lshift args]
+                }
+
+                default {
+                    error "Unknown option: \"$opt\""
+                }
+            }
+        }
+
+        # NEXT, find the matching entries.
+        set f [$self Index $file]
+        set levels [::marsutil::logger levels]
+
+        set entries [list]
+        set ch [open $file r]
+        fconfigure $ch -translation binary
+
+        try {
+            foreach offset $idx($f,offset) \
+                    length $idx($f,length) \
+                    time   $idx($f,time)   \
+                    lvl    $idx($f,level)  \
+                    comp   $idx($f,component) {
+                if {$since ne "" && [string compare $time $since] < 0} {
+                    continue
+                }
+
+                if {$component ne "" && $comp ne $component} {
+                    continue
+                }
+
+                if {$maxlevel ne ""} {
+                    set num [lsearch -exact $levels $lvl]
+
+                    if {$num == -1 || $num > $maxlevel} {
+                        continue
+                    }
+                }
+
+                seek $ch $offset
+                lappend entries [read $ch $length]
+            }
+        } finally {
+            close $ch
+        }
+
+        return [$self Parse [$self Decode $f $entries]]
+    }
+
+    # Decode f chunks
+    #
+    # f        A normalized file name
+    # chunks   A list of raw entries, or runs of entries, read from the
+    #          file in binary mode
+    #
+    # Returns the entries as text.
+
+    method Decode {f chunks} {
+        if {$idx($f,binary)} {
+            set entries [lindex \
+                [::marsutil::logdecode [join $chunks ""] $idx($f,comps)] 2]
+
+            return [join $entries \n]
+        }
+
+        return [string map [list \r\n \n] \
+                    [encoding convertfrom utf-8 [join $chunks \n]]]
+    }
+
+    # Index file
+    #
+    # file     Pathname of a log file.
+    #
+    # Brings the index for the file up to date, loading it from
+    # the sidecar file if need be and indexing any entries added to
+    # the file since.  Returns the normalized file name, the key to the
+    # idx array.
+
+    method Index {file} {
+        set f [file normalize $file]
+        set size [file size $f]
+
+        # FIRST, if we have no index, or the file has been truncated,
+        # start afresh.
+        if {![info exists idx($f,size)] || $size < $idx($f,size)} {
+            $self ClearIndex $f
+
+            if {[::marsutil::logger fileformat $f] eq "binary"} {
+                set idx($f,binary) 1
+                set idx($f,size) [::marsutil::logger headersize]
+            } elseif {$options(-sidecar)} {
+                $self LoadSidecar $f $size
+            }
+        }
+
+        # NEXT, if the file hasn't grown, we're done.
+        if {$size <= $idx($f,size)} {
+            return $f
+        }
+
+        # NEXT, binary files are indexed by the decoder.
+        if {$idx($f,binary)} {
+            $self IndexBinary $f
+            return $f
+        }
+
+        # NEXT, index any complete entries added since.  We read the
+        # file as binary so that offsets and lengths are in bytes.
+        set ch [open $f r]
+        fconfigure $ch -translation binary
+        seek $ch $idx($f,size)
+
+        set offset $idx($f,size)
+        set records [list]
+
+        try {
+            while {[gets $ch line] >= 0} {
+                # An unterminated line is an entry still being written.
+                if {[eof $ch]} {
+                    break
+                }
+
+                set length [string length $line]
+
+                if {[string trim $line] ne ""} {
+                    # Strip any carriage return, as "lf" translation
+                    # would.
+                    if {[string index $line end] eq "\r"} {
+                        set line [string range $line 0 end-1]
+                    }
+
+                    if {[catch {lassign $line time level component}]} {
+                        lassign "" time level component
+                    }
+
+                    set component [encoding convertfrom utf-8 $component]
+                    lappend idx($f,offset)    $offset
+                    lappend idx($f,length)    $length
+                    lappend idx($f,time)      $time
+                    lappend idx($f,level)     $level
+                    lappend idx($f,component) $component
+                    lappend records [list $offset $length $time $level \
+                                         $component]
+                }
+
+                incr offset [expr {$length + 1}]
+            }
+        } finally {
+            close $ch
+        }
+
+        set idx($f,size) $offset
+
+        # NEXT, save the new records.
+        if {$options(-sidecar) && [llength $records] > 0} {
+            $self SaveSidecar $f $records
+        }
+
+        return $f
+    }
+
+    # IndexBinary f
+    #
+    # f     A normalized file name
+    #
+    # Indexes any complete records added to a binary log file since
+    # it was last indexed.
+
+    method IndexBinary {f} {
+        set ch [open $f r]
+        fconfigure $ch -translation binary
+        seek $ch $idx($f,size)
+        set data [read $ch]
+        close $ch
+
+        lassign [::marsutil::logdecode $data $idx($f,comps) \
+                     -index -base $idx($f,size)] consumed idx($f,comps) records
+
+        foreach record $records {
+            lassign $record offset length time level component
+            lappend idx($f,offset)    $offset
+            lappend idx($f,length)    $length
+            lappend idx($f,time)      $time
+            lappend idx($f,level)     $level
+            lappend idx($f,component) $component
+        }
+
+        incr idx($f,size) $consumed
+    }
+
+    # ClearIndex f
+    #
+    # f     A normalized file name
+    #
+    # Clears the index for the file.
+
+    method ClearIndex {f} {
+        set idx($f,size)   0
+        set idx($f,binary) 0
+        set idx($f,comps)  [dict create]
+
+        foreach field {offset length time level component} {
+            set idx($f,$field) [list]
+        }
+    }
+
+    # LoadSidecar f size
+    #
+    # f      A normalized file name
+    # size   The file's current size
+    #
+    # Loads the index from the file's sidecar, if it has one.  The
+    # sidecar is ignored if it doesn't match the file.
+
+    method LoadSidecar {f size} {
+        if {[catch {
+            set ch [open $f.idx r]
+            set records [split [read -nonewline $ch] \n]
+            close $ch
+        }]} {
+            return
+        }
+
+        # FIRST, the first record is the header.
+        if {[::marsutil::lshift records] ne "logreader-index 1"} {
+            return
+        }
+
+        # NEXT, the indexed entries must fit in the file.  A log file
+        # overwritten by a larger one won't be caught, but this is
+        # consistent with newentries.
+        set end 0
+
+        if {[llength $records] > 0} {
+            lassign [lindex $records end] offset length
+            set end [expr {$offset + $length + 1}]
+        }
+
+        if {$end > $size} {
+            file delete -force $f.idx
+            return
+        }
+
+        foreach record $records {
+            lassign $record offset length time level component
+            lappend idx($f,offset)    $offset
+            lappend idx($f,length)    $length
+            lappend idx($f,time)      $time
+            lappend idx($f,level)     $level
+            lappend idx($f,component) $component
+        }
+
+        set idx($f,size) $end
+    }
+
+    # SaveSidecar f records
+    #
+    # f        A normalized file name
+    # records  A list of new index records
+    #
+    # Appends the records to the file's sidecar, creating it if need
+    # be.  Failure to write the sidecar isn't an error; the index
+    # is simply rebuilt next time.
+
+    method SaveSidecar {f records} {
+        catch {
+            if {[llength $idx($f,offset)] == [llength $records]} {
+                set ch [open $f.idx w]
+                puts $ch "logreader-index 1"
+            } else {
+                set ch [open $f.idx a]
+            }
+
+            puts $ch [join $records \n]
+            close $ch
+        }
+    }
+
+    # ReadBytes file offset length
+    #
+    # file     A file name
+    # offset   A byte offset
+    # length   A number of bytes
+    #
+    # Reads the bytes from the file.
+
+    proc ReadBytes {file offset length} {
+        set ch [open $file r]
+        fconfigure $ch -translation binary
+
+        try {
+            seek $ch $offset
+            set data [read $ch $length]
+        } finally {
+            close $ch
+        }
+
+        return $data
+    }
+
     # close
     #
     # Closes the current log file, if any
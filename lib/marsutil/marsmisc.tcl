@@ -55,6 +55,7 @@ namespace eval ::marsutil:: {
     namespace export    \
         commafmt        \
         count           \
+        decimate        \
         discrete        \
         echo            \
         gettimeofday    \
@@ -145,6 +146,97 @@ proc roundrange {min max} {
     return [list $min $max]
 }
 
+# decimate xylist px0 x0 xppu py0 y0 yppu ?start?
+#
+# xylist       A flat list of X/Y data pairs, in X order
+# px0 x0 xppu  X transform: px = px0 + (x - x0)*xppu
+# py0 y0 yppu  Y transform: py = py0 - (y - y0)*yppu
+# start        Index of the first pair to decimate; defaults to 0
+#
+# Transforms the pairs to pixel coordinates, keeping only the first,
+# minimum, maximum, and last points in each pixel column.  Returns
+# {coords last lastlen}, where last is the index of the first pair
+# in the final pixel column and lastlen is the number of values in
+# coords that belong to it.
+#
+# NOTE: Marsbin defines this as a binary command.  Define it here
+# only if the binary command doesn't exist.
+
+if {[llength [info commands ::marsutil::decimate]] == 0} {
+
+    proc ::marsutil::decimate {xylist px0 x0 xppu py0 y0 yppu {start 0}} {
+        if {[llength $xylist] % 2 != 0} {
+            error "xylist has an odd number of elements"
+        }
+
+        set coords  [list]
+        set last    $start
+        set lastlen 0
+        set col     ""
+
+        # Each column is a list of {index px py} points: first, min,
+        # max, last.  Pixel Y increases downward.
+        set flush {
+            set pts [list [lindex $points 0]]
+            foreach p [lsort -integer -index 0 [lrange $points 1 2]] {
+                lappend pts $p
+            }
+            lappend pts [lindex $points 3]
+
+            set lastlen 0
+            set prev    ""
+            foreach p $pts {
+                if {[lindex $p 0] ne $prev} {
+                    lappend coords [lindex $p 1] [lindex $p 2]
+                    incr lastlen 2
+                    set prev [lindex $p 0]
+                }
+            }
+        }
+
+        set i -1
+        foreach {x y} $xylist {
+            if {[incr i] < $start} {
+                continue
+            }
+
+            set px [expr {$px0 + ($x - $x0)*$xppu}]
+            set py [expr {$py0 - ($y - $y0)*$yppu}]
+            set c  [expr {int(floor($px))}]
+
+            if {$col ne "" && $c != $col} {
+                eval $flush
+                set col ""
+            }
+
+            set pt [list $i $px $py]
+
+            if {$col eq ""} {
+                set col    $c
+                set last   $i
+                set points [list $pt $pt $pt $pt]
+            } else {
+                if {$py > [lindex $points 1 2]} {
+                    lset points 1 $pt
+                }
+
+                if {$py < [lindex $points 2 2]} {
+                    lset points 2 $pt
+                }
+
+                lset points 3 $pt
+            }
+        }
+
+        if {$col ne ""} {
+            eval $flush
+        }
+
+        return [list $coords $last $lastlen]
+    }
+
+}
+
 # gettimeofday
 #
 # Returns the current wallclock seconds as a decimal value;
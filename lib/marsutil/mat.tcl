@@ -19,6 +19,11 @@
 #   Matrix elements are retrieved and set using the lindex and lset 
 #   commands.  An m*n matrix is indexed 0..m-1, and 0..n-1.
 #
+#   When Marsbin is loaded, the numeric subcommands are implemented
+#   by ::marsutil::dmat, which holds matrices as contiguous doubles;
+#   the results are still valid lists.  The Tcl code below is the
+#   fallback.
+#
 #-----------------------------------------------------------------------
 
 #-----------------------------------------------------------------------
@@ -37,8 +42,17 @@ snit::type ::marsutil::mat {
 
     typeconstructor {
         namespace import ::marsutil::*
+
+        set native [llength [info commands ::marsutil::dmat]]
     }
 
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # native: 1 if the Marsbin dmat command is available, and 0 
+    # otherwise.
+    typevariable native 0
+
     #-------------------------------------------------------------------
     # Ensemble subcommands
 
@@ -67,6 +81,10 @@ snit::type ::marsutil::mat {
     #
     # Returns the number of rows in the matrix.
     typemethod rows {matrix} {
+        if {$native} {
+            return [::marsutil::dmat rows $matrix]
+        }
+
         llength $matrix
     }
 
@@ -74,6 +92,10 @@ snit::type ::marsutil::mat {
     #
     # Returns the number of columns in the matrix.
     typemethod cols {matrix} {
+        if {$native} {
+            return [::marsutil::dmat cols $matrix]
+        }
+
         llength [lindex $matrix 0]
     }
 
@@ -82,6 +104,13 @@ snit::type ::marsutil::mat {
     # Returns row i as a vector
     typemethod rowvec {matrix i} {
         assert {0 <= $i && $i < [mat rows $matrix]}
+
+        # Non-numeric matrices, and matrices the native code would
+        # reformat, use the list code.
+        if {$native && ![catch {::marsutil::dmat row $matrix $i} result]} {
+            return $result
+        }
+
         lindex $matrix $i
     }
     
@@ -91,6 +120,10 @@ snit::type ::marsutil::mat {
     typemethod colvec {matrix j} {
         assert {0 <= $j && $j < [mat cols $matrix]}
 
+        if {$native && ![catch {::marsutil::dmat col $matrix $j} result]} {
+            return $result
+        }
+
         set m [mat rows $matrix]
 
         set result {}
@@ -119,6 +152,10 @@ snit::type ::marsutil::mat {
             return 0
         }
 
+        if {$native && ![catch {::marsutil::dmat equal $mat1 $mat2} result]} {
+            return $result
+        }
+
         for {set i 0} {$i < $m} {incr i} {
             for {set j 0} {$j < $n} {incr j} {
                 if {[lindex $mat1 $i $j] != [lindex $mat2 $i $j]} {
@@ -142,6 +179,12 @@ snit::type ::marsutil::mat {
 
         assert {$m1 == $m2 && $n1 == $n2}
 
+        if {$native} {
+            try {
+                return [::marsutil::dmat add $mat1 $mat2]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set result [mat new $m1 $n1]
 
         for {set i 0} {$i < $m1} {incr i} {
@@ -167,6 +210,12 @@ snit::type ::marsutil::mat {
 
         assert {$m1 == $m2 && $n1 == $n2}
 
+        if {$native} {
+            try {
+                return [::marsutil::dmat sub $mat1 $mat2]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set result [mat new $m1 $n1]
 
         for {set i 0} {$i < $m1} {incr i} {
@@ -184,6 +233,12 @@ snit::type ::marsutil::mat {
     #
     # Returns the product of a matrix and a scalar.
     typemethod scalarmul {matrix constant} {
+        if {$native} {
+            try {
+                return [::marsutil::dmat scalarmul $matrix $constant]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set m [mat rows $matrix]
         set n [mat cols $matrix]
 
@@ -199,6 +254,137 @@ snit::type ::marsutil::mat {
         return $result
     }
 
+    # mul mat1 mat2
+    #
+    # mat1      An m*p matrix
+    # mat2      A p*n matrix
+    #
+    # Returns the m*n matrix product of the two matrices.
+
+    typemethod mul {mat1 mat2} {
+        set m [mat rows $mat1]
+        set p [mat cols $mat1]
+        set n [mat cols $mat2]
+
+        assert {$p == [mat rows $mat2]}
+
+        if {$native} {
+            try {
+                return [::marsutil::dmat mul $mat1 $mat2]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set result [mat new $m $n]
+
+        for {set i 0} {$i < $m} {incr i} {
+            for {set j 0} {$j < $n} {incr j} {
+                set sum 0
+
+                for {set k 0} {$k < $p} {incr k} {
+                    set sum [expr {
+                        $sum + [lindex $mat1 $i $k]*[lindex $mat2 $k $j]
+                    }]
+                }
+
+                lset result $i $j $sum
+            }
+        }
+
+        return $result
+    }
+
+    # transpose matrix
+    #
+    # Returns the transpose of the matrix.
+
+    typemethod transpose {matrix} {
+        if {$native && ![catch {::marsutil::dmat transpose $matrix} result]} {
+            return $result
+        }
+
+        set result {}
+
+        for {set j 0} {$j < [mat cols $matrix]} {incr j} {
+            lappend result [mat colvec $matrix $j]
+        }
+
+        return $result
+    }
+
+    # sum matrix
+    #
+    # Returns the sum of the matrix's elements.
+
+    typemethod sum {matrix} {
+        if {$native} {
+            try {
+                return [::marsutil::dmat sum $matrix]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set sum 0
+
+        foreach row $matrix {
+            foreach value $row {
+                set sum [expr {$sum + $value}]
+            }
+        }
+
+        return $sum
+    }
+
+    # min matrix
+    #
+    # Returns the smallest of the matrix's elements.
+
+    typemethod min {matrix} {
+        assert {[mat rows $matrix] > 0 && [mat cols $matrix] > 0}
+
+        if {$native} {
+            try {
+                return [::marsutil::dmat min $matrix]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set result [lindex $matrix 0 0]
+
+        foreach row $matrix {
+            foreach value $row {
+                if {$value < $result} {
+                    set result $value
+                }
+            }
+        }
+
+        return [expr {$result}]
+    }
+
+    # max matrix
+    #
+    # Returns the largest of the matrix's elements.
+
+    typemethod max {matrix} {
+        assert {[mat rows $matrix] > 0 && [mat cols $matrix] > 0}
+
+        if {$native} {
+            try {
+                return [::marsutil::dmat max $matrix]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set result [lindex $matrix 0 0]
+
+        foreach row $matrix {
+            foreach value $row {
+                if {$value > $result} {
+                    set result $value
+                }
+            }
+        }
+
+        return [expr {$result}]
+    }
+
     # format matrix fmtstring
     #
     # matrix      A matrix
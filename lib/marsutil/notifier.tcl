@@ -19,6 +19,10 @@
 #    and event. When the subject sends the event, all bound callbacks
 #    are called.  Any errors are handled by bgerror.
 #
+#    The bindings table is the record of truth for bind, forget,
+#    rename, and introspection; triggers on it maintain a hash
+#    of the substituted bindings, so that send never touches SQL.
+#
 #-----------------------------------------------------------------------
 
 #-----------------------------------------------------------------------
@@ -46,12 +50,26 @@ snit::type ::marsutil::notifier {
     # info array: Scalars
     #
     # tracecmd     Name of command to trace execution of events.
+    # flushId      after(n) ID of the pending deferred flush, or "".
 
     typevariable info -array {
         tracecmd {}
+        flushId  {}
     }
 
+    # hash array: Dispatch table, kept in sync with the bindings
+    # table by triggers.
+    #
+    # {$subject $event}  -> dictionary of substituted bindings by object,
+    #                       for those events with at least one binding.
+
+    typevariable hash -array {}
+
+    # deferred: Dictionary of events queued by "defer" and not yet
+    # sent.  The key is the list {subject event args}; the value is
+    # unused.  Identical events coalesce into a single key.
 
+    typevariable deferred {}
 
     #-------------------------------------------------------------------
     # Type Constructor
@@ -75,9 +93,33 @@ snit::type ::marsutil::notifier {
             );
 
             CREATE INDEX binding_index ON bindings(binding);
+
+            CREATE TRIGGER bindings_insert
+            AFTER INSERT ON bindings BEGIN
+                SELECT hash_set(new.subject, new.event, new.object,
+                                new.binding);
+            END;
+
+            CREATE TRIGGER bindings_update
+            AFTER UPDATE ON bindings BEGIN
+                SELECT hash_unset(old.subject, old.event, old.object)
+                WHERE old.subject IS NOT new.subject
+                OR    old.event   IS NOT new.event
+                OR    old.object  IS NOT new.object;
+
+                SELECT hash_set(new.subject, new.event, new.object,
+                                new.binding);
+            END;
+
+            CREATE TRIGGER bindings_delete
+            AFTER DELETE ON bindings BEGIN
+                SELECT hash_unset(old.subject, old.event, old.object);
+            END;
         }
 
         $db function substitute [myproc Substitute]
+        $db function hash_set   [myproc HashSet]
+        $db function hash_unset [myproc HashUnset]
     }
 
     #-------------------------------------------------------------------
@@ -252,19 +294,32 @@ snit::type ::marsutil::notifier {
     # Calls the binding for each object wired to this event.
     
     typemethod send {subject event args} {
-        if {$info(tracecmd) ne ""} {
-            set objects [$db eval {
-                SELECT object FROM bindings
-                WHERE subject=$subject AND event=$event
-            }]
+        set key [list $subject $event]
 
-            {*}$info(tracecmd) $subject $event $args $objects
+        if {![info exists hash($key)]} {
+            if {$info(tracecmd) ne ""} {
+                {*}$info(tracecmd) $subject $event $args {}
+            }
+            return
         }
-        
-        $db eval {
-            SELECT binding FROM bindings
-            WHERE subject=$subject AND event=$event
-        } {
+
+        set bindings $hash($key)
+
+        if {$info(tracecmd) ne ""} {
+            {*}$info(tracecmd) $subject $event $args [dict keys $bindings]
+        }
+
+        dict for {object binding} $bindings {
+            # FIRST, skip bindings deleted by an earlier callback, and
+            # pick up any that were changed.
+            if {![info exists hash($key)] ||
+                ![dict exists $hash($key) $object]
+            } {
+                continue
+            }
+
+            set binding [dict get $hash($key) $object]
+
             if {[catch {
                 uplevel \#0 $binding $args
             } result]} {
@@ -273,12 +328,88 @@ snit::type ::marsutil::notifier {
         }
     }
 
+    # defer subject event args
+    #
+    # subject    An object name
+    # event      An event name
+    # args       Arguments for this event from this object
+    #
+    # Queues the event to be sent when the event loop next goes idle.
+    # Identical events deferred within one event loop turn are sent
+    # only once, in the order in which they were first deferred.
+
+    typemethod defer {subject event args} {
+        dict set deferred [list $subject $event $args] 1
+
+        if {$info(flushId) eq ""} {
+            set info(flushId) [after idle [mytypemethod flush]]
+        }
+
+        return
+    }
+
+    # flush
+    #
+    # Sends all deferred events immediately.  Events deferred by
+    # the bindings called during the flush are queued for the
+    # next flush.
+
+    typemethod flush {} {
+        after cancel $info(flushId)
+        set info(flushId) ""
+
+        set events [dict keys $deferred]
+        set deferred [dict create]
+
+        foreach event $events {
+            lassign $event subject event args
+            $type send $subject $event {*}$args
+        }
+
+        return
+    }
+
     #-------------------------------------------------------------------
     # Utility Procs
 
     proc Substitute {binding subject object} {
         string map [list %s [list $subject] %o [list $object]] $binding
     }
+
+    # HashSet subject event object binding
+    #
+    # Called by the bindings triggers to add or replace a substituted
+    # binding in the dispatch hash.  An empty binding is a row still
+    # being defined, and is not dispatched.
+
+    proc HashSet {subject event object binding} {
+        if {$binding eq ""} {
+            HashUnset $subject $event $object
+        } else {
+            dict set hash([list $subject $event]) $object $binding
+        }
+
+        return
+    }
+
+    # HashUnset subject event object
+    #
+    # Called by the bindings triggers to remove a binding from the
+    # dispatch hash.
+
+    proc HashUnset {subject event object} {
+        set key [list $subject $event]
+
+        if {[info exists hash($key)]} {
+            dict unset hash($key) $object
+
+            if {[dict size $hash($key)] == 0} {
+                unset hash($key)
+            }
+        }
+
+        return
+    }
 }
 
 
@@ -12,6 +12,14 @@
 #    and the reporting of results to the application.  It also manages
 #    the undo/redo stacks.
 #
+#    The undo/redo stacks retain the order objects themselves.  If
+#    they are limited by depth, the least recently used orders and
+#    transactions beyond the limit are frozen into compact, compressed
+#    strings, and thawed into new order objects when they are undone
+#    or redone.  The frozen entries can be limited by memory; entries
+#    over the limit are evicted, or, if a spill database is configured,
+#    moved to a temporary SQLite table.
+#
 #    An order_flunky is created relative to a particular order_set(n),
 #    and handles the orders in that set.
 #
@@ -39,13 +47,43 @@ oo::class create ::marsutil::order_flunky {
     variable execMode
 
     # undoStack - stack of items to be undone.  The top is the end.
-    # An item might be an order or a transaction.
+    # An item might be an order or a transaction; it is represented
+    # by the ID of its entry in the undo store.
     variable undoStack
 
     # redoStack - stack of items to be redone.  The top is the end.
-    # An item might be an order or a transaction.
+    # Its contents are as for undoStack.
     variable redoStack
 
+    # opts - array of configuration options.  See [$f configure].
+    #
+    # -undodepth    Maximum number of items on the undo and redo
+    #               stacks together kept as live objects, or 0 for no 
+    #               limit.  Older items are frozen.
+    # -undomemory   Maximum number of bytes of frozen items held in
+    #               memory, or 0 for no limit.
+    # -spilldb      An SQLite3 database handle, or "".  If given, items
+    #               over the -undomemory budget are spilled to a temporary
+    #               table in this database rather than evicted.
+    variable opts
+
+    # store - The undo store: the items on the undo and redo stacks,
+    # by entry ID.  An entry is live, frozen, or spilled.
+    #
+    # nextId       - The next entry ID
+    # clock        - Use counter, for LRU eviction
+    # live         - Number of live entries
+    # bytes        - Total size of the frozen entries held in memory
+    # spilled      - Number of entries spilled to the -spilldb
+    # spilledBytes - Total size of the spilled entries
+    #
+    # text-$id     - The item's narrative
+    # used-$id     - The value of store(clock) when the item was last used
+    # item-$id     - The order or transaction list, if live
+    # size-$id     - The size of the frozen item, in bytes, if not live
+    # data-$id     - The frozen item, if frozen and held in memory
+    variable store
+
     # transList - list of orders in the current transaction, while 
     # in a transaction.
     #
@@ -74,6 +112,82 @@ oo::class create ::marsutil::order_flunky {
         set undoStack [list]
         set redoStack [list]
         set transList [list]
+
+        array set opts {
+            -undodepth  0
+            -undomemory 0
+            -spilldb    ""
+        }
+
+        array set store {
+            nextId       0
+            clock        0
+            live         0
+            bytes        0
+            spilled      0
+            spilledBytes 0
+        }
+    }
+
+    # destructor
+    #
+    # Destroys the live entries, and deletes any spilled entries.
+
+    destructor {
+        catch {my DropEntries [concat $undoStack $redoStack]}
+    }
+
+    #-------------------------------------------------------------------
+    # Configuration
+
+    # configure ?option value...?
+    #
+    # Sets the flunky's options; see the opts variable.  With no 
+    # arguments, returns a dictionary of the options and their values.
+    # The undo and redo stacks are brought within any new limits
+    # immediately.
+
+    method configure {args} {
+        if {[llength $args] == 0} {
+            set result [dict create]
+
+            foreach opt {-undodepth -undomemory -spilldb} {
+                dict set result $opt $opts($opt)
+            }
+
+            return $result
+        }
+
+        foreach {opt val} $args {
+            ::marsutil::require {[info exists opts($opt)]} \
+                "Unknown option: \"$opt\""
+
+            if {$opt eq "-spilldb"} {
+                # Bring any spilled entries back from the old database.
+                my UnspillAll
+            } else {
+                ::marsutil::require {[string is integer -strict $val] && $val >= 0} \
+                    "Invalid $opt value: \"$val\""
+            }
+
+            set opts($opt) $val
+        }
+
+        my Enforce
+        return
+    }
+
+    # cget opt
+    #
+    # opt  - An option name
+    #
+    # Returns the option's value.
+
+    method cget {opt} {
+        ::marsutil::require {[info exists opts($opt)]} \
+            "Unknown option: \"$opt\""
+
+        return $opts($opt)
     }
 
 
@@ -185,9 +299,14 @@ oo::class create ::marsutil::order_flunky {
             # destroy our copy of the order; we don't need it.
             $mycopy destroy
         } else {
-            # pass our copy of the order along to the undo stack.
-            my UndoPushNew $mycopy
+            # pass our copy of the order along to the undo stack.  If
+            # it can't be undone, it isn't kept.
+            set kept [my UndoPushNew $mycopy]
             my _onExecute $mycopy
+
+            if {!$kept} {
+                $mycopy destroy
+            }
         }
 
         return $result
@@ -516,7 +635,7 @@ oo::class create ::marsutil::order_flunky {
             return ""
         }
 
-        return [my ItemNarrative "Undo" [::kiteutils::ltop $undoStack]]
+        return "Undo: $store(text-[::kiteutils::ltop $undoStack])"
 
     }
 
@@ -544,7 +663,7 @@ oo::class create ::marsutil::order_flunky {
             return ""
         }
 
-        return [my ItemNarrative "Redo" [::kiteutils::ltop $redoStack]]
+        return "Redo: $store(text-[::kiteutils::ltop $redoStack])"
     }
 
     # undo
@@ -559,7 +678,8 @@ oo::class create ::marsutil::order_flunky {
             error "Nothing to undo; stack is empty."
         }
 
-        set item [::kiteutils::lpop undoStack]
+        set id   [::kiteutils::lpop undoStack]
+        set item [my LoadItem $id]
 
         if {[my IsTrans $item]} {
             foreach order [lreverse [lrange $item 1 end]] {
@@ -571,7 +691,8 @@ oo::class create ::marsutil::order_flunky {
             my _onUndo $item
         }
 
-        ::kiteutils::lpush redoStack $item
+        ::kiteutils::lpush redoStack $id
+        my Enforce
         return
     }
 
@@ -597,7 +718,8 @@ oo::class create ::marsutil::order_flunky {
             error "Nothing to redo; stack is empty."
         }
 
-        set item [::kiteutils::lpop redoStack]
+        set id   [::kiteutils::lpop redoStack]
+        set item [my LoadItem $id]
 
         if {[my IsTrans $item]} {
             foreach order [lrange $item 1 end] {
@@ -611,7 +733,8 @@ oo::class create ::marsutil::order_flunky {
 
         # We know it can undone, because it wouldn't be on the redo
         # stack otherwise.
-        ::kiteutils::lpush undoStack $item
+        ::kiteutils::lpush undoStack $id
+        my Enforce
         return
     }
 
@@ -630,8 +753,10 @@ oo::class create ::marsutil::order_flunky {
     #
     # item - An order or transaction list that was successfully executed.
     #
-    # If the item can be undone, it is pushed onto the Undo Stack;
-    # otherwise, the stack is cleared.
+    # If the item can be undone, it is pushed onto the Undo Stack,
+    # or onto the current transaction, which then owns it; otherwise, 
+    # the stack is cleared.  Returns 1 if the item was kept, and 0
+    # otherwise.
 
     method UndoPushNew {item} {
         # FIRST, we've got a new successful order or transaction; the
@@ -640,8 +765,9 @@ oo::class create ::marsutil::order_flunky {
 
         # NEXT, transaction lists are always undoable.
         if {[my IsTrans $item]} {
-            ::kiteutils::lpush undoStack $item
-            return
+            ::kiteutils::lpush undoStack [my SaveItem $item]
+            my Enforce
+            return 1
         }
 
         # NEXT, what happens depends on whether we are in a transaction
@@ -656,11 +782,15 @@ oo::class create ::marsutil::order_flunky {
             }
         } else {
             if {[$order canundo]} {
-                ::kiteutils::lpush undoStack $order
+                ::kiteutils::lpush undoStack [my SaveItem $order]
+                my Enforce
             } else {
                 my UndoClear
+                return 0
             }
         }
+
+        return 1
     }
 
     # UndoClear
@@ -669,7 +799,7 @@ oo::class create ::marsutil::order_flunky {
 
     method UndoClear {} {
         try {
-            my DestroyItems $undoStack
+            my DropEntries $undoStack
         } finally {
             set undoStack [list]
         }
@@ -681,7 +811,7 @@ oo::class create ::marsutil::order_flunky {
 
     method RedoClear {} {
         try {
-            my DestroyItems $redoStack
+            my DropEntries $redoStack
         } finally {
             set redoStack [list]
         }
@@ -705,21 +835,357 @@ oo::class create ::marsutil::order_flunky {
         }
     }
 
-    # ItemNarrative op item
+    #-------------------------------------------------------------------
+    # Undo Store
+
+    # footprint
     #
-    # op    - The operation
-    # item  - an order or transaction
+    # Returns a dictionary describing the current size of the undo store:
     #
-    # Returns the item's narrative string.
+    # undo         - Number of items on the undo stack
+    # redo         - Number of items on the redo stack
+    # live         - Number of items kept as live objects
+    # bytes        - Size in bytes of the frozen items held in memory
+    # spilled      - Number of items spilled to the -spilldb
+    # spilledBytes - Size in bytes of the spilled items
+
+    method footprint {} {
+        return [dict create \
+                    undo         [llength $undoStack] \
+                    redo         [llength $redoStack] \
+                    live         $store(live)         \
+                    bytes        $store(bytes)        \
+                    spilled      $store(spilled)      \
+                    spilledBytes $store(spilledBytes)]
+    }
 
-    method ItemNarrative {op item} {
+    # SaveItem item
+    #
+    # item - An order or transaction list
+    #
+    # Adds the item to the undo store as a live entry, and returns the 
+    # new entry ID.  The store now owns the item's order objects.
+
+    method SaveItem {item} {
         if {[my IsTrans $item]} {
-            return "$op: [lindex $item 0]"
+            set text [lindex $item 0]
+        } else {
+            set text [$item narrative]
+        }
+
+        set id [incr store(nextId)]
+        set store(text-$id) $text
+        set store(used-$id) [incr store(clock)]
+        set store(item-$id) $item
+        incr store(live)
+
+        return $id
+    }
+
+    # LoadItem id
+    #
+    # id  - An entry ID
+    #
+    # Returns the entry's order or transaction list, thawing it into
+    # a live entry if need be.  The entry remains in the store.
+
+    method LoadItem {id} {
+        set store(used-$id) [incr store(clock)]
+
+        if {[info exists store(item-$id)]} {
+            return $store(item-$id)
+        }
+
+        if {[info exists store(data-$id)]} {
+            set data $store(data-$id)
+            unset store(data-$id)
+            incr store(bytes) -$store(size-$id)
+        } else {
+            set me [self]
+            set data [$opts(-spilldb) onecolumn {
+                SELECT data FROM order_flunky_undo 
+                WHERE flunky = $me AND id = $id
+            }]
+            $opts(-spilldb) eval {
+                DELETE FROM order_flunky_undo 
+                WHERE flunky = $me AND id = $id
+            }
+            incr store(spilled) -1
+            incr store(spilledBytes) -$store(size-$id)
+        }
+
+        unset store(size-$id)
+
+        set payload [encoding convertfrom utf-8 [zlib inflate $data]]
+
+        if {[llength $payload] == 1} {
+            set item [my ThawOrder [lindex $payload 0]]
+        } else {
+            set item [list [lindex $payload 0]]
+
+            foreach frozen [lrange $payload 1 end] {
+                lappend item [my ThawOrder $frozen]
+            }
+        }
+
+        set store(item-$id) $item
+        incr store(live)
+
+        return $item
+    }
+
+    # Freeze id
+    #
+    # id  - The ID of a live entry
+    #
+    # Freezes the entry's item into a compressed string held in memory,
+    # and destroys its order objects.
+
+    method Freeze {id} {
+        set item $store(item-$id)
+
+        if {[my IsTrans $item]} {
+            set payload [list [lindex $item 0]]
+
+            foreach order [lrange $item 1 end] {
+                lappend payload [my FreezeOrder $order]
+            }
+        } else {
+            set payload [list [my FreezeOrder $item]]
+        }
+
+        set data [zlib deflate [encoding convertto utf-8 $payload]]
+
+        set store(size-$id) [string length $data]
+        set store(data-$id) $data
+        incr store(bytes) $store(size-$id)
+
+        unset store(item-$id)
+        incr store(live) -1
+        my DestroyItems [list $item]
+    }
+
+    # DropEntries ids
+    #
+    # ids - A list of entry IDs
+    #
+    # Removes the entries from the undo store, destroying the live
+    # entries' order objects.
+
+    method DropEntries {ids} {
+        foreach id $ids {
+            if {[info exists store(item-$id)]} {
+                set item $store(item-$id)
+                array unset store *-$id
+                incr store(live) -1
+                my DestroyItems [list $item]
+                continue
+            }
+
+            if {[info exists store(data-$id)]} {
+                incr store(bytes) -$store(size-$id)
+            } else {
+                incr store(spilled) -1
+                incr store(spilledBytes) -$store(size-$id)
+
+                set me [self]
+                $opts(-spilldb) eval {
+                    DELETE FROM order_flunky_undo 
+                    WHERE flunky = $me AND id = $id
+                }
+            }
+
+            array unset store *-$id
+        }
+    }
+
+    # Enforce
+    #
+    # Brings the undo store within the -undodepth and -undomemory
+    # budgets.  Live entries beyond the -undodepth are frozen, least
+    # recently used first.  Frozen entries over the -undomemory are
+    # spilled to the -spilldb, if any, or evicted from the bottoms of
+    # the stacks, least recently used first.  The last remaining entry
+    # is never evicted.
+
+    method Enforce {} {
+        if {$opts(-undodepth) > 0} {
+            while {$store(live) > $opts(-undodepth)} {
+                my Freeze [my LRU item]
+            }
+        }
+
+        if {$opts(-undomemory) > 0} {
+            while {$store(bytes) > $opts(-undomemory)} {
+                if {$opts(-spilldb) ne ""} {
+                    my Spill
+                } elseif {[llength $undoStack] + [llength $redoStack] > 1} {
+                    my Evict
+                } else {
+                    break
+                }
+            }
+        }
+    }
+
+    # LRU kind
+    #
+    # kind  - item | data
+    #
+    # Returns the ID of the least recently used entry that is live
+    # (item) or frozen in memory (data).
+
+    method LRU {kind} {
+        set lru ""
+
+        foreach id [concat $undoStack $redoStack] {
+            if {[info exists store($kind-$id)] &&
+                ($lru eq "" || $store(used-$id) < $store(used-$lru))
+            } {
+                set lru $id
+            }
+        }
+
+        return $lru
+    }
+
+    # Evict
+    #
+    # Removes the least recently used entry that can be removed without
+    # breaking the undo or redo chain, i.e., the entry at the bottom
+    # of the undo or redo stack.
+
+    method Evict {} {
+        set u [lindex $undoStack 0]
+        set r [lindex $redoStack 0]
+
+        if {$r eq "" || ($u ne "" && $store(used-$u) < $store(used-$r))} {
+            set undoStack [lrange $undoStack 1 end]
+            my DropEntries [list $u]
         } else {
-            return "$op: [$item narrative]"
+            set redoStack [lrange $redoStack 1 end]
+            my DropEntries [list $r]
         }
     }
 
+    # Spill
+    #
+    # Moves the least recently used frozen entry held in memory to the
+    # -spilldb.
+
+    method Spill {} {
+        set lru  [my LRU data]
+        set me   [self]
+        set data $store(data-$lru)
+
+        $opts(-spilldb) eval {
+            CREATE TEMPORARY TABLE IF NOT EXISTS order_flunky_undo (
+                flunky TEXT,
+                id     INTEGER,
+                data   BLOB,
+                PRIMARY KEY (flunky, id)
+            );
+
+            INSERT INTO order_flunky_undo(flunky, id, data)
+            VALUES($me, $lru, @data);
+        }
+
+        unset store(data-$lru)
+        incr store(bytes) -$store(size-$lru)
+        incr store(spilled)
+        incr store(spilledBytes) $store(size-$lru)
+    }
+
+    # UnspillAll
+    #
+    # Moves any spilled entries back into memory.
+
+    method UnspillAll {} {
+        if {$store(spilled) == 0} {
+            return
+        }
+
+        set me [self]
+
+        $opts(-spilldb) eval {
+            SELECT id, data FROM order_flunky_undo WHERE flunky = $me
+        } {
+            set store(data-$id) $data
+            incr store(bytes) $store(size-$id)
+        }
+
+        $opts(-spilldb) eval {
+            DELETE FROM order_flunky_undo WHERE flunky = $me
+        }
+
+        set store(spilled)      0
+        set store(spilledBytes) 0
+    }
+
+    # FreezeOrder order
+    #
+    # order - An order(n) object
+    #
+    # Returns a list of the order's class, a dictionary of its
+    # instance variables, and its mixins, from which ThawOrder can 
+    # recreate it.  Each variable's value is a pair, {scalar value} or 
+    # {array dict}.
+
+    method FreezeOrder {order} {
+        set vars [dict create]
+
+        foreach var [info vars [info object namespace $order]::*] {
+            if {[array exists $var]} {
+                dict set vars [namespace tail $var] [list array [array get $var]]
+            } else {
+                dict set vars [namespace tail $var] [list scalar [set $var]]
+            }
+        }
+
+        return [list [info object class $order] $vars \
+                    [info object mixins $order]]
+    }
+
+    # ThawOrder frozen
+    #
+    # frozen - An order frozen by FreezeOrder
+    #
+    # Creates and returns a new order object with the frozen order's
+    # class, instance variables, and mixins.  The order is created 
+    # with order_flunky_thaw mixed into its class, so that its 
+    # constructor isn't run again; its state comes entirely from the
+    # variables.
+
+    method ThawOrder {frozen} {
+        lassign $frozen cls vars mixins
+
+        set classMixins [info class mixins $cls]
+        oo::define $cls mixin ::marsutil::order_flunky_thaw {*}$classMixins
+
+        try {
+            set order [$cls new]
+        } finally {
+            oo::define $cls mixin {*}$classMixins
+        }
+
+        if {[llength $mixins] > 0} {
+            oo::objdefine $order mixin {*}$mixins
+        }
+
+        set ns [info object namespace $order]
+
+        dict for {name pair} $vars {
+            lassign $pair kind value
+
+            if {$kind eq "array"} {
+                array set ${ns}::$name $value
+            } else {
+                set ${ns}::$name $value
+            }
+        }
+
+        return $order
+    }
 
     #-------------------------------------------------------------------
     # Debugging Commands
@@ -733,14 +1199,8 @@ oo::class create ::marsutil::order_flunky {
         set out [list]
 
         if {[::kiteutils::got $redoStack]} {
-            foreach o $redoStack {
-                if {[my IsTrans $o]} {
-                    lappend out \
-                        "redo transaction -- [lindex $o 0]"
-                } else {
-                    lappend out "redo $o -- [$o name] <[$o getdict]>"
-
-                }
+            foreach id $redoStack {
+                lappend out "redo $id -- [my EntryDump $id]"
             }
             lappend out ""
         }
@@ -750,17 +1210,42 @@ oo::class create ::marsutil::order_flunky {
         if {[::kiteutils::got $undoStack]} {
             lappend out ""
 
-            foreach o [lreverse $undoStack] {
-                if {[my IsTrans $o]} {
-                    lappend out \
-                        "undo transaction -- [lindex $o 0]"
-                } else {
-                    lappend out "undo $o -- [$o name] <[$o getdict]>"
-
-                }
+            foreach id [lreverse $undoStack] {
+                lappend out "undo $id -- [my EntryDump $id]"
             }
         }
 
         return [join $out \n]
     }
+
+    # EntryDump id
+    #
+    # id  - An entry ID
+    #
+    # Returns a description of the entry for [$f dump].
+
+    method EntryDump {id} {
+        if {[info exists store(item-$id)]} {
+            set where "live"
+        } elseif {[info exists store(data-$id)]} {
+            set where "$store(size-$id) bytes"
+        } else {
+            set where "$store(size-$id) bytes, spilled"
+        }
+
+        return "$store(text-$id) ($where)"
+    }
+}
+
+#-----------------------------------------------------------------------
+# order_flunky_thaw class
+#
+# Mixed into an order class while [$f ThawOrder] creates an instance
+# of it.  Its constructor doesn't call [next], so the order's own 
+# constructor isn't run.
+
+oo::class create ::marsutil::order_flunky_thaw {
+    constructor {args} {
+        # The order's state is restored from its frozen variables.
+    }
 }
@@ -36,6 +36,12 @@
 #   comments, but there's not much point, as the file is often produced
 #   by software.
 #
+#   Alternatively, the parameters can be saved in a compact binary
+#   format, which includes a hash of the parmset's schema, i.e., of its
+#   parameter names and types and the types' definitions.  When loading
+#   a binary file whose schema hash matches, the values are known to be
+#   valid, and are loaded by index without re-validation.
+#
 #   This module defines the parmset type; to define a parameter set,
 #   create an instance of parmset; then define the parameters using
 #   the define method.
@@ -88,6 +94,11 @@ snit::type ::marsutil::parmset {
     # to manipulate it separately.
     variable values
 
+    # Change journal: an array whose keys are the IDs of the parameters
+    # whose values differ from their defaults.  It allows checkpoint,
+    # restore, and reset to touch only the changed parameters.
+    variable journal -array {}
+
     # Array of parameter set data.  In what follows, "$id" is 
     # the lowercase form of the parameter or subset name.
     #
@@ -104,6 +115,7 @@ snit::type ::marsutil::parmset {
     # vtype-$id        Parameter's value type
     # defvalue-$id     Parameter's default value
     # locked-$id       1 if the parameter is locked, and 0 otherwise.
+    # index-$id        Parameter's index in info(parms)
 
     variable info -array {
         items   {}
@@ -112,6 +124,12 @@ snit::type ::marsutil::parmset {
         changed 0
     }
 
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Magic string that begins a binary parameter file.
+    typevariable binaryMagic "MARSPS01"
+
     #-------------------------------------------------------------------
     # Constructor/Destructor
 
@@ -188,6 +206,8 @@ snit::type ::marsutil::parmset {
         set info(itype-$id)   parm
         set info(vtype-$id)   $vtype
         set info(locked-$id)  0
+        set info(index-$id)   [llength $info(parms)]
+        lappend info(parms) $id
 
         # NEXT, turn notifications off
         set info(notify) 0
@@ -268,13 +288,19 @@ snit::type ::marsutil::parmset {
         require {!$info(locked-$id) || $value eq $values($id)} \
             "Parameter is locked: \"$name\""
 
-        # NEXT, save the value
+        # NEXT, save the value, and update the journal.
         set values($id) $value
 
         if {$op eq "setdefault"} {
             set info(defvalue-$id)  $value
         }
 
+        if {$value ne $info(defvalue-$id)} {
+            set journal($id) 1
+        } else {
+            unset -nocomplain journal($id)
+        }
+
         # NEXT, do notifications.
         $self notify $name
 
@@ -284,6 +310,71 @@ snit::type ::marsutil::parmset {
         return $value
     }
 
+    # CheckValue id name value
+    #
+    # id     The parameter ID
+    # name   The parameter name, as given by the caller
+    # value  The new value
+    #
+    # Validates and normalizes the value, and verifies that the
+    # parameter can be set, as SetParm does.  Returns the normalized
+    # value.
+
+    method CheckValue {id name value} {
+        if {[catch {$info(vtype-$id) validate $value} result]} {
+            error "Invalid $name value \"$value\": $result"
+        }
+
+        set value [Normalize $value]
+
+        require {!$info(locked-$id) || $value eq $values($id)} \
+            "Parameter is locked: \"$name\""
+
+        return $value
+    }
+
+    # setlist nvlist
+    #
+    # nvlist   A list of parameter names and values
+    #
+    # Sets multiple parameters at once.  All of the values are
+    # validated before any are set, so that on error none are changed.
+    # A single notification is sent: the parameter name, if only
+    # one was given, and "" otherwise.
+
+    method setlist {nvlist} {
+        # FIRST, validate all of the values.
+        set checked [list]
+
+        foreach {name value} $nvlist {
+            set id [$self ValidID $name]
+            lappend checked $id [$self CheckValue $id $name $value]
+        }
+
+        # NEXT, save them.
+        foreach {id value} $checked {
+            set values($id) $value
+
+            if {$value ne $info(defvalue-$id)} {
+                set journal($id) 1
+            } else {
+                unset -nocomplain journal($id)
+            }
+        }
+
+        # NEXT, do notifications.
+        if {[llength $checked] == 2} {
+            $self notify [lindex $nvlist 0]
+        } elseif {[llength $checked] > 2} {
+            $self notify
+        }
+
+        # NEXT, set the change flag
+        set info(changed) 1
+
+        return
+    }
+
     # lock pattern
     #
     # pattern    A glob pattern
@@ -470,6 +561,50 @@ snit::type ::marsutil::parmset {
         return $out
     }
 
+    # schemahash
+    #
+    # Returns a hash of the parmset's schema, i.e., of its parameter
+    # names and value types in order of definition, and of the value
+    # types' definitions.  Values saved by a parmset with the same 
+    # schema hash are known to be valid.  A type can be redefined 
+    # at any time, so the hash isn't cached.
+
+    method schemahash {} {
+        set schema [list]
+
+        foreach id $info(parms) {
+            lappend schema $info(canon-$id) $info(vtype-$id)
+            set vtypes($info(vtype-$id)) 1
+        }
+
+        foreach vtype [lsort [array names vtypes]] {
+            lappend schema [VtypeDefinition $vtype]
+        }
+
+        return [format %08x [zlib crc32 [encoding convertto utf-8 $schema]]]
+    }
+
+    # JournalIDs
+    #
+    # Returns the IDs of the parameters whose values differ from their
+    # defaults, in order of definition.
+
+    method JournalIDs {} {
+        set pairs [list]
+
+        foreach id [array names journal] {
+            lappend pairs [list $info(index-$id) $id]
+        }
+
+        set ids [list]
+
+        foreach pair [lsort -integer -index 0 $pairs] {
+            lappend ids [lindex $pair 1]
+        }
+
+        return $ids
+    }
+
     # items
     #
     # Returns a list of the item names and types, sorted by item name.
@@ -489,18 +624,30 @@ snit::type ::marsutil::parmset {
     #-------------------------------------------------------------------
     # File Handling
 
-    # save filename
+    # save filename ?-binary?
+    #
+    # filename    File to save
+    # -binary     If specified, the file is saved in binary format.
     #
     # Saves non-defaulted parameter data to a file   
     #
     # Note: does not affect saveable(i) status!
 
-    method save {filename} {
+    method save {filename {opt ""}} {
+        if {$opt ne "" && $opt ne "-binary"} {
+            error "Invalid option: \"$opt\""
+        }
+
         # FIRST, rename any old file
         if {[file exists $filename]} {
             file copy -force $filename $filename.bak
         }
 
+        if {$opt eq "-binary"} {
+            $self SaveBinary $filename
+            return
+        }
+
         set f [open $filename w]
 
         puts $f "# File saved [clock format [clock seconds]]\n"
@@ -520,16 +667,48 @@ snit::type ::marsutil::parmset {
         close $f
     }
 
+    # SaveBinary filename
+    #
+    # filename    File to save
+    #
+    # Saves the non-defaulted parameter data to a file in binary format:
+    # the magic string, the schema hash and the number of entries, 
+    # followed by one entry per parameter: its index in info(parms), its
+    # name, and its value.  Strings are UTF-8, preceded by their
+    # lengths; integers are unsigned 32-bit big-endian.
+
+    method SaveBinary {filename} {
+        set ids [$self JournalIDs]
+
+        set data [binary format a8a8I \
+                      $binaryMagic [$self schemahash] [llength $ids]]
+
+        foreach id $ids {
+            set name  [encoding convertto utf-8 $info(canon-$id)]
+            set value [encoding convertto utf-8 $values($id)]
+
+            append data [binary format IIa*Ia* \
+                             $info(index-$id)        \
+                             [string length $name]  $name \
+                             [string length $value] $value]
+        }
+
+        set f [open $filename wb]
+        puts -nonewline $f $data
+        close $f
+    }
+
     # reset
     #
     # Resets all values to their defaults.
     
     method reset {} {
-        # FIRST, reset the values
-        foreach id [array names values] {
+        # FIRST, reset the changed values
+        foreach id [array names journal] {
             # Only reset unlocked parameters.
             if {!$info(locked-$id)} {
                 set values($id) $info(defvalue-$id)
+                unset journal($id)
             }
         }
 
@@ -547,8 +726,9 @@ snit::type ::marsutil::parmset {
     #             an invalid parameter or value.  All valid parameters will 
     #             be loaded and errors will be ignored.
     #
-    # Loads the data from a file. If the file is invalid, the existing
-    # values are untouched.
+    # Loads the data from a file, which may be a text file or a
+    # binary file written by "save -binary". If the file is invalid, the
+    # existing values are untouched.
 
     method load {filename {opt ""}} {
         require {[file exists $filename]} \
@@ -561,6 +741,7 @@ snit::type ::marsutil::parmset {
 
         # NEXT, save the old values
         set savedValues [array get values]
+        set savedJournal [array get journal]
 
         # NEXT, disable notifications until we're done.
         set info(notify) 0
@@ -569,7 +750,11 @@ snit::type ::marsutil::parmset {
         $self reset
 
         # NEXT, try to load the file
-        set code [catch {$self LoadFile $filename $opt} result]
+        if {[IsBinary $filename]} {
+            set code [catch {$self LoadBinary $filename $opt} result]
+        } else {
+            set code [catch {$self LoadFile $filename $opt} result]
+        }
 
         # NEXT, re-enable notification
         set info(notify) 1
@@ -578,6 +763,8 @@ snit::type ::marsutil::parmset {
         if {$code} {
             # Restore the saved values
             array set values $savedValues
+            array unset journal
+            array set journal $savedJournal
 
             return -code error "Error in $filename: $result"
         }
@@ -627,6 +814,86 @@ snit::type ::marsutil::parmset {
         return
     }
 
+    # LoadBinary filename opt
+    #
+    # filename    File to load
+    # opt         When equal to "-safe", will silently ignore erroneous
+    #             parameters and values.
+    #
+    # Loads a binary file written by SaveBinary.  If the file's schema
+    # hash matches, the values are stored by index without validation;
+    # otherwise, they are set by name, as for a text file.
+
+    method LoadBinary {filename opt} {
+        set f [open $filename rb]
+        set data [read $f]
+        close $f
+
+        if {[binary scan $data a8a8I magic hash count] != 3} {
+            error "truncated binary parameter file"
+        }
+
+        set fast [expr {$hash eq [$self schemahash]}]
+        set offset 20
+
+        for {set i 0} {$i < $count} {incr i} {
+            # FIRST, get the entry.
+            if {[binary scan $data @${offset}II index len] != 2} {
+                error "truncated binary parameter file"
+            }
+
+            incr offset 8
+            set name [string range $data $offset [expr {$offset + $len - 1}]]
+            incr offset $len
+
+            if {[binary scan $data @${offset}I len] != 1} {
+                error "truncated binary parameter file"
+            }
+
+            incr offset 4
+            set value [string range $data $offset [expr {$offset + $len - 1}]]
+            incr offset $len
+
+            set name  [encoding convertfrom utf-8 $name]
+            set value [encoding convertfrom utf-8 $value]
+
+            # NEXT, save the value.
+            if {$fast} {
+                set id [lindex $info(parms) $index]
+
+                if {!$info(locked-$id) || $value eq $values($id)} {
+                    set values($id) $value
+
+                    if {$value ne $info(defvalue-$id)} {
+                        set journal($id) 1
+                    }
+                } elseif {$opt ne "-safe"} {
+                    error "Parameter is locked: \"$name\""
+                }
+            } elseif {$opt eq "-safe"} {
+                catch {$self set $name $value}
+            } else {
+                $self set $name $value
+            }
+        }
+
+        return
+    }
+
+    # IsBinary filename
+    #
+    # filename    A parameter file
+    #
+    # Returns 1 if the file is a binary parameter file, and 0 otherwise.
+
+    proc IsBinary {filename} {
+        set f [open $filename rb]
+        set magic [read $f [string length $binaryMagic]]
+        close $f
+
+        expr {$magic eq $binaryMagic}
+    }
+
     #-------------------------------------------------------------------
     # Cloning Parameters into another parmset
 
@@ -828,14 +1095,12 @@ snit::type ::marsutil::parmset {
             set info(changed) 0
         }
 
-        # Do not include parms with default values
+        # Do not include parms with default values; the change journal
+        # tells us which these are.
         set checkpoint [list]
 
-        foreach name [$self names] {
-            set id [string tolower $name]
-            if {$values($id) ne $info(defvalue-$id)} {
-                lappend checkpoint $id $values($id)
-            }
+        foreach id [$self JournalIDs] {
+            lappend checkpoint $id $values($id)
         }
 
         return $checkpoint
@@ -854,11 +1119,22 @@ snit::type ::marsutil::parmset {
         # defaults first; then save the checkpointed values,
         # if any.
 
-        foreach id [array names values] {
+        foreach id [array names journal] {
             set values($id) $info(defvalue-$id)
         }
 
-        array set values $checkpoint
+        array unset journal
+
+        foreach {id value} $checkpoint {
+            # Skip parameters that are no longer defined.
+            if {[info exists info(vtype-$id)]} {
+                set values($id) $value
+
+                if {$value ne $info(defvalue-$id)} {
+                    set journal($id) 1
+                }
+            }
+        }
 
         # NEXT, do notifications
         $self notify
@@ -899,6 +1175,122 @@ snit::type ::marsutil::parmset {
         join [lrange [split $name "."] 0 end-1] "."
     }
 
+    # VtypeDefinition vtype
+    #
+    # vtype     A parameter's value type
+    #
+    # Returns the value type's definition, as nearly as it can be found
+    # without calling it: the command prefix and the aliases it leads
+    # to, and then the arguments and body of a proc, or the 
+    # configuration, variables, and procs of a namespace ensemble, 
+    # e.g., a snit(n) type or instance.  An ensemble in an ensemble's
+    # namespace, e.g., a snit(n) instance of a type, includes the 
+    # procs of the outer namespace as well.
+
+    proc VtypeDefinition {vtype} {
+        set def [list $vtype]
+        set cmd [lindex $vtype 0]
+
+        # FIRST, follow aliases.  Tcl doesn't allow alias loops.
+        while {[set target [AliasTarget $cmd]] ne ""} {
+            lappend def $target
+            set cmd [lindex $target 0]
+        }
+
+        set cmd [namespace which -command $cmd]
+
+        # NEXT, get the command's definition.
+        if {$cmd eq ""} {
+            # Nothing to add
+        } elseif {[info procs $cmd] ne ""} {
+            lappend def [ProcDefinition $cmd]
+        } elseif {[namespace ensemble exists $cmd]} {
+            set config [namespace ensemble configure $cmd]
+            set ns     [dict get $config -namespace]
+            set outer  [namespace qualifiers $ns]
+
+            lappend def $config [NamespaceDefinition $ns 1]
+
+            if {$outer ne "" && [namespace ensemble exists $outer]} {
+                lappend def [NamespaceDefinition $outer 0]
+            }
+        }
+
+        return $def
+    }
+
+    # AliasTarget cmd
+    #
+    # cmd       A command name
+    #
+    # Returns the target command prefix of the alias cmd, or "" if
+    # it isn't an alias.  Aliases are known by the name they were
+    # created with, which needn't be fully qualified.
+
+    proc AliasTarget {cmd} {
+        set cmd [namespace which -command $cmd]
+
+        if {$cmd eq ""} {
+            return ""
+        }
+
+        foreach token [interp aliases {}] {
+            if {[namespace which -command $token] eq $cmd} {
+                return [interp alias {} $token]
+            }
+        }
+
+        return ""
+    }
+
+    # ProcDefinition name
+    #
+    # name      A fully-qualified proc name
+    #
+    # Returns the proc's arguments, with their defaults, and body.
+
+    proc ProcDefinition {name} {
+        set arglist [list]
+
+        foreach arg [info args $name] {
+            if {[info default $name $arg value]} {
+                lappend arglist [list $arg $value]
+            } else {
+                lappend arglist $arg
+            }
+        }
+
+        return [list $arglist [info body $name]]
+    }
+
+    # NamespaceDefinition ns withVars
+    #
+    # ns        A namespace
+    # withVars  1 if the namespace's variables are included
+    #
+    # Returns the definitions of the namespace's procs and, optionally,
+    # the values of its variables.
+
+    proc NamespaceDefinition {ns withVars} {
+        set def [list]
+
+        foreach name [lsort [info procs ${ns}::*]] {
+            lappend def $name [ProcDefinition $name]
+        }
+
+        if {$withVars} {
+            foreach var [lsort [info vars ${ns}::*]] {
+                if {[array exists $var]} {
+                    lappend def $var [lsort -stride 2 [array get $var]]
+                } elseif {[info exists $var]} {
+                    lappend def $var [set $var]
+                }
+            }
+        }
+
+        return $def
+    }
+
     # Normalize text
     #
     # text      A block of text
@@ -63,6 +63,7 @@ source [file join $::marsutil::library range.tcl          ]
 source [file join $::marsutil::library vec.tcl            ]
 source [file join $::marsutil::library mat.tcl            ]
 source [file join $::marsutil::library parmset.tcl        ]
+source [file join $::marsutil::library commframe.tcl      ]
 source [file join $::marsutil::library commserver.tcl     ]
 source [file join $::marsutil::library commclient.tcl     ]
 source [file join $::marsutil::library gtclient.tcl       ]
@@ -70,9 +71,12 @@ source [file join $::marsutil::library gtserver.tcl       ]
 source [file join $::marsutil::library zcurve.tcl         ]
 source [file join $::marsutil::library sqlib.tcl          ]
 source [file join $::marsutil::library sqldocument.tcl    ]
+source [file join $::marsutil::library sqlworker.tcl      ]
 source [file join $::marsutil::library statecontroller.tcl]
 source [file join $::marsutil::library timeout.tcl        ]
 source [file join $::marsutil::library lazyupdater.tcl    ]
+source [file join $::marsutil::library profiler.tcl       ]
+source [file join $::marsutil::library snapshot.tcl       ]
 source [file join $::marsutil::library eventq.tcl         ]
 source [file join $::marsutil::library cmdinfo.tcl        ]
 source [file join $::marsutil::library tabletext.tcl      ]
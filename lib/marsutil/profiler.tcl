@@ -0,0 +1,392 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   profiler.tcl
+#
+# PACKAGE:
+#   marsutil(n) -- Tcl Utilities
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+# DESCRIPTION:
+#   marsutil(n) profiler: per-method timing instrumentation
+#
+#   A profiler accumulates call counts and wall-clock times for the
+#   methods of one or more object or ensemble commands, each of which
+#   is "attached" under a module name, e.g., "uram" or "cellmodel".
+#   Attaching a command adds Tcl execution traces to it; detaching it
+#   removes them, so that unprofiled modules pay nothing.
+#
+#   A profiler can also be attached to an sqldocument(n) or SQLite3
+#   database handle via the handle's "profile" hook, in which case
+#   it counts SQL statements and their run times, charging them
+#   to the innermost profiled method that is executing.
+#
+#   The accumulated statistics can be dumped as text, or saved into
+#   a temporary table in an SQLite3 database for querying.
+#
+#-----------------------------------------------------------------------
+
+namespace eval ::marsutil:: {
+    namespace export profiler
+}
+
+#-----------------------------------------------------------------------
+# profiler type
+
+snit::type ::marsutil::profiler {
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Schema of the temporary table used by "save".
+
+    typevariable schema {
+        CREATE TEMPORARY TABLE IF NOT EXISTS profile_stats (
+            module    TEXT,
+            method    TEXT,
+            calls     INTEGER,
+            total_ms  DOUBLE,
+            min_ms    DOUBLE,
+            max_ms    DOUBLE,
+            avg_ms    DOUBLE,
+            sql_count INTEGER,
+            sql_ms    DOUBLE,
+
+            PRIMARY KEY (module, method)
+        );
+    }
+
+    #-------------------------------------------------------------------
+    # Instance Variables
+
+    # modules: Array of attached commands by module name.
+    variable modules -array {}
+
+    # dbs: Array of attached database handles by module name.
+    variable dbs -array {}
+
+    # stats: Array of statistics by {module method}.  Each value is
+    # a list {calls total min max sqlcount sqltime}, where the times
+    # are in microseconds.
+    variable stats -array {}
+
+    # stack: List of {module method start} entries for the profiled
+    # calls currently executing, innermost last.
+    variable stack {}
+
+    #-------------------------------------------------------------------
+    # Constructor/Destructor
+
+    # No constructor is needed at this time.
+
+    destructor {
+        catch {$self detach}
+    }
+
+    #-------------------------------------------------------------------
+    # Public Methods
+
+    # attach module cmd
+    #
+    # module     The module name, e.g., "uram"
+    # cmd        An object or ensemble command
+    #
+    # Begins profiling the methods of cmd, recording them under the
+    # given module name.
+
+    method attach {module cmd} {
+        set name $cmd
+        set cmd [uplevel 1 [list namespace which -command $name]]
+
+        require {$cmd ne ""} "No such command: \"$name\""
+
+        $self DetachCommands $module
+        set modules($module) $cmd
+
+        trace add execution $cmd enter [mymethod Enter $module]
+        trace add execution $cmd leave [mymethod Leave $module]
+
+        return
+    }
+
+    # attachdb module db
+    #
+    # module     The module name, e.g., "rdb"
+    # db         An sqldocument(n) or SQLite3 database handle
+    #
+    # Begins counting SQL statements executed by db.  Statements are
+    # charged to the innermost profiled method that is executing,
+    # or to the method "(sql)" of the given module if none is.
+    # This replaces any existing profile hook on the db.
+
+    method attachdb {module db} {
+        $self DetachDbs $module
+        set dbs($module) $db
+        $db profile [mymethod SqlProfile $module]
+
+        return
+    }
+
+    # detach ?module?
+    #
+    # module     A module name
+    #
+    # Stops profiling the named module, or all modules if none is
+    # named.  The accumulated statistics are retained.
+
+    method detach {{module *}} {
+        $self DetachCommands $module
+        $self DetachDbs $module
+        return
+    }
+
+    # modules
+    #
+    # Returns a list of the names of the attached modules.
+
+    method modules {} {
+        lsort -unique [concat [array names modules] [array names dbs]]
+    }
+
+    # reset
+    #
+    # Clears the accumulated statistics.
+
+    method reset {} {
+        array unset stats
+        return
+    }
+
+    # stats ?module?
+    #
+    # module     A module name pattern; defaults to "*"
+    #
+    # Returns a list of {module method calls total min max sqlcount
+    # sqltime} records, with times in microseconds, sorted by module
+    # and method.
+
+    method stats {{module *}} {
+        set result [list]
+
+        foreach key [lsort -dictionary [array names stats]] {
+            if {[string match $module [lindex $key 0]]} {
+                lappend result [concat $key $stats($key)]
+            }
+        }
+
+        return $result
+    }
+
+    # dump ?module?
+    #
+    # module     A module name pattern; defaults to "*"
+    #
+    # Returns a formatted table of the accumulated statistics, in
+    # milliseconds, sorted by decreasing total time.
+
+    method dump {{module *}} {
+        set rows [lsort -real -decreasing -index 3 [$self stats $module]]
+
+        if {[llength $rows] == 0} {
+            return "No profile data."
+        }
+
+        set wid 6
+        foreach row $rows {
+            let wid {max($wid, [string length [lrange $row 0 1]])}
+        }
+
+        set fmt "%-*s %8s %10s %9s %9s %9s %8s %9s"
+
+        set out [format $fmt $wid "Method" "Calls" "Total ms" \
+                     "Avg ms" "Min ms" "Max ms" "SQL" "SQL ms"]
+
+        foreach row $rows {
+            lassign $row mod meth calls total min max sqlcount sqltime
+
+            append out "\n" [format $fmt $wid [list $mod $meth] $calls \
+                                 [Ms $total] [Ms [Avg $total $calls]] \
+                                 [Ms $min] [Ms $max] \
+                                 $sqlcount [Ms $sqltime]]
+        }
+
+        return $out
+    }
+
+    # save db
+    #
+    # db       An sqldocument(n) or SQLite3 database handle
+    #
+    # Saves the accumulated statistics into the temporary table
+    # profile_stats in db, replacing its previous contents.
+
+    method save {db} {
+        $db eval $schema
+        $db eval {DELETE FROM temp.profile_stats}
+
+        foreach row [$self stats] {
+            lassign $row mod meth calls total min max sqlcount sqltime
+            set avg [Avg $total $calls]
+
+            $db eval {
+                INSERT INTO temp.profile_stats(
+                    module, method, calls, total_ms, min_ms, max_ms,
+                    avg_ms, sql_count, sql_ms)
+                VALUES($mod, $meth, $calls, $total/1000.0, $min/1000.0,
+                       $max/1000.0, $avg/1000.0, $sqlcount,
+                       $sqltime/1000.0)
+            }
+        }
+
+        return
+    }
+
+    #-------------------------------------------------------------------
+    # Private Methods
+
+    # DetachCommands pattern
+    #
+    # pattern     A module name pattern
+    #
+    # Removes the execution traces from matching modules.
+
+    method DetachCommands {pattern} {
+        foreach module [array names modules $pattern] {
+            set cmd $modules($module)
+            unset modules($module)
+
+            if {[llength [info commands $cmd]] == 0} {
+                continue
+            }
+
+            trace remove execution $cmd enter [mymethod Enter $module]
+            trace remove execution $cmd leave [mymethod Leave $module]
+        }
+    }
+
+    # DetachDbs pattern
+    #
+    # pattern     A module name pattern
+    #
+    # Removes the profile hook from matching databases.
+
+    method DetachDbs {pattern} {
+        foreach module [array names dbs $pattern] {
+            catch {$dbs($module) profile ""}
+            unset dbs($module)
+        }
+    }
+
+    # Enter module cmdline op
+    #
+    # module     The module name
+    # cmdline    The command being executed
+    # op         "enter"
+    #
+    # Execution trace: pushes the call on the stack.
+
+    method Enter {module cmdline op} {
+        lappend stack [list $module [lindex $cmdline 1] [clock microseconds]]
+    }
+
+    # Leave module cmdline code result op
+    #
+    # module     The module name
+    # cmdline    The command being executed
+    # code       The command's return code
+    # result     The command's result
+    # op         "leave"
+    #
+    # Execution trace: pops the call off of the stack, and charges
+    # its elapsed time to its method.  Any entries above the call's
+    # own entry belong to calls whose leave trace never fired, e.g.,
+    # because the command was destroyed; they are discarded.
+
+    method Leave {module cmdline code result op} {
+        set now [clock microseconds]
+        set key [list $module [lindex $cmdline 1]]
+
+        # FIRST, find the call's entry.
+        for {set i [llength $stack]} {[incr i -1] >= 0} {} {
+            if {[lrange [lindex $stack $i] 0 1] eq $key} {
+                break
+            }
+        }
+
+        if {$i < 0} {
+            return
+        }
+
+        let elapsed {$now - [lindex $stack $i 2]}
+        set stack [lrange $stack 0 $i-1]
+
+        # NEXT, accumulate the statistics.
+        if {![info exists stats($key)]} {
+            set stats($key) [list 0 0 0 0 0 0]
+        }
+
+        lassign $stats($key) calls total min max sqlcount sqltime
+
+        if {$calls == 0} {
+            set min $elapsed
+        }
+
+        set stats($key) [list \
+                             [incr calls]                    \
+                             [expr {$total + $elapsed}]      \
+                             [expr {min($min, $elapsed)}]    \
+                             [expr {max($max, $elapsed)}]    \
+                             $sqlcount $sqltime]
+    }
+
+    # SqlProfile module sql nsecs
+    #
+    # module     The module name given to attachdb
+    # sql        The SQL statement that was executed
+    # nsecs      Its run time in nanoseconds
+    #
+    # SQLite3 profile hook: charges the statement to the innermost
+    # profiled method.
+
+    method SqlProfile {module sql nsecs} {
+        if {[llength $stack] > 0} {
+            set key [lrange [lindex $stack end] 0 1]
+        } else {
+            set key [list $module (sql)]
+        }
+
+        if {![info exists stats($key)]} {
+            set stats($key) [list 0 0 0 0 0 0]
+        }
+
+        lassign $stats($key) calls total min max sqlcount sqltime
+
+        lset stats($key) 4 [incr sqlcount]
+        lset stats($key) 5 [expr {$sqltime + $nsecs/1000.0}]
+    }
+
+    # Avg total calls
+    #
+    # total     A total time
+    # calls     A number of calls
+    #
+    # Returns the average time per call, or 0 if there were no calls,
+    # as for statements run outside any profiled method.
+
+    proc Avg {total calls} {
+        expr {$calls > 0 ? double($total)/$calls : 0.0}
+    }
+
+    # Ms usecs
+    #
+    # usecs     A time in microseconds
+    #
+    # Formats the time in milliseconds.
+
+    proc Ms {usecs} {
+        format "%.3f" [expr {$usecs/1000.0}]
+    }
+}
@@ -208,6 +208,26 @@ snit::type ::marsutil::simclock {
     # simulated time.
     option -requestcmd -default ""
 
+    # -interval
+    #
+    # The delay in milliseconds before the motor retries a time
+    # advance request that was deferred by the -requestcmd (via
+    # "break") or that failed with an error.
+    option -interval \
+        -default 10 \
+        -type {snit::integer -min 1}
+
+    # -maxbatch
+    #
+    # The maximum number of ticks to request in a single time advance.
+    # In "auto" mode every request is for -maxbatch ticks; in
+    # game-ratio mode, a clock that has fallen behind real time
+    # requests all of the ticks that are due, up to -maxbatch, so as
+    # to catch up.
+    option -maxbatch \
+        -default 1 \
+        -type {snit::integer -min 1}
+
     # -ratiovar
     #
     # Names a variable which will be updated with the current game
@@ -259,14 +279,21 @@ snit::type ::marsutil::simclock {
 
     # tm -- time management array
     #
-    # afterId            After handler ID, or ""
+    # running            1 if the motor is running, and 0 otherwise.
+    # afterId            After handler ID of the next scheduled
+    #                    Motor or Idle call, or ""
     # ratio              The requested game ratio; ratio >= 0.0
     # baseWallclock      The wallclock time, in decimal minutes, when
     #                    the game ratio was last set.
     # baseSimtime        The simclock time, in decimal minutes, when
     #                    the game ratio was last set.
     # grantWallclock     Wallclock time of the last advance grant
-    # elapsedTimes       List of 0 to 20 elapsed times between grants.
+    # elapsedTimes       List of 0 to 20 {elapsed ticks} pairs, the
+    #                    elapsed wallclock time between grants and the
+    #                    number of ticks granted.
+    # grantLog           List of 0 to 20 {wallclock ticks} pairs, one
+    #                    for each recent grant while running, used to
+    #                    compute the tickstats.
     # actualRatio        The measured game ratio
     # advancePending     1 if a time advance grant is pending, and 0
     #                    otherwise.
@@ -274,12 +301,14 @@ snit::type ::marsutil::simclock {
     #                    otherwise.
 
     variable tm -array {
+        running           0
         afterId            ""
         ratio             0.0
         baseWallclock     0.0
         baseSimtime       0.0
         grantWallclock    0.0
         elapsedTimes      {}
+        grantLog          {}
         actualRatio       0.0
         advancePending    0
         advanceReceived   0
@@ -327,6 +356,10 @@ snit::type ::marsutil::simclock {
 
             $self SetRatio $rat
             $self Log normal "ratio $tm(ratio)"
+
+            # NEXT, the next advance may now be due sooner, later,
+            # or never.
+            $self Schedule
         }
 
         return $tm(ratio)
@@ -341,6 +374,59 @@ snit::type ::marsutil::simclock {
         return $tm(actualRatio)
     }
 
+    # tickstats
+    #
+    # Returns a dictionary of statistics about the recent time advance
+    # grants received while the motor is running:
+    #
+    # rate       The achieved advance rate in ticks per wallclock second
+    # jitter     The standard deviation of the wallclock interval
+    #            between grants, in milliseconds
+    # samples    The number of grants the statistics are based on
+    #
+    # The rate and jitter are "???" until at least three grants have
+    # been received.
+
+    method tickstats {} {
+        set n [llength $tm(grantLog)]
+
+        if {$n < 3} {
+            return [dict create rate ??? jitter ??? samples $n]
+        }
+
+        # FIRST, get the intervals between grants, and the number of
+        # ticks granted over them.
+        set ticks 0
+        set intervals [list]
+        set last [lindex $tm(grantLog) 0 0]
+
+        foreach entry [lrange $tm(grantLog) 1 end] {
+            lassign $entry wc dt
+            incr ticks $dt
+            lappend intervals [expr {1000.0*($wc - $last)}]
+            set last $wc
+        }
+
+        # NEXT, compute the rate and the jitter.
+        set total [expr {$last - [lindex $tm(grantLog) 0 0]}]
+
+        if {$total > 0.0} {
+            set rate [format "%.3f" [expr {$ticks/$total}]]
+        } else {
+            set rate ???
+        }
+
+        set m    [llength $intervals]
+        set mean [expr {1000.0*$total/$m}]
+        set sum  0.0
+        foreach val $intervals {
+            set sum [expr {$sum + ($val - $mean)**2}]
+        }
+        set jitter [format "%.3f" [expr {sqrt($sum/$m)}]]
+
+        return [dict create rate $rate jitter $jitter samples $n]
+    }
+
 
     # start ?ticks?
     #
@@ -352,7 +438,7 @@ snit::type ::marsutil::simclock {
     # given.
 
     method start {{ticks ""} {advancePending 0}} {
-        require {$tm(afterId) eq ""}  "simclock $self is already running."
+        require {!$tm(running)}  "simclock $self is already running."
 
         # FIRST, Advance time to the specified time.
         if {$ticks ne ""} {
@@ -366,6 +452,7 @@ snit::type ::marsutil::simclock {
         set tm(grantWallclock)  $tm(baseWallclock)
         set tm(baseSimtime)     [$self asMinutes]
         set tm(elapsedTimes)    [list]
+        set tm(grantLog)        [list]
         set tm(advancePending)  $advancePending
         set tm(advanceReceived) 0
 
@@ -373,6 +460,7 @@ snit::type ::marsutil::simclock {
         $self Log normal "started [$self asZulu] ($tsim)"
 
         # NEXT, Start the motor.
+        set tm(running) 1
         $self Motor
 
         return
@@ -386,13 +474,13 @@ snit::type ::marsutil::simclock {
         $self Log normal "stop"
 
         # FIRST, if we're already stopped there's nothing more to do.
-        if {$tm(afterId) eq ""} {
+        if {!$tm(running)} {
             return
         }
 
         # NEXT, stop the motor
-        after cancel $tm(afterId)
-        set tm(afterId) ""
+        set tm(running) 0
+        $self Schedule
 
         # NEXT, clear all of the time management variables.
         $self SetRatio          0.0
@@ -401,6 +489,7 @@ snit::type ::marsutil::simclock {
         set tm(baseSimtime)     0.0
         set tm(grantWallclock)  0.0
         set tm(elapsedTimes)    [list]
+        set tm(grantLog)        [list]
         set tm(advancePending)  0
         set tm(advanceReceived) 0
        
@@ -414,7 +503,7 @@ snit::type ::marsutil::simclock {
     # at ratio 0.0) and 0 if the simclock is stopped.
 
     method isactive {} {
-        expr {$tm(afterId) ne ""}
+        return $tm(running)
     }
 
     #-------------------------------------------------------------------
@@ -424,21 +513,30 @@ snit::type ::marsutil::simclock {
     #
     # ticks     The time to which we can advance.
     #
-    # Advance time to ticks; or, more precisely, to $tsim + 1, since 
-    # that's what we requested.  This should only be called explicitly 
-    # in immediate or eventual response to the -requestcmd.
+    # Advance time to ticks; or, more precisely, to the time we
+    # requested.  This should only be called explicitly in immediate 
+    # or eventual response to the -requestcmd.
 
     method grant {ticks} {
-        # NEXT, advance to the specified time and clear the pending
+        # FIRST, advance to the specified time and clear the pending
         # flag.
+        set dt [expr {$ticks - $tsim}]
         $self SetSimTime $ticks
         set tm(advancePending) 0
         $self Log normal "grant [$self asZulu] ($ticks)"
 
-        # NEXT, compute the actual game ratio, if we're in active
-        # mode.
-        if {$tm(afterId) ne ""} {
-            $self ComputeActualRatio [WallClock]
+        # NEXT, compute the actual game ratio and the tick statistics,
+        # and schedule the next request, if we're in active mode.
+        if {$tm(running)} {
+            set now [WallClock]
+            $self ComputeActualRatio $now $dt
+
+            if {[llength $tm(grantLog)] >= 20} {
+                set tm(grantLog) [lrange $tm(grantLog) 1 end]
+            }
+            lappend tm(grantLog) [list [expr {60.0*$now}] $dt]
+
+            $self Schedule
         }
 
         # NEXT, call the advance command, if any.
@@ -454,10 +552,70 @@ snit::type ::marsutil::simclock {
     #-------------------------------------------------------------------
     # Private Methods, Time Management
 
+    # Schedule ?delay?
+    #
+    # delay     A delay in milliseconds, or ""
+    #
+    # Schedules the next call to the Motor, cancelling any call that
+    # is already scheduled.  Nothing is scheduled if the motor is
+    # stopped, if the game ratio is 0.0, or if an advance is pending;
+    # in these cases the clock sleeps until "start", "ratio", or 
+    # "grant" is called.  Otherwise, the Motor is called after the 
+    # given delay, if any, or when the next advance is due: 
+    # as soon as the application is idle in "auto" mode, and when the
+    # wallclock catches up with sim time in game-ratio mode.
+
+    method Schedule {{delay ""}} {
+        # FIRST, cancel any scheduled call.
+        if {$tm(afterId) ne ""} {
+            after cancel $tm(afterId)
+            set tm(afterId) ""
+        }
+
+        # NEXT, is there anything to do?
+        if {!$tm(running)          ||
+            $tm(advancePending)    ||
+            ($tm(ratio) ne "auto" && $tm(ratio) == 0.0)
+        } {
+            return
+        }
+
+        # NEXT, determine when the next advance is due.  In "auto"
+        # mode, wait until idle; a chain of "after 0" calls would
+        # keep the application's idle handlers from ever running.
+        if {$delay eq ""} {
+            if {$tm(ratio) eq "auto"} {
+                set tm(afterId) [after idle [mymethod Idle]]
+                return
+            } else {
+                let due {
+                    $tm(baseWallclock) + 
+                    ([$self asMinutes] - $tm(baseSimtime))/$tm(ratio)
+                }
+                let delay {
+                    max(0, int(ceil(60000.0*($due - [WallClock]))))
+                }
+            }
+        }
+
+        set tm(afterId) [after $delay [mymethod Motor]]
+    }
+
+    # Idle
+    #
+    # Called by Schedule in "auto" mode once the application is idle;
+    # calls the Motor as soon as pending events have been handled.
+
+    method Idle {} {
+        set tm(afterId) [after 0 [mymethod Motor]]
+    }
+
     # Motor
     #
-    # This is the motor.  It keeps track of the
-    # game ratio, and advances simulation time accordingly.
+    # This is the motor.  It is called by Schedule when the next 
+    # advance is due, and requests an advance according to the 
+    # game ratio.  When sim time has fallen behind the game ratio,
+    # it requests all ticks that are due, up to -maxbatch.
     #
     # WARNING: If this routine throws an error, it can break the 
     # timeout loop, and stop time from advancing. Be careful that 
@@ -465,54 +623,67 @@ snit::type ::marsutil::simclock {
     # appropriately.
 
     method Motor {} {
-        # FIRST, schedule the next timeout.
-        # TBD: the interval should really be an option!
-        set tm(afterId) [after 10 [mymethod Motor]]
+        set tm(afterId) ""
+
+        # FIRST, We need to request advances based on the game ratio.
+        if {!$tm(running)                                 ||
+            $tm(advancePending)                           ||
+            ($tm(ratio) ne "auto" && $tm(ratio) == 0.0)
+        } {
+            return
+        }
 
-        # NEXT, We need to request advances based on the game ratio.
-        if {($tm(ratio) eq "auto" || $tm(ratio) > 0.0)} {
+        # NEXT, determine the number of ticks to request.
+        if {$tm(ratio) eq "auto"} {
+            set n $options(-maxbatch)
+        } else {
+            set newWC [expr {[WallClock] - $tm(baseWallclock)}]
+            set newST [expr {[$self asMinutes] - $tm(baseSimtime)}]
 
-            if {!$tm(advancePending)} {
-                set newWC [expr {[WallClock] - $tm(baseWallclock)}]
-                set newST [expr {[$self asMinutes] - $tm(baseSimtime)}]
+            if {$newWC*$tm(ratio) < $newST} {
+                # Woke early; go back to sleep.
+                $self Schedule
+                return
+            }
 
-                if {$tm(ratio) eq "auto" || 
-                    $newWC*$tm(ratio) >= $newST} {
-                    # FIRST, compute the next time
+            # One tick is due now, plus any we've fallen behind by.
+            let behind {
+                int(($newWC*$tm(ratio) - $newST)/[$self toMinutes 1])
+            }
+            let n {min($options(-maxbatch), 1 + $behind)}
+        }
 
-                    set newTime [expr {$tsim + 1}]
-                    $self Log normal \
-              "time advance request [$self toZulu $newTime] ($newTime)"
+        # NEXT, compute the next time
+        set newTime [expr {$tsim + $n}]
+        $self Log normal \
+            "time advance request [$self toZulu $newTime] ($newTime)"
                     
-                    # NEXT, remember that we've asked for an advance.
-                    set tm(advancePending) 1
-
-                    # NEXT, request the advance.  Call the -requestcmd
-                    # if there is one; otherwise, trivially grant
-                    # the request.
-                    set cmd $options(-requestcmd)
-
-                    if {$cmd ne ""} {
-                        lappend cmd $newTime
-
-                        set code [catch {uplevel \#0 $cmd} result]
-
-                        if {$code == 3} {
-                            # break!  Retry next time.
-                            set tm(advancePending) 0
-                            return
-                        } elseif {$code} {
-                            # Any other non-zero code is an error.
-                            # Log the error and retry.
-                            bgerror "-requestcmd: $result"
-                            set tm(advancePending) 0
-                            return
-                        }
-                    } else {
-                        $self grant $newTime
-                    }
-                }
+        # NEXT, remember that we've asked for an advance.
+        set tm(advancePending) 1
+
+        # NEXT, request the advance.  Call the -requestcmd
+        # if there is one; otherwise, trivially grant
+        # the request.
+        set cmd $options(-requestcmd)
+
+        if {$cmd ne ""} {
+            lappend cmd $newTime
+
+            set code [catch {uplevel \#0 $cmd} result]
+
+            if {$code == 3} {
+                # break!  Retry after the -interval.
+                set tm(advancePending) 0
+                $self Schedule $options(-interval)
+            } elseif {$code} {
+                # Any other non-zero code is an error.
+                # Log the error and retry.
+                bgerror "-requestcmd: $result"
+                set tm(advancePending) 0
+                $self Schedule $options(-interval)
             }
+        } else {
+            $self grant $newTime
         }
     }
 
@@ -550,15 +721,16 @@ snit::type ::marsutil::simclock {
         }
     }
 
-    # ComputeActualRatio grantTime
+    # ComputeActualRatio grantTime ?ticks?
     #
     # grantTime    The timeAdvanceGrant wallclock time in decimal
     #              minutes, or 0.0
+    # ticks        The number of ticks granted; defaults to 1.
     #
     # Computes the actual game ratio as a smoothed estimate of the
-    # last four measurements.
+    # last twenty measurements.
 
-    method ComputeActualRatio {grantTime} {
+    method ComputeActualRatio {grantTime {ticks 1}} {
         # FIRST, handling clearing the ratio
         if {$grantTime == 0.0} {
             set tm(grantWallclock) 0.0
@@ -575,7 +747,7 @@ snit::type ::marsutil::simclock {
             if {[llength $tm(elapsedTimes)] >= 20} {
                 set tm(elapsedTimes) [lrange $tm(elapsedTimes) 1 end]
             }
-            lappend tm(elapsedTimes) $diff
+            lappend tm(elapsedTimes) [list $diff $ticks]
 
             # If we have only a few elapsed times, don't compute
             # the actual ratio.
@@ -583,13 +755,14 @@ snit::type ::marsutil::simclock {
                 $self SetActualRatio "???"
             } else {
                 set sum 0.0
-                foreach val $tm(elapsedTimes) {
+                set n   0
+                foreach entry $tm(elapsedTimes) {
+                    lassign $entry val dt
                     let sum {$sum + $val}
+                    incr n $dt
                 }
-            
 
-                set n [llength $tm(elapsedTimes)]
-                let rat {double([$self toMinutes 1])/($sum/$n)}
+                let rat {double([$self toMinutes $n])/$sum}
                 
                 $self SetActualRatio [format "%.3f" $rat]
             }
@@ -614,7 +787,7 @@ snit::type ::marsutil::simclock {
     # any desired time.  Use with care.
     
     method advance {t} {
-        require {$tm(afterId) eq ""} \
+        require {!$tm(running)} \
             "Cannot advance simclock manually; simclock is active."
         require {[string is integer -strict $t]} \
             "expected integer ticks: \"$t\""
@@ -649,7 +822,7 @@ snit::type ::marsutil::simclock {
     # running
 
     method step {ticks} {
-        require {$tm(afterId) eq ""} \
+        require {!$tm(running)} \
             "Cannot step simclock manually; simclock is active."
         require {[string is integer -strict $ticks]} \
             "expected integer ticks: \"$ticks\""
@@ -678,7 +851,7 @@ snit::type ::marsutil::simclock {
     # Advances time one tick, and calls the -advancecmd, if any.
 
     method tick {} {
-        require {$tm(afterId) eq ""} \
+        require {!$tm(running)} \
             "Cannot tick simclock manually; simclock is active."
 
         $self grant [expr {$tsim + 1}]
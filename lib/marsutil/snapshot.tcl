@@ -0,0 +1,706 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   snapshot.tcl
+#
+# PACKAGE:
+#   marsutil(n) -- Tcl Utilities
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+# DESCRIPTION:
+#   marsutil(n) snapshot: incremental checkpoint/restore manager
+#
+#   A snapshot manager takes snapshots of a simulation's state, usually
+#   once per time advance, and can restore the state to any of the
+#   last -depth snapshots.  The state consists of the contents of an
+#   sqldocument(n) RDB plus the checkpoints of any number of registered
+#   saveable(i) modules.
+#
+#   Rather than copying the RDB, the manager keeps a change journal.
+#   Temporary triggers on each journaled table record every INSERT,
+#   UPDATE, and DELETE in the snapshot_journal table, and save the
+#   row's old values in a temporary "shadow" table.  Rows that an
+#   INSERT or UPDATE might replace on a uniqueness conflict are saved
+#   as well, since REPLACE's deletes don't fire the delete triggers.  A snapshot is just
+#   a position in the journal; restoring it undoes the changes made
+#   since then, most recent first, and so takes time proportional to
+#   the number of changes rather than to the size of the RDB.  Runs of
+#   changes of one kind to one table are undone by a single SQL 
+#   statement.  Journal entries older than the oldest snapshot are 
+#   discarded.
+#
+#   Module checkpoints are stored as Tcl values; a module whose
+#   checkpoint is unchanged since the previous snapshot shares the
+#   previous snapshot's value.  Getting and comparing a checkpoint
+#   costs time proportional to the module's state, so a module can
+#   be registered with a stamp command, a cheap check whose value
+#   changes whenever the state does; while its stamp is unchanged,
+#   the module isn't checkpointed at all.
+#
+#-----------------------------------------------------------------------
+
+namespace eval ::marsutil:: {
+    namespace export snapshot
+}
+
+#-----------------------------------------------------------------------
+# snapshot type
+
+snit::type ::marsutil::snapshot {
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Schema of the temporary journal table.
+
+    typevariable schema {
+        CREATE TEMPORARY TABLE IF NOT EXISTS snapshot_journal (
+            -- Sequence numbers are never reused, so that they can
+            -- mark snapshots.
+            seq   INTEGER PRIMARY KEY AUTOINCREMENT,
+
+            -- The table that was changed
+            tbl   TEXT,
+
+            -- The operation: I (insert), U (update), D (delete),
+            -- or R (rows an insert or update might replace)
+            op    TEXT
+        );
+    }
+
+    # rdbTracker
+    #
+    # Array of snapshot instances by RDB, so that there is only one
+    # instance per RDB.
+
+    typevariable rdbTracker -array { }
+
+    #-------------------------------------------------------------------
+    # Components
+
+    component rdb   ;# The sqldocument(n)
+
+    #-------------------------------------------------------------------
+    # Options
+
+    # -rdb cmd
+    #
+    # The sqldocument(n) whose contents are to be snapshotted.
+
+    option -rdb \
+        -readonly 1
+
+    # -depth k
+    #
+    # The number of snapshots to retain.  Defaults to 10.
+
+    option -depth \
+        -type     {snit::integer -min 1} \
+        -default  10
+
+    # -tables patterns
+    #
+    # A list of glob patterns; tables in the RDB's main schema whose
+    # names match any of the patterns are journaled.  Defaults to "*".
+
+    option -tables \
+        -default  *  \
+        -readonly 1
+
+    #-------------------------------------------------------------------
+    # Instance Variables
+
+    # modules: Array of saveable(i) command prefixes by module name.
+    variable modules -array {}
+
+    # stampcmds: Array of stamp command prefixes by module name, for
+    # the modules that have them.
+    variable stampcmds -array {}
+
+    # tags: List of snapshot tags, oldest first.
+    variable tags {}
+
+    # marks: Array of journal positions by snapshot tag; the snapshot
+    # includes all journal entries with seq <= the mark.
+    variable marks -array {}
+
+    # states: Array of module checkpoint dictionaries by snapshot tag.
+    variable states -array {}
+
+    # stamps: Array of module stamp dictionaries by snapshot tag.
+    variable stamps -array {}
+
+    # shadows: Array of shadow table names by journaled table name.
+    variable shadows -array {}
+
+    # undo: Array of SQL statements that undo a run of changes, by
+    # table name and operation, e.g., undo($table,U).  Each statement
+    # undoes the changes with sequence numbers from $lo to $hi.
+    variable undo -array {}
+
+    # triggers: List of the names of the journal triggers.
+    variable triggers {}
+
+    #-------------------------------------------------------------------
+    # Constructor/Destructor
+
+    constructor {args} {
+        # FIRST, get the options
+        $self configurelist $args
+
+        set rdb $options(-rdb)
+
+        require {$rdb ne ""} "-rdb is required"
+        require {![info exists rdbTracker($rdb)]} \
+            "RDB $rdb already has a snapshot manager"
+
+        set rdbTracker($rdb) $self
+
+        # NEXT, create the journal and its triggers.
+        $self reset
+    }
+
+    destructor {
+        catch {
+            unset -nocomplain rdbTracker($rdb)
+            $self DropJournal
+            $rdb eval {DROP TABLE IF EXISTS temp.snapshot_journal}
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Public Methods
+
+    # register name cmd ?stampcmd?
+    #
+    # name      The module name, e.g., "uram"
+    # cmd       A saveable(i) command prefix, e.g., "::ram saveable"
+    # stampcmd  A command prefix that returns the module's stamp
+    #
+    # Registers a saveable(i) module whose state will be included
+    # in subsequent snapshots.  The stamp, if any, must change 
+    # whenever the module's state does, and never return to an 
+    # earlier value; a change counter will do.
+
+    method register {name cmd {stampcmd ""}} {
+        set modules($name) $cmd
+
+        if {$stampcmd ne ""} {
+            set stampcmds($name) $stampcmd
+        } else {
+            unset -nocomplain stampcmds($name)
+        }
+
+        return
+    }
+
+    # modules
+    #
+    # Returns the names of the registered modules.
+
+    method modules {} {
+        return [lsort [array names modules]]
+    }
+
+    # reset
+    #
+    # Discards all snapshots and the journal, and (re)creates the
+    # journal triggers.  This must be called whenever the RDB's schema
+    # changes, e.g., after the RDB is opened or cleared.
+
+    method reset {} {
+        set tags [list]
+        array unset marks
+        array unset states
+        array unset stamps
+
+        $self DropJournal
+
+        $rdb eval $schema
+        $rdb eval {DELETE FROM temp.snapshot_journal}
+
+        $self CreateJournal
+
+        return
+    }
+
+    # take tag
+    #
+    # tag    A snapshot tag, e.g., the simulation time
+    #
+    # Takes a snapshot of the RDB and the registered modules, labeled
+    # with the tag, which must not be in use.  If there are more than
+    # -depth snapshots, the oldest is discarded.
+
+    method take {tag} {
+        require {![info exists marks($tag)]} "Duplicate snapshot tag: \"$tag\""
+
+        # FIRST, remember the current end of the journal.
+        set marks($tag) [$rdb onecolumn {
+            SELECT coalesce(max(seq), 0) FROM temp.snapshot_journal
+        }]
+
+        # NEXT, get the module checkpoints.  If a module's stamp
+        # hasn't changed, it isn't checkpointed; if its checkpoint
+        # hasn't changed, share the previous value.
+        set prev [lindex $tags end]
+        set state [dict create]
+        set stamp [dict create]
+
+        foreach name [lsort [array names modules]] {
+            set shared [expr {
+                $prev ne "" && [dict exists $states($prev) $name]
+            }]
+
+            if {[info exists stampcmds($name)]} {
+                dict set stamp $name [{*}$stampcmds($name)]
+
+                if {$shared && 
+                    [dict exists $stamps($prev) $name] &&
+                    [dict get $stamps($prev) $name] eq 
+                    [dict get $stamp $name]
+                } {
+                    dict set state $name [dict get $states($prev) $name]
+                    continue
+                }
+            }
+
+            set checkpoint [{*}$modules($name) checkpoint]
+
+            if {$shared &&
+                [dict get $states($prev) $name] eq $checkpoint
+            } {
+                set checkpoint [dict get $states($prev) $name]
+            }
+
+            dict set state $name $checkpoint
+        }
+
+        set states($tag) $state
+        set stamps($tag) $stamp
+        lappend tags $tag
+
+        # NEXT, discard old snapshots.
+        $self Trim
+
+        return
+    }
+
+    # restore tag
+    #
+    # tag    A snapshot tag
+    #
+    # Restores the RDB and the registered modules to the state they
+    # had when the snapshot was taken.  The snapshot is retained;
+    # all later snapshots are discarded.  Returns the number of
+    # RDB changes undone.
+
+    method restore {tag} {
+        require {[info exists marks($tag)]} "Unknown snapshot tag: \"$tag\""
+
+        set mark $marks($tag)
+
+        # FIRST, find the runs of changes since the mark, most recent
+        # first.
+        set runs [list]
+        set run  ""
+        set count 0
+
+        $rdb eval {
+            SELECT seq, tbl || ',' || op AS key
+            FROM temp.snapshot_journal
+            WHERE seq > $mark
+            ORDER BY seq DESC
+        } {
+            incr count
+
+            if {$key ne $run} {
+                if {$run ne ""} {
+                    lappend runs $run $lo $hi
+                }
+
+                set run $key
+                set hi  $seq
+            }
+
+            set lo $seq
+        }
+
+        if {$run ne ""} {
+            lappend runs $run $lo $hi
+        }
+
+        # NEXT, undo them.  The undo statements use $lo and $hi.
+        # Undoing the changes adds journal entries of its own; 
+        # delete them as well.  A cascaded delete is journaled after
+        # the delete that caused it, so child rows are restored before
+        # their parents; foreign key checks are deferred until the
+        # parents are back.
+        if {$count > 0} {
+            $rdb transaction {
+                set defer [$rdb onecolumn {PRAGMA defer_foreign_keys}]
+                $rdb eval {PRAGMA defer_foreign_keys = ON}
+
+                try {
+                    foreach {run lo hi} $runs {
+                        $rdb eval $undo($run)
+                    }
+                } finally {
+                    $rdb eval "PRAGMA defer_foreign_keys = $defer"
+                }
+
+                $self DeleteJournal > $mark
+            }
+        }
+
+        # NEXT, restore the modules.
+        dict for {name checkpoint} $states($tag) {
+            if {[info exists modules($name)]} {
+                {*}$modules($name) restore $checkpoint
+            }
+        }
+
+        # NEXT, discard the later snapshots.
+        set ndx [lsearch -exact $tags $tag]
+
+        foreach later [lrange $tags $ndx+1 end] {
+            unset marks($later)
+            unset states($later)
+            unset stamps($later)
+        }
+
+        set tags [lrange $tags 0 $ndx]
+
+        return $count
+    }
+
+    # tags
+    #
+    # Returns the tags of the retained snapshots, oldest first.
+
+    method tags {} {
+        return $tags
+    }
+
+    # exists tag
+    #
+    # tag    A snapshot tag
+    #
+    # Returns 1 if there's a snapshot with the given tag, and 0 otherwise.
+
+    method exists {tag} {
+        return [info exists marks($tag)]
+    }
+
+    # changes ?tag?
+    #
+    # tag    A snapshot tag
+    #
+    # Returns the number of RDB changes that restoring the tag would
+    # undo.  If no tag is given, returns the size of the journal.
+
+    method changes {{tag ""}} {
+        if {$tag eq ""} {
+            set mark -1
+        } else {
+            require {[info exists marks($tag)]} \
+                "Unknown snapshot tag: \"$tag\""
+            set mark $marks($tag)
+        }
+
+        return [$rdb onecolumn {
+            SELECT count(*) FROM temp.snapshot_journal WHERE seq > $mark
+        }]
+    }
+
+    #-------------------------------------------------------------------
+    # Private Methods
+
+    # Trim
+    #
+    # Discards the oldest snapshots in excess of -depth, and the journal
+    # entries that can no longer be used.
+
+    method Trim {} {
+        while {[llength $tags] > $options(-depth)} {
+            set oldest [lindex $tags 0]
+            set tags [lrange $tags 1 end]
+            unset marks($oldest)
+            unset states($oldest)
+            unset stamps($oldest)
+        }
+
+        $self DeleteJournal <= $marks([lindex $tags 0])
+    }
+
+    # DeleteJournal op mark
+    #
+    # op     A comparison operator, > or <=
+    # mark   A journal sequence number
+    #
+    # Deletes the journal entries and shadow rows whose sequence
+    # numbers compare to the mark.
+
+    method DeleteJournal {op mark} {
+        $rdb eval "DELETE FROM temp.snapshot_journal WHERE seq $op \$mark"
+
+        foreach table [array names shadows] {
+            $rdb eval "
+                DELETE FROM temp.\"$shadows($table)\" WHERE seq $op \$mark
+            "
+        }
+    }
+
+    # CreateJournal
+    #
+    # Creates the shadow tables and journal triggers for each
+    # journaled table.
+
+    method CreateJournal {} {
+        set names [$rdb eval {
+            SELECT name FROM sqlite_master
+            WHERE type='table' AND name NOT GLOB 'sqlite_*'
+            ORDER BY name
+        }]
+
+        foreach table $names {
+            foreach pattern $options(-tables) {
+                if {[string match $pattern $table]} {
+                    $self JournalTable $table
+                    break
+                }
+            }
+        }
+    }
+
+    # JournalTable table
+    #
+    # table    A table in the RDB's main schema
+    #
+    # Creates the shadow table and journal triggers for the table, and
+    # the statements that undo runs of changes.  Rows are identified
+    # by rowid, so tables created WITHOUT ROWID cannot be journaled.
+
+    method JournalTable {table} {
+        if {[catch {$rdb eval "SELECT rowid FROM main.\"$table\" LIMIT 0"}]} {
+            error "Table has no rowid: \"$table\""
+        }
+
+        # FIRST, get the columns.  A column that is an alias for the
+        # rowid needn't be set when undoing an update, and shouldn't 
+        # be, since setting a referenced key triggers foreign key 
+        # checks.
+        set cols  [list]
+        set pks   [list]
+        set alias ""
+
+        $rdb eval "PRAGMA main.table_info(\"$table\")" row {
+            lappend cols "\"$row(name)\""
+
+            if {$row(pk)} {
+                lappend pks "\"$row(name)\"" [string toupper $row(type)]
+            }
+        }
+
+        if {[llength $pks] == 2 && [lindex $pks 1] eq "INTEGER"} {
+            set alias [lindex $pks 0]
+        }
+
+        set setcols [lsearch -all -inline -exact -not $cols $alias]
+
+        # NEXT, get the unique keys, as lists of column names.  Keys
+        # on expressions can't be checked, and are skipped.
+        set keys [list]
+
+        $rdb eval "PRAGMA main.index_list(\"$table\")" idx {
+            if {!$idx(unique)} {
+                continue
+            }
+
+            set key [list]
+
+            $rdb eval "PRAGMA main.index_info(\"$idx(name)\")" icol {
+                lappend key $icol(name)
+            }
+
+            if {"" ni $key} {
+                lappend keys $key
+            }
+        }
+
+        # NEXT, create the shadow table.  Its columns have no declared
+        # type, so that values are saved exactly as they are.  An R
+        # entry can save several rows.
+        set shadow "snapshot_$table"
+        set shadows($table) $shadow
+
+        $rdb eval "
+            CREATE TEMPORARY TABLE \"$shadow\" (
+                seq INTEGER,
+                rid INTEGER,
+                [join $cols ,]
+            );
+
+            CREATE INDEX temp.\"${shadow}_seq\" ON \"$shadow\"(seq);
+            CREATE INDEX temp.\"${shadow}_rid\" ON \"$shadow\"(rid, seq);
+        "
+
+        # NEXT, create the triggers.  An update that changes the rowid
+        # is journaled as a delete and an insert; an update that
+        # changes nothing isn't journaled at all.
+        set qtable [SqlQuote $table]
+        set ocols  [lmap col $cols {string cat old. $col}]
+        set diffs  [lmap col $cols {string cat "old.$col IS NOT new.$col"}]
+
+        set ins "
+            INSERT INTO snapshot_journal(tbl, op) VALUES($qtable, 'I');
+            INSERT INTO \"$shadow\"(seq, rid)
+            VALUES(last_insert_rowid(), new.rowid);
+        "
+
+        set del "
+            INSERT INTO snapshot_journal(tbl, op) VALUES($qtable, 'D');
+            INSERT INTO \"$shadow\"(seq, rid, [join $cols ,])
+            VALUES(last_insert_rowid(), old.rowid, [join $ocols ,]);
+        "
+
+        set upd "
+            INSERT INTO snapshot_journal(tbl, op) VALUES($qtable, 'U');
+            INSERT INTO \"$shadow\"(seq, rid, [join $cols ,])
+            VALUES(last_insert_rowid(), old.rowid, [join $ocols ,]);
+        "
+
+        # The rows that conflict with the new row, and that REPLACE
+        # would delete.  They're saved before every insert and update,
+        # since a trigger can't tell whether REPLACE is in effect.
+        set conflicts [list "T.rowid = new.rowid"]
+
+        foreach key $keys {
+            lappend conflicts [join [lmap col $key {
+                string cat "T.\"$col\" = new.\"$col\""
+            }] " AND "]
+        }
+
+        set replaced "
+            FROM main.\"$table\" AS T
+            WHERE (([join $conflicts {) OR (}]))
+        "
+
+        set rep "
+            INSERT INTO snapshot_journal(tbl, op)
+            SELECT $qtable, 'R' WHERE EXISTS (SELECT 1 $replaced %OTHER%);
+            INSERT INTO \"$shadow\"(seq, rid, [join $cols ,])
+            SELECT last_insert_rowid(), T.rowid, 
+                   [join [lmap col $cols {string cat T. $col}] ,]
+            $replaced %OTHER%;
+        "
+
+        set insrep [string map {%OTHER% ""} $rep]
+        set updrep [string map {%OTHER% "AND T.rowid != old.rowid"} $rep]
+
+        foreach {name event condition body} [list \
+            replace  "BEFORE INSERT" ""                          $insrep \
+            insert   "AFTER INSERT"  ""                          $ins    \
+            ureplace "BEFORE UPDATE" ""                          $updrep \
+            update   "AFTER UPDATE"  "WHEN old.rowid = new.rowid 
+                                      AND ([join $diffs { OR }])" $upd   \
+            rekey    "AFTER UPDATE"  "WHEN old.rowid != new.rowid" \
+                                                           "$del $ins"   \
+            delete   "BEFORE DELETE" ""                          $del    \
+        ] {
+            set trigger "${shadow}_$name"
+
+            $rdb eval "
+                CREATE TEMPORARY TRIGGER \"$trigger\"
+                $event ON main.\"$table\"
+                $condition
+                BEGIN
+                    $body
+                END;
+            "
+
+            lappend triggers $trigger
+        }
+
+        # NEXT, the undo statements.  A run contains consecutive
+        # changes of one kind to one table.  For updates, the earliest
+        # change to each row in the run has the values to restore.
+        set range {seq BETWEEN $lo AND $hi}
+
+        set undo($table,I) "
+            DELETE FROM main.\"$table\"
+            WHERE rowid IN (SELECT rid FROM temp.\"$shadow\" WHERE $range)
+        "
+
+        set undo($table,D) "
+            INSERT INTO main.\"$table\"(rowid, [join $cols ,])
+            SELECT rid, [join $cols ,] FROM temp.\"$shadow\"
+            WHERE $range
+            ORDER BY seq DESC
+        "
+
+        # Replaced rows are restored unless they're still there, as
+        # they are when the insert or update didn't replace them.
+        set undo($table,R) "
+            INSERT OR IGNORE INTO main.\"$table\"(rowid, [join $cols ,])
+            SELECT rid, [join $cols ,] FROM temp.\"$shadow\"
+            WHERE $range
+            ORDER BY seq DESC
+        "
+
+        # If the only column is the rowid alias, every update is 
+        # a rekey.  Each column gets its own subquery, as the row
+        # value form "SET (a,b) = (SELECT ...)" needs SQLite 3.15.
+        set undo($table,U) ""
+
+        if {[llength $setcols] > 0} {
+            set sets [lmap col $setcols {
+                string cat "$col = (
+                    SELECT S.$col FROM temp.\"$shadow\" AS S
+                    WHERE S.rid = main.\"$table\".rowid AND S.$range
+                    ORDER BY S.seq LIMIT 1
+                )"
+            }]
+
+            set undo($table,U) "
+                UPDATE main.\"$table\"
+                SET [join $sets ,]
+                WHERE rowid IN (SELECT rid FROM temp.\"$shadow\" WHERE $range)
+            "
+        }
+    }
+
+    # DropJournal
+    #
+    # Drops the journal triggers and shadow tables.
+
+    method DropJournal {} {
+        foreach trigger $triggers {
+            $rdb eval "DROP TRIGGER IF EXISTS temp.\"$trigger\""
+        }
+
+        foreach table [array names shadows] {
+            $rdb eval "DROP TABLE IF EXISTS temp.\"$shadows($table)\""
+        }
+
+        set triggers [list]
+        array unset shadows
+        array unset undo
+    }
+
+    #-------------------------------------------------------------------
+    # Helper Procs
+
+    # SqlQuote text
+    #
+    # text    A string
+    #
+    # Returns the text as an SQL string literal.
+
+    proc SqlQuote {text} {
+        return "'[string map {' ''} $text]'"
+    }
+}
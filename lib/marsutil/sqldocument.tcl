@@ -198,6 +198,17 @@ snit::type ::marsutil::sqldocument {
         -readonly yes \
         -type     snit::boolean
 
+    # -wal flag
+    #
+    # If true, a file database is put in write-ahead log mode, so that
+    # other connections, e.g., an sqlworker(n), can read committed data
+    # while this one has a transaction open.
+
+    option -wal \
+        -default  no \
+        -readonly yes \
+        -type     snit::boolean
+
 
     #-------------------------------------------------------------------
     # Instance variables
@@ -210,15 +221,33 @@ snit::type ::marsutil::sqldocument {
     # registry      - List of registered sqlsection module names,
     #                 in order of registration.
     # monitorLevel  - Number of nested "monitor *" calls
+    # changes       - [$db total_changes] when the changed tables
+    #                 were last cleared.
+    # hooked        - Number of row changes reported by the update
+    #                 hook since info(changes) was set.
 
     variable info -array {
         dbIsOpen       0
         dbFile         {}
         registry       ::marsutil::sqldocument
         monitorLevel   0
-
+        changes        0
+        hooked         0
     }
 
+    # dirty array: tables changed in the current transaction
+    #
+    # The array is cleared when the -autotrans transaction is begun,
+    # or when "uncommitted" finds that no transaction is open; so
+    # with -autotrans off it can include tables changed in an
+    # earlier transaction, which is safe.
+    #
+    # The keys are table names; the values are ignored.  Tables in
+    # the "temp" database aren't included, as other connections can't
+    # see them anyway.
+
+    variable dirty -array { }
+
     # monitors array: monitored tables
     #
     # List of keynames by table name.
@@ -237,6 +266,15 @@ snit::type ::marsutil::sqldocument {
 
     typevariable updates {}
 
+    # readTables list
+    #
+    # The names of the tables read by the query passed to
+    # "uncommitted", as reported to the ReadAuthorizer.  The database
+    # name isn't always reported, so the tables are known by name.
+    # It's a typevariable for the same reason as "updates".
+
+    typevariable readTables {}
+
     #-------------------------------------------------------------------
     # Constructor
     
@@ -310,6 +348,12 @@ snit::type ::marsutil::sqldocument {
         # NEXT, define the DICT collating sequence.
         $db collate DICT [myproc DictCompare]
 
+        # NEXT, track the tables changed in the current transaction,
+        # for "uncommitted".  (The commit and rollback hooks would
+        # replace the result of "$db transaction", so aren't used.)
+        $self ClearChanges
+        $db update_hook [myproc UpdateHook $selfns]
+
         # NEXT, set up various pragmas, IF we are not read-only.
         # If we are read-only we can't change these things, and anyway
         # they should already be set in the DB we're reading.
@@ -325,8 +369,13 @@ snit::type ::marsutil::sqldocument {
                 PRAGMA temp_store=MEMORY;
             }
 
-            # NEXT, if -rollback is off, turn off journaling.
-            if {!$options(-rollback)} {
+            # NEXT, if -wal is on, use a write-ahead log; otherwise,
+            # if -rollback is off, turn off journaling.
+            if {$options(-wal)} {
+                $db eval {
+                    PRAGMA journal_mode=WAL;
+                }
+            } elseif {!$options(-rollback)} {
                 $db eval {
                     PRAGMA journal_mode=OFF;
                 }
@@ -362,7 +411,7 @@ snit::type ::marsutil::sqldocument {
 
         # NEXT, if -autotrans then open the initial transaction.
         if {!$options(-readonly) && $options(-autotrans)} {
-            $db eval {BEGIN IMMEDIATE TRANSACTION;}
+            $self BeginTransaction
         }
     }
 
@@ -437,7 +486,7 @@ snit::type ::marsutil::sqldocument {
         # data to disk from time to time.
 
         if {$options(-autotrans)} {
-            $db eval {BEGIN IMMEDIATE TRANSACTION;}
+            $self BeginTransaction
         }
     }
 
@@ -610,13 +659,68 @@ snit::type ::marsutil::sqldocument {
                     }
                 }
             } finally {
-                $db eval {
-                    BEGIN IMMEDIATE TRANSACTION;
-                }
+                $self BeginTransaction
             }
         }
     }
 
+    # BeginTransaction
+    #
+    # Opens the -autotrans transaction, noting the number of changes
+    # made so far.
+
+    method BeginTransaction {} {
+        $db eval {BEGIN IMMEDIATE TRANSACTION;}
+        $self ClearChanges
+    }
+
+    # ClearChanges
+    #
+    # Forgets the tables changed, as the changes are no longer
+    # uncommitted, and notes the number of changes made so far.
+
+    method ClearChanges {} {
+        array unset dirty
+        set info(changes) [$db total_changes]
+        set info(hooked)  0
+    }
+
+    # InTransaction
+    #
+    # Returns 1 if a transaction is open, and 0 otherwise.  The
+    # Tcl interface has no direct way to ask, so try to begin one;
+    # a deferred transaction takes no locks until it's used.
+
+    method InTransaction {} {
+        if {[catch {$db eval {BEGIN DEFERRED TRANSACTION;}}]} {
+            return 1
+        }
+
+        $db eval {COMMIT TRANSACTION;}
+        return 0
+    }
+
+    # UpdateHook selfns op dbname table rowid
+    #
+    # selfns   - The instance namespace
+    # op       - INSERT, UPDATE, or DELETE
+    # dbname   - The database containing the table: main, temp, etc.
+    # table    - The table changed
+    # rowid    - The rowid of the row changed; ignored.
+    #
+    # The update hook; notes that the table has uncommitted changes.
+
+    proc UpdateHook {selfns op dbname table rowid} {
+        upvar 1 ${selfns}::info info
+        upvar 1 ${selfns}::dirty dirty
+
+        incr info(hooked)
+
+        if {$dbname ne "temp"} {
+            set dirty($table) 1
+        }
+    }
+
     # close
     #
     # Commits all changes and closes the wsdb.  Once this is done,
@@ -632,6 +736,7 @@ snit::type ::marsutil::sqldocument {
 
         set info(dbIsOpen) 0
         set db [myproc NullDatabase]
+        array unset dirty
     }
 
     #-------------------------------------------------------------------
@@ -666,6 +771,96 @@ snit::type ::marsutil::sqldocument {
         return $info(dbIsOpen)
     }
 
+    # uncommitted ?query?
+    #
+    # query    - An SQL query
+    #
+    # Returns 1 if changes have been made in the open transaction,
+    # whether the -autotrans transaction or an explicit one, and so
+    # are not yet visible to other connections, and 0 otherwise.
+    # If the query is given, returns 1 only if it reads a table with
+    # uncommitted changes, or if that can't be determined.
+    #
+    # The changed tables are reported by the update hook, which isn't
+    # called for rows deleted by SQLite's truncate optimization or
+    # ON CONFLICT REPLACE; such changes are counted by total_changes,
+    # and if there are any every table is considered changed.
+
+    method uncommitted {{query ""}} {
+        if {!$info(dbIsOpen) || $options(-readonly)} {
+            return 0
+        }
+
+        # FIRST, are there changes the update hook didn't see?
+        set unseen [expr {
+            [$db total_changes] - $info(changes) > $info(hooked)
+        }]
+
+        if {!$unseen && [array size dirty] == 0} {
+            return 0
+        }
+
+        # NEXT, the changes might have been committed or rolled back
+        # since.
+        if {![$self InTransaction]} {
+            $self ClearChanges
+            return 0
+        }
+
+        if {$unseen || $query eq ""} {
+            return 1
+        }
+
+        # NEXT, get the tables the query reads by compiling it.
+        # Only the first statement is compiled by EXPLAIN, so deny
+        # anything but reading, lest later statements change something.
+        set readTables [list]
+        set oldAuthorizer [$db authorizer]
+        $db authorizer [myproc ReadAuthorizer]
+
+        try {
+            $db eval "EXPLAIN $query"
+        } on error {} {
+            return 1
+        } finally {
+            $db authorizer $oldAuthorizer
+        }
+
+        foreach table $readTables {
+            if {[info exists dirty($table)]} {
+                return 1
+            }
+        }
+
+        return 0
+    }
+
+    # ReadAuthorizer op args
+    #
+    # op        The SQLite operation
+    # args      Related arguments
+    #
+    # Like RdbAuthorizer, but saves the tables read in readTables.
+
+    proc ReadAuthorizer {op args} {
+        switch -exact -- $op {
+            SQLITE_READ {
+                lappend readTables [lindex $args 0]
+                return SQLITE_OK
+            }
+
+            SQLITE_SELECT    -
+            SQLITE_FUNCTION  -
+            SQLITE_RECURSIVE {
+                return SQLITE_OK
+            }
+
+            default {
+                return SQLITE_DENY
+            }
+        }
+    }
+
     # saveas filename
     #
     # filename   A file name
@@ -697,7 +892,7 @@ snit::type ::marsutil::sqldocument {
             $self lock $lockedTables
             
             if {$options(-autotrans)} {
-                $db eval {BEGIN IMMEDIATE TRANSACTION;}
+                $self BeginTransaction
             }
         }
 
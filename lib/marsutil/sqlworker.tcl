@@ -0,0 +1,459 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#   sqlworker.tcl
+#
+# PACKAGE:
+#   marsutil(n) -- Tcl Utilities
+#
+# PROJECT:
+#   Mars Simulation Infrastructure Library
+#
+# AUTHOR:
+#   Will Duquette
+#
+# DESCRIPTION:
+#   marsutil(n) Background SQL Query Service
+#
+#   An sqlworker(n) runs queries against an sqldocument(n)'s database
+#   file in a worker thread with its own read-only SQLite connection,
+#   so that a slow query doesn't freeze the GUI.  The result rows are
+#   returned a page at a time through the event loop, and a query can
+#   be canceled, which interrupts the statement in the worker.
+#
+#   The worker's connection sees only committed data.  The sqlworker
+#   never commits the -rdb's transaction: if the query reads a table
+#   with uncommitted changes, in the -autotrans transaction or any
+#   other, it is run in the main thread, which sees them; queries on
+#   other tables still go to the worker.  The -rdb should be opened
+#   with -wal yes, so that the worker can read while the -autotrans
+#   transaction is open.
+#
+#   If the Thread package is not available, or the -rdb has no file,
+#   queries are also run in the main thread, and the results are
+#   returned in the same way.  A query that fails in the worker before returning
+#   any rows, e.g., because it uses a temporary view or an SQL function
+#   defined in Tcl, is rerun in the main thread.
+#
+#   See also sqlbrowser(n), querybrowser(n), databrowser(n).
+#
+#-----------------------------------------------------------------------
+
+namespace eval ::marsutil:: {
+    namespace export sqlworker
+}
+
+snit::type ::marsutil::sqlworker {
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Counter used to assign query IDs.  IDs are unique across instances,
+    # as the cancellation flags are in the shared "sqlworker" tsv array.
+    typevariable counter 0
+
+    # The code evaluated in each worker thread.  ::sqlworker::Run
+    # runs one query, and sends the results back to the main thread
+    # as "$callback $id page $rows", then "$callback $id done",
+    # "$callback $id error $message", or "$callback $id canceled".
+    # A query is canceled when tsv sqlworker($id) exists; the
+    # progress handler then interrupts the statement.
+
+    typevariable workerScript {
+        package require sqlite3
+
+        namespace eval ::sqlworker {
+            # The file open as ::sqlworker::db, or ""
+            variable dbfile ""
+        }
+
+        proc ::sqlworker::Run {main callback id file sql pagesize} {
+            variable dbfile
+
+            # FIRST, skip queries canceled while they were queued.
+            if {[tsv::exists sqlworker $id]} {
+                tsv::unset sqlworker $id
+                thread::send -async $main [list {*}$callback $id canceled]
+                return
+            }
+
+            # NEXT, run the query, sending each page as it fills.
+            set rows [list]
+            set n 0
+
+            try {
+                if {$file ne $dbfile} {
+                    catch {::sqlworker::db close}
+                    set dbfile ""
+                    sqlite3 ::sqlworker::db $file -readonly 1
+                    ::sqlworker::db collate DICT ::sqlworker::DictCompare
+                    set dbfile $file
+                }
+
+                ::sqlworker::db progress 1000 [list ::sqlworker::Canceled $id]
+
+                ::sqlworker::db eval $sql row {
+                    foreach name $row(*) {
+                        lappend rows $row($name)
+                    }
+
+                    if {[incr n] == $pagesize} {
+                        thread::send -async $main \
+                            [list {*}$callback $id page $rows]
+                        set rows [list]
+                        set n 0
+                    }
+                }
+
+                if {$n > 0} {
+                    thread::send -async $main [list {*}$callback $id page $rows]
+                }
+
+                thread::send -async $main [list {*}$callback $id done]
+            } on error {result} {
+                if {[tsv::exists sqlworker $id]} {
+                    tsv::unset sqlworker $id
+                    thread::send -async $main [list {*}$callback $id canceled]
+                } else {
+                    thread::send -async $main \
+                        [list {*}$callback $id error $result]
+                }
+            } finally {
+                catch {::sqlworker::db progress 0 ""}
+            }
+        }
+
+        # Progress handler: interrupts the query if it's been canceled.
+        proc ::sqlworker::Canceled {id} {
+            tsv::exists sqlworker $id
+        }
+
+        # The DICT collating sequence, as defined by sqldocument(n).
+        proc ::sqlworker::DictCompare {a b} {
+            expr {[string equal $a \
+                   [lindex [lsort -dictionary [list $a $b]] 0]] ? -1 : 1}
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Options
+
+    # -rdb
+    #
+    # The sqldocument(n) to query.
+
+    option -rdb -readonly yes
+
+    # -pagesize
+    #
+    # The maximum number of rows returned at one time.
+
+    option -pagesize -default 500 -type {snit::integer -min 1}
+
+    #-------------------------------------------------------------------
+    # Instance Variables
+
+    # The worker thread ID, or "" if it hasn't been created.
+    variable thread ""
+
+    # Array of query dictionaries, by query ID:
+    #
+    #   command  - The callback command prefix
+    #   sql      - The query
+    #   state    - running | canceled
+    #   worker   - 1 if the query was sent to the worker thread, and 0
+    #              if it runs in the main thread
+    #   pages    - Number of pages returned so far
+    #   after    - The "after" ID of a query waiting to run in the
+    #              main thread, or ""
+
+    variable jobs -array {}
+
+    #-------------------------------------------------------------------
+    # Constructor
+
+    constructor {args} {
+        $self configurelist $args
+
+        require {$options(-rdb) ne ""} "-rdb is required"
+    }
+
+    destructor {
+        foreach id [array names jobs] {
+            $self cancel $id
+        }
+
+        # The worker exits once it finishes its current query, which
+        # has been canceled.
+        if {$thread ne ""} {
+            thread::release $thread
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Private Methods
+
+    # DbFile
+    #
+    # Returns the -rdb's database file, or "" if the worker thread
+    # can't read it.
+
+    method DbFile {} {
+        if {[catch {package require Thread 2.6}] ||
+            ![$options(-rdb) isopen]
+        } {
+            return ""
+        }
+
+        set file [$options(-rdb) dbfile]
+
+        if {$file in {"" ":memory:"}} {
+            return ""
+        }
+
+        return [file normalize $file]
+    }
+
+    # Worker
+    #
+    # Returns the worker thread, creating it if need be.
+
+    method Worker {} {
+        if {$thread eq ""} {
+            set thread [thread::create -preserved]
+            thread::send $thread [list set ::auto_path $::auto_path]
+            thread::send $thread $workerScript
+        }
+
+        return $thread
+    }
+
+    # Receive instance id event ?arg?
+    #
+    # instance   An sqlworker(n)
+    # id         A query ID
+    # event      page | done | error | canceled
+    # arg        The rows, or the error message
+    #
+    # Called by the worker thread, which might outlive the instance.
+
+    typemethod Receive {instance id event args} {
+        if {[llength [info commands $instance]] > 0} {
+            $instance Deliver $id $event {*}$args
+        }
+    }
+
+    # Deliver id event ?arg?
+    #
+    # id         A query ID
+    # event      page | done | error | canceled
+    # arg        The rows, or the error message
+    #
+    # Passes the worker's results to the query's callback.
+
+    method Deliver {id event args} {
+        if {![info exists jobs($id)]} {
+            return
+        }
+
+        set command [dict get $jobs($id) command]
+
+        # FIRST, if the query was canceled, forget it once the
+        # worker is done with it.  If the worker finished before seeing
+        # the cancellation, clear the flag.
+        if {[dict get $jobs($id) state] eq "canceled"} {
+            if {$event ne "page"} {
+                unset jobs($id)
+
+                if {$event ne "canceled"} {
+                    tsv::unset sqlworker $id
+                }
+            }
+
+            return
+        }
+
+        switch -exact -- $event {
+            page {
+                dict incr jobs($id) pages
+                callwith $command $id page [lindex $args 0]
+            }
+
+            done {
+                unset jobs($id)
+                callwith $command $id done
+            }
+
+            error {
+                # The worker lacks the -rdb's temporary schema and
+                # Tcl functions; if that's the problem, the query will
+                # run in the main thread.
+                if {[dict get $jobs($id) pages] == 0} {
+                    dict set jobs($id) worker 0
+                    $self RunInMain $id
+                } else {
+                    unset jobs($id)
+                    callwith $command $id error [lindex $args 0]
+                }
+            }
+
+            canceled {
+                unset jobs($id)
+            }
+        }
+    }
+
+    # RunInMain id
+    #
+    # id     A query ID
+    #
+    # Runs the query using the -rdb, returning the results as the
+    # worker would.
+
+    method RunInMain {id} {
+        dict set jobs($id) after ""
+        set command [dict get $jobs($id) command]
+
+        set rows [list]
+        set n 0
+
+        try {
+            $options(-rdb) eval [dict get $jobs($id) sql] row {
+                foreach name $row(*) {
+                    lappend rows $row($name)
+                }
+
+                if {[incr n] == $options(-pagesize)} {
+                    callwith $command $id page $rows
+                    set rows [list]
+                    set n 0
+
+                    # The callback might have canceled the query.
+                    if {[dict get $jobs($id) state] eq "canceled"} {
+                        break
+                    }
+                }
+            }
+        } on error {result} {
+            unset jobs($id)
+            callwith $command $id error $result
+            return
+        }
+
+        if {[dict get $jobs($id) state] eq "canceled"} {
+            unset jobs($id)
+            return
+        }
+
+        if {$n > 0} {
+            callwith $command $id page $rows
+        }
+
+        unset jobs($id)
+        callwith $command $id done
+    }
+
+    #-------------------------------------------------------------------
+    # Public Methods
+
+    # query sql command
+    #
+    # sql       An SQL query
+    # command   A command prefix
+    #
+    # Runs the query in the background, and returns its ID.  The
+    # command is called with the ID and additional arguments, back in
+    # the event loop:
+    #
+    #   page rows     - The next page of rows, as a flat list of values,
+    #                   as from "$db eval $sql".  There may be any number
+    #                   of pages, including none.
+    #   done          - The query has completed.
+    #   error message - The query failed.
+    #
+    # Nothing more is returned once the query is canceled.
+
+    method query {sql command} {
+        set id [incr counter]
+
+        set jobs($id) [dict create \
+                           command $command \
+                           sql     $sql     \
+                           state   running  \
+                           worker  0        \
+                           pages   0        \
+                           after   ""]
+
+        set file [$self DbFile]
+
+        # NEXT, the worker can't see uncommitted changes to the
+        # tables the query reads, and committing them would end the
+        # caller's transaction.
+        if {$file eq "" || [$options(-rdb) uncommitted $sql]} {
+            dict set jobs($id) after [after 0 [mymethod RunInMain $id]]
+            return $id
+        }
+
+        dict set jobs($id) worker 1
+
+        thread::send -async [$self Worker] [list ::sqlworker::Run \
+            [thread::id] [list $type Receive $self] $id $file $sql \
+            $options(-pagesize)]
+
+        return $id
+    }
+
+    # cancel id
+    #
+    # id     A query ID
+    #
+    # Cancels the query, if it hasn't completed: the callback will
+    # not be called again, and if the worker is running the query it
+    # is interrupted.
+
+    method cancel {id} {
+        if {![info exists jobs($id)] ||
+            [dict get $jobs($id) state] eq "canceled"
+        } {
+            return
+        }
+
+        set afterId [dict get $jobs($id) after]
+
+        if {$afterId ne ""} {
+            after cancel $afterId
+            unset jobs($id)
+            return
+        }
+
+        dict set jobs($id) state canceled
+
+        if {[dict get $jobs($id) worker]} {
+            tsv::set sqlworker $id 1
+        }
+    }
+
+    # async
+    #
+    # Returns 1 if queries can run in the worker thread, and 0 if
+    # they will always run in the main thread.
+
+    method async {} {
+        expr {[$self DbFile] ne ""}
+    }
+
+    # pending
+    #
+    # Returns the IDs of the queries that have neither completed nor
+    # been canceled.
+
+    method pending {} {
+        set result [list]
+
+        foreach id [lsort -integer [array names jobs]] {
+            if {[dict get $jobs($id) state] ne "canceled"} {
+                lappend result $id
+            }
+        }
+
+        return $result
+    }
+}
@@ -66,6 +66,8 @@ snit::type ::marsutil::tabletext {
     # rooterr      Prefix for error messages.
     # row          The ROWID of the new record.
     # seen-$table  1 if we've parsed $table, and 0 otherwise.
+    # keys-$table  When loading in bulk, a dictionary whose keys are 
+    #              the key values of the records loaded into $table.
 
     variable info
 
@@ -459,8 +461,17 @@ snit::type ::marsutil::tabletext {
             set info(rooterr) "Error in $filename, "
         }
 
-        # NEXT, Evaluate the input text in the "table" interpreter.
-        $interp(table) eval $text
+        # NEXT, if the input text is plain data, load it directly.
+        # Otherwise, evaluate it in the "table" interpreter.
+        if {[$self Tokenize $text tables]} {
+            $db transaction {
+                foreach {table records} $tables {
+                    $self LoadTable $table $records
+                }
+            }
+        } else {
+            $interp(table) eval $text
+        }
 
         # NEXT, call the validators for all unseen tables
         foreach table $schema(tables) {
@@ -470,6 +481,437 @@ snit::type ::marsutil::tabletext {
         }
     }
 
+    # Tokenize text tablesVar
+    #
+    # text       Table data text to parse
+    # tablesVar  Name of a variable to receive the tokenized tables
+    #
+    # Most input files are plain data: "table", "record", and "field"
+    # commands with literal arguments.  Such files can be loaded
+    # without evaluating them, which is much faster for large inputs.
+    # If the text is plain data, this method returns 1 and sets
+    # tablesVar to a flat list of table names and record lists; each
+    # record list is a flat list of key lists and field name/value
+    # lists.  Otherwise, e.g., if the text uses variables or commands,
+    # or has syntax errors, it returns 0, and the text must be
+    # evaluated.
+
+    method Tokenize {text tablesVar} {
+        upvar 1 $tablesVar tables
+        set tables [list]
+
+        try {
+            foreach tcmd [::marsutil::tabletextparse $text] {
+                if {[lindex $tcmd 0] ne "table" || [llength $tcmd] != 3} {
+                    return 0
+                }
+
+                set records [list]
+
+                foreach rcmd [::marsutil::tabletextparse [lindex $tcmd 2]] {
+                    if {[lindex $rcmd 0] ne "record" || [llength $rcmd] < 2} {
+                        return 0
+                    }
+
+                    set fields [list]
+
+                    foreach fcmd [::marsutil::tabletextparse [lindex $rcmd end]] {
+                        if {[lindex $fcmd 0] ne "field" || 
+                            [llength $fcmd] != 3
+                        } {
+                            return 0
+                        }
+
+                        lappend fields [lindex $fcmd 1] [lindex $fcmd 2]
+                    }
+
+                    lappend records [lrange $rcmd 1 end-1] $fields
+                }
+
+                lappend tables [lindex $tcmd 1] $records
+            }
+        } trap {TABLETEXT TCL} {} {
+            return 0
+        }
+
+        return 1
+    }
+
+    # LoadTable table records
+    #
+    # table     The table name
+    # records   The table's records, as returned by Tokenize
+    #
+    # Loads a table's records as ParseTable does, but in bulk: the
+    # records are inserted first, one INSERT per record, and then
+    # the field validators, the -unique and -required checks, and the
+    # record validators are applied to the table as a whole.  Each
+    # distinct field value is validated once.  If there are errors,
+    # the one for the earliest record is thrown, with the same message
+    # ParseTable would have given.
+
+    method LoadTable {table records} {
+        # FIRST, check the table as ParseTable does.
+        set db   $info(db)
+        set root "$info(rooterr)table $table"
+
+        require {[lsearch -exact $schema(tables) $table] != -1} \
+            "$root, invalid table name: \"$table\""
+
+        foreach t $schema(dependson-$table) {
+            require {$info(seen-$t)} \
+                "$root, table $t must be defined first but wasn't"
+        }
+
+        set info(table) $table
+
+        if {![info exists info(keys-$table)]} {
+            set info(keys-$table) [dict create]
+        }
+
+        # NEXT, get the values every record starts with: the defaults,
+        # and a blank first field for tables without keys.
+        set keyFields $schema(keys-$table)
+        set defaults  [dict create]
+
+        if {[llength $keyFields] == 0} {
+            dict set defaults [lindex $schema(fields-$table) 0] ""
+        }
+
+        foreach field $schema(fields-$table) {
+            if {[info exists schema(default-$table-$field)]} {
+                dict set defaults $field $schema(default-$table-$field)
+            }
+        }
+
+        # NEXT, insert the records.  For each new row, order($row) is
+        # its index in the input, reckeys($row) its key list, and
+        # gave($row) the names of the fields given for it.  keyvals($key)
+        # and given($field) are dictionaries of the key and field values
+        # given in the input, and the rows they were given for.  
+        # Records with malformed keys or fields are flagged and not
+        # inserted.
+        set rows  [list]
+        set index -1
+        array set errors {}
+
+        foreach key $keyFields {
+            set isKey($key) 1
+        }
+
+        foreach {keylist fields} $records {
+            incr index
+
+            if {[llength $keylist] % 2 != 0} {
+                FlagError errors $index \
+                    "missing key name or value in \"$keylist\""
+                continue
+            }
+
+            set values    $defaults
+            set key       [list]
+            set malformed 0
+
+            foreach {name value} $keylist {
+                if {![info exists isKey($name)]} {
+                    set malformed 1
+                }
+
+                dict set values $name $value
+            }
+
+            if {![Complete $keylist $keyFields]} {
+                set malformed 1
+            }
+
+            if {!$malformed && [llength $keyFields] > 0} {
+                foreach name $keyFields {
+                    lappend key [dict get $values $name]
+                }
+
+                set malformed [dict exists $info(keys-$table) $key]
+            }
+
+            foreach {name value} $fields {
+                if {![info exists schema(fv-$table-$name)]} {
+                    set malformed 1
+                }
+            }
+
+            if {$malformed} {
+                FlagError errors $index \
+                    [$self RecordError $root $keylist $fields]
+                continue
+            }
+
+            if {[llength $keyFields] > 0} {
+                dict set info(keys-$table) $key 1
+            }
+
+            # Insert the record, reusing the statement for records
+            # that set the same columns.
+            set values [dict merge $values $fields]
+            set cols   [dict keys $values]
+
+            if {![info exists sql($cols)]} {
+                set binds [list]
+
+                for {set i 0} {$i < [llength $cols]} {incr i} {
+                    lappend binds "\$v($i)"
+                }
+
+                set sql($cols) "
+                    INSERT INTO ${table}([join $cols ,])
+                    VALUES([join $binds ,]);
+                    SELECT last_insert_rowid();
+                "
+            }
+
+            set i 0
+            foreach value [dict values $values] {
+                set v($i) $value
+                incr i
+            }
+
+            set row [$db eval $sql($cols)]
+            set order($row) $index
+            set reckeys($row) $keylist
+            set gave($row) [dict keys $fields]
+            lappend rows $row
+
+            foreach {name value} $keylist {
+                dict lappend keyvals($name) $value $row
+            }
+
+            dict for {name value} $fields {
+                dict lappend given($name) $value $row
+            }
+        }
+
+        # NEXT, validate the key values.  As in ParseRecord, they are
+        # checked but not canonicalized.
+        foreach key $keyFields {
+            set validator $schema(fv-$table-$key)
+
+            if {$validator eq "" || ![info exists keyvals($key)]} {
+                continue
+            }
+
+            dict for {value vrows} $keyvals($key) {
+                if {[catch {callwith $validator $db $table $value} result]} {
+                    set row [lindex $vrows 0]
+                    FlagError errors $order($row) \
+                        "$root, record $reckeys($row), $result"
+                }
+            }
+        }
+
+        # NEXT, validate and canonicalize the field values, and check
+        # the -unique and -required fields.
+        foreach field $schema(fields-$table) {
+            set validator $schema(fv-$table-$field)
+
+            if {$validator ne "" && [info exists given($field)]} {
+                dict for {value vrows} $given($field) {
+                    if {[catch {
+                        callwith $validator $db $table $value
+                    } result]} {
+                        set row [lindex $vrows 0]
+                        FlagError errors $order($row) \
+                            "$root, record $reckeys($row), field $field, $result"
+                    } elseif {$result ne $value} {
+                        $db eval "
+                            UPDATE $table SET $field=\$result
+                            WHERE rowid IN ([join $vrows ,])
+                        "
+                    }
+                }
+            }
+
+            if {$schema(unique-$table-$field) && [info exists given($field)]} {
+                # For each duplicated value, the first row after the
+                # earliest that was given the value is in error.  Rows
+                # loaded by an earlier table block come first.
+                set dups [dict create]
+
+                $db eval "
+                    SELECT rowid AS row, $field AS value FROM $table
+                    WHERE $field IN (
+                        SELECT $field FROM $table 
+                        GROUP BY $field HAVING count(*) > 1
+                    )
+                " {
+                    if {[info exists order($row)]} {
+                        dict lappend dups $value [list $order($row) $row]
+                    } else {
+                        dict lappend dups $value [list -1 $row]
+                    }
+                }
+
+                dict for {value items} $dups {
+                    set items [lsort -integer -index 0 $items]
+
+                    foreach item [lrange $items 1 end] {
+                        lassign $item index row
+
+                        if {$index >= 0 && $field in $gave($row)} {
+                            FlagError errors $index "$root, record\
+                                $reckeys($row), field $field, $field value\
+                                is not unique: \"$value\""
+                            break
+                        }
+                    }
+                }
+            }
+
+            if {$schema(required-$table-$field)} {
+                $db eval "
+                    SELECT rowid AS row FROM $table
+                    WHERE $field IS NULL OR $field = ''
+                " {
+                    if {[info exists order($row)]} {
+                        FlagError errors $order($row) \
+                            "$root, record $reckeys($row), missing field: $field"
+                    }
+                }
+            }
+        }
+
+        # NEXT, call the record validator on each record, in order,
+        # up to the first record with an error.
+        set first [lindex [lsort -integer [array names errors]] 0]
+
+        if {$first eq ""} {
+            set first [expr {$index + 1}]
+        }
+
+        if {$schema(rv-$table) ne ""} {
+            foreach row $rows {
+                if {$order($row) >= $first} {
+                    break
+                }
+
+                if {[catch {
+                    callwith $schema(rv-$table) $db $table $row
+                } result]} {
+                    FlagError errors $order($row) \
+                        "$root, record $reckeys($row), $result"
+                    set first $order($row)
+                    break
+                }
+            }
+        }
+
+        if {[info exists errors($first)]} {
+            error $errors($first)
+        }
+
+        # NEXT, validate the table as a whole.
+        $self ValidateTable $table
+
+        # NEXT, mark the table parsed.
+        set info(seen-$table) 1
+    }
+
+    # RecordError root keylist fields
+    #
+    # root      The error root for the table
+    # keylist   A record's key list
+    # fields    The record's field names and values
+    #
+    # Returns the error ParseRecord would throw for a record that 
+    # LoadTable found malformed.  Like ParseRecord, it checks the keys
+    # in order, then whether they are complete and whether they 
+    # duplicate a previous record's, and then the fields in order.
+
+    method RecordError {root keylist fields} {
+        set table $info(table)
+        set keys  $schema(keys-$table)
+
+        foreach {name value} $keylist {
+            if {$name ni $keys} {
+                return "$root, record $keylist, unknown key field: \"$name\""
+            }
+
+            if {[catch {$self CheckValue $name $value} result]} {
+                return "$root, record $keylist, $result"
+            }
+        }
+
+        if {![Complete $keylist $keys]} {
+            return "incomplete key list"
+        }
+
+        set key [lmap name $keys {dict get $keylist $name}]
+
+        if {[llength $keys] > 0 && [dict exists $info(keys-$table) $key]} {
+            return "$root, record $keylist, keys duplicate previous record"
+        }
+
+        foreach {name value} $fields {
+            if {![info exists schema(fv-$table-$name)]} {
+                return "$root, record $keylist, field $name, invalid field name"
+            }
+
+            if {[catch {$self CheckValue $name $value} result]} {
+                return "$root, record $keylist, field $name, $result"
+            }
+        }
+    }
+
+    # Complete keylist keys
+    #
+    # keylist   A record's key list
+    # keys      The table's key fields
+    #
+    # Returns 1 if the key list gives each key field once, and 0 
+    # otherwise.
+
+    proc Complete {keylist keys} {
+        if {[llength $keylist] != 2*[llength $keys]} {
+            return 0
+        }
+
+        foreach name $keys {
+            if {![dict exists $keylist $name]} {
+                return 0
+            }
+        }
+
+        return 1
+    }
+
+    # CheckValue field value
+    #
+    # field     A field of the current table
+    # value     A value for it
+    #
+    # Calls the field's validator, if any, on the value.
+
+    method CheckValue {field value} {
+        set validator $schema(fv-$info(table)-$field)
+
+        if {$validator ne ""} {
+            callwith $validator $info(db) $info(table) $value
+        }
+    }
+
+    # FlagError errorsVar index message
+    #
+    # errorsVar   An array of error messages by record index
+    # index       The index of a record in the input
+    # message     The error message
+    #
+    # Saves the first error found for the given record.
+
+    proc FlagError {errorsVar index message} {
+        upvar 1 $errorsVar errors
+
+        if {![info exists errors($index)]} {
+            set errors($index) $message
+        }
+    }
+
     # ParseTable table records
     #
     # table     The table name
@@ -776,3 +1218,94 @@ snit::type ::marsutil::tabletext {
 
 
 
+
+#-----------------------------------------------------------------------
+# tabletextparse script
+#
+# script     A tabletext(n) input script
+#
+# Tokenizes a script containing only literal data, returning a list of
+# its commands, each of which is a list of its words.  If the script
+# might contain anything else, throws an error with error code 
+# "TABLETEXT TCL".  This is the Tcl version of the Marsbin command; it
+# is more conservative, refusing any script with a "$", "[", "\", or
+# ";" outside of a comment.
+
+if {[llength [info commands ::marsutil::tabletextparse]] == 0} {
+    proc ::marsutil::tabletextparse {script} {
+        set result  [list]
+        set command ""
+        set plain   1
+
+        foreach line [split $script \n] {
+            # FIRST, skip blank lines and comments between commands.
+            if {$command eq ""} {
+                set trimmed [string trimleft $line]
+
+                if {$trimmed eq ""} {
+                    continue
+                }
+
+                if {[string index $trimmed 0] eq "#"} {
+                    if {[string index $line end] eq "\\"} {
+                        set plain 0
+                        break
+                    }
+
+                    continue
+                }
+            }
+
+            # NEXT, accumulate lines until the command is complete.
+            # Counting braces saves rescanning long commands on every
+            # line.  Outside a braced word, only a brace at the start
+            # of a word opens one; within it, every brace counts.
+            # Quotes can hide braces, so check those with [info complete].
+            if {$command eq ""} {
+                set depth  0
+                set quoted 0
+            }
+
+            append command $line \n
+
+            foreach pair [regexp -all -inline -indices {[\{\}]} $line] {
+                set i [lindex $pair 0]
+
+                if {[string index $line $i] eq "\{"} {
+                    if {$depth > 0 || $i == 0 ||
+                        [string is space [string index $line $i-1]]
+                    } {
+                        incr depth
+                    }
+                } elseif {$depth > 0} {
+                    incr depth -1
+                }
+            }
+
+            if {[string first \" $line] != -1} {
+                set quoted 1
+            }
+
+            if {(!$quoted && $depth > 0) || ![info complete $command]} {
+                continue
+            }
+
+            if {[regexp {[$\[\\;]} $command] ||
+                [catch {lrange $command 0 end} words]
+            } {
+                set plain 0
+                break
+            }
+
+            lappend result $words
+            set command ""
+        }
+
+        if {!$plain || $command ne ""} {
+            return -code error -errorcode {TABLETEXT TCL} \
+                "script is not plain tabletext"
+        }
+
+        return $result
+    }
+}
@@ -18,6 +18,11 @@
 #   commands.  An n-vector is indexed 0..n-1, following
 #   normal mathematical conventions.
 #
+#   When Marsbin is loaded, the numeric subcommands are implemented
+#   by ::marsutil::dvec, which holds vectors as contiguous doubles;
+#   the results are still valid lists.  The Tcl code below is the
+#   fallback.
+#
 #-----------------------------------------------------------------------
 
 #-----------------------------------------------------------------------
@@ -37,9 +42,17 @@ snit::type ::marsutil::vec {
 
     typeconstructor {
         namespace import ::marsutil::*
-        namespace import ::marsutil::*
+
+        set native [llength [info commands ::marsutil::dvec]]
     }
 
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # native: 1 if the Marsbin dvec command is available, and 0 
+    # otherwise.
+    typevariable native 0
+
     #-------------------------------------------------------------------
     # Ensemble subcommands
 
@@ -65,6 +78,10 @@ snit::type ::marsutil::vec {
     #
     # Returns the number of elements in the vector.
     typemethod size {vector} {
+        if {$native} {
+            return [::marsutil::dvec size $vector]
+        }
+
         llength $vector
     }
 
@@ -80,6 +97,11 @@ snit::type ::marsutil::vec {
             return 0
         }
 
+        # Non-numeric vectors use the list code.
+        if {$native && ![catch {::marsutil::dvec equal $vec1 $vec2} result]} {
+            return $result
+        }
+
         for {set i 0} {$i < $n} {incr i} {
             if {[lindex $vec1 $i] != [lindex $vec2 $i]} {
                 return 0
@@ -98,6 +120,12 @@ snit::type ::marsutil::vec {
 
         assert {$n1 == $n2}
 
+        if {$native} {
+            try {
+                return [::marsutil::dvec add $vec1 $vec2]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set result {}
 
         for {set i 0} {$i < $n1} {incr i} {
@@ -119,6 +147,12 @@ snit::type ::marsutil::vec {
 
         assert {$n1 == $n2}
 
+        if {$native} {
+            try {
+                return [::marsutil::dvec sub $vec1 $vec2]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set result {}
 
         for {set i 0} {$i < $n1} {incr i} {
@@ -135,6 +169,12 @@ snit::type ::marsutil::vec {
     # Returns the vector multiplied by a scalar constant.
 
     typemethod scalarmul {vec constant} {
+        if {$native} {
+            try {
+                return [::marsutil::dvec scalarmul $vec $constant]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set n1 [vec size $vec]
 
         set result {}
@@ -156,6 +196,12 @@ snit::type ::marsutil::vec {
     # 0 <= num <= 1 and sum(vector) == 1.0.
 
     typemethod normalize {vec} {
+        if {$native} {
+            try {
+                return [::marsutil::dvec normalize $vec]
+            } trap {DMAT USETCL} {} {}
+        }
+
         set sum [expr [join $vec +]]
         
         if {$sum <= 0} {
@@ -165,6 +211,96 @@ snit::type ::marsutil::vec {
         return [vec scalarmul $vec [expr {1.0/$sum}]]
     }
 
+    # dot vec1 vec2
+    #
+    # Returns the dot product of the two vectors.
+
+    typemethod dot {vec1 vec2} {
+        assert {[vec size $vec1] == [vec size $vec2]}
+
+        if {$native} {
+            try {
+                return [::marsutil::dvec dot $vec1 $vec2]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set sum 0
+
+        foreach v1 $vec1 v2 $vec2 {
+            set sum [expr {$sum + $v1*$v2}]
+        }
+
+        return $sum
+    }
+
+    # sum vector
+    #
+    # Returns the sum of the vector's elements.
+
+    typemethod sum {vector} {
+        if {$native} {
+            try {
+                return [::marsutil::dvec sum $vector]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set sum 0
+
+        foreach value $vector {
+            set sum [expr {$sum + $value}]
+        }
+
+        return $sum
+    }
+
+    # min vector
+    #
+    # Returns the smallest of the vector's elements.
+
+    typemethod min {vector} {
+        assert {[vec size $vector] > 0}
+
+        if {$native} {
+            try {
+                return [::marsutil::dvec min $vector]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set result [lindex $vector 0]
+
+        foreach value $vector {
+            if {$value < $result} {
+                set result $value
+            }
+        }
+
+        return [expr {$result}]
+    }
+
+    # max vector
+    #
+    # Returns the largest of the vector's elements.
+
+    typemethod max {vector} {
+        assert {[vec size $vector] > 0}
+
+        if {$native} {
+            try {
+                return [::marsutil::dvec max $vector]
+            } trap {DMAT USETCL} {} {}
+        }
+
+        set result [lindex $vector 0]
+
+        foreach value $vector {
+            if {$value > $result} {
+                set result $value
+            }
+        }
+
+        return [expr {$result}]
+    }
+
     # numerize vector quality
     #
     # Converts a vector of symbols to a vector of numbers using the
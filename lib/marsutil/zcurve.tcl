@@ -148,6 +148,29 @@ snit::type ::marsutil::zcurve {
         }
     }
 
+    # evalmany curve xs
+    #
+    # curve      A list of parameters {lo a b hi} which define the
+    #            Z curve.
+    # xs         A list of x values
+    #
+    # Computes Z(x) for each x, returning a list of the results.  
+    # Marsbin does this in C; otherwise, each x is evaluated in turn.
+
+    typemethod evalmany {curve xs} {
+        if {[llength [info commands ::marsutil::zcurvemany]] > 0} {
+            return [::marsutil::zcurvemany $curve $epsilon $xs]
+        }
+
+        set result [list]
+
+        foreach x $xs {
+            lappend result [$type eval $curve $x]
+        }
+
+        return $result
+    }
+
     #-------------------------------------------------------------------
     # Instance Options
 
@@ -183,7 +206,8 @@ snit::type ::marsutil::zcurve {
     #-------------------------------------------------------------------
     # Instance Methods
 
-    delegate method eval using {%t eval}
+    delegate method eval     using {%t eval}
+    delegate method evalmany using {%t evalmany}
 
     # validate curve
     #
@@ -111,6 +111,37 @@ snit::type ::simlib::coverage {
 
         return $cf
     }
+
+    # evalmany func personnel populations
+    #
+    # func         A personnel coverage function spec, {c d}
+    # personnel    A list of personnel counts
+    # populations  A list of civilian populations, one for each count
+    #
+    # Computes the personnel coverage for each pair of inputs, 
+    # returning a list of the results.  Marsbin does this in C; 
+    # otherwise, each pair is evaluated in turn.
+
+    typemethod evalmany {func personnel populations} {
+        if {[llength [info commands ::marsutil::coveragemany]] > 0} {
+            return [::marsutil::coveragemany $func $personnel $populations]
+        }
+
+        set n [llength $personnel]
+        set m [llength $populations]
+
+        if {$n != $m} {
+            error "got $n personnel counts for $m populations"
+        }
+
+        set result [list]
+
+        foreach p $personnel pop $populations {
+            lappend result [$type eval $func $p $pop]
+        }
+
+        return $result
+    }
 }
 
 
@@ -216,6 +216,36 @@ snit::type ::simlib::rmf {
 
         return [expr {$root*$root}]
     }
+
+    # evalmany name Rs ?Rnom?
+    #
+    # name   - An RMF name
+    # Rs     - A list of relationship values
+    # Rnom   - Nominal relationship
+    #
+    # Evaluates the named RMF for each R, returning a list of the 
+    # multipliers.  Marsbin does this in C; otherwise, each R is 
+    # evaluated in turn.
+
+    typemethod evalmany {name Rs {Rnom ""}} {
+        set name [$enum validate $name]
+
+        if {$Rnom eq ""} {
+            set Rnom [$parm get rmf.nominalRelationship]
+        }
+
+        if {[llength [info commands ::marsutil::rmfmany]] > 0} {
+            return [::marsutil::rmfmany $name $Rnom $Rs]
+        }
+
+        set result [list]
+
+        foreach R $Rs {
+            lappend result [$type $name $R $Rnom]
+        }
+
+        return $result
+    }
 }
 
 
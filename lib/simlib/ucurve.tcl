@@ -437,6 +437,53 @@ snit::type ::simlib::ucurve {
         return $ids
     }
 
+    # curve addfrom query
+    #
+    # query    - An SQL SELECT query on the -rdb, returning columns
+    #            seq, ctype, a, b, c
+    #
+    # Defines one curve for each row returned by the query, in bulk.
+    # The ctype column is a curve type name; seq is a positive integer,
+    # unique across the rows.  The new curves are assigned the IDs
+    # base+seq, where base is the largest curve ID defined before the
+    # call; returns base.  As with [curve add], the values are presumed
+    # to be numeric in the correct range.
+
+    method {curve addfrom} {query} {
+        set base [$rdb onecolumn {
+            SELECT coalesce(max(curve_id), 0) FROM ucurve_curves_t
+        }]
+
+        # NEXT, use a transaction so that nothing changes on error.
+        # A row with an unknown ctype gets a NULL ct_id, which is
+        # rejected below.
+        $rdb transaction {
+            $rdb eval "
+                INSERT INTO ucurve_curves_t(curve_id, ct_id, a, b, c,
+                                            a0, b0, c0)
+                SELECT \$base + Q.seq, T.ct_id, Q.a, Q.b, Q.c,
+                       Q.a, Q.b, Q.c
+                FROM ($query) AS Q
+                LEFT OUTER JOIN ucurve_ctypes_t AS T ON (T.name = Q.ctype)
+            "
+
+            set bad [$rdb onecolumn {
+                SELECT curve_id FROM ucurve_curves_t
+                WHERE curve_id > $base AND ct_id IS NULL
+                LIMIT 1
+            }]
+
+            if {$bad ne ""} {
+                error "Unknown curve type in curve $bad"
+            }
+        }
+
+        # NEXT, save the undo information
+        $us add [list $self UndoCurveAdd [expr {$base + 1}]]
+
+        return $base
+    }
+
     # UndoCurveAdd id
     #
     # id   - A curve ID
@@ -262,6 +262,15 @@ snit::type ::simlib::uram {
         -default  uram \
         -readonly 1
 
+    # -profiler cmd
+    #
+    # The name of a profiler(n) object.  If given, the methods of
+    # this instance and of its ucurve(n) component are profiled as 
+    # modules "uram" and "ucurve".
+
+    option -profiler \
+        -readonly 1
+
     # -rdb cmd
     #
     # The name of the sqldocument(n) instance in which
@@ -279,6 +288,16 @@ snit::type ::simlib::uram {
     option -parmset \
         -readonly 1
 
+    # -idcache size
+    #
+    # The maximum number of entries in each of the ID lookup caches;
+    # see <idCache>.  Defaults to 1000.
+
+    option -idcache \
+        -type     {snit::integer -min 1} \
+        -default  1000                   \
+        -readonly 1
+
     #-------------------------------------------------------------------
     # Components
     #
@@ -324,14 +343,9 @@ snit::type ::simlib::uram {
     #   ssCache     - Satisfaction spread cache: a dictionary
     #                 {$g,$s,$p,$q -> spread}, where spread is a dict
     #                 {$g_id -> $factor}.
-    #   scid        - Sat curve_id dict: g_id -> c_id -> curve_id
-    #   causeIDs    - Dictionary: cause -> cause_id
-    #   groupIDs    - Dictionary: g -> g_id
-    #   concernIDs  - Dictionary: c -> c_id
-    #   hrelIDs     - Dictionary: f -> g -> curve_id
-    #   vrelIDs     - Dictionary: g -> a -> curve_id
-    #   satIDs      - Dictionary: g -> c -> curve_id
-    #   coopIDs     - Dictionary: f -> g -> curve_id
+    #
+    # The mappings from names to IDs are not checkpointed; they are
+    # looked up in the RDB as needed.  See <idCache>.
     #
     #-----------------------------------------------------------------------
     
@@ -350,16 +364,88 @@ snit::type ::simlib::uram {
         time             ""
         nextDriver       ""
         ssCache          {}
-        scid             {}
-        causeIDs         {}
-        groupIDs         {}
-        concernIDs       {}
-        hrelIDs          {}
-        vrelIDs          {}
-        satIDs           {}
-        coopIDs          {}
     }
 
+    # idQueries
+    #
+    # Array, SQL queries for the ID lookups done by <GetID>, by kind.
+    # Each query retrieves the ID given the keys $k1 and $k2.  
+    # Lookups of curve IDs have a second query, idQueries($kind,k1),
+    # used to determine which key is unknown when the lookup fails.
+
+    typevariable idQueries -array {
+        cause {
+            SELECT cause_id FROM uram_cause WHERE cause=$k1
+        }
+        group {
+            SELECT g_id FROM uram_g WHERE g=$k1
+        }
+        concern {
+            SELECT c_id FROM uram_c WHERE c=$k1
+        }
+        hrel {
+            SELECT R.curve_id
+            FROM uram_hrel_t AS R
+            JOIN uram_g      AS F ON (F.g_id = R.f_id)
+            JOIN uram_g      AS G ON (G.g_id = R.g_id)
+            WHERE F.g=$k1 AND G.g=$k2
+        }
+        hrel,k1 {
+            SELECT 1 FROM uram_hrel_t AS R
+            JOIN uram_g AS F ON (F.g_id = R.f_id)
+            WHERE F.g=$k1
+        }
+        vrel {
+            SELECT R.curve_id
+            FROM uram_vrel_t AS R
+            JOIN uram_g      AS G ON (G.g_id = R.g_id)
+            JOIN uram_a      AS A ON (A.a_id = R.a_id)
+            WHERE G.g=$k1 AND A.a=$k2
+        }
+        vrel,k1 {
+            SELECT 1 FROM uram_vrel_t AS R
+            JOIN uram_g AS G ON (G.g_id = R.g_id)
+            WHERE G.g=$k1
+        }
+        sat {
+            SELECT R.curve_id
+            FROM uram_sat_t AS R
+            JOIN uram_g     AS G ON (G.g_id = R.g_id)
+            JOIN uram_c     AS C ON (C.c_id = R.c_id)
+            WHERE G.g=$k1 AND C.c=$k2
+        }
+        sat,k1 {
+            SELECT 1 FROM uram_sat_t AS R
+            JOIN uram_g AS G ON (G.g_id = R.g_id)
+            WHERE G.g=$k1
+        }
+        coop {
+            SELECT R.curve_id
+            FROM uram_coop_t AS R
+            JOIN uram_g      AS F ON (F.g_id = R.f_id)
+            JOIN uram_g      AS G ON (G.g_id = R.g_id)
+            WHERE F.g=$k1 AND G.g=$k2
+        }
+        coop,k1 {
+            SELECT 1 FROM uram_coop_t AS R
+            JOIN uram_g AS F ON (F.g_id = R.f_id)
+            WHERE F.g=$k1
+        }
+    }
+
+    # idCache
+    #
+    # Array, LRU caches of ID lookups by kind, as for <idQueries>.  
+    # Each cache is a dictionary {$k1 $k2} -> id, ordered from least to
+    # most recently used, of at most -idcache entries.  In addition,
+    # idCache(scid) is a dictionary c_id -> g_id -> curve_id, for the 
+    # satisfaction spread.
+    #
+    # The caches are cleared whenever the RDB's contents might have
+    # changed out from under them, i.e., on load, clear, and restore.
+
+    variable idCache -array { }
+
     # info
     #
     # Array, non-checkpointed scalar data.  The keys are as follows.
@@ -375,12 +461,9 @@ snit::type ::simlib::uram {
     # Transient data, used during loading.
     #
     # loadstate   - indicates the progress of the -loadcmd.
-    # fgids       - Dict, f_id,g_id -> fg_id, from uram_hrel_t,
-    #               used to provide consistent fg_ids across tables.
 
     variable trans -array {
         loadstate ""
-        fgids     ""
     }
 
 
@@ -435,9 +518,15 @@ snit::type ::simlib::uram {
             -undostack   $us                         \
             -savehistory [$options(-parmset) get uram.saveHistory]
 
+        # NEXT, attach the profiler, if any.
+        if {$options(-profiler) ne ""} {
+            $options(-profiler) attach uram   $self
+            $options(-profiler) attach ucurve $cm
+        }
 
         # NEXT, initialize db
         array set db $clearedDB
+        $self ClearIDCache
     }
     
     # destructor
@@ -450,6 +539,11 @@ snit::type ::simlib::uram {
         catch {
             unset -nocomplain rdbTracker($rdb)
 
+            if {$options(-profiler) ne ""} {
+                $options(-profiler) detach uram
+                $options(-profiler) detach ucurve
+            }
+
             $self ClearTables
         }
     }
@@ -509,6 +603,7 @@ snit::type ::simlib::uram {
         # FIRST, reset the in-memory data
         array unset db
         array set db $clearedDB
+        $self ClearIDCache
 
         # NEXT, Clear the RDB
         $self ClearTables
@@ -577,6 +672,7 @@ snit::type ::simlib::uram {
         # FIRST, clear all of the tables, so that they can be
         # refilled.
         $self ClearTables
+        $self ClearIDCache
 
         # NEXT, create the curve types in ucurve(n)
         $cm ctype add AUT  -100.0 100.0
@@ -597,15 +693,10 @@ snit::type ::simlib::uram {
             INSERT INTO uram_c(c) VALUES('SFT');
         }
 
-        set db(concernIDs) [$rdb eval {
-            SELECT c, c_id FROM uram_c
-        }]
-
         # NEXT, the client's -loadcmd must call the "load *" methods
         # in a precise sequence.  Set up the state machine to handle
         # it.
         set trans(loadstate) begin
-        set trans(fgids)     [dict create]
 
         # NEXT, call the -loadcmd.  The client will specify the
         # entities and input data, and URAM will populate tables.
@@ -621,7 +712,6 @@ snit::type ::simlib::uram {
         $self ComputeCivRelTable
         $self ComputeFrcRelTable
         $self PopulateNbhoodCoopTable
-        $self PopulateScid
 
         # NEXT, untrack curves for empty groups.
         set empty [$rdb eval {
@@ -670,11 +760,6 @@ snit::type ::simlib::uram {
             }
         }
 
-        # NEXT, save them in a dictionary for quick access.
-        set db(causeIDs) [$rdb eval {
-            SELECT cause, cause_id FROM uram_cause ORDER BY cause_id
-        }]
-
         set trans(loadstate) "causes"
     }
 
@@ -799,88 +884,91 @@ snit::type ::simlib::uram {
             }
         }
 
-        # NEXT, cache all of the group IDs.
-        set db(groupIDs) [$rdb eval {
-            SELECT g, g_id FROM uram_g
-        }]
-
         set trans(loadstate) "otherg"
     }
 
 
     # load hrel f g current base nat ?f g current base nat...?
+    # load hrel -sql query
     #
     # f       - Group name
     # g       - Group name
     # current - Initial current baseline relationship
     # base    - Initial baseline relationship
     # nat     - Initial natural relationship
+    # query   - An SQL query on the -rdb returning rows f, g, current,
+    #           base, nat, in the desired order.
     #
     # Loads horizontal relationships into uram_hrel_t.
 
     method {load hrel} {args} {
         assert {$trans(loadstate) eq "otherg"}
 
-        array set gids [$rdb eval {SELECT g, g_id FROM uram_g}]
-
-        set db(vrelIDs) [dict create]
-
-        foreach {f g current base nat} $args {
-            set f_id $gids($f)
-            set g_id $gids($g)
+        $self StageLoadData 5 $args
 
-            # A=B
-            set curve_id [$cm curve add HREL $current $base $nat]
-
-            $rdb eval {
-                INSERT INTO uram_hrel_t(f_id, g_id, curve_id)
-                VALUES($f_id, $g_id, $curve_id)
-            }
-
-            dict set db(hrelIDs) $f $g $curve_id
-        }
+        $self CheckLoadKeys hrel {
+            SELECT k1 FROM uram_load_t WHERE k1 NOT IN (SELECT g FROM uram_g)
+            UNION
+            SELECT k2 FROM uram_load_t WHERE k2 NOT IN (SELECT g FROM uram_g)
+        } "Unknown group"
 
-        # Get the fg_id mapping
-        set trans(fgids) [$rdb eval {
-            SELECT f_id || ',' || g_id, fg_id FROM uram_hrel_t
+        # A=B
+        set base [$cm curve addfrom {
+            SELECT seq, 'HREL' AS ctype, cur AS a, base AS b, nat AS c
+            FROM uram_load_t
         }]
 
+        $rdb eval {
+            INSERT INTO uram_hrel_t(f_id, g_id, curve_id)
+            SELECT F.g_id, G.g_id, $base + L.seq
+            FROM uram_load_t AS L
+            JOIN uram_g      AS F ON (F.g = L.k1)
+            JOIN uram_g      AS G ON (G.g = L.k2)
+            ORDER BY L.seq
+        }
 
         set trans(loadstate) "hrel"
     }
 
     # load vrel g a current base nat ?g a current base nat...?
+    # load vrel -sql query
     #
     # g        - Group name
     # a        - Actor name
     # current  - Initial current relationship
     # base     - Initial baseline relationship
     # nat      - Initial natural relationship
+    # query    - An SQL query on the -rdb returning rows g, a, current,
+    #            base, nat, in the desired order.
     #
     # Loads vertical relationships into uram_ga.
 
     method {load vrel} {args} {
         assert {$trans(loadstate) eq "hrel"}
 
-        # FIRST, load the data
-        array set gids [$rdb eval {SELECT g, g_id FROM uram_g}]
-        array set aids [$rdb eval {SELECT a, a_id FROM uram_a}]
+        $self StageLoadData 5 $args
 
-        set db(vrelIDs) [dict create]
+        $self CheckLoadKeys vrel {
+            SELECT k1 FROM uram_load_t WHERE k1 NOT IN (SELECT g FROM uram_g)
+        } "Unknown group"
 
-        foreach {g a current base nat} $args {
-            set g_id $gids($g)
-            set a_id $aids($a)
+        $self CheckLoadKeys vrel {
+            SELECT k2 FROM uram_load_t WHERE k2 NOT IN (SELECT a FROM uram_a)
+        } "Unknown actor"
 
-            # A=B
-            set curve_id [$cm curve add VREL $current $base $nat]
-
-            $rdb eval {
-                INSERT INTO uram_vrel_t(g_id, a_id, curve_id)
-                VALUES($g_id, $a_id, $curve_id)
-            }
+        # A=B
+        set base [$cm curve addfrom {
+            SELECT seq, 'VREL' AS ctype, cur AS a, base AS b, nat AS c
+            FROM uram_load_t
+        }]
 
-            dict set db(vrelIDs) $g $a $curve_id
+        $rdb eval {
+            INSERT INTO uram_vrel_t(g_id, a_id, curve_id)
+            SELECT G.g_id, A.a_id, $base + L.seq
+            FROM uram_load_t AS L
+            JOIN uram_g      AS G ON (G.g = L.k1)
+            JOIN uram_a      AS A ON (A.a = L.k2)
+            ORDER BY L.seq
         }
 
         set trans(loadstate) "vrel"
@@ -888,6 +976,7 @@ snit::type ::simlib::uram {
 
 
     # load sat g c current base nat saliency ?g c current base nat saliency ...?
+    # load sat -sql query
     #
     # g        - Group name
     # c        - Concern name
@@ -895,6 +984,8 @@ snit::type ::simlib::uram {
     # base     - Initial baseline level
     # nat      - Initial natural level
     # saliency - Saliency
+    # query    - An SQL query on the -rdb returning rows g, c, current,
+    #            base, nat, saliency, in the desired order.
     #
     # Loads the satisfaction curve data into ucurve(n) and
     # uram_sat_t.
@@ -902,69 +993,142 @@ snit::type ::simlib::uram {
     method {load sat} {args} {
         assert {$trans(loadstate) eq "vrel"}
 
-        array set gids [$rdb eval {SELECT g, g_id FROM uram_g}]
-        array set cids [$rdb eval {SELECT c, c_id FROM uram_c}]
+        $self StageLoadData 6 $args
 
-        set db(satIDs) [dict create]
+        $self CheckLoadKeys sat {
+            SELECT k1 FROM uram_load_t WHERE k1 NOT IN (SELECT g FROM uram_g)
+        } "Unknown group"
 
-        foreach {g c current base nat saliency} $args {
-            set g_id $gids($g)
-            set c_id $cids($c)
+        $self CheckLoadKeys sat {
+            SELECT k2 FROM uram_load_t WHERE k2 NOT IN (SELECT c FROM uram_c)
+        } "Unknown concern"
 
-            # A=B; C will be set explicitly later.
-            set curve_id [$cm curve add $c $current $base $nat]
-
-            $rdb eval {
-                INSERT INTO uram_sat_t(g_id, c_id, curve_id, saliency)
-                VALUES($g_id, $c_id, $curve_id, $saliency);
-            }
+        # A=B; C will be set explicitly later.  The curve type is
+        # the concern.
+        set base [$cm curve addfrom {
+            SELECT seq, k2 AS ctype, cur AS a, base AS b, nat AS c
+            FROM uram_load_t
+        }]
 
-            dict set db(satIDs) $g $c $curve_id
+        $rdb eval {
+            INSERT INTO uram_sat_t(g_id, c_id, curve_id, saliency)
+            SELECT G.g_id, C.c_id, $base + L.seq, L.saliency
+            FROM uram_load_t AS L
+            JOIN uram_g      AS G ON (G.g = L.k1)
+            JOIN uram_c      AS C ON (C.c = L.k2)
+            ORDER BY L.seq
         }
 
         set trans(loadstate) "sat"
     }
 
     # load coop f g current base nat ?f g current base nat...?
+    # load coop -sql query
     #
     # f       - Force group name
     # g       - Civ group name
     # current - Initial current level
     # base    - Initial baseline level
     # nat     - Initial natural level
+    # query   - An SQL query on the -rdb returning rows f, g, current,
+    #           base, nat, in the desired order.
     #
     # Loads cooperation curve data into ucurve(n) and uram_coop_t.  
 
     method {load coop} {args} {
         assert {$trans(loadstate) eq "sat"}
 
-        # FIRST, get the group IDs
-        array set gids [$rdb eval {SELECT g, g_id FROM uram_g}]
-
-        set db(coopIDs) [dict create]
-
-        foreach {f g current base nat} $args {
-            set f_id $gids($f)
-            set g_id $gids($g)
-            set fg_id [dict get $trans(fgids) $f_id,$g_id]
-            
-            # A=B
-            set curve_id [$cm curve add COOP $current $base $nat]
+        $self StageLoadData 5 $args
 
-            # Make sure we get the same fg_id's as in uram_hrel_t.
-            $rdb eval {
-                INSERT INTO uram_coop_t(fg_id, f_id, g_id, curve_id)
-                VALUES($fg_id, $f_id, $g_id, $curve_id)
-            }
+        $self CheckLoadKeys coop {
+            SELECT k1 FROM uram_load_t WHERE k1 NOT IN (SELECT g FROM uram_g)
+            UNION
+            SELECT k2 FROM uram_load_t WHERE k2 NOT IN (SELECT g FROM uram_g)
+        } "Unknown group"
+
+        # Every pair needs a uram_hrel_t row; see the INSERT below.
+        $self CheckLoadKeys coop {
+            SELECT L.k1 || ' ' || L.k2
+            FROM uram_load_t AS L
+            JOIN uram_g      AS F ON (F.g = L.k1)
+            JOIN uram_g      AS G ON (G.g = L.k2)
+            LEFT OUTER JOIN uram_hrel_t AS R
+            ON (R.f_id = F.g_id AND R.g_id = G.g_id)
+            WHERE R.fg_id IS NULL
+        } "No horizontal relationship for"
+
+        # A=B
+        set base [$cm curve addfrom {
+            SELECT seq, 'COOP' AS ctype, cur AS a, base AS b, nat AS c
+            FROM uram_load_t
+        }]
 
-            dict set db(coopIDs) $f $g $curve_id
+        # Make sure we get the same fg_id's as in uram_hrel_t.
+        $rdb eval {
+            INSERT INTO uram_coop_t(fg_id, f_id, g_id, curve_id)
+            SELECT R.fg_id, R.f_id, R.g_id, $base + L.seq
+            FROM uram_load_t AS L
+            JOIN uram_g      AS F ON (F.g = L.k1)
+            JOIN uram_g      AS G ON (G.g = L.k2)
+            JOIN uram_hrel_t AS R ON (R.f_id = F.g_id AND R.g_id = G.g_id)
+            ORDER BY L.seq
         }
 
+        $rdb eval {DELETE FROM uram_load_t}
+
         set trans(loadstate) "coop"
     }
 
+    # StageLoadData ncols arglist
+    #
+    # ncols   - The number of values per row: 5, or 6 for SAT
+    # arglist - The arguments to one of the "load *" curve methods:
+    #           either a flat list of rows, or "-sql query".
+    #
+    # Clears uram_load_t and stages the rows in it, in order, so that 
+    # the curves and uram tables can be populated in bulk.  Given
+    # "-sql query", the rows never leave SQLite.
+
+    method StageLoadData {ncols arglist} {
+        $rdb eval {DELETE FROM uram_load_t}
+
+        set cols [lrange {k1 k2 cur base nat saliency} 0 $ncols-1]
+
+        if {[lindex $arglist 0] eq "-sql"} {
+            require {[llength $arglist] == 2} "Expected \"-sql query\""
+
+            $rdb eval "
+                INSERT INTO uram_load_t([join $cols ,]) 
+                [lindex $arglist 1]
+            "
+        } else {
+            set vals [lmap col $cols { string cat "\$" $col }]
+
+            foreach $cols $arglist {
+                $rdb eval "
+                    INSERT INTO uram_load_t([join $cols ,])
+                    VALUES([join $vals ,])
+                "
+            }
+        }
+    }
+
+    # CheckLoadKeys what query message
+    #
+    # what    - The kind of data being loaded, e.g., "hrel"
+    # query   - A query on uram_load_t returning invalid key values
+    # message - The error message prefix
+    #
+    # Throws an error naming the first invalid key, if any.
+
+    method CheckLoadKeys {what query message} {
+        set bad [$rdb onecolumn $query]
+
+        if {$bad ne ""} {
+            error "load $what: $message: \"$bad\""
+        }
+    }
 
-    
     # SanityCheck
     #
     # Verifies that LoadData has loaded everything we need to run.
@@ -1006,6 +1170,8 @@ snit::type ::simlib::uram {
 
     method ComputeCivRelTable {} {
         $rdb eval {
+            INSERT INTO 
+            uram_civrel_t(f_id, g_id, fg_id, hrel_id, proximity)
             SELECT F.g_id                        AS f_id,
                    G.g_id                        AS g_id,
                    HREL.fg_id                    AS fg_id,
@@ -1018,12 +1184,6 @@ snit::type ::simlib::uram {
             JOIN uram_civ_g  AS G    ON (G.n_id = MN.n_id)
             JOIN uram_hrel_t AS HREL 
                  ON (HREL.f_id = F.g_id AND HREL.g_id = G.g_id);
-        } {
-            $rdb eval {
-                INSERT INTO 
-                uram_civrel_t(fg_id, f_id, g_id, hrel_id, proximity)
-                VALUES($fg_id, $f_id, $g_id, $hrel_id, $proximity);
-            }
         }
     }
 
@@ -1034,6 +1194,8 @@ snit::type ::simlib::uram {
 
     method ComputeFrcRelTable {} {
         $rdb eval {
+            INSERT INTO 
+            uram_frcrel_t(fg_id, hrel_id, f_id, g_id)
             SELECT R.fg_id      AS fg_id,
                    R.curve_id   AS hrel_id,
                    F.g_id       AS f_id,
@@ -1042,12 +1204,6 @@ snit::type ::simlib::uram {
             JOIN uram_g      AS F ON (F.g_id = R.f_id)
             JOIN uram_g      AS G ON (G.g_id = R.g_id)
             WHERE F.gtype = 'FRC' AND G.gtype = 'FRC'
-        } {
-            $rdb eval {
-                INSERT INTO 
-                uram_frcrel_t(fg_id, f_id, g_id, hrel_id)
-                VALUES($fg_id, $f_id, $g_id, $hrel_id);
-            }
         }
     }
 
@@ -1066,20 +1222,6 @@ snit::type ::simlib::uram {
         }
     }
 
-    # PopulateScid
-    #
-    # Populates the db(scid) dict for quick satisfaction curve lookups
-    
-    method PopulateScid {} {
-        set db(scid) [dict create]
-
-        $rdb eval {
-            SELECT g_id,c_id,curve_id FROM uram_sat_t
-        } {
-            dict set db(scid) $g_id $c_id $curve_id
-        }
-    }
-
     #-------------------------------------------------------------------
     # Update API
     #
@@ -1106,7 +1248,7 @@ snit::type ::simlib::uram {
         set nowUntracked [list]
 
         foreach {g pop} $args {
-            set g_id [dict get $db(groupIDs) $g]
+            set g_id [$self GetID group $g]
 
             set oldPop [$rdb eval {
                 SELECT pop FROM uram_civ_g WHERE g_id=$g_id
@@ -1425,7 +1567,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "Persistent inputs not allowed when t=-1"
 
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(hrelIDs) $f $g]
+        set curve_id [$self GetID hrel $f $g]
         set mag      [umag validate $mag]
 
         if {![$cm istracked $curve_id]} {
@@ -1452,7 +1594,7 @@ snit::type ::simlib::uram {
 
     method {hrel transient} {driver cause f g mag} {
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(hrelIDs) $f $g]
+        set curve_id [$self GetID hrel $f $g]
         set mag      [umag validate $mag]
 
         if {![$cm istracked $curve_id]} {
@@ -1477,7 +1619,7 @@ snit::type ::simlib::uram {
     method {hrel badjust} {driver f g delta} {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
-        set curve_id [dict get $db(hrelIDs) $f $g]
+        set curve_id [$self GetID hrel $f $g]
 
         if {![$cm istracked $curve_id]} {
             return
@@ -1505,7 +1647,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
         # FIRST, validate inputs.
-        set curve_id [dict get $db(hrelIDs) $f $g]
+        set curve_id [$self GetID hrel $f $g]
 
         if {![$cm istracked $curve_id]} {
             return
@@ -1541,7 +1683,7 @@ snit::type ::simlib::uram {
 
         foreach {f g value} $args {
             lappend cmlist \
-                [dict get $db(hrelIDs) $f $g] [qaffinity validate $value]
+                [$self GetID hrel $f $g] [qaffinity validate $value]
         }
 
         # ucurve adds the necessary records to the undo stack
@@ -1570,7 +1712,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "Persistent inputs not allowed when t=-1"
 
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(vrelIDs) $g $a] 
+        set curve_id [$self GetID vrel $g $a] 
         set mag      [umag validate $mag]
 
         if {![$cm istracked $curve_id]} {
@@ -1597,7 +1739,7 @@ snit::type ::simlib::uram {
 
     method {vrel transient} {driver cause g a mag} {
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(vrelIDs) $g $a] 
+        set curve_id [$self GetID vrel $g $a] 
         set mag      [umag validate $mag]
 
         if {![$cm istracked $curve_id]} {
@@ -1622,7 +1764,7 @@ snit::type ::simlib::uram {
     method {vrel badjust} {driver g a delta} {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
-        set curve_id [dict get $db(vrelIDs) $g $a] 
+        set curve_id [$self GetID vrel $g $a] 
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -1649,7 +1791,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
         # FIRST, validate inputs.
-        set curve_id [dict get $db(vrelIDs) $g $a] 
+        set curve_id [$self GetID vrel $g $a] 
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -1684,7 +1826,7 @@ snit::type ::simlib::uram {
 
         foreach {g a value} $args {
             lappend cmlist \
-                [dict get $db(vrelIDs) $g $a] \
+                [$self GetID vrel $g $a] \
                 [qaffinity validate $value]
         }
 
@@ -1723,9 +1865,9 @@ snit::type ::simlib::uram {
 
         # FIRST, validate the normal inputs and retrieve IDs.
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(satIDs) $g $c]
-        set g_id     [dict get $db(groupIDs) $g]
-        set c_id     [dict get $db(concernIDs) $c]
+        set curve_id [$self GetID sat $g $c]
+        set g_id     [$self GetID group $g]
+        set c_id     [$self GetID concern $c]
         set mag      [umag validate $mag]
 
         # NEXT, if the mag is 0.0, ignore it.
@@ -1770,9 +1912,9 @@ snit::type ::simlib::uram {
     method {sat transient} {driver cause g c mag args} {
         # FIRST, validate the normal inputs and retrieve IDs.
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(satIDs) $g $c]
-        set g_id     [dict get $db(groupIDs) $g]
-        set c_id     [dict get $db(concernIDs) $c]
+        set curve_id [$self GetID sat $g $c]
+        set g_id     [$self GetID group $g]
+        set c_id     [$self GetID concern $c]
         set mag      [umag validate $mag]
 
         # NEXT, if the mag is 0.0, ignore it.
@@ -1806,10 +1948,11 @@ snit::type ::simlib::uram {
 
     method SatSpreadEffects {g_id c_id mag s p q} {
         set cmlist [list]
+        set curves [$self GetSatCurves $c_id]
 
         foreach {ig_id factor} [$self SatSpread $g_id $s $p $q] {
             lappend cmlist \
-                [dict get $db(scid) $ig_id $c_id] \
+                [dict get $curves $ig_id] \
                 [expr {$factor*$mag}]
         }
 
@@ -1905,7 +2048,7 @@ snit::type ::simlib::uram {
     method {sat badjust} {driver g c delta} {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
-        set curve_id [dict get $db(satIDs) $g $c]
+        set curve_id [$self GetID sat $g $c]
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -1932,7 +2075,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
         # FIRST, validate inputs.
-        set curve_id [dict get $db(satIDs) $g $c]
+        set curve_id [$self GetID sat $g $c]
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -1968,7 +2111,7 @@ snit::type ::simlib::uram {
 
         foreach {g c value} $args {
             lappend cmlist \
-                [dict get $db(satIDs) $g $c] [qsat validate $value]
+                [$self GetID sat $g $c] [qsat validate $value]
         }
 
         # ucurve adds the necessary records to the undo stack
@@ -2003,10 +2146,10 @@ snit::type ::simlib::uram {
 
         # FIRST, validate the normal inputs and retrieve IDs.
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(coopIDs) $f $g]
+        set curve_id [$self GetID coop $f $g]
         set mag      [umag validate $mag]
-        set f_id     [dict get $db(groupIDs) $f]
-        set g_id     [dict get $db(groupIDs) $g]
+        set f_id     [$self GetID group $f]
+        set g_id     [$self GetID group $g]
 
         # NEXT, if the mag is 0.0, ignore it.
         if {$mag == 0.0} {
@@ -2048,10 +2191,10 @@ snit::type ::simlib::uram {
     method {coop transient} {driver cause f g mag args} {
         # FIRST, validate the normal inputs and retrieve IDs.
         set cause_id [$self GetCauseID $cause $driver]
-        set curve_id [dict get $db(coopIDs) $f $g]
+        set curve_id [$self GetID coop $f $g]
         set mag      [umag validate $mag]
-        set f_id     [dict get $db(groupIDs) $f]
-        set g_id     [dict get $db(groupIDs) $g]
+        set f_id     [$self GetID group $f]
+        set g_id     [$self GetID group $g]
 
         # NEXT, if the mag is 0.0, ignore it.
         if {$mag == 0.0} {
@@ -2148,7 +2291,7 @@ snit::type ::simlib::uram {
     method {coop badjust} {driver f g delta} {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
-        set curve_id [dict get $db(coopIDs) $f $g]
+        set curve_id [$self GetID coop $f $g]
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -2175,7 +2318,7 @@ snit::type ::simlib::uram {
         require {$db(time) >= 0} "baseline adjustments not allowed when t=-1"
 
         # FIRST, validate inputs.
-        set curve_id [dict get $db(coopIDs) $f $g]
+        set curve_id [$self GetID coop $f $g]
         if {![$cm istracked $curve_id]} {
             return
         }
@@ -2210,7 +2353,7 @@ snit::type ::simlib::uram {
 
         foreach {f g value} $args {
             lappend cmlist \
-                [dict get $db(coopIDs) $f $g] [qcooperation validate $value]
+                [$self GetID coop $f $g] [qcooperation validate $value]
         }
 
         # ucurve adds the necessary records to the undo stack
@@ -2233,12 +2376,95 @@ snit::type ::simlib::uram {
         if {$cause eq ""} {
             set cause_id $driver
         } else {
-            set cause_id [dict get $db(causeIDs) $cause]
+            set cause_id [$self GetID cause $cause]
         }
 
         return $cause_id
     }
 
+    # GetID kind k1 ?k2?
+    #
+    # kind  - The kind of ID: cause, group, concern, hrel, vrel, sat,
+    #         or coop.
+    # k1    - The first key, e.g., a group name
+    # k2    - The second key, for curve IDs, e.g., a concern name
+    #
+    # Returns the ID for the given keys, e.g., [GetID sat $g $c] returns
+    # the curve_id of the satisfaction curve for g and c.  The ID is
+    # retrieved from the LRU <idCache> if possible, and from the RDB
+    # otherwise.  It's an error if either key is unknown.
+
+    method GetID {kind k1 {k2 ""}} {
+        set key [list $k1 $k2]
+
+        # FIRST, look in the cache.  On a hit, move the entry to the
+        # most recently used end.
+        if {[dict exists $idCache($kind) $key]} {
+            set id [dict get $idCache($kind) $key]
+            dict unset idCache($kind) $key
+            dict set idCache($kind) $key $id
+            return $id
+        }
+
+        # NEXT, look it up in the RDB.
+        set id [$rdb onecolumn $idQueries($kind)]
+
+        if {$id eq ""} {
+            if {[info exists idQueries($kind,k1)] &&
+                [$rdb exists $idQueries($kind,k1)]
+            } {
+                set bad $k2
+            } else {
+                set bad $k1
+            }
+
+            error "key \"$bad\" not known in dictionary"
+        }
+
+        # NEXT, evict the least recently used entry, if need be, and
+        # cache the new one.
+        if {[dict size $idCache($kind)] >= $options(-idcache)} {
+            dict for {old dummy} $idCache($kind) {
+                dict unset idCache($kind) $old
+                break
+            }
+        }
+
+        dict set idCache($kind) $key $id
+
+        return $id
+    }
+
+    # GetSatCurves c_id
+    #
+    # c_id   - A concern ID
+    #
+    # Returns a dictionary g_id -> curve_id of the satisfaction curves
+    # for concern c_id, for use by the satisfaction spread.  There
+    # are only four concerns, so these are always cached.
+
+    method GetSatCurves {c_id} {
+        if {![dict exists $idCache(scid) $c_id]} {
+            dict set idCache(scid) $c_id [$rdb eval {
+                SELECT g_id, curve_id FROM uram_sat_t WHERE c_id=$c_id
+            }]
+        }
+
+        return [dict get $idCache(scid) $c_id]
+    }
+
+    # ClearIDCache
+    #
+    # Clears the <idCache>.
+
+    method ClearIDCache {} {
+        array unset idCache
+
+        foreach kind {cause group concern hrel vrel sat coop scid} {
+            set idCache($kind) [dict create]
+        }
+    }
+
     # ParseInputOptions optsArray optsList
     #
     # optsArray - An array to receive the options
@@ -2331,7 +2557,7 @@ snit::type ::simlib::uram {
     #    -end      - End tick; default is now.
 
     method {contribs hrel} {f g args} {
-        $self GetCurveContribs [dict get $db(hrelIDs) $f $g] {*}$args
+        $self GetCurveContribs [$self GetID hrel $f $g] {*}$args
     }
 
     # contribs vrel g a ?options...?
@@ -2344,7 +2570,7 @@ snit::type ::simlib::uram {
     #    -end      - End tick; default is now.
 
     method {contribs vrel} {g a args} {
-        $self GetCurveContribs [dict get $db(vrelIDs) $g $a] {*}$args
+        $self GetCurveContribs [$self GetID vrel $g $a] {*}$args
     }
 
     # contribs sat g c ?options...?
@@ -2357,7 +2583,7 @@ snit::type ::simlib::uram {
     #    -end      - End tick; default is now.
 
     method {contribs sat} {g c args} {
-        $self GetCurveContribs [dict get $db(satIDs) $g $c] {*}$args
+        $self GetCurveContribs [$self GetID sat $g $c] {*}$args
     }
 
     # contribs coop f g ?options...?
@@ -2370,7 +2596,7 @@ snit::type ::simlib::uram {
     #    -end      - End tick; default is now.
 
     method {contribs coop} {f g args} {
-        $self GetCurveContribs [dict get $db(coopIDs) $f $g] {*}$args
+        $self GetCurveContribs [$self GetID coop $f $g] {*}$args
     }
 
     # contribs mood g ?options...?
@@ -2692,12 +2918,16 @@ snit::type ::simlib::uram {
     # unchanged.
 
     method {saveable restore} {state {option ""}} {
-        # FIRST, restore the state.
+        # FIRST, restore the state.  Checkpoints from older versions
+        # may contain ID maps; these are rebuilt on demand instead.
         array unset db
         array set db $clearedDB
+        $self ClearIDCache
 
-        if {[llength $state] > 0} {
-            array set db $state
+        dict for {key value} $state {
+            if {[dict exists $clearedDB $key]} {
+                set db($key) $value
+            }
         }
 
         # NEXT, set the changed flag
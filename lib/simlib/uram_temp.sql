@@ -40,3 +40,21 @@ CREATE TEMPORARY TABLE uram_contribs (
 );
 
 
+------------------------------------------------------------------------
+-- Bulk Loading
+
+CREATE TEMPORARY TABLE uram_load_t (
+    -- Staging table for the "load hrel", "load vrel", "load sat", and
+    -- "load coop" methods.  The rows for one method are staged here,
+    -- in order, and then copied to the ucurve(n) and uram tables
+    -- in bulk.
+
+    seq       INTEGER PRIMARY KEY,     -- Row number, from 1
+    k1        TEXT,                    -- First key: f or g
+    k2        TEXT,                    -- Second key: g, a, or c
+    cur       DOUBLE,                  -- Initial current level
+    base      DOUBLE,                  -- Initial baseline level
+    nat       DOUBLE,                  -- Initial natural level
+    saliency  DOUBLE DEFAULT 1.0       -- Saliency (SAT only)
+);
+
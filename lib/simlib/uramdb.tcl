@@ -769,25 +769,45 @@ snit::type ::simlib::uramdb {
             ORDER BY g;
         }]
 
-        $uram load hrel {*}[$db eval {
+        # NEXT, the curves.  These are the bulk of the data.
+        $type LoadCurves $db $uram hrel {
             SELECT f, g, hrel, hrel, hrel FROM uramdb_hrel
             ORDER BY f, g
-        }]
+        }
 
-        $uram load vrel {*}[$db eval {
+        $type LoadCurves $db $uram vrel {
             SELECT g, a, vrel, vrel, vrel FROM uramdb_vrel
             ORDER BY g, a
-        }]
+        }
 
-        $uram load sat {*}[$db eval {
+        $type LoadCurves $db $uram sat {
             SELECT g, c, sat, sat, sat, saliency FROM uramdb_sat
             ORDER BY g, c
-        }]
+        }
 
-        $uram load coop {*}[$db eval {
+        $type LoadCurves $db $uram coop {
             SELECT f, g, coop, coop, coop FROM uramdb_coop
             ORDER BY f, g
-        }]
+        }
+    }
+
+    # LoadCurves db uram what query
+    #
+    # db     An sqldocument(n) with uramdb(5) data
+    # uram   A uram(n)
+    # what   hrel, vrel, sat, or coop
+    # query  The query that retrieves the curve data from db
+    #
+    # Loads the curve data into the uram(n).  If the uram(n) uses db as 
+    # its -rdb, the data is passed to it as an SQL query, so that it 
+    # can be copied in bulk without passing through Tcl.
+
+    typemethod LoadCurves {db uram what query} {
+        if {[$uram cget -rdb] eq $db} {
+            $uram load $what -sql $query
+        } else {
+            $uram load $what {*}[$db eval $query]
+        }
     }
 
     #-------------------------------------------------------------------
@@ -15,6 +15,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/time.h>
 
 #ifndef WIN32
@@ -71,6 +72,35 @@ const double earthRadius   = 6371.0; /* earthDiameter/2.0 */
 #define MODEL_PIXEL_SCALE_TAG 33550
 #define MODEL_TIEPOINT_TAG    33922
 
+/*
+ * logger(n) binary log constants
+ */
+#define LOG_LEVEL_COUNT 7       /* Number of verbosity levels */
+#define LOG_ENTRY_FIXED 24      /* Size of an entry record's fixed fields */
+
+/*
+ * dmat(n) constants
+ */
+#define DMAT_MAT 0              /* A matrix: a list of rows */
+#define DMAT_VEC 1              /* A vector: a flat list */
+#define DMAT_MAXINT 9007199254740992.0 /* 2^53: larger integers aren't
+                                        * exact as doubles */
+
+/*
+ * rmf(n) function indices
+ */
+enum {
+    RMF_CONSTANT, RMF_LINEAR, RMF_QUAD, RMF_FRQUAD, RMF_FRMORE,
+    RMF_ENQUAD, RMF_ENMORE
+};
+
+/* Lets the compiler vectorize the element-wise kernels. */
+#if defined(__GNUC__)
+#define DMAT_RESTRICT __restrict__
+#else
+#define DMAT_RESTRICT
+#endif
+
 /*
  * Structure Definitions
  */
@@ -126,6 +156,45 @@ typedef struct GeotiffInfo {
     GTIF*  gtif;
 } GeotiffInfo;
 
+/* dmat(n) element storage: a reference-counted block of doubles, 
+ * shared among matrix and vector values and their views. */
+
+typedef struct DmatStore {
+    int    refCount;         /* Number of Dmats using this store */
+    int    size;             /* Number of doubles in data */
+    double data[1];          /* The elements */
+} DmatStore;
+
+/* dmat(n) value: a matrix or vector, or a view of one, on a store. 
+ * Element (i,j) is data[offset + i*rstride + j*cstride]; a vector
+ * has one row. */
+
+typedef struct Dmat {
+    DmatStore* store;        /* Element storage */
+    int        kind;         /* DMAT_MAT or DMAT_VEC */
+    int        isint;        /* 1 if all elements are integers */
+    int        exact;        /* 1 if the doubles compute as expr would:
+                              * the elements are all integers or all 
+                              * reals, and no integer exceeds 2^53 */
+    int        literal;      /* 1 if the string rep is the caller's 
+                              * text rather than one generated here */
+    int        rows;         /* Number of rows */
+    int        cols;         /* Number of columns */
+    int        offset;       /* Index of element (0,0) in the store */
+    int        rstride;      /* Distance between rows */
+    int        cstride;      /* Distance between columns */
+} Dmat;
+
+/* An array of doubles, possibly strided, taken from a list or a
+ * dvec value. */
+
+typedef struct DoubleVec {
+    double* data;            /* The first element */
+    int     stride;          /* Distance between elements */
+    int     size;            /* Number of elements */
+    double* buffer;          /* Storage to free, or NULL */
+} DoubleVec;
+
 /*
  * Static Function Prototypes
  */
@@ -165,6 +234,27 @@ static int marsutil_latlongCmd      (ClientData, Tcl_Interp*, int,
 static int marsutil_geotiffCmd     (ClientData, Tcl_Interp*, int,
                                  Tcl_Obj* CONST argv[]);
 
+static int marsutil_logdecodeCmd    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_decimateCmd     (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_dmatCmd         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_zcurvemanyCmd   (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_rmfmanyCmd      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_coveragemanyCmd (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_tabletextparseCmd (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
 /* latlong Subcommands */
 static int latlong_spheroid     (ClientData, Tcl_Interp*, int, 
                                  Tcl_Obj* CONST objv[]);
@@ -188,6 +278,38 @@ static int latlong_area         (ClientData, Tcl_Interp*, int,
 static int geotiff_read         (ClientData, Tcl_Interp*, int,
                                  Tcl_Obj* CONST objv[]);
 
+/* dmat/dvec subcommands */
+static int dmat_rows            (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_cols            (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_equal           (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_add             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_sub             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_scalarmul       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_normalize       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_row             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_col             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_transpose       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_mul             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_dot             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_sum             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_min             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int dmat_max             (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
 /* utility functions */
 
 static LatlongInfo* newLatlongInfo    (void);
@@ -214,6 +336,29 @@ static int    getPoints     (Tcl_Interp*, Tcl_Obj*, int minSize, Points*);
 static int    getLatLong    (Tcl_Interp*, Tcl_Obj*, double*, double*);
 static int    validateLatLong (Tcl_Interp*, double, double);
 
+static unsigned int  getBE16    (const unsigned char*);
+static unsigned long getBE32    (const unsigned char*);
+static Tcl_WideInt   getBE64    (const unsigned char*);
+static Tcl_Obj*      newUtf8Obj (Tcl_Encoding, const unsigned char*, int);
+
+static void     dmatFreeIntRep   (Tcl_Obj*);
+static void     dmatDupIntRep    (Tcl_Obj*, Tcl_Obj*);
+static void     dmatUpdateString (Tcl_Obj*);
+static Dmat*    newDmat          (int kind, int rows, int cols, int isint);
+static Dmat*    newDmatView      (Dmat*, int kind, int rows, int cols, 
+                                  int offset, int rstride, int cstride);
+static Tcl_Obj* newDmatObj       (Dmat*);
+static int      getDmat          (Tcl_Interp*, Tcl_Obj*, int kind, Dmat**);
+static int      getDmatPair      (Tcl_Interp*, Tcl_Obj* CONST objv[], 
+                                  int kind, Dmat**, Dmat**);
+static int      dmatIsFlat       (Dmat*);
+static double   dmatMaxAbs       (Dmat*);
+static int      dmatUseTcl       (Tcl_Interp*);
+static int      dmatElementwise  (Tcl_Interp*, Tcl_Obj* CONST objv[], 
+                                  int kind, char op);
+static int      getDoubleVec     (Tcl_Interp*, Tcl_Obj*, DoubleVec*);
+static void     freeDoubleVec    (DoubleVec*);
+
 /*
  * Static Variables
  */
@@ -240,6 +385,63 @@ static SubcommandVector geotiffTable[] = {
     {NULL}
 };
 
+/* dmat and dvec Dispatch tables */
+
+static SubcommandVector dmatTable[] = {
+    {"add",       dmat_add},
+    {"col",       dmat_col},
+    {"cols",      dmat_cols},
+    {"equal",     dmat_equal},
+    {"max",       dmat_max},
+    {"min",       dmat_min},
+    {"mul",       dmat_mul},
+    {"row",       dmat_row},
+    {"rows",      dmat_rows},
+    {"scalarmul", dmat_scalarmul},
+    {"sub",       dmat_sub},
+    {"sum",       dmat_sum},
+    {"transpose", dmat_transpose},
+    {NULL}
+};
+
+static SubcommandVector dvecTable[] = {
+    {"add",       dmat_add},
+    {"dot",       dmat_dot},
+    {"equal",     dmat_equal},
+    {"max",       dmat_max},
+    {"min",       dmat_min},
+    {"normalize", dmat_normalize},
+    {"scalarmul", dmat_scalarmul},
+    {"size",      dmat_cols},
+    {"sub",       dmat_sub},
+    {"sum",       dmat_sum},
+    {NULL}
+};
+
+/* rmf(n) function names, in RMF_* order */
+
+static CONST char* rmfNames[] = {
+    "constant", "linear", "quad", "frquad", "frmore", "enquad", "enmore",
+    NULL
+};
+
+/* dmat(n) Tcl_Obj type: the string rep is always a valid list (of 
+ * rows, for a matrix), so values convert freely to and from lists. */
+
+static Tcl_ObjType dmatType = {
+    "marsutil::dmat",
+    dmatFreeIntRep,
+    dmatDupIntRep,
+    dmatUpdateString,
+    NULL
+};
+
+/* logger(n) verbosity levels, by level number */
+
+static CONST char* logLevels[] = {
+    "silent", "fatal", "error", "warning", "normal", "detail", "debug"
+};
+
 /* Ellipsoids */
 
 static Ellipsoid ellipsoidTable [] = {
@@ -338,6 +540,30 @@ Marsbin_Init(Tcl_Interp *interp)
                          marsutil_geotiffCmd, newGeotiffInfo(),
                          (Tcl_CmdDeleteProc*)deleteGeotiffInfo);
 
+    Tcl_CreateObjCommand(interp, "::marsutil::logdecode",
+                         marsutil_logdecodeCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::decimate",
+                         marsutil_decimateCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::dmat",
+                         marsutil_dmatCmd, (ClientData)DMAT_MAT, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::dvec",
+                         marsutil_dmatCmd, (ClientData)DMAT_VEC, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::zcurvemany",
+                         marsutil_zcurvemanyCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::rmfmany",
+                         marsutil_rmfmanyCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::coveragemany",
+                         marsutil_coveragemanyCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::tabletextparse",
+                         marsutil_tabletextparseCmd, NULL, NULL);
+
     return TCL_OK;
 }
 
@@ -1715,738 +1941,3169 @@ geotiff_read(ClientData cd, Tcl_Interp *interp,
 }
 
 /*
- * Math and Geometry Functions
+ * logger(n) binary log decoding
  */
 
 /***********************************************************************
  *
  * FUNCTION:
- *	spheredist
+ *	logdecode data comps ?options...?
  *
  * INPUTS:
- *	lat1		A latitude in decimal degrees
- *      lon1            A longitude in decimal degrees
- *	lat2		A latitude in decimal degrees
- *      lon2            A longitude in decimal degrees
+ *	data		A byte array of binary log records, sans header
+ *	comps		A dictionary of component names by component ID
+ *
+ *	Options:
+ *	-base offset	Offset of data within the log file; default 0
+ *	-index		Return index records rather than entries
+ *	-level num	Return only entries at this verbosity level number
+ *			or lower
+ *	-component name	Return only entries logged by this component
+ *	-since ms	Return only entries logged at or after this
+ *			wall-clock time, in milliseconds
  *
  * RETURNS:
- *	The distance between loc 1 and loc 2 in kilometers.
+ *	A list {consumed comps entries}, where consumed is the number of
+ *	bytes of complete records in data, comps is the component
+ *	dictionary updated with any component records in data, and
+ *	entries is the list of matching entries.
  *
  * DESCRIPTION:
- *	Computes the distance between the two points and returns
- *      an answer in kilometers.  The algorithm is equivalent to
- *      that used in CBS.
+ *	Decodes logger(n) binary log records.  Each entry is returned in
+ *	logger(n)'s text form, {timestamp level component message ?zulu?},
+ *	with the message flattened.  With -index, each entry is returned
+ *	as {offset length timestamp level component} instead, where the
+ *	offset and length are those of the record in the file.
+ *
+ *	Trailing bytes that don't make up a complete record are ignored;
+ *	the caller can pass them in again once the record is complete.
+ *
+ *	This function is documented in logger(n).
  */
 
-static double
-spheredist(double lat1, double lon1, double lat2, double lon2)
+static int 
+marsutil_logdecodeCmd(ClientData cd, Tcl_Interp *interp, 
+                      int objc, Tcl_Obj* CONST objv[])
 {
-    /* Earth's diameter in kilometers, per CBS */
-    double diameter = 12742.0;
+    static CONST char* optionNames[] = {
+        "-base", "-index", "-level", "-component", "-since", NULL
+    };
+    enum Options { OPT_BASE, OPT_INDEX, OPT_LEVEL, OPT_COMPONENT, OPT_SINCE };
 
-    /* NEXT, convert points to radians */
-    lat1 *= radians;
-    lon1 *= radians;
-    lat2 *= radians;
-    lon2 *= radians;
+    if (objc < 3) {
+        Tcl_WrongNumArgs(interp, 1, objv, "data comps ?options...?");
+        return TCL_ERROR;
+    }
 
-    /* NEXT, compute the distance. */
-    double sinHalfDlat = sin((lat2 - lat1)/2.0);
-    double sinHalfDlon = sin((lon2 - lon1)/2.0);
+    /* FIRST, get the options. */
+    Tcl_WideInt base     = 0;
+    int         indexFlag = 0;
+    int         maxLevel = LOG_LEVEL_COUNT;
+    char*       compName = NULL;
+    Tcl_WideInt since    = 0;
+    int         sinceFlag = 0;
+    int         i;
 
-    double dist = 
-        diameter * 
-        asin(sqrt(sinHalfDlat*sinHalfDlat +
-                  cos(lat1)*cos(lat2)*sinHalfDlon*sinHalfDlon));
+    for (i = 3; i < objc; i++) {
+        int opt;
 
-    return dist;
+        if (Tcl_GetIndexFromObj(interp, objv[i], optionNames, "option",
+                                0, &opt) != TCL_OK) {
+            return TCL_ERROR;
+        }
+
+        if (opt == OPT_INDEX) {
+            indexFlag = 1;
+            continue;
+        }
+
+        if (i + 1 >= objc) {
+            Tcl_AppendResult(interp, "missing value for ", 
+                             optionNames[opt], NULL);
+            return TCL_ERROR;
+        }
+
+        i++;
+
+        switch (opt) {
+        case OPT_BASE:
+            if (Tcl_GetWideIntFromObj(interp, objv[i], &base) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            break;
+
+        case OPT_LEVEL:
+            if (Tcl_GetIntFromObj(interp, objv[i], &maxLevel) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            break;
+
+        case OPT_COMPONENT:
+            compName = Tcl_GetString(objv[i]);
+            break;
+
+        case OPT_SINCE:
+            if (Tcl_GetWideIntFromObj(interp, objv[i], &since) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            sinceFlag = 1;
+            break;
+        }
+    }
+
+    /* NEXT, get the data and the component dictionary. */
+    int                  len;
+    const unsigned char* data = Tcl_GetByteArrayFromObj(objv[1], &len);
+    Tcl_Obj*             comps = objv[2];
+    int                  size;
+
+    if (Tcl_DictObjSize(interp, comps, &size) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_IsShared(comps)) {
+        comps = Tcl_DuplicateObj(comps);
+    }
+
+    Tcl_IncrRefCount(comps);
+
+    /* NEXT, prepare the per-call caches: the level names, the
+     * name used for unknown components, and the most recently 
+     * formatted timestamp, since consecutive entries are usually
+     * logged in the same second. */
+    Tcl_Encoding utf8      = Tcl_GetEncoding(NULL, "utf-8");
+    Tcl_Obj*     levelObjs[LOG_LEVEL_COUNT];
+    Tcl_Obj*     emptyObj  = Tcl_NewObj();
+    Tcl_Obj*     stampObj  = NULL;
+    Tcl_WideInt  stampSecs = -1;
+    Tcl_Obj*     entries   = Tcl_NewListObj(0, NULL);
+    Tcl_DString  flat;
+    int          code = TCL_OK;
+    int          pos  = 0;
+
+    Tcl_IncrRefCount(emptyObj);
+    Tcl_IncrRefCount(entries);
+    Tcl_DStringInit(&flat);
+
+    for (i = 0; i < LOG_LEVEL_COUNT; i++) {
+        levelObjs[i] = Tcl_NewStringObj(logLevels[i], -1);
+        Tcl_IncrRefCount(levelObjs[i]);
+    }
+
+    /* NEXT, decode the complete records. */
+    while (pos + 4 <= len) {
+        unsigned long        reclen = getBE32(data + pos);
+        const unsigned char* body   = data + pos + 4;
+
+        if (reclen > (unsigned long)(len - pos - 4)) {
+            /* Incomplete record */
+            break;
+        }
+
+        if (reclen < 1) {
+            Tcl_SetResult(interp, "invalid log record", TCL_STATIC);
+            code = TCL_ERROR;
+            break;
+        }
+
+        if (body[0] == 'C') {
+            /* Component record: type, ID, name */
+            if (reclen < 3) {
+                Tcl_SetResult(interp, "invalid log record", TCL_STATIC);
+                code = TCL_ERROR;
+                break;
+            }
+
+            Tcl_DictObjPut(NULL, comps, 
+                           Tcl_NewIntObj(getBE16(body + 1)),
+                           newUtf8Obj(utf8, body + 3, reclen - 3));
+        } else if (body[0] == 'E') {
+            /* Entry record: type, wall-clock ms, sim time, level,
+             * component ID, message length, message, zulu time */
+            if (reclen < LOG_ENTRY_FIXED) {
+                Tcl_SetResult(interp, "invalid log record", TCL_STATIC);
+                code = TCL_ERROR;
+                break;
+            }
+
+            Tcl_WideInt   wall   = getBE64(body + 1);
+            int           level  = body[17];
+            int           compId = getBE16(body + 18);
+            unsigned long msglen = getBE32(body + 20);
+
+            if (msglen > reclen - LOG_ENTRY_FIXED || 
+                level >= LOG_LEVEL_COUNT) {
+                Tcl_SetResult(interp, "invalid log record", TCL_STATIC);
+                code = TCL_ERROR;
+                break;
+            }
+
+            /* Apply the filters */
+            if (level > maxLevel || (sinceFlag && wall < since)) {
+                pos += 4 + reclen;
+                continue;
+            }
+
+            Tcl_Obj* compObj = NULL;
+            Tcl_Obj* idObj   = Tcl_NewIntObj(compId);
+
+            Tcl_IncrRefCount(idObj);
+            Tcl_DictObjGet(NULL, comps, idObj, &compObj);
+            Tcl_DecrRefCount(idObj);
+
+            if (compObj == NULL) {
+                compObj = emptyObj;
+            }
+
+            if (compName != NULL && 
+                strcmp(compName, Tcl_GetString(compObj)) != 0) {
+                pos += 4 + reclen;
+                continue;
+            }
+
+            /* Format the timestamp */
+            if (stampObj == NULL || wall / 1000 != stampSecs) {
+                char      buf[32];
+                time_t    secs = (time_t)(wall / 1000);
+                struct tm tmval;
+
+#ifdef WIN32
+                localtime_s(&tmval, &secs);
+#else
+                localtime_r(&secs, &tmval);
+#endif
+                strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tmval);
+
+                if (stampObj != NULL) {
+                    Tcl_DecrRefCount(stampObj);
+                }
+
+                stampSecs = wall / 1000;
+                stampObj  = Tcl_NewStringObj(buf, -1);
+                Tcl_IncrRefCount(stampObj);
+            }
+
+            Tcl_Obj* entry = Tcl_NewListObj(0, NULL);
+
+            if (indexFlag) {
+                Tcl_ListObjAppendElement(NULL, entry, 
+                                         Tcl_NewWideIntObj(base + pos));
+                Tcl_ListObjAppendElement(NULL, entry, 
+                                         Tcl_NewWideIntObj(4 + reclen));
+                Tcl_ListObjAppendElement(NULL, entry, stampObj);
+                Tcl_ListObjAppendElement(NULL, entry, levelObjs[level]);
+                Tcl_ListObjAppendElement(NULL, entry, compObj);
+            } else {
+                const unsigned char* msg  = body + LOG_ENTRY_FIXED;
+                const unsigned char* zulu = msg + msglen;
+                unsigned long        zlen = reclen - LOG_ENTRY_FIXED - msglen;
+                unsigned long        j;
+
+                /* Flatten the message as logger(n) does: "\" becomes
+                 * "\\" and newline becomes "\n".  Both are ASCII, so
+                 * this can be done on the UTF-8 bytes. */
+                Tcl_DStringSetLength(&flat, 0);
+
+                for (j = 0; j < msglen; j++) {
+                    if (msg[j] == '\\') {
+                        Tcl_DStringAppend(&flat, "\\\\", 2);
+                    } else if (msg[j] == '\n') {
+                        Tcl_DStringAppend(&flat, "\\n", 2);
+                    } else {
+                        Tcl_DStringAppend(&flat, (const char*)msg + j, 1);
+                    }
+                }
+
+                Tcl_ListObjAppendElement(NULL, entry, stampObj);
+                Tcl_ListObjAppendElement(NULL, entry, levelObjs[level]);
+                Tcl_ListObjAppendElement(NULL, entry, compObj);
+
+                Tcl_ListObjAppendElement(NULL, entry, 
+                    newUtf8Obj(utf8,
+                               (const unsigned char*)Tcl_DStringValue(&flat),
+                               Tcl_DStringLength(&flat)));
+
+                if (zlen > 0) {
+                    Tcl_ListObjAppendElement(NULL, entry, 
+                                             newUtf8Obj(utf8, zulu, zlen));
+                }
+            }
+
+            Tcl_ListObjAppendElement(NULL, entries, entry);
+        } else {
+            Tcl_SetResult(interp, "invalid log record", TCL_STATIC);
+            code = TCL_ERROR;
+            break;
+        }
+
+        pos += 4 + reclen;
+    }
+
+    /* NEXT, return the result. */
+    if (code == TCL_OK) {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewIntObj(pos));
+        Tcl_ListObjAppendElement(interp, result, comps);
+        Tcl_ListObjAppendElement(interp, result, entries);
+    }
+
+    /* NEXT, clean up. */
+    for (i = 0; i < LOG_LEVEL_COUNT; i++) {
+        Tcl_DecrRefCount(levelObjs[i]);
+    }
+
+    if (stampObj != NULL) {
+        Tcl_DecrRefCount(stampObj);
+    }
+
+    Tcl_DStringFree(&flat);
+    Tcl_DecrRefCount(emptyObj);
+    Tcl_DecrRefCount(entries);
+    Tcl_DecrRefCount(comps);
+    Tcl_FreeEncoding(utf8);
+
+    return code;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	bbox()
+ *	decimate xylist px0 x0 xppu py0 y0 yppu ?start?
  *
  * INPUTS:
- *	points		A list of Points
- *
- * OUTPUTS
- *      bbox	A bounding box
+ *	xylist		A flat list of X/Y data pairs, in X order
+ *	px0 x0 xppu	X transform: px = px0 + (x - x0)*xppu
+ *	py0 y0 yppu	Y transform: py = py0 - (y - y0)*yppu
+ *	start		Index of the first pair to decimate; defaults to 0
  *
  * RETURNS:
- *	nothing
+ *	A list {coords last lastlen}, where coords is a flat list of 
+ *	pixel coordinates, last is the index of the first pair in the 
+ *	final pixel column, and lastlen is the number of values in coords
+ *	that belong to the final pixel column.
  *
  * DESCRIPTION:
- *	Computes the bounding box of the Points
+ *	Transforms the data pairs to pixel coordinates and decimates them
+ *	for plotting as a line: for each run of pairs that fall in the 
+ *	same pixel column, only the first, minimum, maximum, and last
+ *	points are kept, in their original order.  The resulting line
+ *	is indistinguishable from the full line, but has at most four
+ *	points per pixel column.
+ *
+ *	The final pixel column may be incomplete if more data is to be 
+ *	appended; "last" and "lastlen" allow the caller to keep the 
+ *	coordinates up to the final column, and decimate again starting
+ *	at "last".
+ *
+ *	This function is documented in marsmisc(n).
  */
 
-static void 
-bbox(Points* points, Bbox* bbox)
+typedef struct DecimateColumn {
+    int    col;			/* Pixel column */
+    int    first;		/* Index of the column's first pair */
+    int    count;		/* Number of pairs in the column */
+    int    idx[4];		/* Indices of first, min, max, last */
+    double px[4];		/* Pixel X of first, min, max, last */
+    double py[4];		/* Pixel Y of first, min, max, last */
+} DecimateColumn;
+
+static int decimateFlush(Tcl_Interp*, Tcl_Obj*, DecimateColumn*);
+
+static int 
+marsutil_decimateCmd(ClientData cd, Tcl_Interp *interp, 
+                     int objc, Tcl_Obj* CONST objv[])
 {
+    double xf[6];
+    int start = 0;
     int i;
 
-    /* FIRST, get the first point as the start point. */
-    bbox->xmin = points->pts[0].x;
-    bbox->xmax = bbox->xmin;
+    if (objc < 8 || objc > 9) {
+        Tcl_WrongNumArgs(interp, 1, objv, 
+                         "xylist px0 x0 xppu py0 y0 yppu ?start?");
+        return TCL_ERROR;
+    }
 
-    bbox->ymin = points->pts[0].y;
-    bbox->ymax = bbox->ymin;
+    /* FIRST, get the transform. */
+    for (i = 0; i < 6; i++) {
+        if (Tcl_GetDoubleFromObj(interp, objv[i+2], &xf[i]) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
 
-    for (i = 1; i < points->size; i++)
-    {
-        double x = points->pts[i].x;
-        double y = points->pts[i].y;
+    if (objc == 9 && 
+        Tcl_GetIntFromObj(interp, objv[8], &start) != TCL_OK) {
+        return TCL_ERROR;
+    }
 
-        if (x < bbox->xmin)
-        {
-            bbox->xmin = x;
-        } 
-        else if (x > bbox->xmax)
+    /* NEXT, get the data. */
+    int       len;
+    Tcl_Obj** elems;
+
+    if (Tcl_ListObjGetElements(interp, objv[1], &len, &elems) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (len % 2 != 0) {
+        Tcl_SetResult(interp, "xylist has an odd number of elements", 
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, decimate the pairs column by column. */
+    Tcl_Obj*       coords = Tcl_NewListObj(0, NULL);
+    DecimateColumn column;
+    int            last    = start;
+    int            lastlen = 0;
+
+    column.count = 0;
+
+    for (i = (start > 0 ? start : 0); i < len/2; i++) {
+        double x;
+        double y;
+
+        if (Tcl_GetDoubleFromObj(interp, elems[2*i],   &x) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, elems[2*i+1], &y) != TCL_OK) 
         {
-            bbox->xmax = x;
+            Tcl_DecrRefCount(coords);
+            return TCL_ERROR;
         }
 
-        if (y < bbox->ymin)
-        {
-            bbox->ymin = y;
-        } 
-        else if (y > bbox->ymax)
-        {
-            bbox->ymax = y;
+        double px  = xf[0] + (x - xf[1])*xf[2];
+        double py  = xf[3] - (y - xf[4])*xf[5];
+        int    col = (int)floor(px);
+
+        if (column.count > 0 && col != column.col) {
+            lastlen = decimateFlush(interp, coords, &column);
         }
-    }
-}
 
-/***********************************************************************
- *
- * FUNCTION:
- *	ccw
- *
- * INPUTS:
- *	a	An {x y} point
- *	b	An (x y) point
- *	c	An {x y} point
- *
- * Checks whether a path from point a to point b to point c turns 
- * counterclockwise or not.
+        if (column.count == 0) {
+            int k;
+
+            column.col   = col;
+            column.first = i;
+
+            for (k = 0; k < 4; k++) {
+                column.idx[k] = i;
+                column.px[k]  = px;
+                column.py[k]  = py;
+            }
+        } else {
+            /* Pixel Y increases downward, so the minimum data value
+             * has the maximum pixel Y. */
+            if (py > column.py[1]) {
+                column.idx[1] = i;
+                column.px[1]  = px;
+                column.py[1]  = py;
+            }
+
+            if (py < column.py[2]) {
+                column.idx[2] = i;
+                column.px[2]  = px;
+                column.py[2]  = py;
+            }
+
+            column.idx[3] = i;
+            column.px[3]  = px;
+            column.py[3]  = py;
+        }
+
+        column.count++;
+    }
+
+    if (column.count > 0) {
+        last    = column.first;
+        lastlen = decimateFlush(interp, coords, &column);
+    }
+
+    /* NEXT, return the result. */
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+
+    Tcl_ListObjAppendElement(interp, result, coords);
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewIntObj(last));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewIntObj(lastlen));
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
  *
- *                   c
- *                   |
- * Returns:   1    a-b    or   a-b-c
+ * FUNCTION:
+ *	decimateFlush()
  *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	coords		The coordinate list being built
+ *	column		The pixel column to flush
  *
- *           -1    a-b    or   c-a-b
- *                   | 
- *                   c
+ * RETURNS:
+ *	The number of values appended to coords.
  *
- *            0    a-c-b
- *                 
- * From Sedgewick, Algorithms in C, page 350, via the CBS Simscript
- * code.  Explicitly handles the case where a == b, which Sedgewick's
- * code doesn't.
+ * DESCRIPTION:
+ *	Appends the column's first, min, max, and last points to coords,
+ *	in index order and without duplicates, and resets the column.
  */
 
 static int
-ccw(Point* a, Point* b, Point* c)
+decimateFlush(Tcl_Interp* interp, Tcl_Obj* coords, DecimateColumn* column)
 {
-    /* FIRST, compute the deltas from a-b and a-c */
-    double dx1 = b->x - a->x;
-    double dy1 = b->y - a->y;
-    double dx2 = c->x - a->x;
-    double dy2 = c->y - a->y;
-
-    /* NEXT, see if point c is on the left of a-b */
-    if (dx1*dy2 > dy1*dx2) {
-        return 1;
-    }
-    
-    /* NEXT, see if point c is on the right of a-b */
-    if (dx1*dy2 < dy1*dx2) {
-        return -1;
+    int order[4] = {0, 1, 2, 3};
+    int count    = 0;
+    int j;
+    int k;
+
+    /* FIRST, the first and last points are already in place; put the
+     * min and max in index order. */
+    if (column->idx[2] < column->idx[1]) {
+        order[1] = 2;
+        order[2] = 1;
     }
 
-    /* NEXT, the points are collinear.
-     * c-a-b */
-    if ((dx1 * dx2 < 0) || (dy1 * dy2 < 0)) {
-        return -1;
-    }
-
-    /* NEXT, Explicitly handle the case where a == b */
-    if (dx1 == 0 && dy1 == 0) {
-        /* a == b */
+    /* NEXT, append the distinct points. */
+    for (j = 0; j < 4; j++) {
+        k = order[j];
 
-        if (dx2 < 0) {
-            /* c->x < a->x */
-            return -1;
-        } else if (dx2 > 0) {
-            /* c->x > a->x */
-            return 1;
-        } else {
-            return 0;
+        if (j > 0 && column->idx[k] == column->idx[order[j-1]]) {
+            continue;
         }
-    }
-        
-    if ((dx1*dx1 + dy1*dy1) < (dx2*dx2 + dy2*dy2)) {
-        return 1;
+
+        Tcl_ListObjAppendElement(interp, coords, 
+                                 Tcl_NewDoubleObj(column->px[k]));
+        Tcl_ListObjAppendElement(interp, coords, 
+                                 Tcl_NewDoubleObj(column->py[k]));
+        count += 2;
     }
 
-    return 0;
+    column->count = 0;
+
+    return count;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	intersect()
+ *	marsutil_dmatCmd()
  *
  * INPUTS:
- *	p1	A point
- *      p2	A point
- *      q1	A point
- *      q2	A point
+ *	subcommand		The subcommand name
+ *      args                    Subcommand arguments
  *
  * RETURNS:
- *	1 if the line segments intersect, and 0 otherwise.	
+ *	Whatever the subcommand returns.
  *
  * DESCRIPTION:
- *	
- *	Given two line segments p1-p2 and q1-q2, returns 1 if the line
- *	segments intersect and 0 otherwise.  The segments are still said
- *	to intersect if the point of intersection is the end point of one
- *	or both segments.  Either segment may be degenerate, i.e.,
- *	p1 == p2 and/or q1 == q2.
- *
- *	From Sedgewick, Algorithms in C, 1990, Addison-Wesley, page 351.
+ *	This is the ensemble command for both dmat and dvec, the native
+ *	backends for mat(n) and vec(n); the client data is DMAT_MAT or
+ *	DMAT_VEC, and selects the dispatch table.  The subcommands 
+ *	share their implementations, and get the kind of value they 
+ *	operate on from the client data.
+ *
+ *	Values are held as contiguous doubles in a "marsutil::dmat"
+ *	Tcl_Obj; their string reps are ordinary lists, so they can be 
+ *	passed to any list command.  Rows, columns, and transposes are
+ *	views that share the matrix's storage.
  */
 
 static int 
-intersect(Point* p1, Point* p2, Point* q1, Point* q2)
+marsutil_dmatCmd(ClientData cd, Tcl_Interp* interp, 
+                 int objc, Tcl_Obj* CONST objv[])
 {
-    if (ccw(p1, p2, q1) * ccw(p1, p2, q2) <= 0 &&
-        ccw(q1, q2, p1) * ccw(q1, q2, p2) <= 0) {
-        return 1;
-    } else {
-        return 0;
+    SubcommandVector* table = 
+        ((size_t)cd == DMAT_VEC) ? dvecTable : dmatTable;
+
+    if (objc < 2) 
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
+        return TCL_ERROR;
+    } 
+
+    int index = 0;
+
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1], 
+                                  table, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
+    {
+        return TCL_ERROR;
     }
+
+    return (*table[index].proc)(cd, interp, objc, objv);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	ptinpoly()
+ *	dmat rows matrix
+ *	dmat cols matrix
+ *	dvec size vector
  *
  * INPUTS:
- *	poly		A polygon defines as a list of Points
- *	p		A point
- *	bbox		The polygon's bounding box
+ *	matrix		A matrix
+ *	vector		A vector
  *
  * RETURNS:
- *	1 if the point is inside the polygon or on its border, and 0
- *	otherwise.
+ *	The number of rows or columns in the matrix, or the number of
+ *	elements in the vector.
  *
  * DESCRIPTION:
- * This function determines whether a given point q is inside or outside
- * of a given polygon; if a point is on an edge or vertex it is defined to
- * be on the inside.  The function determines this by:
- *
- * (1) Comparing q against the bounding box of the polygon; if it's outside
- *     the bounding box, it's outside the polygon.
- *
- * (2) Checking q against each edge of the polygon, using [intersect].
- *     If it's explicitly on the border, it's "inside".
- *
- * (3) Checking whether q is inside the polygon by counting the number
- *     intersections made between q and a point outside the polygon.
- *     This part of the algorithm was found in an on-line paper by
- *     Paul Bourke called "Determining If A Point Lies On The Interior
- *     Of A Polygon", at 
- *
- *     http://astronomy.swin.edu.au/~pbourke/geometry/insidepoly
+ *	Returns the dimensions of a value without converting it; 
+ *	unlike llength, these leave a native value native.  A list 
+ *	value is measured as a list, and so needn't be numeric.
  */
 
-static int
-ptinpoly(Points* poly, Point* p, Bbox* box)
+static int 
+dmat_rows(ClientData cd, Tcl_Interp *interp, 
+          int objc, Tcl_Obj* CONST objv[])
 {
-    int    i;
-    int    counter;
-    Point* p1;
+    int len;
 
-    /* FIRST, if p is outside the bounding box, it's outside the
-     * polygon. */
-    if (p->x < box->xmin || p->x > box->xmax ||
-        p->y < box->ymin || p->y > box->ymax) {
-        return 0;
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "matrix");
+        return TCL_ERROR;
     }
 
-    /* NEXT, count the intersections */
-    counter = 0;
-    p1 = &poly->pts[0];
-
-    for (i = 1; i <= poly->size; i++)
-    {
-        Point* p2 = &poly->pts[i % poly->size];
+    if (objv[2]->typePtr == &dmatType) {
+        Dmat* mat = (Dmat*)objv[2]->internalRep.twoPtrValue.ptr1;
 
-        /* FIRST, if the point is on this edge then it's "inside" */
-        if (intersect(p1, p2, p, p)) {
-            return 1;
+        if (mat->kind == DMAT_MAT) {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(mat->rows));
+            return TCL_OK;
         }
+    }
 
-        /* NEXT, check for an intersection */
-        if (p->y > dmin(p1->y, p2->y))
-        {
-            if (p->y <= dmax(p1->y, p2->y))
-            {
-                if (p->x <= dmax(p1->x, p2->x))
-                {
-                    if (p1->y != p2->y) 
-                    {
-                        double xInters = 
-                            (p->y - p1->y)*(p2->x - p1->x)/(p2->y - p1->y) 
-                            + p1->x;
+    if (Tcl_ListObjLength(interp, objv[2], &len) != TCL_OK) {
+        return TCL_ERROR;
+    }
 
-                        if (p1->x == p2->x || p->x <= xInters) {
-                            ++counter;
-                        }
-                    }
-                }
-            }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(len));
+    return TCL_OK;
+}
+
+static int 
+dmat_cols(ClientData cd, Tcl_Interp *interp, 
+          int objc, Tcl_Obj* CONST objv[])
+{
+    int       kind = (int)(size_t)cd;
+    Tcl_Obj*  row;
+    int       len  = 0;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? "vector" : "matrix");
+        return TCL_ERROR;
+    }
+
+    row = objv[2];
+
+    if (objv[2]->typePtr == &dmatType) {
+        Dmat* val = (Dmat*)objv[2]->internalRep.twoPtrValue.ptr1;
+
+        if (val->kind == kind) {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(val->cols));
+            return TCL_OK;
         }
-        
-        p1 = p2;
     }
 
-    if (counter % 2 == 0) {
-        return 0;
-    } else {
-        return 1;
+    /* A matrix's column count is the length of its first row. */
+    if (kind == DMAT_MAT &&
+        Tcl_ListObjIndex(interp, objv[2], 0, &row) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (row != NULL && 
+        Tcl_ListObjLength(interp, row, &len) != TCL_OK) {
+        return TCL_ERROR;
     }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(len));
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	dmin()
+ *	dmat equal mat1 mat2
+ *	dvec equal vec1 vec2
  *
  * INPUTS:
- *	a	a value
- *	b	a value
+ *	mat1, mat2	Two matrices, or
+ *	vec1, vec2	Two vectors
  *
  * RETURNS:
- *	The minimum of the two values.
+ *	1 if the values have the same dimensions and numerically equal
+ *	elements, and 0 otherwise.
+ *
+ * DESCRIPTION:
+ *	Compares two numeric values element by element.
  */
 
-static double
-dmin(double a, double b)
+static int 
+dmat_equal(ClientData cd, Tcl_Interp *interp, 
+           int objc, Tcl_Obj* CONST objv[])
 {
-    if (a < b)
-    {
-        return a;
+    int   kind = (int)(size_t)cd;
+    Dmat* a;
+    Dmat* b;
+    int   i;
+    int   j;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? "vec1 vec2" : "mat1 mat2");
+        return TCL_ERROR;
     }
-    else
-    {
-        return b;
+
+    if (getDmatPair(interp, objv, kind, &a, &b) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (!a->exact || !b->exact) {
+        return dmatUseTcl(interp);
+    }
+
+    int equal = (a->rows == b->rows && a->cols == b->cols);
+
+    for (i = 0; equal && i < a->rows; i++) {
+        double* arow = a->store->data + a->offset + i*a->rstride;
+        double* brow = b->store->data + b->offset + i*b->rstride;
+
+        for (j = 0; j < a->cols; j++) {
+            if (arow[j*a->cstride] != brow[j*b->cstride]) {
+                equal = 0;
+                break;
+            }
+        }
     }
+
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(equal));
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	dmax()
+ *	dmat add|sub mat1 mat2
+ *	dvec add|sub vec1 vec2
  *
  * INPUTS:
- *	a	a value
- *	b	a value
+ *	mat1, mat2	Two matrices of the same dimensions, or
+ *	vec1, vec2	Two vectors of the same size
  *
  * RETURNS:
- *	The maximum of the two values.
+ *	The element-wise sum or difference.
+ *
+ * DESCRIPTION:
+ *	See dmatElementwise().
  */
 
-static double
-dmax(double a, double b)
+static int 
+dmat_add(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
 {
-    if (a > b)
-    {
-        return a;
-    }
+    int kind = (int)(size_t)cd;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? "vec1 vec2" : "mat1 mat2");
+        return TCL_ERROR;
+    }
+
+    return dmatElementwise(interp, objv, kind, '+');
+}
+
+static int 
+dmat_sub(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    int kind = (int)(size_t)cd;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? "vec1 vec2" : "mat1 mat2");
+        return TCL_ERROR;
+    }
+
+    return dmatElementwise(interp, objv, kind, '-');
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmat scalarmul matrix constant
+ *	dvec scalarmul vector constant
+ *
+ * INPUTS:
+ *	matrix		A matrix, or
+ *	vector		A vector
+ *	constant	A number
+ *
+ * RETURNS:
+ *	The value multiplied by the constant.
+ *
+ * DESCRIPTION:
+ *	See dmatElementwise().
+ */
+
+static int 
+dmat_scalarmul(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
+{
+    int kind = (int)(size_t)cd;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? 
+                         "vector constant" : "matrix constant");
+        return TCL_ERROR;
+    }
+
+    return dmatElementwise(interp, objv, kind, '*');
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dvec normalize vector
+ *
+ * INPUTS:
+ *	vector		A vector of numbers >= 0 with a positive sum
+ *
+ * RETURNS:
+ *	The vector scaled so that its elements sum to 1.0.
+ *
+ * DESCRIPTION:
+ *	Equivalent to vec normalize.
+ */
+
+static int 
+dmat_normalize(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat*  vec;
+    double sum = 0.0;
+    int    j;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "vector");
+        return TCL_ERROR;
+    }
+
+    if (getDmat(interp, objv[2], DMAT_VEC, &vec) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (!vec->exact ||
+        (vec->isint && vec->cols*dmatMaxAbs(vec) >= DMAT_MAXINT)) {
+        return dmatUseTcl(interp);
+    }
+
+    double* src = vec->store->data + vec->offset;
+
+    for (j = 0; j < vec->cols; j++) {
+        sum += src[j*vec->cstride];
+    }
+
+    if (sum <= 0.0) {
+        Tcl_SetResult(interp, "Cannot normalize, sum <= 0", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Dmat*   result = newDmat(DMAT_VEC, 1, vec->cols, 0);
+    double* DMAT_RESTRICT dst = result->store->data;
+    double  factor = 1.0/sum;
+
+    for (j = 0; j < vec->cols; j++) {
+        dst[j] = factor*src[j*vec->cstride];
+    }
+
+    Tcl_SetObjResult(interp, newDmatObj(result));
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmat row matrix i
+ *	dmat col matrix j
+ *	dmat transpose matrix
+ *
+ * INPUTS:
+ *	matrix		A matrix
+ *	i, j		A row or column index
+ *
+ * RETURNS:
+ *	Row i or column j as a vector, or the transpose of the matrix.
+ *
+ * DESCRIPTION:
+ *	These return views: new values that share the matrix's storage,
+ *	and so cost nothing to create no matter how large the matrix.
+ *	Values are immutable, so the sharing is never visible.
+ *
+ *	A view formats its elements afresh, where the Tcl code returns
+ *	them as the caller wrote them, so a matrix still in the 
+ *	caller's text is left to the Tcl code.
+ */
+
+static int 
+dmat_row(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat* mat;
+    int   i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "matrix i");
+        return TCL_ERROR;
+    }
+
+    if (getDmat(interp, objv[2], DMAT_MAT, &mat) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &i) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (mat->literal || !mat->exact) {
+        return dmatUseTcl(interp);
+    }
+
+    if (i < 0 || i >= mat->rows) {
+        Tcl_SetResult(interp, "row index out of range", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, 
+        newDmatObj(newDmatView(mat, DMAT_VEC, 1, mat->cols, 
+                               mat->offset + i*mat->rstride,
+                               mat->rstride, mat->cstride)));
+    return TCL_OK;
+}
+
+static int 
+dmat_col(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat* mat;
+    int   j;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "matrix j");
+        return TCL_ERROR;
+    }
+
+    if (getDmat(interp, objv[2], DMAT_MAT, &mat) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &j) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (mat->literal || !mat->exact) {
+        return dmatUseTcl(interp);
+    }
+
+    if (j < 0 || j >= mat->cols) {
+        Tcl_SetResult(interp, "column index out of range", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* A column is a vector whose elements are rstride apart. */
+    Tcl_SetObjResult(interp, 
+        newDmatObj(newDmatView(mat, DMAT_VEC, 1, mat->rows, 
+                               mat->offset + j*mat->cstride,
+                               mat->cstride, mat->rstride)));
+    return TCL_OK;
+}
+
+static int 
+dmat_transpose(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat* mat;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "matrix");
+        return TCL_ERROR;
+    }
+
+    if (getDmat(interp, objv[2], DMAT_MAT, &mat) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (mat->literal || !mat->exact) {
+        return dmatUseTcl(interp);
+    }
+
+    Tcl_SetObjResult(interp, 
+        newDmatObj(newDmatView(mat, DMAT_MAT, mat->cols, mat->rows, 
+                               mat->offset, 
+                               mat->cstride, mat->rstride)));
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmat mul mat1 mat2
+ *
+ * INPUTS:
+ *	mat1		An m*p matrix
+ *	mat2		A p*n matrix
+ *
+ * RETURNS:
+ *	The m*n matrix product.
+ *
+ * DESCRIPTION:
+ *	Computes each row of the product as a sum of scaled rows of
+ *	mat2, so that the inner loop runs along contiguous memory and
+ *	can be vectorized.  Each element is still summed in the same
+ *	order as the textbook definition.
+ */
+
+static int 
+dmat_mul(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat* a;
+    Dmat* b;
+    int   i;
+    int   j;
+    int   k;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "mat1 mat2");
+        return TCL_ERROR;
+    }
+
+    if (getDmatPair(interp, objv, DMAT_MAT, &a, &b) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (a->cols != b->rows) {
+        Tcl_SetObjResult(interp, 
+            Tcl_ObjPrintf("cannot multiply %dx%d matrix by %dx%d matrix",
+                          a->rows, a->cols, b->rows, b->cols));
+        return TCL_ERROR;
+    }
+
+    if (!a->exact || !b->exact ||
+        (a->isint && b->isint && 
+         a->cols*dmatMaxAbs(a)*dmatMaxAbs(b) >= DMAT_MAXINT)) {
+        return dmatUseTcl(interp);
+    }
+
+    Dmat* result = newDmat(DMAT_MAT, a->rows, b->cols, 
+                           a->isint && b->isint);
+
+    for (i = 0; i < a->rows; i++) {
+        double* DMAT_RESTRICT dst = result->store->data + i*b->cols;
+        double* arow = a->store->data + a->offset + i*a->rstride;
+
+        for (j = 0; j < b->cols; j++) {
+            dst[j] = 0.0;
+        }
+
+        for (k = 0; k < a->cols; k++) {
+            double  aik  = arow[k*a->cstride];
+            double* brow = b->store->data + b->offset + k*b->rstride;
+
+            if (b->cstride == 1) {
+                const double* DMAT_RESTRICT src = brow;
+
+                for (j = 0; j < b->cols; j++) {
+                    dst[j] += aik*src[j];
+                }
+            } else {
+                for (j = 0; j < b->cols; j++) {
+                    dst[j] += aik*brow[j*b->cstride];
+                }
+            }
+        }
+    }
+
+    Tcl_SetObjResult(interp, newDmatObj(result));
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dvec dot vec1 vec2
+ *
+ * INPUTS:
+ *	vec1, vec2	Two vectors of the same size
+ *
+ * RETURNS:
+ *	The dot product of the two vectors.
+ *
+ * DESCRIPTION:
+ *	Sums the products in index order.
+ */
+
+static int 
+dmat_dot(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    Dmat*  a;
+    Dmat*  b;
+    double sum = 0.0;
+    int    j;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "vec1 vec2");
+        return TCL_ERROR;
+    }
+
+    if (getDmatPair(interp, objv, DMAT_VEC, &a, &b) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (a->cols != b->cols) {
+        Tcl_SetObjResult(interp, 
+            Tcl_ObjPrintf("vector sizes differ: %d vs. %d",
+                          a->cols, b->cols));
+        return TCL_ERROR;
+    }
+
+    if (!a->exact || !b->exact ||
+        (a->isint && b->isint && 
+         a->cols*dmatMaxAbs(a)*dmatMaxAbs(b) >= DMAT_MAXINT)) {
+        return dmatUseTcl(interp);
+    }
+
+    double* adata = a->store->data + a->offset;
+    double* bdata = b->store->data + b->offset;
+
+    for (j = 0; j < a->cols; j++) {
+        sum += adata[j*a->cstride]*bdata[j*b->cstride];
+    }
+
+    if (a->isint && b->isint) {
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)sum));
+    } else {
+        Tcl_SetObjResult(interp, Tcl_NewDoubleObj(sum));
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmat sum|min|max matrix
+ *	dvec sum|min|max vector
+ *
+ * INPUTS:
+ *	matrix		A matrix, or
+ *	vector		A vector
+ *
+ * RETURNS:
+ *	The sum, minimum, or maximum of the elements.
+ *
+ * DESCRIPTION:
+ *	Reduces the elements in row-major order.  The sum of no 
+ *	elements is 0; the min and max of no elements are errors.
+ */
+
+static int dmatReduce(ClientData, Tcl_Interp*, int, Tcl_Obj* CONST objv[],
+                      char op);
+
+static int 
+dmat_sum(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    return dmatReduce(cd, interp, objc, objv, '+');
+}
+
+static int 
+dmat_min(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    return dmatReduce(cd, interp, objc, objv, '<');
+}
+
+static int 
+dmat_max(ClientData cd, Tcl_Interp *interp, 
+         int objc, Tcl_Obj* CONST objv[])
+{
+    return dmatReduce(cd, interp, objc, objv, '>');
+}
+
+static int
+dmatReduce(ClientData cd, Tcl_Interp *interp, 
+           int objc, Tcl_Obj* CONST objv[], char op)
+{
+    int    kind = (int)(size_t)cd;
+    Dmat*  val;
+    double result = 0.0;
+    int    i;
+    int    j;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (kind == DMAT_VEC) ? "vector" : "matrix");
+        return TCL_ERROR;
+    }
+
+    if (getDmat(interp, objv[2], kind, &val) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (!val->exact ||
+        (op == '+' && val->isint && 
+         val->rows*val->cols*dmatMaxAbs(val) >= DMAT_MAXINT)) {
+        return dmatUseTcl(interp);
+    }
+
+    if (op != '+') {
+        if (val->rows == 0 || val->cols == 0) {
+            Tcl_SetResult(interp, "no elements", TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        result = val->store->data[val->offset];
+    }
+
+    for (i = 0; i < val->rows; i++) {
+        double* row = val->store->data + val->offset + i*val->rstride;
+
+        for (j = 0; j < val->cols; j++) {
+            double x = row[j*val->cstride];
+
+            if (op == '+') {
+                result += x;
+            } else if (op == '<' ? x < result : x > result) {
+                result = x;
+            }
+        }
+    }
+
+    if (val->isint) {
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)result));
+    } else {
+        Tcl_SetObjResult(interp, Tcl_NewDoubleObj(result));
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmatElementwise()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	objv		The add, sub, or scalarmul command words
+ *	kind		DMAT_MAT or DMAT_VEC
+ *	op		'+', '-', or '*'
+ *
+ * RETURNS:
+ *	A Tcl result code; the result is the new value.
+ *
+ * DESCRIPTION:
+ *	Implements the element-wise operations.  The result is always
+ *	a new contiguous value.  When the operands are contiguous too,
+ *	as they are unless they are views, the work is done in a single
+ *	flat loop the compiler can vectorize; otherwise, row by row.
+ *
+ *	The result is integral if the operands are, so that results 
+ *	format the same as the equivalent expr computations.  Operands
+ *	that aren't exact, or integer results that might exceed 2^53,
+ *	are left to the Tcl code.
+ */
+
+static int
+dmatElementwise(Tcl_Interp* interp, Tcl_Obj* CONST objv[], 
+                int kind, char op)
+{
+    Dmat*       a;
+    Dmat*       b      = NULL;
+    double      factor = 0.0;
+    Tcl_WideInt iconst;
+    int         isint;
+    int         i;
+    int         j;
+
+    if (op == '*') {
+        if (getDmat(interp, objv[2], kind, &a) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, objv[3], &factor) != TCL_OK) {
+            return TCL_ERROR;
+        }
+
+        /* The constant is an integer unless it parsed as a double. */
+        int intconst = 
+            (objv[3]->typePtr != Tcl_GetObjType("double"));
+
+        if (!a->exact ||
+            (intconst &&
+             (Tcl_GetWideIntFromObj(NULL, objv[3], &iconst) != TCL_OK ||
+              iconst > (Tcl_WideInt)DMAT_MAXINT ||
+              iconst < -(Tcl_WideInt)DMAT_MAXINT))) {
+            return dmatUseTcl(interp);
+        }
+
+        isint = a->isint && intconst;
+
+        if (isint && fabs(factor)*dmatMaxAbs(a) >= DMAT_MAXINT) {
+            return dmatUseTcl(interp);
+        }
+    } else {
+        if (getDmatPair(interp, objv, kind, &a, &b) != TCL_OK) {
+            return TCL_ERROR;
+        }
+
+        if (a->rows != b->rows || a->cols != b->cols) {
+            Tcl_SetObjResult(interp, 
+                Tcl_ObjPrintf("dimensions differ: %dx%d vs. %dx%d",
+                              a->rows, a->cols, b->rows, b->cols));
+            return TCL_ERROR;
+        }
+
+        isint = a->isint && b->isint;
+
+        if (!a->exact || !b->exact ||
+            (isint && dmatMaxAbs(a) + dmatMaxAbs(b) >= DMAT_MAXINT)) {
+            return dmatUseTcl(interp);
+        }
+    }
+
+    Dmat* result = newDmat(kind, a->rows, a->cols, isint);
+
+    int     flat   = dmatIsFlat(a) && (b == NULL || dmatIsFlat(b));
+    int     nrows  = flat ? 1 : a->rows;
+    int     ncols  = flat ? a->rows*a->cols : a->cols;
+
+    for (i = 0; i < nrows; i++) {
+        double* DMAT_RESTRICT dst = result->store->data + i*a->cols;
+        const double* asrc = a->store->data + a->offset + i*a->rstride;
+        const double* bsrc = 
+            b ? b->store->data + b->offset + i*b->rstride : NULL;
+        int as = flat ? 1 : a->cstride;
+        int bs = flat ? 1 : (b ? b->cstride : 0);
+
+        if (as == 1 && (b == NULL || bs == 1)) {
+            const double* DMAT_RESTRICT x = asrc;
+            const double* DMAT_RESTRICT y = bsrc;
+
+            switch (op) {
+            case '+':
+                for (j = 0; j < ncols; j++) dst[j] = x[j] + y[j];
+                break;
+            case '-':
+                for (j = 0; j < ncols; j++) dst[j] = x[j] - y[j];
+                break;
+            default:
+                for (j = 0; j < ncols; j++) dst[j] = factor*x[j];
+                break;
+            }
+        } else {
+            for (j = 0; j < ncols; j++) {
+                double x = asrc[j*as];
+
+                switch (op) {
+                case '+': dst[j] = x + bsrc[j*bs]; break;
+                case '-': dst[j] = x - bsrc[j*bs]; break;
+                default:  dst[j] = factor*x;       break;
+                }
+            }
+        }
+    }
+
+    Tcl_SetObjResult(interp, newDmatObj(result));
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	zcurvemany curve epsilon xs
+ *
+ * INPUTS:
+ *	curve		A Z-curve, {lo a b hi}
+ *	epsilon		The zcurve(n) epsilon
+ *	xs		A list of x values
+ *
+ * RETURNS:
+ *	A list of Z(x) values, one for each x.
+ *
+ * DESCRIPTION:
+ *	Evaluates the Z-curve for each x, exactly as zcurve eval does;
+ *	the curve is parsed once for the whole list.  The xs may be a 
+ *	list or a dvec value.
+ *
+ *	This function is documented in zcurve(n), as zcurve evalmany.
+ */
+
+static int 
+marsutil_zcurvemanyCmd(ClientData cd, Tcl_Interp *interp, 
+                       int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_Obj** elems;
+    int       len;
+    double    z[4];
+    double    epsilon;
+    DoubleVec xs;
+    int       i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 1, objv, "curve epsilon xs");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the curve. */
+    if (Tcl_ListObjGetElements(interp, objv[1], &len, &elems) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (len != 4) {
+        Tcl_SetObjResult(interp, 
+            Tcl_ObjPrintf("invalid zcurve, should be {lo a b hi}: \"%s\"",
+                          Tcl_GetString(objv[1])));
+        return TCL_ERROR;
+    }
+
+    for (i = 0; i < 4; i++) {
+        if (Tcl_GetDoubleFromObj(interp, elems[i], &z[i]) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, objv[2], &epsilon) != TCL_OK ||
+        getDoubleVec(interp, objv[3], &xs) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, evaluate the curve. */
+    double lo    = z[0];
+    double a     = z[1];
+    double b     = z[2];
+    double hi    = z[3];
+    double slope = (b - a < epsilon) ? 0.0 : (hi - lo)/(b - a);
+
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+
+    for (i = 0; i < xs.size; i++) {
+        double x = xs.data[i*xs.stride];
+        double y;
+
+        if (x < a) {
+            y = lo;
+        } else if (x > b) {
+            y = hi;
+        } else if (b - a < epsilon) {
+            y = (lo + hi)/2;
+        } else {
+            y = lo + slope*(x - a);
+        }
+
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(y));
+    }
+
+    freeDoubleVec(&xs);
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	rmfmany name Rnom Rs
+ *
+ * INPUTS:
+ *	name		An RMF name, e.g., "quad"
+ *	Rnom		The nominal relationship
+ *	Rs		A list of relationship values
+ *
+ * RETURNS:
+ *	A list of multipliers, one for each R.
+ *
+ * DESCRIPTION:
+ *	Evaluates the named relationship multiplier function for each
+ *	R, exactly as the rmf(n) subcommand of that name does.  The Rs
+ *	may be a list or a dvec value.
+ *
+ *	This function is documented in rmf(n), as rmf evalmany.
+ */
+
+static int 
+marsutil_rmfmanyCmd(ClientData cd, Tcl_Interp *interp, 
+                    int objc, Tcl_Obj* CONST objv[])
+{
+    int       func;
+    double    Rnom;
+    DoubleVec Rs;
+    int       i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 1, objv, "name Rnom Rs");
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetIndexFromObj(interp, objv[1], rmfNames, "RMF", 
+                            TCL_EXACT, &func) != TCL_OK ||
+        Tcl_GetDoubleFromObj(interp, objv[2], &Rnom) != TCL_OK ||
+        getDoubleVec(interp, objv[3], &Rs) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+
+    for (i = 0; i < Rs.size; i++) {
+        double R    = Rs.data[i*Rs.stride];
+        double root = R/Rnom;
+        double m    = 0.0;
+
+        switch (func) {
+        case RMF_CONSTANT: 
+            m = 1.0;
+            break;
+        case RMF_LINEAR:
+            m = root;
+            break;
+        case RMF_QUAD:
+            if (R > 0) {
+                m = root*root;
+            } else if (R < 0) {
+                m = -(root*root);
+            }
+            break;
+        case RMF_FRQUAD:
+            if (R > 0) {
+                m = root*root;
+            }
+            break;
+        case RMF_FRMORE:
+            root = (1 + R)/(1 + Rnom);
+            m    = root*root;
+            break;
+        case RMF_ENQUAD:
+            if (R < 0) {
+                m = root*root;
+            }
+            break;
+        case RMF_ENMORE:
+            root = (1 - R)/(1 + Rnom);
+            m    = root*root;
+            break;
+        }
+
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(m));
+    }
+
+    freeDoubleVec(&Rs);
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	coveragemany func personnel populations
+ *
+ * INPUTS:
+ *	func		A coverage function, {c d}
+ *	personnel	A list of personnel counts
+ *	populations	A list of populations, one for each count
+ *
+ * RETURNS:
+ *	A list of coverage fractions.
+ *
+ * DESCRIPTION:
+ *	Evaluates the coverage function for each pair of personnel
+ *	and population, exactly as coverage eval does.  The lists may 
+ *	be lists or dvec values.
+ *
+ *	This function is documented in coverage(n), as coverage 
+ *	evalmany.
+ */
+
+static int 
+marsutil_coveragemanyCmd(ClientData cd, Tcl_Interp *interp, 
+                         int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_Obj** elems;
+    int       len;
+    double    c;
+    double    d;
+    DoubleVec personnel;
+    DoubleVec population;
+    int       i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 1, objv, "func personnel populations");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the function. */
+    if (Tcl_ListObjGetElements(interp, objv[1], &len, &elems) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (len != 2) {
+        Tcl_SetObjResult(interp, 
+            Tcl_ObjPrintf("invalid coverage function \"%s\", "
+                          "expected \"c d\"", Tcl_GetString(objv[1])));
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, elems[0], &c) != TCL_OK ||
+        Tcl_GetDoubleFromObj(interp, elems[1], &d) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the inputs. */
+    if (getDoubleVec(interp, objv[2], &personnel) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (getDoubleVec(interp, objv[3], &population) != TCL_OK) {
+        freeDoubleVec(&personnel);
+        return TCL_ERROR;
+    }
+
+    if (personnel.size != population.size) {
+        Tcl_SetObjResult(interp, 
+            Tcl_ObjPrintf("got %d personnel counts for %d populations",
+                          personnel.size, population.size));
+        freeDoubleVec(&personnel);
+        freeDoubleVec(&population);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, evaluate the function. */
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+    double   log3   = log(3);
+
+    for (i = 0; i < population.size; i++) {
+        double pop = population.data[i*population.stride];
+        double cf  = 0.0;
+
+        if (pop != 0) {
+            double td = personnel.data[i*personnel.stride]*d/pop;
+
+            cf = 1 - exp(-(td)*log3/(c));
+        }
+
+        if (isnan(cf)) {
+            Tcl_DecrRefCount(result);
+            freeDoubleVec(&personnel);
+            freeDoubleVec(&population);
+            Tcl_SetResult(interp, "domain error: argument not in valid range",
+                          TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(cf));
+    }
+
+    freeDoubleVec(&personnel);
+    freeDoubleVec(&population);
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	tabletextparse script
+ *
+ * INPUTS:
+ *	script		A tabletext(n) input script
+ *
+ * RETURNS:
+ *	A list of the script's commands, each of which is a list of
+ *	its words.
+ *
+ * DESCRIPTION:
+ *	Tokenizes a script written in the literal subset of Tcl syntax
+ *	used by tabletext(n) input files: commands separated by newlines
+ *	or semicolons, comments, and bare, quoted, and braced words.
+ *	Words are returned as Tcl would see them; in particular, a
+ *	backslash-newline within a braced word becomes a single space.
+ *
+ *	If the script uses any other Tcl construct (variable, command,
+ *	or backslash substitution, or argument expansion) or is not
+ *	well-formed, the command throws an error with error code
+ *	"TABLETEXT TCL"; the caller should then evaluate the script
+ *	as Tcl.
+ *
+ *	This function is used by tabletext(n) to load large input
+ *	files without evaluating them.
+ */
+
+#define TT_SPACE(c) \
+    ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\v' || (c) == '\f')
+
+#define TT_END(p, end) \
+    ((p) == (end) || TT_SPACE(*(p)) || *(p) == '\n' || *(p) == ';')
+
+static int 
+marsutil_tabletextparseCmd(ClientData cd, Tcl_Interp *interp, 
+                           int objc, Tcl_Obj* CONST objv[])
+{
+    const char* p;
+    const char* end;
+    const char* start;
+    int         len;
+    int         depth;
+    int         collapse;
+    Tcl_Obj*    result;
+    Tcl_Obj*    command;
+    Tcl_Obj*    word;
+
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "script");
+        return TCL_ERROR;
+    }
+
+    p      = Tcl_GetStringFromObj(objv[1], &len);
+    end    = p + len;
+    result = Tcl_NewListObj(0, NULL);
+
+    while (p < end) {
+        /* FIRST, skip white space and empty commands. */
+        if (TT_SPACE(*p) || *p == '\n' || *p == ';') {
+            p++;
+            continue;
+        }
+
+        /* NEXT, skip comments.  A backslash quotes the following
+         * character, so a backslash-newline continues the comment. */
+        if (*p == '#') {
+            while (p < end && *p != '\n') {
+                p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            }
+            continue;
+        }
+
+        /* NEXT, get the command's words. */
+        command = Tcl_NewListObj(0, NULL);
+        Tcl_ListObjAppendElement(interp, result, command);
+
+        while (p < end && *p != '\n' && *p != ';') {
+            if (TT_SPACE(*p)) {
+                p++;
+                continue;
+            }
+
+            if (*p == '{') {
+                /* Braced word: find the matching close brace. */
+                start    = ++p;
+                depth    = 1;
+                collapse = 0;
+
+                while (p < end) {
+                    if (*p == '\\' && p + 1 < end) {
+                        collapse |= (p[1] == '\n');
+                        p += 2;
+                        continue;
+                    }
+
+                    if (*p == '{') {
+                        depth++;
+                    } else if (*p == '}' && --depth == 0) {
+                        break;
+                    }
+
+                    p++;
+                }
+
+                if (p == end || !TT_END(p + 1, end)) {
+                    goto notPlain;
+                }
+
+                if (!collapse) {
+                    word = Tcl_NewStringObj(start, p - start);
+                } else {
+                    /* Replace each backslash-newline and the white
+                     * space following it with a single space. */
+                    const char* q = start;
+
+                    word = Tcl_NewObj();
+
+                    while (q < p) {
+                        const char* run = q;
+
+                        while (q < p && !(q[0] == '\\' && q[1] == '\n')) {
+                            q += (*q == '\\') ? 2 : 1;
+                        }
+
+                        Tcl_AppendToObj(word, run, q - run);
+
+                        if (q < p) {
+                            Tcl_AppendToObj(word, " ", 1);
+                            q += 2;
+
+                            while (q < p && (*q == ' ' || *q == '\t')) {
+                                q++;
+                            }
+                        }
+                    }
+                }
+
+                p++;
+            } else if (*p == '"') {
+                /* Quoted word: no substitutions allowed. */
+                start = ++p;
+
+                while (p < end && *p != '"') {
+                    if (*p == '$' || *p == '[' || *p == '\\') {
+                        goto notPlain;
+                    }
+                    p++;
+                }
+
+                if (p == end || !TT_END(p + 1, end)) {
+                    goto notPlain;
+                }
+
+                word = Tcl_NewStringObj(start, p - start);
+                p++;
+            } else {
+                /* Bare word: no substitutions allowed. */
+                start = p;
+
+                while (!TT_END(p, end)) {
+                    if (*p == '$' || *p == '[' || *p == '\\') {
+                        goto notPlain;
+                    }
+                    p++;
+                }
+
+                word = Tcl_NewStringObj(start, p - start);
+            }
+
+            Tcl_ListObjAppendElement(interp, command, word);
+        }
+    }
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+
+ notPlain:
+    Tcl_DecrRefCount(result);
+    Tcl_SetResult(interp, "script is not plain tabletext", TCL_STATIC);
+    Tcl_SetErrorCode(interp, "TABLETEXT", "TCL", NULL);
+    return TCL_ERROR;
+}
+
+/*
+ * Math and Geometry Functions
+ */
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	spheredist
+ *
+ * INPUTS:
+ *	lat1		A latitude in decimal degrees
+ *      lon1            A longitude in decimal degrees
+ *	lat2		A latitude in decimal degrees
+ *      lon2            A longitude in decimal degrees
+ *
+ * RETURNS:
+ *	The distance between loc 1 and loc 2 in kilometers.
+ *
+ * DESCRIPTION:
+ *	Computes the distance between the two points and returns
+ *      an answer in kilometers.  The algorithm is equivalent to
+ *      that used in CBS.
+ */
+
+static double
+spheredist(double lat1, double lon1, double lat2, double lon2)
+{
+    /* Earth's diameter in kilometers, per CBS */
+    double diameter = 12742.0;
+
+    /* NEXT, convert points to radians */
+    lat1 *= radians;
+    lon1 *= radians;
+    lat2 *= radians;
+    lon2 *= radians;
+
+    /* NEXT, compute the distance. */
+    double sinHalfDlat = sin((lat2 - lat1)/2.0);
+    double sinHalfDlon = sin((lon2 - lon1)/2.0);
+
+    double dist = 
+        diameter * 
+        asin(sqrt(sinHalfDlat*sinHalfDlat +
+                  cos(lat1)*cos(lat2)*sinHalfDlon*sinHalfDlon));
+
+    return dist;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	bbox()
+ *
+ * INPUTS:
+ *	points		A list of Points
+ *
+ * OUTPUTS
+ *      bbox	A bounding box
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Computes the bounding box of the Points
+ */
+
+static void 
+bbox(Points* points, Bbox* bbox)
+{
+    int i;
+
+    /* FIRST, get the first point as the start point. */
+    bbox->xmin = points->pts[0].x;
+    bbox->xmax = bbox->xmin;
+
+    bbox->ymin = points->pts[0].y;
+    bbox->ymax = bbox->ymin;
+
+    for (i = 1; i < points->size; i++)
+    {
+        double x = points->pts[i].x;
+        double y = points->pts[i].y;
+
+        if (x < bbox->xmin)
+        {
+            bbox->xmin = x;
+        } 
+        else if (x > bbox->xmax)
+        {
+            bbox->xmax = x;
+        }
+
+        if (y < bbox->ymin)
+        {
+            bbox->ymin = y;
+        } 
+        else if (y > bbox->ymax)
+        {
+            bbox->ymax = y;
+        }
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ccw
+ *
+ * INPUTS:
+ *	a	An {x y} point
+ *	b	An (x y) point
+ *	c	An {x y} point
+ *
+ * Checks whether a path from point a to point b to point c turns 
+ * counterclockwise or not.
+ *
+ *                   c
+ *                   |
+ * Returns:   1    a-b    or   a-b-c
+ *
+ *
+ *           -1    a-b    or   c-a-b
+ *                   | 
+ *                   c
+ *
+ *            0    a-c-b
+ *                 
+ * From Sedgewick, Algorithms in C, page 350, via the CBS Simscript
+ * code.  Explicitly handles the case where a == b, which Sedgewick's
+ * code doesn't.
+ */
+
+static int
+ccw(Point* a, Point* b, Point* c)
+{
+    /* FIRST, compute the deltas from a-b and a-c */
+    double dx1 = b->x - a->x;
+    double dy1 = b->y - a->y;
+    double dx2 = c->x - a->x;
+    double dy2 = c->y - a->y;
+
+    /* NEXT, see if point c is on the left of a-b */
+    if (dx1*dy2 > dy1*dx2) {
+        return 1;
+    }
+    
+    /* NEXT, see if point c is on the right of a-b */
+    if (dx1*dy2 < dy1*dx2) {
+        return -1;
+    }
+
+    /* NEXT, the points are collinear.
+     * c-a-b */
+    if ((dx1 * dx2 < 0) || (dy1 * dy2 < 0)) {
+        return -1;
+    }
+
+    /* NEXT, Explicitly handle the case where a == b */
+    if (dx1 == 0 && dy1 == 0) {
+        /* a == b */
+
+        if (dx2 < 0) {
+            /* c->x < a->x */
+            return -1;
+        } else if (dx2 > 0) {
+            /* c->x > a->x */
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+        
+    if ((dx1*dx1 + dy1*dy1) < (dx2*dx2 + dy2*dy2)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	intersect()
+ *
+ * INPUTS:
+ *	p1	A point
+ *      p2	A point
+ *      q1	A point
+ *      q2	A point
+ *
+ * RETURNS:
+ *	1 if the line segments intersect, and 0 otherwise.	
+ *
+ * DESCRIPTION:
+ *	
+ *	Given two line segments p1-p2 and q1-q2, returns 1 if the line
+ *	segments intersect and 0 otherwise.  The segments are still said
+ *	to intersect if the point of intersection is the end point of one
+ *	or both segments.  Either segment may be degenerate, i.e.,
+ *	p1 == p2 and/or q1 == q2.
+ *
+ *	From Sedgewick, Algorithms in C, 1990, Addison-Wesley, page 351.
+ */
+
+static int 
+intersect(Point* p1, Point* p2, Point* q1, Point* q2)
+{
+    if (ccw(p1, p2, q1) * ccw(p1, p2, q2) <= 0 &&
+        ccw(q1, q2, p1) * ccw(q1, q2, p2) <= 0) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ptinpoly()
+ *
+ * INPUTS:
+ *	poly		A polygon defines as a list of Points
+ *	p		A point
+ *	bbox		The polygon's bounding box
+ *
+ * RETURNS:
+ *	1 if the point is inside the polygon or on its border, and 0
+ *	otherwise.
+ *
+ * DESCRIPTION:
+ * This function determines whether a given point q is inside or outside
+ * of a given polygon; if a point is on an edge or vertex it is defined to
+ * be on the inside.  The function determines this by:
+ *
+ * (1) Comparing q against the bounding box of the polygon; if it's outside
+ *     the bounding box, it's outside the polygon.
+ *
+ * (2) Checking q against each edge of the polygon, using [intersect].
+ *     If it's explicitly on the border, it's "inside".
+ *
+ * (3) Checking whether q is inside the polygon by counting the number
+ *     intersections made between q and a point outside the polygon.
+ *     This part of the algorithm was found in an on-line paper by
+ *     Paul Bourke called "Determining If A Point Lies On The Interior
+ *     Of A Polygon", at 
+ *
+ *     http://astronomy.swin.edu.au/~pbourke/geometry/insidepoly
+ */
+
+static int
+ptinpoly(Points* poly, Point* p, Bbox* box)
+{
+    int    i;
+    int    counter;
+    Point* p1;
+
+    /* FIRST, if p is outside the bounding box, it's outside the
+     * polygon. */
+    if (p->x < box->xmin || p->x > box->xmax ||
+        p->y < box->ymin || p->y > box->ymax) {
+        return 0;
+    }
+
+    /* NEXT, count the intersections */
+    counter = 0;
+    p1 = &poly->pts[0];
+
+    for (i = 1; i <= poly->size; i++)
+    {
+        Point* p2 = &poly->pts[i % poly->size];
+
+        /* FIRST, if the point is on this edge then it's "inside" */
+        if (intersect(p1, p2, p, p)) {
+            return 1;
+        }
+
+        /* NEXT, check for an intersection */
+        if (p->y > dmin(p1->y, p2->y))
+        {
+            if (p->y <= dmax(p1->y, p2->y))
+            {
+                if (p->x <= dmax(p1->x, p2->x))
+                {
+                    if (p1->y != p2->y) 
+                    {
+                        double xInters = 
+                            (p->y - p1->y)*(p2->x - p1->x)/(p2->y - p1->y) 
+                            + p1->x;
+
+                        if (p1->x == p2->x || p->x <= xInters) {
+                            ++counter;
+                        }
+                    }
+                }
+            }
+        }
+        
+        p1 = p2;
+    }
+
+    if (counter % 2 == 0) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmin()
+ *
+ * INPUTS:
+ *	a	a value
+ *	b	a value
+ *
+ * RETURNS:
+ *	The minimum of the two values.
+ */
+
+static double
+dmin(double a, double b)
+{
+    if (a < b)
+    {
+        return a;
+    }
+    else
+    {
+        return b;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmax()
+ *
+ * INPUTS:
+ *	a	a value
+ *	b	a value
+ *
+ * RETURNS:
+ *	The maximum of the two values.
+ */
+
+static double
+dmax(double a, double b)
+{
+    if (a > b)
+    {
+        return a;
+    }
     else
     {
-        return b;
+        return b;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ll_area()
+ *
+ * INPUTS:
+ *	poly		A list of (lat,lon) pairs
+ *
+ * RETURNS:
+ *	The area of the polygon in square kilometers
+ *
+ * DESCRIPTION:
+ *	Computes the area of the polygon, taking curvature of the
+ *      Earth into account.  See latlong.tcl for a discussion of the
+ *      algorithm and its limitations.
+ */
+
+static double
+ll_area(Points* poly)
+{
+    int    i;
+    double sum;
+
+    /* FIRST, convert the lat/lon points to radians */
+    for (i = 0; i < poly->size; i++)
+    {
+        poly->pts[i].x *= radians;
+        poly->pts[i].y *= radians;
+    }
+
+    /* NEXT, compute the sum. */
+    sum = 0.0;
+
+    for (i = 0; i < poly->size; i++)
+    {
+        int j = (i - 2);
+
+        if (j < 0)
+        {
+            j += poly->size;
+        }
+
+        int k = (i - 1);
+
+        if (k < 0)
+        {
+            k += poly->size;
+        }
+
+        double ilon = poly->pts[i].y;
+        double jlon = poly->pts[j].y;
+        double klat = poly->pts[k].x;
+
+        sum += (ilon - jlon)*sin(klat);
+    }
+
+    double area = -(earthRadius*earthRadius/2.0)*sum;
+
+    return area;
+}
+
+/*
+ * Private Helper Functions
+ */
+
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newLatlongInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a zeroed LatlongInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new LatlongInfo struct, and zeroes it.
+ */
+
+static LatlongInfo*
+newLatlongInfo(void)
+{
+    LatlongInfo* info = (LatlongInfo*)Tcl_Alloc(sizeof(LatlongInfo));
+    memset(info, 0, sizeof(LatlongInfo));
+    info->pointsBuffer = newPoints();
+    info->spheroid = 0;
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newGeotiffInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a zeroed GeotiffInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new GeotiffInfo struct, and zeroes it.
+ */
+
+static GeotiffInfo*
+newGeotiffInfo(void)
+{
+    GeotiffInfo* info = (GeotiffInfo*)Tcl_Alloc(sizeof(GeotiffInfo));
+    memset(info, 0, sizeof(GeotiffInfo));
+    info->tiff = NULL;
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	closeGeotiff()
+ *
+ * INPUTS:
+ *	Pointer to a GeotiffInfo struct
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *  nothing
+ *
+ * DESCRIPTION:
+ *	Closes a Geotiff associated with a Geotiff info and cleans up
+ *  pointers.
+ *
+ */
+
+static void
+closeGeotiff(GeotiffInfo* info)
+{
+    XTIFFClose(info->tiff);
+    info->tiff = NULL;
+    info->gtif = NULL;
+    return;
+}
+
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteLatlongInfo()
+ *
+ * INPUTS:
+ *	none
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a LatlongInfo struct allocated with newLatlongInfo().
+ *
+ * DESCRIPTION:
+ *	Frees the LatlongInfo* data.
+ */
+
+static void
+deleteLatlongInfo(LatlongInfo* p)
+{
+    deletePoints(p->pointsBuffer);
+
+    Tcl_Free((void*)p);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteGeotiffInfo()
+ *
+ * INPUTS:
+ *	A pointer to a GeotiffInfo struct
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *  nothing
+ *
+ * DESCRIPTION:
+ *	Frees the GeotiffInfo* data.
+ */
+
+static void
+deleteGeotiffInfo(GeotiffInfo* g)
+{
+    Tcl_Free((void*)g);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newPoints()
+ *
+ * INPUTS:
+ *	none
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to an initialized Points struct
+ *
+ * DESCRIPTION:
+ *	Allocates and zeros a new Points struct.
+ */
+
+static Points*
+newPoints()
+{
+    Points* p = (Points*)Tcl_Alloc(sizeof(Points));
+    memset(p, 0, sizeof(Points));
+
+    return p;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deletePoints()
+ *
+ * INPUTS:
+ *	none
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a Points struct allocated with newPoints().
+ *
+ * DESCRIPTION:
+ *	Frees the Points* data.
+ */
+
+static void
+deletePoints(Points* p)
+{
+    if (p->pts != NULL)
+    {
+        Tcl_Free((void*)p->pts);
     }
+
+    Tcl_Free((void*)p);
 }
 
+
 /***********************************************************************
  *
  * FUNCTION:
- *	ll_area()
+ *	getBbox()
  *
  * INPUTS:
- *	poly		A list of (lat,lon) pairs
+ *	interp		The Tcl interpreter
+ *      coords		The coordinates: xmin ymin xmax ymax
+ *
+ * OUTPUTS:
+ *	box		A pointer to the Bbox struct.
  *
  * RETURNS:
- *	The area of the polygon in square kilometers
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
  *
  * DESCRIPTION:
- *	Computes the area of the polygon, taking curvature of the
- *      Earth into account.  See latlong.tcl for a discussion of the
- *      algorithm and its limitations.
+ *	Converts a flat list of coordinates into a bounding box.
  */
 
-static double
-ll_area(Points* poly)
+static int
+getBbox(Tcl_Interp* interp, Tcl_Obj* coords, Bbox* box)
 {
-    int    i;
-    double sum;
+    int listc;
+    Tcl_Obj** listv;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-    /* FIRST, convert the lat/lon points to radians */
-    for (i = 0; i < poly->size; i++)
+    if (listc != 4)
     {
-        poly->pts[i].x *= radians;
-        poly->pts[i].y *= radians;
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(
+            result, 
+            "invalid bounding box, expected 4 coordinates, got: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
+        Tcl_AppendStringsToObj(
+            result, 
+            "\"", NULL);
+        
+        return TCL_ERROR;
     }
 
-    /* NEXT, compute the sum. */
-    sum = 0.0;
+    if (Tcl_GetDoubleFromObj(interp, listv[0], &box->xmin) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-    for (i = 0; i < poly->size; i++)
+    if (Tcl_GetDoubleFromObj(interp, listv[1], &box->ymin) != TCL_OK)
     {
-        int j = (i - 2);
+        return TCL_ERROR;
+    }
 
-        if (j < 0)
-        {
-            j += poly->size;
-        }
+    if (Tcl_GetDoubleFromObj(interp, listv[2], &box->xmax) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-        int k = (i - 1);
+    if (Tcl_GetDoubleFromObj(interp, listv[3], &box->ymax) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-        if (k < 0)
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPoint()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      coords		The coordinates: a 2-element Tcl list
+ *
+ * OUTPUTS:
+ *	point		A pointer to the Point struct.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a coordinate pair into a Point.
+ */
+
+static int
+getPoint(Tcl_Interp* interp, Tcl_Obj* coords, Point* point)
+{
+    int listc;
+    Tcl_Obj** listv;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (listc != 2)
+    {
+        Tcl_SetResult(interp, "not a coordinate pair",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[0], &point->x) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[1], &point->y) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPoints()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      coords		The coordinates: an N-element Tcl list
+ *      minSize         Minimum number of points
+ *
+ * OUTPUTS:
+ *	points		A pointer to the Points struct.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a flat list of coordinates into a set of Points.
+ *
+ *      getPoints allocates enough space in points to hold the current 
+ *      Note that it assumes that the points buffer is being reused.
+ *      Initially, the points buffer should be all zeros.
+ */
+
+static int
+getPoints(Tcl_Interp* interp, Tcl_Obj* coords, int minSize, Points* points)
+{
+    int       listc;
+    Tcl_Obj** listv;
+    int       i;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (listc % 2 != 0)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, 
+                               "expected even number of coordinates, got ", 
+                               NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
+        Tcl_AppendStringsToObj(result, ": \"", NULL);
+        Tcl_AppendObjToObj(result, coords);
+        Tcl_AppendStringsToObj(result, "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (listc < 2*minSize)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, "expected at least ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(minSize));
+        Tcl_AppendStringsToObj(result, " point(s), got ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc/2));
+        Tcl_AppendStringsToObj(result, ": \"", NULL);
+        Tcl_AppendObjToObj(result, coords);
+        Tcl_AppendStringsToObj(result, "\"", NULL);
+
+        
+        return TCL_ERROR;
+    }
+
+    points->size = listc/2;
+
+    if (points->maxSize == 0)
+    {
+        points->maxSize = points->size;
+        points->pts = (Point*)Tcl_Alloc(points->size * sizeof(Point));
+    }
+    else if (points->size > points->maxSize)
+    {
+        points->maxSize = points->size;
+        points->pts = (Point*)Tcl_Realloc((char*)points->pts, 
+                                          points->size * sizeof(Point));
+    }
+
+    for (i = 0; i < points->size; i++) {
+        if (Tcl_GetDoubleFromObj(interp, listv[2*i], 
+                                 &points->pts[i].x) != TCL_OK)
         {
-            k += poly->size;
+            return TCL_ERROR;
         }
 
-        double ilon = poly->pts[i].y;
-        double jlon = poly->pts[j].y;
-        double klat = poly->pts[k].x;
-
-        sum += (ilon - jlon)*sin(klat);
+        if (Tcl_GetDoubleFromObj(interp, listv[2*i + 1], 
+                                 &points->pts[i].y) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
     }
-
-    double area = -(earthRadius*earthRadius/2.0)*sum;
-
-    return area;
+    return TCL_OK;
 }
 
-/*
- * Private Helper Functions
- */
-
-
 /***********************************************************************
  *
  * FUNCTION:
- *	newLatlongInfo()
+ *	getLatLong()
  *
  * INPUTS:
- *	nothing
+ *	interp		The Tcl interpreter
+ *      loc		The location: a 2-element Tcl list
  *
  * OUTPUTS:
- *	none
+ *	lat		The latitude
+ *      lon		The longitude
  *
  * RETURNS:
- *	A pointer to a zeroed LatlongInfo struct
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
  *
  * DESCRIPTION:
- *	Allocates a new LatlongInfo struct, and zeroes it.
+ *	Converts a lat/long pair into doubles--or, really, any 
+ *      double-valued coordinate pair.
  */
 
-static LatlongInfo*
-newLatlongInfo(void)
+static int
+getLatLong(Tcl_Interp* interp, Tcl_Obj* loc, double* lat, double* lon)
 {
-    LatlongInfo* info = (LatlongInfo*)Tcl_Alloc(sizeof(LatlongInfo));
-    memset(info, 0, sizeof(LatlongInfo));
-    info->pointsBuffer = newPoints();
-    info->spheroid = 0;
+    int locc;
+    Tcl_Obj** locv;
+    
+    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-    return info;
+    if (locc != 2)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(
+            result, 
+            "expected lat/long pair, got: \"", NULL);
+        Tcl_AppendObjToObj(result, loc);
+        Tcl_AppendStringsToObj(
+            result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[0], lat) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[1], lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	newGeotiffInfo()
+ *	validateLatLong()
  *
  * INPUTS:
- *	nothing
- *
- * OUTPUTS:
- *	none
+ *	interp		The Tcl interpreter
+ *	lat		The latitude
+ *      lon		The longitude
  *
  * RETURNS:
- *	A pointer to a zeroed GeotiffInfo struct
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
  *
  * DESCRIPTION:
- *	Allocates a new GeotiffInfo struct, and zeroes it.
+ *	Validates the lat and lon values.
  */
 
-static GeotiffInfo*
-newGeotiffInfo(void)
+static int
+validateLatLong(Tcl_Interp* interp, double lat, double lon)
 {
-    GeotiffInfo* info = (GeotiffInfo*)Tcl_Alloc(sizeof(GeotiffInfo));
-    memset(info, 0, sizeof(GeotiffInfo));
-    info->tiff = NULL;
+    if (lat < LAT_MIN || lat > LAT_MAX)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
 
-    return info;
+        Tcl_AppendStringsToObj(result, 
+            "invalid latitude, should be ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MIN));
+        Tcl_AppendStringsToObj(result, 
+            " to ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MAX));
+        Tcl_AppendStringsToObj(result, 
+            " degrees: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lat));
+        Tcl_AppendStringsToObj(result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (lon < LON_MIN || lon > LON_MAX)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, 
+            "invalid longitude, should be ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MIN));
+        Tcl_AppendStringsToObj(result, 
+            " to ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MAX));
+        Tcl_AppendStringsToObj(result, 
+            " degrees: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lon));
+        Tcl_AppendStringsToObj(result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	closeGeotiff()
+ *	getBE16(), getBE32(), getBE64()
  *
  * INPUTS:
- *	Pointer to a GeotiffInfo struct
- *
- * OUTPUTS:
- *	none
+ *	bytes		Pointer to the first byte of the value
  *
  * RETURNS:
- *  nothing
+ *	The unsigned big-endian integer at bytes.
  *
  * DESCRIPTION:
- *	Closes a Geotiff associated with a Geotiff info and cleans up
- *  pointers.
- *
+ *	Decodes big-endian integers as written by [binary format S/I/W].
  */
 
-static void
-closeGeotiff(GeotiffInfo* info)
+static unsigned int
+getBE16(const unsigned char* bytes)
 {
-    XTIFFClose(info->tiff);
-    info->tiff = NULL;
-    info->gtif = NULL;
-    return;
+    return ((unsigned int)bytes[0] << 8) | bytes[1];
+}
+
+static unsigned long
+getBE32(const unsigned char* bytes)
+{
+    return ((unsigned long)getBE16(bytes) << 16) | getBE16(bytes + 2);
 }
 
+static Tcl_WideInt
+getBE64(const unsigned char* bytes)
+{
+    return (Tcl_WideInt)(((Tcl_WideUInt)getBE32(bytes) << 32) | 
+                         getBE32(bytes + 4));
+}
 
 /***********************************************************************
  *
  * FUNCTION:
- *	deleteLatlongInfo()
+ *	newUtf8Obj()
  *
  * INPUTS:
- *	none
- *
- * OUTPUTS:
- *	none
+ *	utf8		The utf-8 encoding
+ *	bytes		A UTF-8 string, not null-terminated
+ *	len		The number of bytes
  *
  * RETURNS:
- *	A pointer to a LatlongInfo struct allocated with newLatlongInfo().
+ *	A new string object
  *
  * DESCRIPTION:
- *	Frees the LatlongInfo* data.
+ *	Converts external UTF-8 to a Tcl string.
  */
 
-static void
-deleteLatlongInfo(LatlongInfo* p)
+static Tcl_Obj*
+newUtf8Obj(Tcl_Encoding utf8, const unsigned char* bytes, int len)
 {
-    deletePoints(p->pointsBuffer);
+    Tcl_DString ds;
 
-    Tcl_Free((void*)p);
+    Tcl_ExternalToUtfDString(utf8, (const char*)bytes, len, &ds);
+
+    Tcl_Obj* obj = Tcl_NewStringObj(Tcl_DStringValue(&ds), 
+                                    Tcl_DStringLength(&ds));
+    Tcl_DStringFree(&ds);
+
+    return obj;
 }
 
+/*
+ * dmat(n) Value Functions
+ */
+
 /***********************************************************************
  *
  * FUNCTION:
- *	deleteGeotiffInfo()
+ *	newDmat()
  *
  * INPUTS:
- *	A pointer to a GeotiffInfo struct
- *
- * OUTPUTS:
- *	none
+ *	kind		DMAT_MAT or DMAT_VEC
+ *	rows		Number of rows; 1 for a vector
+ *	cols		Number of columns
+ *	isint		1 if the elements will be integers
  *
  * RETURNS:
- *  nothing
+ *	A new value with its own contiguous, uninitialized storage.
  *
  * DESCRIPTION:
- *	Frees the GeotiffInfo* data.
+ *	Allocates a value and its store.
  */
 
-static void
-deleteGeotiffInfo(GeotiffInfo* g)
+static Dmat*
+newDmat(int kind, int rows, int cols, int isint)
 {
-    Tcl_Free((void*)g);
+    int        size  = rows*cols;
+    DmatStore* store = (DmatStore*) 
+        ckalloc(sizeof(DmatStore) + 
+                (size > 0 ? size - 1 : 0)*sizeof(double));
+
+    store->refCount = 0;
+    store->size     = size;
+
+    Dmat* val = newDmatView(NULL, kind, rows, cols, 0, cols, 1);
+
+    val->store = store;
+    val->isint = isint;
+    store->refCount++;
+
+    return val;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	newPoints()
+ *	newDmatView()
  *
  * INPUTS:
- *	none
- *
- * OUTPUTS:
- *	none
+ *	base		The value whose storage is shared, or NULL
+ *	kind		DMAT_MAT or DMAT_VEC
+ *	rows, cols	The view's dimensions
+ *	offset		Index of the view's element (0,0) in the store
+ *	rstride		Distance between the view's rows
+ *	cstride		Distance between the view's columns
  *
  * RETURNS:
- *	A pointer to an initialized Points struct
+ *	A new value sharing base's storage.
  *
  * DESCRIPTION:
- *	Allocates and zeros a new Points struct.
+ *	Creates a view of an existing value.
  */
 
-static Points*
-newPoints()
+static Dmat*
+newDmatView(Dmat* base, int kind, int rows, int cols, 
+            int offset, int rstride, int cstride)
 {
-    Points* p = (Points*)Tcl_Alloc(sizeof(Points));
-    memset(p, 0, sizeof(Points));
+    Dmat* val = (Dmat*)ckalloc(sizeof(Dmat));
+
+    val->store   = NULL;
+    val->kind    = kind;
+    val->isint   = 0;
+    val->exact   = 1;
+    val->literal = 0;
+    val->rows    = rows;
+    val->cols    = cols;
+    val->offset  = offset;
+    val->rstride = rstride;
+    val->cstride = cstride;
+
+    if (base != NULL) {
+        val->store = base->store;
+        val->isint = base->isint;
+        val->exact = base->exact;
+        val->store->refCount++;
+    }
 
-    return p;
+    return val;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	deletePoints()
+ *	newDmatObj()
  *
  * INPUTS:
- *	none
- *
- * OUTPUTS:
- *	none
+ *	val		A new value
  *
  * RETURNS:
- *	A pointer to a Points struct allocated with newPoints().
+ *	A new Tcl_Obj that owns val.
  *
  * DESCRIPTION:
- *	Frees the Points* data.
+ *	Wraps a value in a Tcl_Obj; the string rep is generated on 
+ *	demand.
  */
 
-static void
-deletePoints(Points* p)
+static Tcl_Obj*
+newDmatObj(Dmat* val)
 {
-    if (p->pts != NULL)
-    {
-        Tcl_Free((void*)p->pts);
-    }
+    Tcl_Obj* obj = Tcl_NewObj();
 
-    Tcl_Free((void*)p);
-}
+    Tcl_InvalidateStringRep(obj);
+    obj->internalRep.twoPtrValue.ptr1 = val;
+    obj->internalRep.twoPtrValue.ptr2 = NULL;
+    obj->typePtr = &dmatType;
 
+    return obj;
+}
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getBbox()
+ *	getDmat()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *      coords		The coordinates: xmin ymin xmax ymax
- *
- * OUTPUTS:
- *	box		A pointer to the Bbox struct.
+ *	obj		A Tcl_Obj
+ *	kind		DMAT_MAT or DMAT_VEC
+ *	valPtr		Returns the value
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	A Tcl result code.
  *
  * DESCRIPTION:
- *	Converts a flat list of coordinates into a bounding box.
+ *	Gets obj's value as a matrix or vector, converting it from its
+ *	list form if it isn't already native.  The string rep is kept, 
+ *	so the conversion is invisible at the Tcl level.  Elements 
+ *	must be numeric.
+ *
+ *	Each element is parsed as expr would parse it, so that the
+ *	value knows whether it is integral, and whether it is exact:
+ *	whether computing on the doubles gives what expr would give.
  */
 
 static int
-getBbox(Tcl_Interp* interp, Tcl_Obj* coords, Bbox* box)
+getDmat(Tcl_Interp* interp, Tcl_Obj* obj, int kind, Dmat** valPtr)
 {
-    int listc;
-    Tcl_Obj** listv;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
+    int       nrows   = 1;
+    int       ncols   = 0;
+    Tcl_Obj** rows    = &obj;
+    int       sawint  = 0;
+    int       sawreal = 0;
+    int       exact   = 1;
+    int       i;
+    int       j;
+
+    static const Tcl_ObjType* doubleType = NULL;
+
+    if (doubleType == NULL) {
+        doubleType = Tcl_GetObjType("double");
     }
 
-    if (listc != 4)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+    if (obj->typePtr == &dmatType) {
+        Dmat* val = (Dmat*)obj->internalRep.twoPtrValue.ptr1;
 
-        Tcl_AppendStringsToObj(
-            result, 
-            "invalid bounding box, expected 4 coordinates, got: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
-        Tcl_AppendStringsToObj(
-            result, 
-            "\"", NULL);
-        
-        return TCL_ERROR;
+        if (val->kind == kind) {
+            *valPtr = val;
+            return TCL_OK;
+        }
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[0], &box->xmin) != TCL_OK)
-    {
-        return TCL_ERROR;
+    /* FIRST, get the rows; a vector is a single row.  Make sure the
+     * string rep exists, as the list rep is about to be replaced. */
+    Tcl_GetString(obj);
+
+    if (kind == DMAT_MAT) {
+        if (Tcl_ListObjGetElements(interp, obj, &nrows, &rows) != TCL_OK) {
+            return TCL_ERROR;
+        }
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[1], &box->ymin) != TCL_OK)
-    {
-        return TCL_ERROR;
+    /* NEXT, parse the rows into a new value. */
+    Dmat*   val  = NULL;
+    double* data = NULL;
+
+    for (i = 0; i < nrows; i++) {
+        Tcl_Obj** elems;
+        int       len;
+
+        if (Tcl_ListObjGetElements(interp, rows[i], &len, &elems) 
+            != TCL_OK) {
+            goto error;
+        }
+
+        if (i == 0) {
+            ncols = len;
+            val   = newDmat(kind, nrows, ncols, 1);
+            data  = val->store->data;
+        } else if (len != ncols) {
+            Tcl_SetObjResult(interp,
+                Tcl_ObjPrintf("row %d has %d elements, expected %d",
+                              i, len, ncols));
+            goto error;
+        }
+
+        for (j = 0; j < len; j++) {
+            Tcl_WideInt ival;
+
+            /* Parsing leaves the element an int, wide int, bignum, or 
+             * double, as expr would see it; integer-valued doubles 
+             * like "1.0" are still doubles. */
+            if (Tcl_GetDoubleFromObj(interp, elems[j], data) != TCL_OK) {
+                goto error;
+            }
+
+            if (elems[j]->typePtr == doubleType) {
+                sawreal = 1;
+            } else {
+                sawint = 1;
+
+                if (Tcl_GetWideIntFromObj(NULL, elems[j], &ival) 
+                    != TCL_OK ||
+                    ival > (Tcl_WideInt)DMAT_MAXINT ||
+                    ival < -(Tcl_WideInt)DMAT_MAXINT) {
+                    exact = 0;
+                } else {
+                    *data = (double)ival;
+                }
+            }
+
+            data++;
+        }
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[2], &box->xmax) != TCL_OK)
-    {
-        return TCL_ERROR;
+    if (val == NULL) {
+        val = newDmat(kind, 0, 0, 1);
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[3], &box->ymax) != TCL_OK)
-    {
-        return TCL_ERROR;
+    val->isint   = !sawreal;
+    val->exact   = exact && !(sawint && sawreal);
+    val->literal = 1;
+
+    /* NEXT, replace obj's internal rep. */
+    if (obj->typePtr != NULL && obj->typePtr->freeIntRepProc != NULL) {
+        obj->typePtr->freeIntRepProc(obj);
     }
 
+    obj->internalRep.twoPtrValue.ptr1 = val;
+    obj->internalRep.twoPtrValue.ptr2 = NULL;
+    obj->typePtr = &dmatType;
+
+    *valPtr = val;
     return TCL_OK;
+
+error:
+    if (val != NULL) {
+        ckfree((char*)val->store);
+        ckfree((char*)val);
+    }
+
+    return TCL_ERROR;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getPoint()
+ *	getDmatPair()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *      coords		The coordinates: a 2-element Tcl list
- *
- * OUTPUTS:
- *	point		A pointer to the Point struct.
+ *	objv		Command words; the operands are objv[2] and objv[3]
+ *	kind		DMAT_MAT or DMAT_VEC
+ *	aPtr, bPtr	Return the values
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	A Tcl result code.
  *
  * DESCRIPTION:
- *	Converts a coordinate pair into a Point.
+ *	Gets two operands.  Converting the second can shimmer the first
+ *	if the first is also an element of the second, so the first is
+ *	fetched again; this is free when it is still native.
  */
 
 static int
-getPoint(Tcl_Interp* interp, Tcl_Obj* coords, Point* point)
+getDmatPair(Tcl_Interp* interp, Tcl_Obj* CONST objv[], int kind, 
+            Dmat** aPtr, Dmat** bPtr)
 {
-    int listc;
-    Tcl_Obj** listv;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
-
-    if (listc != 2)
-    {
-        Tcl_SetResult(interp, "not a coordinate pair",
-                      TCL_STATIC);
-        return TCL_ERROR;
-    }
-
-    if (Tcl_GetDoubleFromObj(interp, listv[0], &point->x) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
-
-    if (Tcl_GetDoubleFromObj(interp, listv[1], &point->y) != TCL_OK)
-    {
+    if (getDmat(interp, objv[2], kind, aPtr) != TCL_OK ||
+        getDmat(interp, objv[3], kind, bPtr) != TCL_OK ||
+        getDmat(interp, objv[2], kind, aPtr) != TCL_OK) {
         return TCL_ERROR;
     }
 
@@ -2456,225 +5113,261 @@ getPoint(Tcl_Interp* interp, Tcl_Obj* coords, Point* point)
 /***********************************************************************
  *
  * FUNCTION:
- *	getPoints()
+ *	getDoubleVec()
+ *	freeDoubleVec()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *      coords		The coordinates: an N-element Tcl list
- *      minSize         Minimum number of points
- *
- * OUTPUTS:
- *	points		A pointer to the Points struct.
+ *	obj		A list of numbers, or a dvec value
+ *	vec		The DoubleVec to fill in or free
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	A Tcl result code.
  *
  * DESCRIPTION:
- *	Converts a flat list of coordinates into a set of Points.
- *
- *      getPoints allocates enough space in points to hold the current 
- *      Note that it assumes that the points buffer is being reused.
- *      Initially, the points buffer should be all zeros.
+ *	Gets the numbers in a list as an array of doubles.  A native 
+ *	dvec value is used in place, without copying or conversion; 
+ *	a list is parsed into a buffer, which freeDoubleVec() frees.
  */
 
 static int
-getPoints(Tcl_Interp* interp, Tcl_Obj* coords, int minSize, Points* points)
+getDoubleVec(Tcl_Interp* interp, Tcl_Obj* obj, DoubleVec* vec)
 {
-    int       listc;
-    Tcl_Obj** listv;
+    Tcl_Obj** elems;
     int       i;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
 
-    if (listc % 2 != 0)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+    vec->buffer = NULL;
 
-        Tcl_AppendStringsToObj(result, 
-                               "expected even number of coordinates, got ", 
-                               NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
-        Tcl_AppendStringsToObj(result, ": \"", NULL);
-        Tcl_AppendObjToObj(result, coords);
-        Tcl_AppendStringsToObj(result, "\"", NULL);
+    if (obj->typePtr == &dmatType) {
+        Dmat* val = (Dmat*)obj->internalRep.twoPtrValue.ptr1;
 
-        return TCL_ERROR;
+        if (val->kind == DMAT_VEC) {
+            vec->data   = val->store->data + val->offset;
+            vec->stride = val->cstride;
+            vec->size   = val->cols;
+            return TCL_OK;
+        }
     }
 
-    if (listc < 2*minSize)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(result, "expected at least ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(minSize));
-        Tcl_AppendStringsToObj(result, " point(s), got ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc/2));
-        Tcl_AppendStringsToObj(result, ": \"", NULL);
-        Tcl_AppendObjToObj(result, coords);
-        Tcl_AppendStringsToObj(result, "\"", NULL);
-
-        
+    if (Tcl_ListObjGetElements(interp, obj, &vec->size, &elems) != TCL_OK) {
         return TCL_ERROR;
     }
 
-    points->size = listc/2;
-
-    if (points->maxSize == 0)
-    {
-        points->maxSize = points->size;
-        points->pts = (Point*)Tcl_Alloc(points->size * sizeof(Point));
-    }
-    else if (points->size > points->maxSize)
-    {
-        points->maxSize = points->size;
-        points->pts = (Point*)Tcl_Realloc((char*)points->pts, 
-                                          points->size * sizeof(Point));
-    }
-
-    for (i = 0; i < points->size; i++) {
-        if (Tcl_GetDoubleFromObj(interp, listv[2*i], 
-                                 &points->pts[i].x) != TCL_OK)
-        {
-            return TCL_ERROR;
-        }
+    vec->buffer = (double*)ckalloc((vec->size + 1)*sizeof(double));
+    vec->data   = vec->buffer;
+    vec->stride = 1;
 
-        if (Tcl_GetDoubleFromObj(interp, listv[2*i + 1], 
-                                 &points->pts[i].y) != TCL_OK)
-        {
+    for (i = 0; i < vec->size; i++) {
+        if (Tcl_GetDoubleFromObj(interp, elems[i], &vec->data[i]) 
+            != TCL_OK) {
+            freeDoubleVec(vec);
             return TCL_ERROR;
         }
     }
+
     return TCL_OK;
 }
 
+static void
+freeDoubleVec(DoubleVec* vec)
+{
+    if (vec->buffer != NULL) {
+        ckfree((char*)vec->buffer);
+        vec->buffer = NULL;
+    }
+}
+
 /***********************************************************************
  *
  * FUNCTION:
- *	getLatLong()
+ *	dmatIsFlat()
  *
  * INPUTS:
- *	interp		The Tcl interpreter
- *      loc		The location: a 2-element Tcl list
- *
- * OUTPUTS:
- *	lat		The latitude
- *      lon		The longitude
+ *	val		A value
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	1 if the value's elements are contiguous in row-major order, 
+ *	and 0 otherwise.
  *
  * DESCRIPTION:
- *	Converts a lat/long pair into doubles--or, really, any 
- *      double-valued coordinate pair.
+ *	Values are flat unless they are column or transpose views.
  */
 
 static int
-getLatLong(Tcl_Interp* interp, Tcl_Obj* loc, double* lat, double* lon)
+dmatIsFlat(Dmat* val)
 {
-    int locc;
-    Tcl_Obj** locv;
-    
-    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    return val->cstride == 1 && (val->rows <= 1 || val->rstride == val->cols);
+}
 
-    if (locc != 2)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmatMaxAbs()
+ *
+ * INPUTS:
+ *	val		A value
+ *
+ * RETURNS:
+ *	The largest absolute value of its elements, or 0.0 if it has 
+ *	none.
+ *
+ * DESCRIPTION:
+ *	Used to check that integer results will fit in 2^53, and so 
+ *	be exact.  Bounds computed from it are compared with >=, as a 
+ *	bound just over 2^53 can round down to 2^53.
+ */
 
-        Tcl_AppendStringsToObj(
-            result, 
-            "expected lat/long pair, got: \"", NULL);
-        Tcl_AppendObjToObj(result, loc);
-        Tcl_AppendStringsToObj(
-            result, 
-            "\"", NULL);
+static double
+dmatMaxAbs(Dmat* val)
+{
+    double max = 0.0;
+    int    i;
+    int    j;
 
-        return TCL_ERROR;
-    }
+    for (i = 0; i < val->rows; i++) {
+        double* row = val->store->data + val->offset + i*val->rstride;
 
-    if (Tcl_GetDoubleFromObj(interp, locv[0], lat) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+        for (j = 0; j < val->cols; j++) {
+            double x = fabs(row[j*val->cstride]);
 
-    if (Tcl_GetDoubleFromObj(interp, locv[1], lon) != TCL_OK)
-    {
-        return TCL_ERROR;
+            if (x > max) {
+                max = x;
+            }
+        }
     }
 
-    return TCL_OK;
+    return max;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	validateLatLong()
+ *	dmatUseTcl()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *	lat		The latitude
- *      lon		The longitude
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	TCL_ERROR, with the error code {DMAT USETCL}.
  *
  * DESCRIPTION:
- *	Validates the lat and lon values.
+ *	Declines an operation whose result would not be what the 
+ *	mat(n) and vec(n) Tcl code returns: integers too large to be 
+ *	exact as doubles, elements that mix integers and reals and so 
+ *	format per element, or a caller's list text that a view would
+ *	reformat.  The Tcl code traps the error code and does the work
+ *	itself.
  */
 
 static int
-validateLatLong(Tcl_Interp* interp, double lat, double lon)
+dmatUseTcl(Tcl_Interp* interp)
 {
-    if (lat < LAT_MIN || lat > LAT_MAX)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_SetResult(interp, 
+                  "value can't be computed natively, use the Tcl code", 
+                  TCL_STATIC);
+    Tcl_SetErrorCode(interp, "DMAT", "USETCL", NULL);
+    return TCL_ERROR;
+}
 
-        Tcl_AppendStringsToObj(result, 
-            "invalid latitude, should be ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MIN));
-        Tcl_AppendStringsToObj(result, 
-            " to ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MAX));
-        Tcl_AppendStringsToObj(result, 
-            " degrees: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lat));
-        Tcl_AppendStringsToObj(result, 
-            "\"", NULL);
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmatFreeIntRep()
+ *	dmatDupIntRep()
+ *	dmatUpdateString()
+ *
+ * INPUTS:
+ *	obj		A "marsutil::dmat" Tcl_Obj
+ *	copy		A new Tcl_Obj
+ *
+ * RETURNS:
+ *	Nothing.
+ *
+ * DESCRIPTION:
+ *	The Tcl_ObjType procs.  Duplicates share the store; the string
+ *	rep is the value as a list, or a list of rows.  Integral values
+ *	format as integers, and others as Tcl formats doubles.
+ */
 
-        return TCL_ERROR;
+static void
+dmatFreeIntRep(Tcl_Obj* obj)
+{
+    Dmat* val = (Dmat*)obj->internalRep.twoPtrValue.ptr1;
+
+    if (--val->store->refCount <= 0) {
+        ckfree((char*)val->store);
     }
 
-    if (lon < LON_MIN || lon > LON_MAX)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+    ckfree((char*)val);
+    obj->typePtr = NULL;
+}
 
-        Tcl_AppendStringsToObj(result, 
-            "invalid longitude, should be ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MIN));
-        Tcl_AppendStringsToObj(result, 
-            " to ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MAX));
-        Tcl_AppendStringsToObj(result, 
-            " degrees: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lon));
-        Tcl_AppendStringsToObj(result, 
-            "\"", NULL);
+static void
+dmatDupIntRep(Tcl_Obj* obj, Tcl_Obj* copy)
+{
+    Dmat* val = (Dmat*)obj->internalRep.twoPtrValue.ptr1;
 
-        return TCL_ERROR;
-    }
+    Dmat* dup = newDmatView(val, val->kind, val->rows, val->cols, 
+                            val->offset, val->rstride, val->cstride);
 
-    return TCL_OK;
+    /* The copy has the same string rep. */
+    dup->literal = val->literal;
+
+    copy->internalRep.twoPtrValue.ptr1 = dup;
+    copy->internalRep.twoPtrValue.ptr2 = NULL;
+    copy->typePtr = &dmatType;
 }
 
+static void
+dmatUpdateString(Tcl_Obj* obj)
+{
+    Dmat*       val = (Dmat*)obj->internalRep.twoPtrValue.ptr1;
+    Tcl_DString ds;
+    char        buf[TCL_DOUBLE_SPACE + 2];
+    int         i;
+    int         j;
+
+    /* Rows are braced as the list commands would brace them: unless
+     * they have exactly one element. */
+    int         brace = (val->kind == DMAT_MAT && val->cols != 1);
 
+    Tcl_DStringInit(&ds);
 
+    for (i = 0; i < val->rows; i++) {
+        double* row = val->store->data + val->offset + i*val->rstride;
 
+        if (i > 0) {
+            Tcl_DStringAppend(&ds, " ", 1);
+        }
+
+        if (brace) {
+            Tcl_DStringAppend(&ds, "{", 1);
+        }
+
+        for (j = 0; j < val->cols; j++) {
+            double x = row[j*val->cstride];
+
+            if (j > 0) {
+                Tcl_DStringAppend(&ds, " ", 1);
+            }
+
+            if (val->isint) {
+                sprintf(buf, "%" TCL_LL_MODIFIER "d", (Tcl_WideInt)x);
+            } else {
+                Tcl_PrintDouble(NULL, x, buf);
+            }
+
+            Tcl_DStringAppend(&ds, buf, -1);
+        }
+
+        if (brace) {
+            Tcl_DStringAppend(&ds, "}", 1);
+        }
+    }
 
+    obj->length = Tcl_DStringLength(&ds);
+    obj->bytes  = ckalloc(obj->length + 1);
+    memcpy(obj->bytes, Tcl_DStringValue(&ds), obj->length + 1);
+
+    Tcl_DStringFree(&ds);
+}